@@ -128,9 +128,9 @@ int main(int argc, char *argv[])
 	else if (strcmp(opts->command, "vanity") == 0)
 	{
 		command_main = &btk_vanity_main;
-		command_requires_input = NULL;  // Vanity doesn't require input
-		command_init = NULL;            // No special init needed
-		command_cleanup = NULL;         // No special cleanup needed
+		command_requires_input = &btk_vanity_requires_input;
+		command_init = &btk_vanity_init;
+		command_cleanup = &btk_vanity_cleanup;
 	}
 	else if (strcmp(opts->command, "help") == 0)
 	{
@@ -33,6 +33,7 @@
 #include "mods/utxokey.h"
 #include "mods/utxovalue.h"
 #include "mods/chainstate.h"
+#include "mods/metrics.h"
 
 #define CHAIN_STATUS_READY    1
 #define CHAIN_STATUS_FINAL    2
@@ -52,6 +53,12 @@ struct thread_args {
 	blockchain bc_head;
 	blockchain bc_tail;
 	int bc_len;
+	char *metrics_path;
+	uint64_t tx_total;
+	uint64_t db_writes;
+	double db_write_seconds;
+	double metrics_time;
+	int metrics_block;
 };
 
 static pthread_t download_thread;
@@ -61,6 +68,9 @@ void *btk_balance_pthread(void *);
 int btk_balance_download(thread_args);
 int btk_balance_process(thread_args);
 void btk_balance_sleep(void);
+int btk_balance_write(thread_args);
+int btk_balance_metrics(thread_args, int, int);
+double btk_balance_now(void);
 
 int btk_balance_main(output_item *output, opts_p opts, unsigned char *input, size_t input_len)
 {
@@ -207,6 +217,7 @@ int btk_balance_main(output_item *output, opts_p opts, unsigned char *input, siz
 		args->bc_head = NULL;
 		args->bc_tail = NULL;
 		args->bc_len = 0;
+		args->metrics_path = opts->metrics_path;
 
 		if (opts->update)
 		{
@@ -221,6 +232,11 @@ int btk_balance_main(output_item *output, opts_p opts, unsigned char *input, siz
 		r = jsonrpc_get_blockcount(&(args->block_count));
 		ERROR_CHECK_NEG(r, "Could not get block count.");
 
+		args->metrics_time = btk_balance_now();
+		args->metrics_block = args->last_block;
+		r = btk_balance_metrics(args, args->last_block, 1);
+		ERROR_CHECK_NEG(r, "Could not write metrics file.");
+
 		r = pthread_create(&download_thread, NULL, &btk_balance_pthread, args);
 		ERROR_CHECK_TRUE(r > 0, "Could not create download thread.");
 
@@ -477,11 +493,8 @@ int btk_balance_process(thread_args args)
 				}
 			}
 
-			r = txoa_batch_write();
-			ERROR_CHECK_NEG(r, "Could not batch write txao records.");
-
-			r = balance_batch_write();
-			ERROR_CHECK_NEG(r, "Could not batch write balance records.");
+			r = btk_balance_write(args);
+			ERROR_CHECK_NEG(r, "Could not write database batches.");
 
 			for (j = 0; j < block->transactions[i]->output_count; j++)
 			{
@@ -513,16 +526,18 @@ int btk_balance_process(thread_args args)
 				}
 			}
 
-			r = txoa_batch_write();
-			ERROR_CHECK_NEG(r, "Could not batch write txao records.");
-
-			r = balance_batch_write();
-			ERROR_CHECK_NEG(r, "Could not batch write balance records.");
+			r = btk_balance_write(args);
+			ERROR_CHECK_NEG(r, "Could not write database batches.");
 		}
 
 		r = txoa_set_last_block(block_num);
 		ERROR_CHECK_NEG(r, "Could not set last block.");
 
+		args->tx_total += block->tx_count;
+
+		r = btk_balance_metrics(args, block_num, (status == CHAIN_STATUS_FINAL));
+		ERROR_CHECK_NEG(r, "Could not write metrics file.");
+
 		if (status == CHAIN_STATUS_FINAL)
 		{
 			break;
@@ -547,6 +562,101 @@ int btk_balance_process(thread_args args)
 	return 1;
 }
 
+double btk_balance_now(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+// Write both database batches, keeping track of how long writes take
+int btk_balance_write(thread_args args)
+{
+	int r;
+	double start;
+
+	start = btk_balance_now();
+
+	r = txoa_batch_write();
+	ERROR_CHECK_NEG(r, "Could not batch write txao records.");
+
+	r = balance_batch_write();
+	ERROR_CHECK_NEG(r, "Could not batch write balance records.");
+
+	args->db_write_seconds += btk_balance_now() - start;
+	args->db_writes += 1;
+
+	return 1;
+}
+
+/*
+ * Rewrite the metrics file, at most once a second unless forced. The
+ * block rate covers the time since the last write.
+ */
+int btk_balance_metrics(thread_args args, int block_num, int force)
+{
+	int r;
+	double now;
+	double interval;
+	struct metrics m;
+
+	if (!args->metrics_path)
+	{
+		return 1;
+	}
+
+	now = btk_balance_now();
+	interval = now - args->metrics_time;
+	if (!force && interval < 1.0)
+	{
+		return 1;
+	}
+
+	metrics_init(&m);
+
+	r = metrics_family(&m, "btk_balance_block", METRICS_TYPE_GAUGE, "Last block processed");
+	ERROR_CHECK_NEG(r, "Could not add metric.");
+	r = metrics_sample(&m, "btk_balance_block", NULL, block_num);
+	ERROR_CHECK_NEG(r, "Could not add metric.");
+
+	r = metrics_family(&m, "btk_balance_block_count", METRICS_TYPE_GAUGE, "Blocks in the node's chain");
+	ERROR_CHECK_NEG(r, "Could not add metric.");
+	r = metrics_sample(&m, "btk_balance_block_count", NULL, args->block_count);
+	ERROR_CHECK_NEG(r, "Could not add metric.");
+
+	r = metrics_family(&m, "btk_balance_blocks_per_second", METRICS_TYPE_GAUGE, "Blocks processed per second since the last update");
+	ERROR_CHECK_NEG(r, "Could not add metric.");
+	r = metrics_sample(&m, "btk_balance_blocks_per_second", NULL, interval > 0 ? (block_num - args->metrics_block) / interval : 0.0);
+	ERROR_CHECK_NEG(r, "Could not add metric.");
+
+	r = metrics_family(&m, "btk_balance_queue_depth", METRICS_TYPE_GAUGE, "Downloaded blocks waiting to be processed");
+	ERROR_CHECK_NEG(r, "Could not add metric.");
+	r = metrics_sample(&m, "btk_balance_queue_depth", NULL, args->bc_len);
+	ERROR_CHECK_NEG(r, "Could not add metric.");
+
+	r = metrics_family(&m, "btk_balance_transactions_total", METRICS_TYPE_COUNTER, "Transactions processed");
+	ERROR_CHECK_NEG(r, "Could not add metric.");
+	r = metrics_sample(&m, "btk_balance_transactions_total", NULL, args->tx_total);
+	ERROR_CHECK_NEG(r, "Could not add metric.");
+
+	r = metrics_family(&m, "btk_balance_db_write_seconds", METRICS_TYPE_SUMMARY, "Time spent writing txoa and balance batches");
+	ERROR_CHECK_NEG(r, "Could not add metric.");
+	r = metrics_sample(&m, "btk_balance_db_write_seconds_sum", NULL, args->db_write_seconds);
+	ERROR_CHECK_NEG(r, "Could not add metric.");
+	r = metrics_sample(&m, "btk_balance_db_write_seconds_count", NULL, args->db_writes);
+	ERROR_CHECK_NEG(r, "Could not add metric.");
+
+	r = metrics_write(&m, args->metrics_path);
+	ERROR_CHECK_NEG(r, "Could not write metrics.");
+
+	args->metrics_time = now;
+	args->metrics_block = block_num;
+
+	return 1;
+}
+
 void btk_balance_sleep(void)
 {
 	struct timespec bcsleep;
@@ -37,6 +37,15 @@ static void print_command_help(const char* command) {
         printf("Options:\n");
         printf("  -C        Use compressed public key format\n");
         printf("  -U        Use uncompressed public key format\n");
+        printf("  --create  Generate a new private key\n");
+        printf("  --count N With --create, write N keys with their pubkeys and addresses\n");
+        printf("            as JSON lines, -L lines or -B binary records\n");
+        printf("            (-B records are 118 bytes: 32 byte key, 1 byte set to 1 for a\n");
+        printf("            compressed pubkey, 65 byte SEC pubkey with compressed ones\n");
+        printf("            zero padded, 20 byte HASH160)\n");
+        printf("  -t N      Threads for --count (default: all CPUs)\n\n");
+        printf("Examples:\n");
+        printf("  btk privkey --create --count 1000000 -L > keys.txt  # A million keys\n");
     } else if (strcmp(command, "pubkey") == 0) {
         printf("btk pubkey - Generate or display public keys\n\n");
         printf("Usage: btk pubkey [options]\n");
@@ -51,19 +60,46 @@ static void print_command_help(const char* command) {
         printf("  --legacy   Generate Legacy address\n");
     } else if (strcmp(command, "vanity") == 0) {
         printf("btk vanity - Generate Bitcoin vanity addresses\n\n");
-        printf("Usage: btk vanity [mode] [pattern] [options]\n\n");
-        printf("Modes:\n");
-        printf("  prefix    Match pattern at start of address\n");
-        printf("  suffix    Match pattern at end of address\n");
-        printf("  anywhere  Match pattern anywhere (default)\n\n");
+        printf("Usage: btk vanity [options] <pattern>\n\n");
+        printf("The pattern is an address prefix, including the leading character of the\n");
+        printf("address type ('1', '3', 'bc1q' or 'bc1p'). Suffixes and matches anywhere in\n");
+        printf("the address go in a --pattern-file, as *xyz and *abc*.\n\n");
         printf("Options:\n");
-        printf("  -i        Case insensitive match (default)\n");
-        printf("  -t N      Number of threads to use (default: 1)\n\n");
+        printf("  -i        Case insensitive match\n");
+        printf("  -t N      Number of threads to use (default: 1, or the --tune result)\n");
+        printf("  --bech32  Search native segwit (bc1q...) addresses by prefix\n");
+        printf("  --p2sh-segwit  Search nested segwit (3...) addresses\n");
+        printf("  --bech32m  Search taproot (bc1p...) addresses by prefix\n");
+        printf("  --also-uncompressed  Also test each key's uncompressed address\n");
+        printf("  --seed TEXT  Repeatable keys for benchmarks, INSECURE\n");
+        printf("  --xpub KEY   Search child indices M/i of an extended public key\n");
+        printf("  --confusable  Pattern characters also match look-alikes (1/l/i, 0/o, 5/S, 8/B)\n");
+        printf("  --pattern-file FILE  Search for every pattern in FILE at once\n");
+        printf("  --checkpoint FILE  Save search progress to FILE\n");
+        printf("  --resume FILE      Continue the search saved in FILE\n");
+        printf("  --continuous       Keep searching, print each match as a JSON line\n");
+        printf("  --count N          Stop after N matches (implies --continuous)\n");
+        printf("  --time SECONDS     Stop after SECONDS (implies --continuous)\n");
+        printf("  --batch-size N     Candidates per batch per thread (default: 256)\n");
+        printf("  --tune             Find the fastest -t and --batch-size, save as defaults\n");
+        printf("  --coordinator ADDR Hand keyspace ranges to workers (unix:/path or host:port)\n");
+        printf("  --range-size N     Candidates per coordinator range (default: 16777216)\n");
+        printf("  --worker ADDR      Search ranges for the coordinator at ADDR\n");
+        printf("  --token-file FILE  Shared secret of a coordinator and its workers; keys still\n");
+        printf("                     cross TCP in the clear\n");
+        printf("  --control PATH     Take status, pause, resume and stop commands on socket PATH\n");
+        printf("  --metrics FILE     Keep Prometheus metrics of the search in FILE\n");
+        printf("  --pin              Pin each thread to its own CPU, local NUMA memory\n");
+        printf("  --skip-smt         Pin to physical cores only (implies --pin)\n\n");
         printf("Examples:\n");
-        printf("  btk vanity abc              # Match 'abc' anywhere\n");
-        printf("  btk vanity prefix abc       # Match 'abc' at start\n");
-        printf("  btk vanity suffix xyz       # Match 'xyz' at end\n");
-        printf("  btk vanity -t 8 abc         # Use 8 threads\n");
+        printf("  btk vanity 1abc             # Match '1abc' at start\n");
+        printf("  btk vanity -i 1abc          # Same, any case\n");
+        printf("  btk vanity -t 8 1abc        # Use 8 threads\n");
+        printf("  echo '*abc*' > p.txt && btk vanity --pattern-file p.txt  # Match 'abc' anywhere\n");
+        printf("  echo '*xyz' > p.txt && btk vanity --pattern-file p.txt   # Match 'xyz' at end\n");
+        printf("  btk vanity --bech32 bc1qxy  # Segwit address starting with 'bc1qxy'\n");
+        printf("  btk vanity --resume s.ckpt 1abcde  # Continue a checkpointed search\n");
+        printf("  btk vanity --count 10 1abc  # Ten addresses starting with '1abc'\n");
     } else {
         printf("Unknown command '%s'. Use 'btk help' for a list of commands.\n", command);
     }
@@ -14,6 +14,7 @@
 #include <stdint.h>
 #include <assert.h>
 #include "mods/privkey.h"
+#include "mods/keygen.h"
 #include "mods/network.h"
 #include "mods/input.h"
 #include "mods/output.h"
@@ -28,6 +29,7 @@ int btk_privkey_get(PrivKey, unsigned char *, size_t);
 int btk_privkey_compression_add(output_item *, PrivKey);
 int btk_privkey_process_rehash(char *);
 int btk_privkey_process_rehash_comp(const void *, const void *);
+int btk_privkey_create_bulk(opts_p);
 
 // Defaults
 static int input_type_wif = 0;
@@ -56,6 +58,12 @@ int btk_privkey_main(output_item *output, opts_p opts, unsigned char *input, siz
 
 	assert(opts);
 
+	// Bulk keys go straight to stdout, not through the output list
+	if (opts->create && opts->count)
+	{
+		return btk_privkey_create_bulk(opts);
+	}
+
 	key = malloc(privkey_sizeof());
 	ERROR_CHECK_NULL(key, "Memory allocation error.");
 
@@ -118,6 +126,62 @@ int btk_privkey_main(output_item *output, opts_p opts, unsigned char *input, siz
 	return 1;
 }
 
+int btk_privkey_create_bulk(opts_p opts)
+{
+	int r;
+	long threads;
+	unsigned int flags = 0;
+	keygen_format_t format = KEYGEN_FORMAT_JSON;
+
+	if (opts->network_test)
+	{
+		network_set_test();
+	}
+	else
+	{
+		network_set_main();
+	}
+
+	// One thread per online CPU unless -t says otherwise
+	threads = opts->threads > 0 ? opts->threads : sysconf(_SC_NPROCESSORS_ONLN);
+	if (threads < 1)
+	{
+		threads = 1;
+	}
+	else if (threads > KEYGEN_MAX_THREADS)
+	{
+		threads = KEYGEN_MAX_THREADS;
+	}
+
+	if (opts->output_format_list)
+	{
+		format = KEYGEN_FORMAT_LIST;
+	}
+	else if (opts->output_format_binary)
+	{
+		format = KEYGEN_FORMAT_BINARY;
+	}
+
+	// Compressed unless asked otherwise, both if asked for both
+	if (compression_on || !compression_off)
+	{
+		flags |= KEYGEN_COMPRESSED;
+	}
+	if (compression_off)
+	{
+		flags |= KEYGEN_UNCOMPRESSED;
+	}
+	if (output_type_hex)
+	{
+		flags |= KEYGEN_HEX;
+	}
+
+	r = keygen_write(stdout, (uint64_t)opts->count, (int)threads, format, flags);
+	ERROR_CHECK_NEG(r, "Could not generate private keys.");
+
+	return 1;
+}
+
 int btk_privkey_get(PrivKey key, unsigned char *input, size_t input_len)
 {
 	int r;
@@ -436,6 +500,18 @@ int btk_privkey_init(opts_p opts)
 		return -1;
 	}
 
+	// Bulk mode writes whole records, keys as WIF or hex
+	if (opts->count)
+	{
+		ERROR_CHECK_FALSE(opts->create, "Option --count needs --create.");
+		ERROR_CHECK_TRUE(rehash, "Can not use rehash option with count.");
+		ERROR_CHECK_TRUE(opts->output_stream, "Can not use stream option with count.");
+		ERROR_CHECK_TRUE(opts->output_grep, "Can not use grep option with count.");
+		ERROR_CHECK_TRUE(opts->output_format_qrcode, "Can not use qrcode output format with count.");
+		ERROR_CHECK_TRUE(output_type_decimal || output_type_raw, "Option --count writes keys as WIF or hex.");
+		ERROR_CHECK_TRUE(output_type_wif && output_type_hex, "Option --count writes keys as WIF or hex, not both.");
+	}
+
 	// Default to wif if no output type specified.
 	if (!output_type_wif && !output_type_hex && !output_type_decimal && !output_type_raw)
 	{
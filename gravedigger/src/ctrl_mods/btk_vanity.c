@@ -17,13 +17,21 @@
 #include <unistd.h>
 #include <stdint.h>
 #include <inttypes.h>
+#include <math.h>
 
 #include "btk_vanity.h"
 #include "mods/debug.h"
-#include "mods/gd_vanity.h"
+#include "mods/vanity.h"
+#include "mods/patternset.h"
+#include "mods/vanitydist.h"
+#include "mods/vanityctl.h"
+#include "mods/metrics.h"
 #include "mods/output.h"
 #include "mods/input.h"
 #include "mods/opts.h"
+#include "mods/json.h"
+#include "mods/config.h"
+#include "mods/error.h"
 
 // ANSI color codes
 #define ANSI_RESET   "\x1b[0m"
@@ -35,6 +43,9 @@
 #define ANSI_MAGENTA "\x1b[35m"
 #define ANSI_CYAN    "\x1b[36m"
 
+#define VANITY_TUNE_TRIAL_MS 400   // Measuring time per calibration setting
+#define VANITY_TOKEN_MAX     256   // Longest --token-file secret, plus one
+
 // Unicode emojis
 #define EMOJI_PICKAXE    "⛏️ "
 #define EMOJI_SPARKLES   "✨ "
@@ -44,7 +55,52 @@
 #define EMOJI_KEY        "🔑 "
 
 // Forward declarations
-static void progress_callback(const vanity_stats_t *stats);
+static void progress_callback(uint64_t attempts, double rate, void *user_data);
+static int print_results(VanitySearch *search);
+static int print_result(const VanityResult *result);
+static int apply_tuning(opts_p opts);
+static int read_token(char *token, size_t size, const char *path);
+static int distribute(opts_p opts, const char *pattern, bool case_sensitive, const char *token);
+static void print_placement(VanitySearch *search, uint32_t num_threads);
+static void print_profile(VanitySearch *search, uint32_t num_threads);
+static void format_duration(char *buf, size_t size, double seconds);
+static int tune(VanitySearch *search, opts_p opts);
+static void format_alternatives(char *buf, size_t size, const pattern_analysis_t *analysis, double rate);
+
+// Matches printed in continuous mode
+static uint64_t count_printed = 0;
+
+// Chances of a match that ETAs are given for
+static const double eta_quantiles[] = {0.5, 0.9, 0.99};
+#define ETA_QUANTILES (sizeof(eta_quantiles) / sizeof(eta_quantiles[0]))
+
+// Expected runtime past which a search gets a warning, 30 days
+#define VANITY_SLOW_SECONDS (30 * 86400.0)
+
+// What the progress callback needs for the metrics file and the slow
+// pattern warning; only the search's monitor thread touches it once
+// the search runs
+typedef struct {
+    VanitySearch *search;
+    const char *path;
+    uint64_t last_attempts[VANITY_MAX_THREADS];
+    uint64_t last_elapsed;
+    bool failed;               // Warned about a failed write already
+    bool analyzable;           // Single base58 pattern, see vanity_analyze()
+    bool rate_checked;         // Checked the pattern at the measured rate
+} VanityMetrics;
+
+static VanityMetrics vanity_metrics;
+static int write_metrics(VanityMetrics *vm);
+
+// Set from the signal handler, polled by the coordinator and worker loops
+static volatile sig_atomic_t interrupt_requested = 0;
+
+static void interrupt_handler(int sig)
+{
+    (void)sig;
+    interrupt_requested = 1;
+}
 
 // Main function for vanity address generation
 int btk_vanity_main(output_item *output, opts_p opts, unsigned char *input, size_t input_len)
@@ -52,120 +108,885 @@ int btk_vanity_main(output_item *output, opts_p opts, unsigned char *input, size
     (void)input;
     (void)input_len;
     
-    // Initialize output if needed
-    if (!*output) {
-        *output = output_new(NULL, 0);
-        if (!*output) {
-            fprintf(stderr, "%sError: Failed to create output item%s\n", ANSI_RED, ANSI_RESET);
-            return -1;
-        }
+    VanitySearch *search = NULL;
+    
+    if (apply_tuning(opts) < 0) {
+        return -1;
     }
     
-    // Get number of threads from options (default to 4)
-    uint32_t num_threads = opts->threads > 0 ? opts->threads : 4;
+    // Threads from -t or the tuned config, otherwise one
+    uint32_t num_threads = opts->threads > 0 ? opts->threads : 1;
     
     // Get case sensitivity from options (default to case sensitive)
     bool case_sensitive = !opts->case_insensitive;
     
-    // Get pattern from input
-    if (opts->input_count < 1) {
-        output_printf(*output, "%sError: Pattern is required%s\n", ANSI_RED, ANSI_RESET);
+    if (opts->output_type_p2wpkh + opts->output_type_p2sh_p2wpkh + opts->output_type_p2wpkh_v1 > 1) {
+        error_log("Choose one of --bech32, --bech32m or --p2sh-segwit.");
         return -1;
     }
-    const char *pattern = opts->input[0];
+    
+    // Segwit addresses only exist for compressed keys
+    if (opts->also_uncompressed &&
+        (opts->output_type_p2wpkh || opts->output_type_p2sh_p2wpkh || opts->output_type_p2wpkh_v1)) {
+        error_log("Option --also-uncompressed is for P2PKH addresses, not segwit.");
+        return -1;
+    }
+    
+    // Ranges fix every key already
+    if (opts->seed && (opts->worker || opts->coordinator)) {
+        error_log("Option --seed is for local searches, not --coordinator or --worker.");
+        return -1;
+    }
+    if (opts->xpub && (opts->worker || opts->coordinator)) {
+        error_log("Option --xpub is for local searches, not --coordinator or --worker.");
+        return -1;
+    }
+    if (opts->confusable && (opts->worker || opts->coordinator)) {
+        error_log("Option --confusable is for local searches, not --coordinator or --worker.");
+        return -1;
+    }
+    if (opts->token_file && !opts->worker && !opts->coordinator) {
+        error_log("Option --token-file is for --coordinator and --worker.");
+        return -1;
+    }
+    
+    // Shared secret of a coordinator and its workers
+    char token[VANITY_TOKEN_MAX];
+    if (opts->token_file && read_token(token, sizeof(token), opts->token_file) < 0) {
+        return -1;
+    }
+    
+    // Workers take everything but the thread count from the coordinator
+    if (opts->worker) {
+        struct sigaction sa = {0};
+        sa.sa_handler = interrupt_handler;
+        sigaction(SIGINT, &sa, NULL);
+        sigaction(SIGTERM, &sa, NULL);
+        
+        fprintf(stderr, "%sWorking for %s with %u thread%s%s\n", ANSI_BOLD, opts->worker, num_threads,
+                num_threads > 1 ? "s" : "", ANSI_RESET);
+        int ranges = vanitydist_work(opts->worker, opts->token_file ? token : NULL, num_threads,
+                                     opts->batch_size, &interrupt_requested);
+        memset(token, 0, sizeof(token));
+        ERROR_CHECK_NEG(ranges, "Worker failed.");
+        fprintf(stderr, "Searched %d range%s\n", ranges, ranges == 1 ? "" : "s");
+        return 1;
+    }
+    
+    // Get pattern from input, or every pattern from a file
+    const char *pattern = NULL;
+    if (opts->pattern_file) {
+        if (opts->input_count > 0) {
+            error_log("Give either a pattern or a pattern file, not both.");
+            return -1;
+        }
+    } else if (opts->input_count < 1) {
+        error_log("Pattern is required.");
+        return -1;
+    } else {
+        pattern = opts->input[0];
+    }
     
     // Initialize debug module
     debug_init(DEBUG_TRACE);
-    debug_info("Starting vanity address search for pattern '%s'", pattern);
+    debug_info("Starting vanity address search for pattern '%s'", pattern ? pattern : opts->pattern_file);
+    
+    if (opts->coordinator) {
+        int r = distribute(opts, pattern, case_sensitive, opts->token_file ? token : NULL);
+        memset(token, 0, sizeof(token));
+        return r;
+    }
+    
+    // Initialize vanity search
+    if (vanity_init(&search, pattern, case_sensitive, num_threads) < 0) {
+        error_log("Failed to initialize vanity search.");
+        return -1;
+    }
+    
+    // Select address type
+    if (opts->output_type_p2wpkh && vanity_set_address_type(search, VANITY_ADDR_P2WPKH) < 0) {
+        error_log("Failed to select bech32 address type.");
+        vanity_cleanup(search);
+        return -1;
+    }
+    if (opts->output_type_p2sh_p2wpkh && vanity_set_address_type(search, VANITY_ADDR_P2SH_P2WPKH) < 0) {
+        error_log("Failed to select nested segwit address type.");
+        vanity_cleanup(search);
+        return -1;
+    }
+    if (opts->output_type_p2wpkh_v1 && vanity_set_address_type(search, VANITY_ADDR_P2TR) < 0) {
+        error_log("Failed to select taproot address type.");
+        vanity_cleanup(search);
+        return -1;
+    }
+    
+    // Test both encodings of every key for the cost of one EC step
+    if (opts->also_uncompressed && vanity_set_uncompressed(search, true) < 0) {
+        error_log("Failed to enable uncompressed addresses.");
+        vanity_cleanup(search);
+        return -1;
+    }
+    
+    if (opts->seed && vanity_set_seed(search, opts->seed) < 0) {
+        error_log("Failed to set seed.");
+        vanity_cleanup(search);
+        return -1;
+    }
+    
+    // Child indices of an extended public key instead of private keys
+    if (opts->xpub && vanity_set_xpub(search, opts->xpub) < 0) {
+        error_log("Failed to set extended public key.");
+        vanity_cleanup(search);
+        return -1;
+    }
     
-    // Initialize vanity search module
-    if (gd_vanity_init(num_threads) < 0) {
-        output_printf(*output, "%sError: Failed to initialize vanity search module%s\n", ANSI_RED, ANSI_RESET);
+    // 1/l/i, 0/o, 5/S and 8/B stand for each other
+    if (opts->confusable && vanity_set_confusable(search, true) < 0) {
+        error_log("Failed to enable look-alike matching.");
+        vanity_cleanup(search);
         return -1;
     }
     
-    // Set progress callback
-    gd_vanity_set_progress_callback(progress_callback);
+    if (opts->pattern_file && vanity_set_pattern_file(search, opts->pattern_file) < 0) {
+        error_log("Failed to set pattern file.");
+        vanity_cleanup(search);
+        return -1;
+    }
+    
+    // Pin workers to CPUs, optionally one per physical core
+    if (opts->pin && vanity_set_affinity(search, opts->skip_smt) < 0) {
+        error_log("Failed to set thread affinity.");
+        vanity_cleanup(search);
+        return -1;
+    }
+    
+    // Measure this machine and keep the best settings in the config
+    if (opts->tune) {
+        int r = tune(search, opts);
+        vanity_cleanup(search);
+        return r;
+    }
+    
+    if (opts->batch_size && vanity_set_batch_size(search, opts->batch_size) < 0) {
+        error_log("Failed to set batch size.");
+        vanity_cleanup(search);
+        return -1;
+    }
+    
+    // Continue a previous search; the checkpoint decides the thread count
+    if (opts->resume_path) {
+        if (vanity_resume(search, opts->resume_path) < 0) {
+            error_log("Failed to resume vanity search.");
+            vanity_cleanup(search);
+            return -1;
+        }
+        num_threads = vanity_get_threads(search);
+    }
+    
+    // A resumed search keeps writing to the checkpoint it came from
+    const char *checkpoint_path = opts->checkpoint_path ? opts->checkpoint_path : opts->resume_path;
+    if (checkpoint_path && vanity_set_checkpoint(search, checkpoint_path, 0) < 0) {
+        error_log("Failed to set checkpoint file.");
+        vanity_cleanup(search);
+        return -1;
+    }
+    
+    // Keep going after a match, up to the count or time limit
+    if (opts->continuous && vanity_set_continuous(search, opts->count, (uint64_t)opts->time_limit * 1000) < 0) {
+        error_log("Failed to set continuous mode.");
+        vanity_cleanup(search);
+        return -1;
+    }
+    
+    // Refuse a pattern no address can match, saying what would do instead
+    pattern_analysis_t analysis;
+    bool analyzable = pattern && !opts->confusable && !opts->output_type_p2wpkh && !opts->output_type_p2wpkh_v1;
+    if (analyzable) {
+        if (vanity_analyze(search, 0.0, 0.0, &analysis) < 0) {
+            vanity_cleanup(search);
+            return -1;
+        }
+        if (analysis.verdict == PATTERN_IMPOSSIBLE) {
+            char alternatives[256];
+            format_alternatives(alternatives, sizeof(alternatives), &analysis, 0.0);
+            if (alternatives[0]) {
+                error_log("Try %s instead.", alternatives);
+            }
+            error_log("%s.", analysis.reason);
+            vanity_cleanup(search);
+            return -1;
+        }
+    }
+    
+    // Set progress callback, which also keeps the metrics file current
+    // and warns once the rate shows the pattern is too slow
+    vanity_metrics.search = search;
+    vanity_metrics.path = opts->metrics_path;
+    vanity_metrics.analyzable = analyzable;
+    vanity_set_progress_callback(search, progress_callback, &vanity_metrics, 1000);
+    
+    // Signals, search events and control commands all wake the wait
+    // loop below. Open it before starting so the workers inherit the
+    // blocked signals.
+    VanityControl *control = NULL;
+    if (vanityctl_open(&control, search, opts->control_path) < 0) {
+        error_log("Failed to set up search control.");
+        vanity_cleanup(search);
+        return -1;
+    }
     
     // Start search
-    if (gd_vanity_start(pattern, case_sensitive) < 0) {
-        output_printf(*output, "%sError: Failed to start vanity search%s\n", ANSI_RED, ANSI_RESET);
-        gd_vanity_cleanup();
+    if (vanity_start(search) < 0) {
+        error_log("Failed to start vanity search.");
+        vanityctl_close(control);
+        vanity_cleanup(search);
+        return -1;
+    }
+    
+    // Fail early on a metrics file that can't be written
+    if (opts->metrics_path && write_metrics(&vanity_metrics) < 0) {
+        error_log("Failed to write metrics file.");
+        vanity_stop(search);
+        vanityctl_close(control);
+        vanity_cleanup(search);
         return -1;
     }
     
     // Print search info
-    output_printf(*output, "%sStarting vanity address search...%s\n", ANSI_BOLD, ANSI_RESET);
-    output_printf(*output, "Pattern: %s%s%s\n", ANSI_BOLD, pattern, ANSI_RESET);
-    output_printf(*output, "Case %ssensitive%s\n", case_sensitive ? "" : "in", ANSI_RESET);
-    output_printf(*output, "Using %u thread%s\n\n", num_threads, num_threads > 1 ? "s" : "");
-    
-    // Wait for result or termination
-    char wif[53] = {0};
-    char address[35] = {0};
+    fprintf(stderr, "%sStarting vanity address search...%s\n", ANSI_BOLD, ANSI_RESET);
+    if (pattern) {
+        fprintf(stderr, "Pattern: %s%s%s\n", ANSI_BOLD, pattern, ANSI_RESET);
+    } else {
+        fprintf(stderr, "Patterns from: %s%s%s\n", ANSI_BOLD, opts->pattern_file, ANSI_RESET);
+    }
+    fprintf(stderr, "Case %ssensitive%s\n", case_sensitive ? "" : "in", ANSI_RESET);
+    if (opts->also_uncompressed) {
+        fprintf(stderr, "Testing compressed and uncompressed addresses of every key\n");
+    }
+    if (opts->confusable) {
+        fprintf(stderr, "Look-alikes match: 1/l/i, 0/o, 5/S, 8/B\n");
+    }
+    if (opts->seed) {
+        fprintf(stderr, "%sWARNING: --seed makes every key predictable. Never send funds to them.%s\n",
+                ANSI_BOLD, ANSI_RESET);
+    }
+    if (opts->xpub) {
+        fprintf(stderr, "Searching child indices M/0 to M/2147483647 of the xpub\n");
+    }
+    double probability = vanity_get_probability(search);
+    if (probability > 0) {
+        fprintf(stderr, "Difficulty: 1 in %.4g, attempts for a", 1.0 / probability);
+        for (size_t i = 0; i < ETA_QUANTILES; i++) {
+            fprintf(stderr, "%s %g%% chance: %.4g", i ? "," : "", eta_quantiles[i] * 100,
+                    vanity_quantile_attempts(probability, eta_quantiles[i]));
+        }
+        fprintf(stderr, "\n");
+    }
+    fprintf(stderr, "Using %u thread%s\n", num_threads, num_threads > 1 ? "s" : "");
+    if (opts->batch_size) {
+        fprintf(stderr, "Batch size %d\n", opts->batch_size);
+    }
+    print_placement(search, num_threads);
+    if (opts->resume_path) {
+        fprintf(stderr, "Resuming from %s after %" PRIu64 " attempts\n", opts->resume_path, vanity_get_attempts(search));
+    }
+    if (checkpoint_path) {
+        fprintf(stderr, "Checkpointing to %s\n", checkpoint_path);
+    }
+    if (opts->control_path) {
+        fprintf(stderr, "Control socket: %s\n", opts->control_path);
+    }
+    if (opts->metrics_path) {
+        fprintf(stderr, "Metrics file: %s\n", opts->metrics_path);
+    }
+    if (opts->continuous) {
+        fprintf(stderr, "Continuous mode");
+        if (opts->count) {
+            fprintf(stderr, ", stopping after %d match%s", opts->count, opts->count == 1 ? "" : "es");
+        }
+        if (opts->time_limit) {
+            fprintf(stderr, ", stopping after %d second%s", opts->time_limit, opts->time_limit == 1 ? "" : "s");
+        }
+        fprintf(stderr, "\n");
+    }
+    fprintf(stderr, "\n");
+    
+    // Wait for result or termination. An xpub search finds M/<index>
+    // in place of a WIF.
+    char wif[PRIVKEY_WIF_LENGTH_MAX + 1] = {0};
+    uint32_t index = 0;
+    char address[KEYBATCH_ADDR_LEN] = {0};
+    char matched[PATTERNSET_MAX_LENGTH + 3] = {0};
     bool found = false;
     bool interrupted = false;
     
-    // Set up signal handler
-    struct sigaction sa = {0};
-    sa.sa_handler = SIG_IGN;
-    sigaction(SIGINT, &sa, NULL);
-    
     while (!found && !interrupted) {
-        if (gd_vanity_get_result(wif, address)) {
-            found = true;
+        // Continuous mode streams matches until the search stops itself
+        if (opts->continuous && print_results(search) < 0) {
             break;
         }
         
-        // Check if search was interrupted
-        if (access("/tmp/vanity_stop", F_OK) == 0) {
-            interrupted = true;
+        if (vanity_found(search)) {
+            if (opts->xpub) {
+                found = vanity_get_index(search, &index) == 0;
+                snprintf(wif, sizeof(wif), "M/%" PRIu32, index);
+            } else {
+                found = vanity_get_wif(search, wif, sizeof(wif)) == 0;
+            }
+            found = found && vanity_get_address(search, address, sizeof(address)) == 0;
+            if (found) {
+                snprintf(matched, sizeof(matched), "%s", vanity_get_pattern(search));
+            }
+            break;
+        }
+        
+        // Workers stop on their own at a continuous mode limit, or if the
+        // pipeline failed
+        if (vanity_is_stopped(search)) {
             break;
         }
         
-        usleep(100000);  // Sleep for 100ms
+        // Stop cleanly on interrupt or a stop command so the final
+        // checkpoint gets written
+        int events = vanityctl_wait(control, -1);
+        if (events < 0) {
+            break;
+        }
+        if (events & (VANITYCTL_INTERRUPT | VANITYCTL_STOP)) {
+            interrupted = true;
+            break;
+        }
     }
     
-    // Stop search and clean up
-    gd_vanity_stop();
-    gd_vanity_cleanup();
-    
-    // Remove stop file if it exists
-    unlink("/tmp/vanity_stop");
+    // Stop search, print whatever the workers queued on the way out, and
+    // clean up
+    vanity_stop(search);
+    bool printed = opts->continuous && print_results(search) == 0;
+    if (opts->metrics_path) {
+        write_metrics(&vanity_metrics);
+    }
+    vanityctl_close(control);
+    print_profile(search, num_threads);
+    vanity_cleanup(search);
     
-    if (found) {
+    if (opts->continuous) {
+        // Results went to stdout as they were found
+        fprintf(stderr, "\n%s%" PRIu64 " matching address%s found%s\n", ANSI_BOLD,
+                count_printed, count_printed == 1 ? "" : "es", ANSI_RESET);
+        if (!printed) {
+            return -1;
+        }
+        return 1;
+    } else if (found) {
         // Output result
-        output_printf(*output, "\n%sFound matching address!%s\n", ANSI_BOLD, ANSI_RESET);
-        output_printf(*output, "Private key (WIF): %s%s%s\n", ANSI_BOLD, wif, ANSI_RESET);
-        output_printf(*output, "Address: %s%s%s\n", ANSI_BOLD, address, ANSI_RESET);
-        return 0;
+        fprintf(stderr, "\n%sFound matching address!%s\n", ANSI_BOLD, ANSI_RESET);
+        *output = output_append_new_copy(*output, wif, strlen(wif) + 1);
+        ERROR_CHECK_NULL(*output, "Memory allocation error.");
+        *output = output_append_new_copy(*output, address, strlen(address) + 1);
+        ERROR_CHECK_NULL(*output, "Memory allocation error.");
+        // With a pattern file, say which pattern the address is for
+        if (opts->pattern_file) {
+            *output = output_append_new_copy(*output, matched, strlen(matched) + 1);
+            ERROR_CHECK_NULL(*output, "Memory allocation error.");
+        }
+        return 1;
     } else if (interrupted) {
-        output_printf(*output, "\n%sSearch interrupted by user%s\n", ANSI_YELLOW, ANSI_RESET);
+        fprintf(stderr, "\n%sSearch interrupted by user%s\n", ANSI_YELLOW, ANSI_RESET);
         return 1;
     } else {
-        output_printf(*output, "%sSearch terminated without finding a match%s\n", ANSI_RED, ANSI_RESET);
+        error_log("Search terminated without finding a match.");
         return -1;
     }
 }
 
-// Progress callback function
-static void progress_callback(const vanity_stats_t *stats)
+/*
+ * Print every queued continuous mode match as one JSON object per line,
+ * so another program can consume them while the search keeps running
+ */
+static int print_results(VanitySearch *search)
+{
+    VanityResult result;
+    int r = 0;
+    
+    while (vanity_next_result(search, &result)) {
+        if (print_result(&result) < 0) {
+            r = -1;
+        }
+        memset(&result, 0, sizeof(result));
+    }
+    
+    return r;
+}
+
+static int print_result(const VanityResult *result)
+{
+    cJSON *jobj = NULL;
+    char *line = NULL;
+    int r = 0;
+    
+    if (json_init_object(&jobj) < 0 ||
+        json_add_string(jobj, (char *)result->address, "address") < 0 ||
+        (result->index < 0 ? json_add_string(jobj, (char *)result->wif, "wif")
+                           : json_add_number(jobj, (double)result->index, "index")) < 0 ||
+        json_add_string(jobj, (char *)result->pattern, "pattern") < 0 ||
+        json_add_number(jobj, result->pattern_id, "pattern_id") < 0 ||
+        json_add_number(jobj, (double)result->attempts, "attempts") < 0 ||
+        json_add_number(jobj, result->timestamp_ms / 1000.0, "timestamp") < 0 ||
+        (line = cJSON_PrintUnformatted(jobj)) == NULL) {
+        error_log("Could not format vanity result.");
+        r = -1;
+    } else {
+        // Clear the progress line so the two don't run together
+        fprintf(stderr, "\r\x1b[K");
+        fprintf(stdout, "%s\n", line);
+        fflush(stdout);
+        count_printed++;
+        memset(line, 0, strlen(line));
+    }
+    free(line);
+    if (jobj) {
+        json_free(jobj);
+    }
+    
+    return r;
+}
+
+static void dist_result(const VanityResult *result, void *user_data)
 {
-    if (!stats) {
+    (void)user_data;
+    
+    print_result(result);
+}
+
+static void dist_progress(uint64_t attempts, double rate, int workers, void *user_data)
+{
+    const char *metrics_path = user_data;
+    
+    if (metrics_path) {
+        struct metrics m;
+        metrics_init(&m);
+        if (metrics_family(&m, "btk_vanity_attempts_total", METRICS_TYPE_COUNTER,
+                           "Candidate keys tried by every worker") < 0 ||
+            metrics_sample(&m, "btk_vanity_attempts_total", NULL, (double)attempts) < 0 ||
+            metrics_family(&m, "btk_vanity_average_candidates_per_second", METRICS_TYPE_GAUGE,
+                           "Candidate keys tried per second by every worker since the search started") < 0 ||
+            metrics_sample(&m, "btk_vanity_average_candidates_per_second", NULL, rate) < 0 ||
+            metrics_family(&m, "btk_vanity_workers", METRICS_TYPE_GAUGE, "Connected workers") < 0 ||
+            metrics_sample(&m, "btk_vanity_workers", NULL, workers) < 0 ||
+            metrics_write(&m, (char *)metrics_path) < 0) {
+            if (!vanity_metrics.failed) {
+                fprintf(stderr, "\r\x1b[K%sCould not write metrics file %s%s\n", ANSI_YELLOW, metrics_path,
+                        ANSI_RESET);
+            }
+            vanity_metrics.failed = true;
+        }
+    }
+    
+    fprintf(stderr, "\r%sSearching...%s %" PRIu64 " attempts (%.2fK/s) on %d worker%s\x1b[K",
+            ANSI_BOLD, ANSI_RESET, attempts, rate / 1000.0, workers, workers == 1 ? "" : "s");
+    fflush(stderr);
+}
+
+/*
+ * Fall back to the saved --tune results where -t and --batch-size
+ * weren't given, but only on the machine they were measured on: a home
+ * directory shared between hosts carries no tuning from one to another.
+ */
+static int apply_tuning(opts_p opts)
+{
+    char host[VANITY_TUNE_HOST_LEN];
+    
+    if (opts->tune || !opts->tuned_host) {
+        return 0;
+    }
+    if (vanity_tune_host(host, sizeof(host)) < 0) {
+        error_log("Could not identify this machine.");
+        return -1;
+    }
+    if (strcmp(host, opts->tuned_host) != 0) {
+        return 0;
+    }
+    
+    if (!opts->threads) {
+        opts->threads = opts->tuned_threads;
+    }
+    if (!opts->batch_size) {
+        opts->batch_size = opts->tuned_batch_size;
+    }
+    return 0;
+}
+
+// The first line of a token file, without its line ending
+static int read_token(char *token, size_t size, const char *path)
+{
+    FILE *file = fopen(path, "r");
+    if (!file) {
+        error_log("Could not open token file %s.", path);
+        return -1;
+    }
+    bool read = fgets(token, size, file) != NULL;
+    fclose(file);
+    if (!read) {
+        error_log("Token file %s is empty.", path);
+        return -1;
+    }
+    token[strcspn(token, "\r\n")] = '\0';
+    if (token[0] == '\0') {
+        error_log("Token file %s is empty.", path);
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * Hand keyspace ranges to workers and print their matches as JSON
+ * lines. Without --continuous, --count or --time the first match ends
+ * the search, as it would locally.
+ */
+static int distribute(opts_p opts, const char *pattern, bool case_sensitive, const char *token)
+{
+    VanityDistJob job = {0};
+    struct sigaction sa = {0};
+    
+    job.address_type = opts->output_type_p2wpkh        ? VANITY_ADDR_P2WPKH
+                       : opts->output_type_p2sh_p2wpkh ? VANITY_ADDR_P2SH_P2WPKH
+                       : opts->output_type_p2wpkh_v1   ? VANITY_ADDR_P2TR
+                                                       : VANITY_ADDR_P2PKH;
+    job.case_sensitive = case_sensitive;
+    job.uncompressed = opts->also_uncompressed;
+    job.pattern = pattern;
+    job.pattern_file = opts->pattern_file;
+    job.max_results = opts->continuous ? (uint64_t)opts->count : 1;
+    job.max_ms = (uint64_t)opts->time_limit * 1000;
+    job.range_length = (uint64_t)opts->range_size;
+    job.token = token;
+    
+    sa.sa_handler = interrupt_handler;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    
+    fprintf(stderr, "%sCoordinating vanity search on %s%s\n", ANSI_BOLD, opts->coordinator, ANSI_RESET);
+    int r = vanitydist_coordinate(opts->coordinator, &job, dist_result, dist_progress, opts->metrics_path,
+                                  &interrupt_requested);
+    ERROR_CHECK_NEG(r, "Coordinator failed.");
+    
+    fprintf(stderr, "\n%s%d matching address%s found%s\n", ANSI_BOLD, r, r == 1 ? "" : "es", ANSI_RESET);
+    return 1;
+}
+
+// Report the topology and which CPU every pinned thread went to
+static void print_placement(VanitySearch *search, uint32_t num_threads)
+{
+    const Topology *topo = vanity_get_topology(search);
+    if (!topo) {
+        return;
+    }
+    
+    fprintf(stderr, "Topology: %d NUMA node%s, %d package%s, %d core%s, %d CPU%s\n",
+            topo->nodes, topo->nodes == 1 ? "" : "s", topo->packages, topo->packages == 1 ? "" : "s",
+            topo->cores, topo->cores == 1 ? "" : "s", topo->count, topo->count == 1 ? "" : "s");
+    bool shared = false;
+    fprintf(stderr, "Pinned to CPU (node):");
+    for (uint32_t i = 0; i < num_threads; i++) {
+        int node;
+        int cpu = vanity_get_worker_cpu(search, i, &node);
+        fprintf(stderr, " %d (%d)", cpu, node);
+        for (uint32_t j = 0; j < i; j++) {
+            shared |= vanity_get_worker_cpu(search, j, NULL) == cpu;
+        }
+    }
+    fprintf(stderr, "\n");
+    
+    if (shared) {
+        fprintf(stderr, "%sMore threads than CPUs; some CPUs run several%s\n", ANSI_YELLOW, ANSI_RESET);
+    }
+}
+
+/*
+ * Where the time went, per candidate and stage, in builds made with
+ * VANITY_PROFILE. Prints nothing otherwise.
+ */
+static void print_profile(VanitySearch *search, uint32_t num_threads)
+{
+    const char *unit = vanity_profile_unit();
+    VanityProfile profile;
+    uint64_t total = 0;
+    
+    if (!unit || vanity_get_profile(search, -1, &profile) < 0 || profile.candidates == 0) {
         return;
     }
+    for (int i = 0; i < VANITY_PROFILE_STAGES; i++) {
+        total += profile.ticks[i];
+    }
+    
+    fprintf(stderr, "\n%sStage profile (%s per candidate, %" PRIu64 " candidates)%s\n", ANSI_BOLD, unit,
+            profile.candidates, ANSI_RESET);
+    for (int i = 0; i < VANITY_PROFILE_STAGES; i++) {
+        fprintf(stderr, "  %-10s %12.1f %6.1f%%\n", vanity_profile_stage_name(i),
+                (double)profile.ticks[i] / profile.candidates, total ? 100.0 * profile.ticks[i] / total : 0.0);
+    }
+    fprintf(stderr, "  %-10s %12.1f\n", "total", (double)total / profile.candidates);
+    
+    for (uint32_t t = 0; num_threads > 1 && t < num_threads; t++) {
+        uint64_t thread_total = 0;
+        if (vanity_get_profile(search, t, &profile) < 0 || profile.candidates == 0) {
+            continue;
+        }
+        for (int i = 0; i < VANITY_PROFILE_STAGES; i++) {
+            thread_total += profile.ticks[i];
+        }
+        fprintf(stderr, "  thread %-3u %12.1f\n", t, (double)thread_total / profile.candidates);
+    }
+}
+
+static void tune_callback(const VanityTuning *trial, void *user_data)
+{
+    (void)user_data;
+    
+    fprintf(stderr, "  %3d thread%s, batch %4zu: %10.2fK/s\n", trial->threads,
+            trial->threads == 1 ? " " : "s", trial->batch_size, trial->rate / 1000.0);
+}
+
+/*
+ * Calibrate thread count and batch size, print the winner as a JSON
+ * line and cache it in the config, where later searches on this
+ * machine pick it up unless -t or --batch-size say otherwise
+ */
+static int tune(VanitySearch *search, opts_p opts)
+{
+    int r;
+    VanityTuning best;
+    char host[VANITY_TUNE_HOST_LEN];
+    char config_path[BUFSIZ];
+    char value[32];
+    cJSON *jobj = NULL;
+    char *line;
+    
+    // Up to one thread per online CPU unless -t gives the limit
+    long max_threads = opts->threads > 0 ? opts->threads : sysconf(_SC_NPROCESSORS_ONLN);
+    if (max_threads < 1) {
+        max_threads = 1;
+    } else if (max_threads > VANITY_MAX_THREADS) {
+        max_threads = VANITY_MAX_THREADS;
+    }
+    
+    fprintf(stderr, "%sCalibrating with up to %ld thread%s...%s\n", ANSI_BOLD, max_threads,
+            max_threads == 1 ? "" : "s", ANSI_RESET);
+    
+    r = vanity_tune(search, (int)max_threads, VANITY_TUNE_TRIAL_MS, &best, tune_callback, NULL);
+    ERROR_CHECK_NEG(r, "Calibration failed.");
+    
+    r = vanity_tune_host(host, sizeof(host));
+    ERROR_CHECK_NEG(r, "Could not identify this machine.");
+    
+    memset(config_path, 0, BUFSIZ);
+    r = config_get_path(config_path, opts->test);
+    ERROR_CHECK_NEG(r, "Could not get config path.");
+    
+    r = config_load(config_path);
+    ERROR_CHECK_NEG(r, "Could not load config.");
+    
+    snprintf(value, sizeof(value), "%d", best.threads);
+    r = config_set("vanity-threads", value);
+    ERROR_CHECK_NEG(r, "Could not set config.");
+    snprintf(value, sizeof(value), "%zu", best.batch_size);
+    r = config_set("vanity-batch-size", value);
+    ERROR_CHECK_NEG(r, "Could not set config.");
+    r = config_set("vanity-tune-host", host);
+    ERROR_CHECK_NEG(r, "Could not set config.");
+    
+    r = config_write(config_path);
+    ERROR_CHECK_NEG(r, "Could not write config.");
+    config_unload();
+    
+    fprintf(stderr, "%sBest: %d thread%s, batch %zu (%.2fK/s), saved to %s%s\n", ANSI_BOLD, best.threads,
+            best.threads == 1 ? "" : "s", best.batch_size, best.rate / 1000.0, config_path, ANSI_RESET);
+    
+    r = json_init_object(&jobj);
+    ERROR_CHECK_NEG(r, "Could not format calibration result.");
+    if (json_add_number(jobj, best.threads, "threads") < 0 ||
+        json_add_number(jobj, (double)best.batch_size, "batch_size") < 0 ||
+        json_add_number(jobj, best.rate, "rate") < 0 ||
+        json_add_string(jobj, host, "host") < 0 ||
+        (line = cJSON_PrintUnformatted(jobj)) == NULL) {
+        json_free(jobj);
+        error_log("Could not format calibration result.");
+        return -1;
+    }
+    fprintf(stdout, "%s\n", line);
+    free(line);
+    json_free(jobj);
+    
+    return 1;
+}
+
+/*
+ * Rewrite the metrics file. Per-thread rates cover the time since the
+ * last write, so a slow core or a throttled host shows up right away.
+ */
+static int write_metrics(VanityMetrics *vm)
+{
+    struct metrics m;
+    char labels[32];
+    VanitySearch *search = vm->search;
+    int threads = vanity_get_threads(search);
+    uint64_t attempts = vanity_get_attempts(search);
+    uint64_t elapsed = vanity_get_elapsed(search);
+    double interval = elapsed > vm->last_elapsed ? (elapsed - vm->last_elapsed) / 1000.0 : 0.0;
+    double rate = elapsed > 0 ? attempts * 1000.0 / elapsed : 0.0;
+    double p = vanity_get_probability(search);
+    int r = 1;
+    
+    metrics_init(&m);
+    
+    r = metrics_family(&m, "btk_vanity_attempts_total", METRICS_TYPE_COUNTER, "Candidate keys tried");
+    if (r > 0) r = metrics_sample(&m, "btk_vanity_attempts_total", NULL, (double)attempts);
+    
+    if (r > 0) r = metrics_family(&m, "btk_vanity_candidates_per_second", METRICS_TYPE_GAUGE,
+                                  "Candidate keys tried per second by one thread since the last update");
+    for (int i = 0; i < threads && r > 0; i++) {
+        uint64_t thread_attempts = vanity_get_thread_attempts(search, i);
+        snprintf(labels, sizeof(labels), "thread=\"%d\"", i);
+        r = metrics_sample(&m, "btk_vanity_candidates_per_second", labels,
+                           interval > 0 ? (thread_attempts - vm->last_attempts[i]) / interval : 0.0);
+        vm->last_attempts[i] = thread_attempts;
+    }
+    vm->last_elapsed = elapsed;
+    
+    if (r > 0) r = metrics_family(&m, "btk_vanity_average_candidates_per_second", METRICS_TYPE_GAUGE,
+                                  "Candidate keys tried per second since the search started");
+    if (r > 0) r = metrics_sample(&m, "btk_vanity_average_candidates_per_second", NULL, rate);
+    if (r > 0) r = metrics_family(&m, "btk_vanity_elapsed_seconds", METRICS_TYPE_GAUGE,
+                                  "Time spent searching, pauses excluded");
+    if (r > 0) r = metrics_sample(&m, "btk_vanity_elapsed_seconds", NULL, elapsed / 1000.0);
+    if (r > 0) r = metrics_family(&m, "btk_vanity_threads", METRICS_TYPE_GAUGE, "Search threads");
+    if (r > 0) r = metrics_sample(&m, "btk_vanity_threads", NULL, threads);
+    if (r > 0) r = metrics_family(&m, "btk_vanity_paused", METRICS_TYPE_GAUGE, "1 while the search is paused");
+    if (r > 0) r = metrics_sample(&m, "btk_vanity_paused", NULL, vanity_is_paused(search) ? 1 : 0);
+    if (r > 0) r = metrics_family(&m, "btk_vanity_matches_total", METRICS_TYPE_COUNTER, "Matching addresses found");
+    if (r > 0) r = metrics_sample(&m, "btk_vanity_matches_total", NULL, (double)vanity_get_matches(search));
+    if (r > 0) r = metrics_family(&m, "btk_vanity_queue_depth", METRICS_TYPE_GAUGE,
+                                  "Matches found but not printed yet");
+    if (r > 0) r = metrics_sample(&m, "btk_vanity_queue_depth", NULL, (double)vanity_get_queue_depth(search));
+    
+    // Matching is memoryless, so the expected wait never shrinks with time spent
+    if (p > 0) {
+        if (r > 0) r = metrics_family(&m, "btk_vanity_match_probability", METRICS_TYPE_GAUGE,
+                                      "Estimated chance that one candidate matches");
+        if (r > 0) r = metrics_sample(&m, "btk_vanity_match_probability", NULL, p);
+        if (rate > 0) {
+            if (r > 0) r = metrics_family(&m, "btk_vanity_expected_seconds", METRICS_TYPE_GAUGE,
+                                          "Expected time to the next match at the average rate");
+            if (r > 0) r = metrics_sample(&m, "btk_vanity_expected_seconds", NULL, 1.0 / (p * rate));
+        }
+    }
+    
+    if (r > 0 && vanity_get_eta(search, eta_quantiles[0]) >= 0) {
+        r = metrics_family(&m, "btk_vanity_eta_seconds", METRICS_TYPE_GAUGE,
+                           "Time until the chance of the next match reaches the quantile");
+        for (size_t i = 0; i < ETA_QUANTILES && r > 0; i++) {
+            snprintf(labels, sizeof(labels), "quantile=\"%g\"", eta_quantiles[i]);
+            r = metrics_sample(&m, "btk_vanity_eta_seconds", labels, vanity_get_eta(search, eta_quantiles[i]));
+        }
+    }
+    
+    if (r > 0) r = metrics_write(&m, (char *)vm->path);
+    
+    return r;
+}
+
+// Progress callback function
+static void progress_callback(uint64_t attempts, double rate, void *user_data)
+{
+    VanityMetrics *vm = user_data;
+    
+    // Keep searching if the metrics file goes away; say so once
+    if (vm && vm->path && write_metrics(vm) < 0 && !vm->failed) {
+        fprintf(stderr, "\r\x1b[K%sCould not write metrics file %s%s\n", ANSI_YELLOW, vm->path, ANSI_RESET);
+        vm->failed = true;
+    }
+    
+    // Format progress message, with the ETA once the rate is known
+    char msg[256], eta[32];
     
-    // Calculate rate
-    double rate = stats->attempts / stats->elapsed_time;
+    // Say once if the pattern will take too long at this rate
+    if (vm && vm->analyzable && !vm->rate_checked && rate > 0) {
+        pattern_analysis_t analysis;
+        char alternatives[256];
+        
+        vm->rate_checked = true;
+        if (vanity_analyze(vm->search, rate, VANITY_SLOW_SECONDS, &analysis) == 0 &&
+            analysis.verdict == PATTERN_SLOW) {
+            format_duration(eta, sizeof(eta), analysis.seconds);
+            format_alternatives(alternatives, sizeof(alternatives), &analysis, rate);
+            fprintf(stderr, "\r\x1b[K%sWARNING: expected to take %s at this rate%s%s%s\n", ANSI_YELLOW, eta,
+                    alternatives[0] ? ", try " : "", alternatives, ANSI_RESET);
+        }
+    }
     
-    // Format progress message
-    char msg[256];
-    snprintf(msg, sizeof(msg), "%sSearching...%s %zu attempts (%.2fK/s)", 
-             ANSI_BOLD, ANSI_RESET, stats->attempts, rate / 1000.0);
+
+    size_t len = snprintf(msg, sizeof(msg), "%sSearching...%s %" PRIu64 " attempts (%.2fK/s)", 
+                          ANSI_BOLD, ANSI_RESET, attempts, rate / 1000.0);
+    for (size_t i = 0; vm && i < ETA_QUANTILES && len < sizeof(msg); i++) {
+        double seconds = vanity_get_eta(vm->search, eta_quantiles[i]);
+        if (seconds < 0) {
+            break;
+        }
+        format_duration(eta, sizeof(eta), seconds);
+        len += snprintf(msg + len, sizeof(msg) - len, "%s %g%% %s", i ? "," : ", ETA", eta_quantiles[i] * 100, eta);
+    }
     
     // Print progress
-    printf("\r%s", msg);
-    fflush(stdout);
+    fprintf(stderr, "\r%s\x1b[K", msg);
+    fflush(stderr);
+}
+
+// Short duration for the progress line: 45s, 12m 3s, 5h 2m, 3d 4h, 2.1e+04y
+static void format_duration(char *buf, size_t size, double seconds)
+{
+    if (seconds < 60) {
+        snprintf(buf, size, "%.0fs", floor(seconds));
+    } else if (seconds < 3600) {
+        snprintf(buf, size, "%.0fm %.0fs", floor(seconds / 60), floor(fmod(seconds, 60)));
+    } else if (seconds < 86400) {
+        snprintf(buf, size, "%.0fh %.0fm", floor(seconds / 3600), floor(fmod(seconds, 3600) / 60));
+    } else if (seconds < 365 * 86400.0) {
+        snprintf(buf, size, "%.0fd %.0fh", floor(seconds / 86400), floor(fmod(seconds, 86400) / 3600));
+    } else {
+        snprintf(buf, size, "%.3gy", seconds / (365.25 * 86400));
+    }
+}
+
+/*
+ * What to search for instead of a pattern that is impossible or slow:
+ * its base58 respelling, case-insensitive matching and a shorter cut,
+ * each with its expected runtime if the rate is known
+ */
+static void format_alternatives(char *buf, size_t size, const pattern_analysis_t *analysis, double rate)
+{
+    char items[4][PATTERN_MAX_LENGTH + 40], eta[32];
+    size_t count = 0, len = 0;
+    
+    if (analysis->respelling[0]) {
+        snprintf(items[count++], sizeof(items[0]), "'%s'", analysis->respelling);
+        snprintf(items[count++], sizeof(items[0]), "--confusable");
+    }
+    if (analysis->insensitive_probability > 0) {
+        format_duration(eta, sizeof(eta), rate > 0 ? 1.0 / (analysis->insensitive_probability * rate) : 0);
+        snprintf(items[count++], sizeof(items[0]), "-i%s%s%s", rate > 0 ? " (" : "", rate > 0 ? eta : "",
+                 rate > 0 ? ")" : "");
+    }
+    if (analysis->shorter[0]) {
+        format_duration(eta, sizeof(eta), rate > 0 ? 1.0 / (analysis->shorter_probability * rate) : 0);
+        snprintf(items[count++], sizeof(items[0]), "'%s'%s%s%s", analysis->shorter, rate > 0 ? " (" : "",
+                 rate > 0 ? eta : "", rate > 0 ? ")" : "");
+    }
+    
+    // a, b or c
+    buf[0] = '\0';
+    for (size_t i = 0; i < count && len < size; i++) {
+        len += snprintf(buf + len, size - len, "%s%s", i == 0 ? "" : i + 1 < count ? ", " : " or ", items[i]);
+    }
 }
 
 // Help function
@@ -183,12 +1004,89 @@ int btk_vanity_help(output_item *output)
     output_printf(*output, "%s%s vanity - Generate a Bitcoin vanity address%s\n\n", ANSI_BOLD, EMOJI_BITCOIN, ANSI_RESET);
     output_printf(*output, "Usage: %sbtk vanity [options] <pattern>%s\n\n", ANSI_BOLD, ANSI_RESET);
     output_printf(*output, "Options:\n");
-    output_printf(*output, "  -t, --threads <n>       Number of threads to use (default: 4)\n");
+    output_printf(*output, "  -t, --threads <n>       Number of threads to use (default: 1, or the --tune result)\n");
     output_printf(*output, "  -i, --case-insensitive  Case insensitive pattern matching\n");
+    output_printf(*output, "  --bech32                Search native segwit (bc1q...) addresses by prefix\n");
+    output_printf(*output, "  --p2sh-segwit           Search nested segwit (P2SH-P2WPKH, 3...) addresses\n");
+    output_printf(*output, "  --bech32m               Search taproot (bc1p...) addresses by prefix. The WIF\n");
+    output_printf(*output, "                          is the internal key, e.g. for a tr(WIF) descriptor\n");
+    output_printf(*output, "  --also-uncompressed     Also test the uncompressed address of every key; a\n");
+    output_printf(*output, "                          match prints a WIF with the matching compression\n");
+    output_printf(*output, "  --seed <text>           INSECURE: derive every key from text, so runs are\n");
+    output_printf(*output, "                          repeatable. For benchmarks and tests only\n");
+    output_printf(*output, "  --xpub <key>            Search the non-hardened children of an extended\n");
+    output_printf(*output, "                          public key; a match prints its path M/<index>\n");
+    output_printf(*output, "                          instead of a WIF (JSON lines carry \"index\")\n");
+    output_printf(*output, "  --confusable            Let pattern characters match their look-alikes,\n");
+    output_printf(*output, "                          1/l/i, 0/o, 5/S and 8/B (base58 prefixes)\n");
+    output_printf(*output, "  --pattern-file <file>   Search for every pattern in file at once, one per\n");
+    output_printf(*output, "                          line: 1abc (prefix), *xyz (suffix), *abc* (anywhere)\n");
+    output_printf(*output, "  --checkpoint <file>     Save search progress to file every minute and on exit\n");
+    output_printf(*output, "  --resume <file>         Continue the search saved in a checkpoint file\n");
+    output_printf(*output, "  --continuous            Keep searching after a match; print each match as a\n");
+    output_printf(*output, "                          JSON line (address, wif, pattern, pattern_id,\n");
+    output_printf(*output, "                          attempts, timestamp)\n");
+    output_printf(*output, "  --count <n>             Stop after n matches (implies --continuous)\n");
+    output_printf(*output, "  --time <seconds>        Stop after this many seconds (implies --continuous)\n");
+    output_printf(*output, "  --batch-size <n>        Candidates per batch per thread (default: 256)\n");
+    output_printf(*output, "  --tune                  Measure the fastest thread count and batch size for\n");
+    output_printf(*output, "                          this machine and save them as the defaults\n");
+    output_printf(*output, "  --coordinator <addr>    Hand keyspace ranges to workers and print their\n");
+    output_printf(*output, "                          matches; addr is unix:/path, host:port or :port\n");
+    output_printf(*output, "                          (loopback only). Other hosts need --token-file\n");
+    output_printf(*output, "  --range-size <n>        Candidates per coordinator range, a multiple of 1024\n");
+    output_printf(*output, "                          (default: 16777216)\n");
+    output_printf(*output, "  --worker <addr>         Search ranges for the coordinator at addr\n");
+    output_printf(*output, "  --token-file <file>     Shared secret a worker proves to its coordinator.\n");
+    output_printf(*output, "                          Nothing is encrypted: ranges and private keys cross\n");
+    output_printf(*output, "                          TCP in the clear, so use it only on trusted networks\n");
+    output_printf(*output, "  --control <path>        Take commands for this search on a Unix socket, one\n");
+    output_printf(*output, "                          per line: status, pause, resume, stop. Each gets a\n");
+    output_printf(*output, "                          JSON status line back\n");
+    output_printf(*output, "  --metrics <file>        Rewrite file every second with search metrics in the\n");
+    output_printf(*output, "                          Prometheus text format (node_exporter textfile)\n");
+    output_printf(*output, "  --pin                   Pin each thread to its own CPU and keep its memory\n");
+    output_printf(*output, "                          on that CPU's NUMA node\n");
+    output_printf(*output, "  --skip-smt              Pin to physical cores only, leaving SMT siblings idle\n");
+    output_printf(*output, "                          (implies --pin)\n");
     output_printf(*output, "\n");
     output_printf(*output, "Example:\n");
     output_printf(*output, "  btk vanity 1abc        Generate address starting with '1abc'\n");
     output_printf(*output, "  btk vanity -i 1ABC     Generate address starting with '1abc' (case insensitive)\n");
+    output_printf(*output, "  btk vanity --bech32 bc1qxyz  Generate segwit address starting with 'bc1qxyz'\n");
+    output_printf(*output, "  btk vanity --p2sh-segwit 3abc  Generate nested segwit address starting with '3abc'\n");
+    output_printf(*output, "  btk vanity --bech32m bc1pxyz   Generate taproot address starting with 'bc1pxyz'\n");
+    output_printf(*output, "  btk vanity --pattern-file orders.txt  Find an address for any pattern in orders.txt\n");
+    output_printf(*output, "  btk vanity --checkpoint s.ckpt 1abcde  Search, saving progress to s.ckpt\n");
+    output_printf(*output, "  btk vanity --resume s.ckpt 1abcde      Pick the same search up again\n");
+    output_printf(*output, "  btk vanity --tune 1abcde                Calibrate for this pattern, then\n");
+    output_printf(*output, "  btk vanity 1abcde                       search with the saved settings\n");
+    output_printf(*output, "  btk vanity --coordinator 0.0.0.0:9735 --token-file t 1abcde  Share a search\n");
+    output_printf(*output, "  btk vanity --worker host:9735 --token-file t -t 8  between machines, one\n");
+    output_printf(*output, "                                          worker per machine\n");
+    output_printf(*output, "  btk vanity --count 100 1ab             Stream 100 addresses starting with '1ab'\n");
     output_printf(*output, "\n");
     return 0;
+}
+
+int btk_vanity_requires_input(opts_p opts)
+{
+    (void)opts;
+    
+    // The pattern is taken from the command line arguments
+    return 0;
+}
+
+int btk_vanity_init(opts_p opts)
+{
+    (void)opts;
+    
+    return 1;
+}
+
+int btk_vanity_cleanup(opts_p opts)
+{
+    (void)opts;
+    
+    return 1;
 }
\ No newline at end of file
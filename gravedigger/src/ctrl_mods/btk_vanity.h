@@ -12,5 +12,8 @@
 #include "../mods/opts.h"
 
 int btk_vanity_main(output_item *output, opts_p opts, unsigned char *input, size_t input_len);
+int btk_vanity_requires_input(opts_p opts);
+int btk_vanity_init(opts_p opts);
+int btk_vanity_cleanup(opts_p opts);
 
 #endif
\ No newline at end of file
@@ -20,6 +20,7 @@
 #define ADDRESS_VERSION_BIT_MAINNET      0x00
 #define ADDRESS_VERSION_BIT_MAINNET_P2SH 0x05
 #define ADDRESS_VERSION_BIT_TESTNET      0x6F
+#define ADDRESS_VERSION_BIT_TESTNET_P2SH 0xC4
 
 int address_get_p2pkh(char *address, PubKey key)
 {
@@ -308,7 +309,14 @@ int address_from_p2sh_script(char *address, unsigned char *script)
 	int r;
 	unsigned char rmd_bit[21];
 
-	rmd_bit[0] = ADDRESS_VERSION_BIT_MAINNET_P2SH;
+	if (network_is_test())
+	{
+		rmd_bit[0] = ADDRESS_VERSION_BIT_TESTNET_P2SH;
+	}
+	else
+	{
+		rmd_bit[0] = ADDRESS_VERSION_BIT_MAINNET_P2SH;
+	}
 
 	memcpy(rmd_bit + 1, script, 20);
 
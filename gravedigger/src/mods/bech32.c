@@ -7,6 +7,8 @@
 
 #include <stddef.h>
 #include <string.h>
+#include <strings.h>
+#include <ctype.h>
 #include <stdint.h>
 #include <assert.h>
 #include "bech32.h"
@@ -20,6 +22,7 @@
 #define BECH32_CHECKSUM_LENGTH        6
 
 static uint32_t bech32_polymod_step(uint8_t value, uint32_t chk);
+static char *bech32_get_hrp(void);
 
 int bech32_get_address(char *output, unsigned char *data, size_t data_len, int witver)
 {
@@ -34,14 +37,7 @@ int bech32_get_address(char *output, unsigned char *data, size_t data_len, int w
 	chk = 1;
 
 	// Get human readable part (hrp)
-	if (network_is_main())
-	{
-		hrp = BECH32_PREFIX_MAINNET;
-	}
-	else if (network_is_test())
-	{
-		hrp = BECH32_PREFIX_TESTNET;
-	}
+	hrp = bech32_get_hrp();
 
 	// hrp
 	l = strlen(hrp);
@@ -122,6 +118,96 @@ int bech32_get_address(char *output, unsigned char *data, size_t data_len, int w
 	
 }
 
+int bech32_prefix_compile(unsigned char *mask, unsigned char *value, size_t data_len, char *prefix, int witver)
+{
+	int v;
+	size_t i, j, k, l, bit, bits;
+	char head[8];
+
+	assert(mask);
+	assert(value);
+	assert(data_len);
+	assert(prefix);
+
+	memset(mask, 0, data_len);
+	memset(value, 0, data_len);
+
+	// The prefix must start with the full address head, i.e. "bc1q".
+	v = base32_get_char(witver);
+	if (v < 0)
+	{
+		error_log("Invalid witness version: %i.", witver);
+		return -1;
+	}
+	l = strlen(bech32_get_hrp());
+	memcpy(head, bech32_get_hrp(), l);
+	head[l++] = BECH32_SEPARATOR;
+	head[l++] = (char)v;
+	head[l] = '\0';
+
+	if (strlen(prefix) < l || strncasecmp(prefix, head, l) != 0)
+	{
+		error_log("Bech32 pattern must begin with '%s'.", head);
+		return -1;
+	}
+
+	// Every data character after the head is exactly 5 bits of the
+	// witness program, most significant bit first. Bits beyond the end
+	// of the program are padding and must be zero.
+	bits = data_len * 8;
+	for (i = l, j = 0; prefix[i]; ++i, ++j)
+	{
+		if ((j * 5) >= bits)
+		{
+			error_log("Bech32 pattern is longer than the witness program.");
+			return -1;
+		}
+
+		v = base32_get_raw(tolower(prefix[i]));
+		if (v < 0)
+		{
+			error_log("Bech32 pattern contains invalid character '%c'.", prefix[i]);
+			return -1;
+		}
+
+		for (k = 0; k < 5; ++k)
+		{
+			bit = (j * 5) + k;
+			if (bit >= bits)
+			{
+				if (v & (0x10 >> k))
+				{
+					error_log("Bech32 pattern character '%c' can not occur at the end of the witness program.", prefix[i]);
+					return -1;
+				}
+				continue;
+			}
+			mask[bit / 8] |= 0x80 >> (bit % 8);
+			if (v & (0x10 >> k))
+			{
+				value[bit / 8] |= 0x80 >> (bit % 8);
+			}
+		}
+	}
+
+	if (j == 0)
+	{
+		error_log("Bech32 pattern contains no characters after '%s'.", head);
+		return -1;
+	}
+
+	return (int)j;
+}
+
+static char *bech32_get_hrp(void)
+{
+	if (network_is_test())
+	{
+		return BECH32_PREFIX_TESTNET;
+	}
+
+	return BECH32_PREFIX_MAINNET;
+}
 
 static uint32_t bech32_polymod_step(uint8_t value, uint32_t chk)
 {
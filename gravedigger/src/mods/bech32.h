@@ -11,5 +11,6 @@
 #include <stddef.h>
 
 int bech32_get_address(char *, unsigned char *, size_t, int);
+int bech32_prefix_compile(unsigned char *, unsigned char *, size_t, char *, int);
 
 #endif
\ No newline at end of file
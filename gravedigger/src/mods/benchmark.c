@@ -102,6 +102,8 @@ int benchmark_run(const struct Pattern *pattern, uint32_t duration_seconds,
 
 double benchmark_estimate_time(const struct Pattern *pattern, uint32_t thread_count,
                              uint64_t keys_per_second) {
+    (void)thread_count;  // keys_per_second already covers every thread
+    
     if (!pattern || keys_per_second == 0) return 0.0;
     
     // Get pattern probability
@@ -111,8 +113,7 @@ double benchmark_estimate_time(const struct Pattern *pattern, uint32_t thread_co
     // Expected attempts needed = 1/probability
     double attempts_needed = 1.0 / prob;
     
-    // Time = attempts / (keys_per_second * thread_count)
-    return attempts_needed / (keys_per_second * thread_count);
+    return attempts_needed / keys_per_second;
 }
 
 void benchmark_print_results(const benchmark_result_t *result, const struct Pattern *pattern) {
@@ -140,6 +141,14 @@ void benchmark_print_results(const benchmark_result_t *result, const struct Patt
         } else {
             printf("Estimated time to match: %.1f days\n", est_time / 86400);
         }
+        
+        // The mean hides a long tail; quote the percentiles too
+        double prob = pattern_probability(pattern);
+        static const double quantiles[] = {0.5, 0.9, 0.99};
+        for (size_t i = 0; i < sizeof(quantiles) / sizeof(quantiles[0]); i++) {
+            printf("%.0f%% chance of a match within: %.1f hours\n", quantiles[i] * 100,
+                   vanity_quantile_attempts(prob, quantiles[i]) / result->keys_per_second / 3600);
+        }
     }
     
     printf("\n");
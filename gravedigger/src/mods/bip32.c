@@ -0,0 +1,286 @@
+/*
+ * Copyright (c) 2023 Brian Barto
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GPL License. See LICENSE for more details.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <gmp.h>
+#ifdef GMP_H_MISSING
+#   include "GMP/mini-gmp.h"
+#endif
+#include "bip32.h"
+#include "point.h"
+#include "ecmult.h"
+#include "crypto.h"
+#include "base58check.h"
+#include "serialize.h"
+#include "network.h"
+#include "error.h"
+
+#define XPUB_DATA_LEN     78
+#define XPUB_MAINNET      0x0488B21E
+#define XPUB_TESTNET      0x043587CF
+#define XPRV_MAINNET      0x0488ADE4
+#define XPRV_TESTNET      0x04358394
+#define MESSAGE_LEN       (BIP32_PUBKEY_LEN + 4)   // K || ser32(index)
+#define SCALAR_LEN        ECMULT_SCALAR_LEN
+
+// Curve order n, big endian
+static const unsigned char curve_order[SCALAR_LEN] = {
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFE,
+    0xBA, 0xAE, 0xDC, 0xE6, 0xAF, 0x48, 0xA0, 0x3B,
+    0xBF, 0xD2, 0x5E, 0x8C, 0xD0, 0x36, 0x41, 0x41
+};
+
+struct Bip32Batch {
+    size_t capacity;
+    Bip32Xpub xpub;          // Parent key, for the reference path
+    sha512_context inner;    // After (chain code ^ ipad)
+    sha512_context outer;    // After (chain code ^ opad)
+    unsigned char message[MESSAGE_LEN];
+    struct Point parent;
+    EcmultBatch *products;   // IL G + K of every child
+    unsigned char *digits;   // capacity * SCALAR_LEN, IL of every child
+};
+
+// IL must be a valid private key: 0 < IL < n
+static int il_is_valid(const unsigned char *il) {
+    unsigned char acc = 0;
+
+    for (int i = 0; i < SCALAR_LEN; i++) {
+        acc |= il[i];
+    }
+    return acc != 0 && memcmp(il, curve_order, SCALAR_LEN) < 0;
+}
+
+static void export_pubkey(unsigned char *output, const struct Point *point) {
+    size_t len = (mpz_sizeinbase(point->x, 2) + 7) / 8;
+
+    output[0] = mpz_odd_p(point->y) ? 0x03 : 0x02;
+    memset(output + 1, 0, BIP32_PUBKEY_LEN - 1);
+    mpz_export(output + BIP32_PUBKEY_LEN - len, NULL, 1, 1, 1, 0, point->x);
+}
+
+// Lift a compressed key to its point; -1 if it is not on the curve
+static int import_pubkey(struct Point *point, const unsigned char *pubkey) {
+    if (pubkey[0] != 0x02 && pubkey[0] != 0x03) {
+        return -1;
+    }
+    mpz_import(point->x, BIP32_PUBKEY_LEN - 1, 1, 1, 1, 0, pubkey + 1);
+    point_solve_y(point, pubkey[0] & 1);
+    return point_verify(point) == 1 ? 0 : -1;
+}
+
+int bip32_xpub_parse(Bip32Xpub *xpub, const char *text) {
+    unsigned char data[128];
+    struct Point point;
+    uint32_t version, expected;
+    int r;
+
+    if (!xpub || !text || strlen(text) > BIP32_XPUB_MAX_LEN) {
+        error_log("Invalid extended public key");
+        return -1;
+    }
+
+    r = base58check_decode(data, (char *)text, BASE58CHECK_TYPE_NA);
+    if (r != XPUB_DATA_LEN) {
+        error_log("Invalid extended public key");
+        return -1;
+    }
+
+    deserialize_uint32(&version, data, SERIALIZE_ENDIAN_BIG);
+    if (version == XPRV_MAINNET || version == XPRV_TESTNET) {
+        error_log("Extended private keys are not accepted, give the matching xpub");
+        memset(data, 0, sizeof(data));
+        return -1;
+    }
+    expected = network_is_test() ? XPUB_TESTNET : XPUB_MAINNET;
+    if (version != expected) {
+        error_log("Extended public keys on this network start with '%s'", network_is_test() ? "tpub" : "xpub");
+        return -1;
+    }
+
+    xpub->version = version;
+    xpub->depth = data[4];
+    deserialize_uint32(&xpub->child_number, data + 9, SERIALIZE_ENDIAN_BIG);
+    memcpy(xpub->chain_code, data + 13, BIP32_CHAIN_CODE_LEN);
+    memcpy(xpub->pubkey, data + 45, BIP32_PUBKEY_LEN);
+
+    point_init(&point);
+    r = import_pubkey(&point, xpub->pubkey);
+    point_clear(&point);
+    if (r < 0) {
+        error_log("Extended public key holds an invalid public key");
+        return -1;
+    }
+
+    return 0;
+}
+
+int bip32_child_pubkey(unsigned char *child, const Bip32Xpub *xpub, uint32_t index) {
+    unsigned char message[MESSAGE_LEN], digest[SHA512_DIGEST_LENGTH];
+    struct Point parent, g, ilg, sum;
+    mpz_t il;
+    int r = -1;
+
+    if (!child || !xpub || index >= BIP32_HARDENED) {
+        error_log("Invalid parameters for child key derivation");
+        return -1;
+    }
+
+    memcpy(message, xpub->pubkey, BIP32_PUBKEY_LEN);
+    serialize_uint32(message + BIP32_PUBKEY_LEN, index, SERIALIZE_ENDIAN_BIG);
+    crypto_get_hmac_sha512(digest, (unsigned char *)xpub->chain_code, BIP32_CHAIN_CODE_LEN, message, MESSAGE_LEN);
+    if (!il_is_valid(digest)) {
+        error_log("Child %u has no valid key", index);
+        return -1;
+    }
+
+    point_init(&parent);
+    point_init(&g);
+    point_init(&ilg);
+    point_init(&sum);
+    mpz_init(il);
+
+    mpz_import(il, SCALAR_LEN, 1, 1, 1, 0, digest);
+    if (import_pubkey(&parent, (unsigned char *)xpub->pubkey) == 0) {
+        point_set_generator(&g);
+        point_mul(&ilg, &g, il);
+        // IL G == +-K has no slope; it takes a discrete log to get there
+        if (mpz_cmp(ilg.x, parent.x) != 0) {
+            point_add(&sum, &ilg, &parent);
+            export_pubkey(child, &sum);
+            r = 0;
+        } else {
+            error_log("Child %u has no valid key", index);
+        }
+    } else {
+        error_log("Extended public key holds an invalid public key");
+    }
+
+    point_clear(&parent);
+    point_clear(&g);
+    point_clear(&ilg);
+    point_clear(&sum);
+    mpz_clear(il);
+
+    return r;
+}
+
+Bip32Batch *bip32_batch_new(const Bip32Xpub *xpub, size_t count) {
+    unsigned char pad[SHA512_BLOCK_LENGTH];
+    Bip32Batch *batch;
+
+    if (!xpub || count == 0) {
+        error_log("Invalid parameters for child key batch");
+        return NULL;
+    }
+
+    batch = calloc(1, sizeof(Bip32Batch));
+    if (!batch) {
+        error_log("Memory allocation error.");
+        return NULL;
+    }
+
+    batch->capacity = count;
+    batch->xpub = *xpub;
+    batch->products = ecmult_batch_new(count);
+    batch->digits = calloc(count, SCALAR_LEN);
+    if (!batch->products || !batch->digits) {
+        error_log("Memory allocation error.");
+        ecmult_batch_free(batch->products);
+        free(batch->digits);
+        free(batch);
+        return NULL;
+    }
+
+    point_init(&batch->parent);
+    if (import_pubkey(&batch->parent, (unsigned char *)xpub->pubkey) < 0) {
+        error_log("Extended public key holds an invalid public key");
+        bip32_batch_free(batch);
+        return NULL;
+    }
+
+    // HMAC midstates; the chain code is always shorter than a block
+    memset(pad, 0x36, sizeof(pad));
+    for (int i = 0; i < BIP32_CHAIN_CODE_LEN; i++) {
+        pad[i] ^= xpub->chain_code[i];
+    }
+    sha512_init(&batch->inner);
+    sha512_update(&batch->inner, pad, sizeof(pad));
+
+    memset(pad, 0x5c, sizeof(pad));
+    for (int i = 0; i < BIP32_CHAIN_CODE_LEN; i++) {
+        pad[i] ^= xpub->chain_code[i];
+    }
+    sha512_init(&batch->outer);
+    sha512_update(&batch->outer, pad, sizeof(pad));
+    memset(pad, 0, sizeof(pad));
+
+    memcpy(batch->message, xpub->pubkey, BIP32_PUBKEY_LEN);
+
+    return batch;
+}
+
+int bip32_batch_children(Bip32Batch *batch, unsigned char *pubkeys, uint32_t first, size_t count) {
+    unsigned char inner[SHA512_DIGEST_LENGTH], digest[SHA512_DIGEST_LENGTH];
+    sha512_context ctx;
+
+    if (!batch || !pubkeys || count == 0 || count > batch->capacity ||
+        first >= BIP32_HARDENED || count > BIP32_HARDENED - first) {
+        error_log("Invalid parameters for child key derivation");
+        return -1;
+    }
+
+    // IL of every child, two compressions each from the midstates
+    for (size_t i = 0; i < count; i++) {
+        serialize_uint32(batch->message + BIP32_PUBKEY_LEN, first + (uint32_t)i, SERIALIZE_ENDIAN_BIG);
+
+        ctx = batch->inner;
+        sha512_update(&ctx, batch->message, MESSAGE_LEN);
+        sha512_final(&ctx, inner);
+        ctx = batch->outer;
+        sha512_update(&ctx, inner, sizeof(inner));
+        sha512_final(&ctx, digest);
+
+        if (!il_is_valid(digest)) {
+            error_log("Child %u has no valid key", first + (uint32_t)i);
+            return -1;
+        }
+        memcpy(batch->digits + i * SCALAR_LEN, digest, SCALAR_LEN);
+    }
+
+    if (ecmult_batch_gen(batch->products, batch->digits, count) < 0 ||
+        ecmult_batch_add(batch->products, &batch->parent, count) < 0) {
+        // A partial sum or IL G met its next term, which takes a
+        // discrete log to arrange. The reference path still gets it
+        // right, or says the index has no child.
+        for (size_t i = 0; i < count; i++) {
+            if (bip32_child_pubkey(pubkeys + i * BIP32_PUBKEY_LEN, &batch->xpub, first + (uint32_t)i) < 0) {
+                return -1;
+            }
+        }
+        return 0;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        export_pubkey(pubkeys + i * BIP32_PUBKEY_LEN, ecmult_batch_point(batch->products, i));
+    }
+
+    return 0;
+}
+
+void bip32_batch_free(Bip32Batch *batch) {
+    if (!batch) return;
+
+    point_clear(&batch->parent);
+    memset(&batch->inner, 0, sizeof(batch->inner));
+    memset(&batch->outer, 0, sizeof(batch->outer));
+    ecmult_batch_free(batch->products);
+    free(batch->digits);
+    free(batch);
+}
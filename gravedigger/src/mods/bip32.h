@@ -0,0 +1,86 @@
+/*
+ * Copyright (c) 2023 Brian Barto
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GPL License. See LICENSE for more details.
+ */
+
+#ifndef BIP32_H
+#define BIP32_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define BIP32_PUBKEY_LEN      33           // Compressed SEC encoding
+#define BIP32_CHAIN_CODE_LEN  32
+#define BIP32_HARDENED        0x80000000u  // First hardened child index
+#define BIP32_XPUB_MAX_LEN    112          // Longest base58 text accepted
+
+typedef struct {
+    uint32_t version;                            // xpub or tpub
+    unsigned char depth;                         // 0 for a master key
+    uint32_t child_number;                       // Index this key has under its parent
+    unsigned char chain_code[BIP32_CHAIN_CODE_LEN];
+    unsigned char pubkey[BIP32_PUBKEY_LEN];
+} Bip32Xpub;
+
+typedef struct Bip32Batch Bip32Batch;
+
+/**
+ * Parse a base58check extended public key. The version must belong to
+ * the active network (xpub on mainnet, tpub on testnet); extended
+ * private keys are refused.
+ *
+ * @param xpub Set to the decoded key
+ * @param text Extended public key
+ * @return 0 on success, -1 on error
+ */
+int bip32_xpub_parse(Bip32Xpub *xpub, const char *text);
+
+/**
+ * Derive a non-hardened child public key (BIP32 CKDpub): with
+ * I = HMAC-SHA512(chain code, K || index), the child is
+ * parse256(I[0:32])G + K. This is the reference path, one full
+ * scalar multiplication per child.
+ *
+ * @param child BIP32_PUBKEY_LEN bytes, set to the compressed child key
+ * @param xpub Parent key
+ * @param index Child index, below BIP32_HARDENED
+ * @return 0 on success, -1 on error or if the index has no valid child
+ */
+int bip32_child_pubkey(unsigned char *child, const Bip32Xpub *xpub, uint32_t index);
+
+/**
+ * Allocate the working space of batched child derivation. The HMAC
+ * key is the same for every child, so both padded key blocks are
+ * hashed once here and every child starts from those midstates.
+ *
+ * @param xpub Parent key, copied
+ * @param count Most children per call
+ * @return New batch or NULL on error
+ */
+Bip32Batch *bip32_batch_new(const Bip32Xpub *xpub, size_t count);
+
+/**
+ * Derive the children at consecutive indices. Every child costs two
+ * SHA-512 compressions and a fixed-base comb multiplication, and the
+ * parent point is added to all of them with one shared inversion.
+ *
+ * @param batch Working space
+ * @param pubkeys count * BIP32_PUBKEY_LEN bytes, set to the child keys
+ * @param first Index of the first child
+ * @param count Number of children, at most the batch size; the last
+ *        index must stay below BIP32_HARDENED
+ * @return 0 on success, -1 on error or if an index has no valid child
+ *         (odds about 2^-127 per index)
+ */
+int bip32_batch_children(Bip32Batch *batch, unsigned char *pubkeys, uint32_t first, size_t count);
+
+/**
+ * Free batch working space
+ *
+ * @param batch Batch, may be NULL
+ */
+void bip32_batch_free(Bip32Batch *batch);
+
+#endif // BIP32_H
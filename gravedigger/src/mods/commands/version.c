@@ -211,10 +211,8 @@ int version_to_json(char **output, Version version)
 	}
 
 	{
-		for(i = 0; i < IP_ADDR_FIELD_LEN; ++i)
-		{
-			sprintf(tmpstr + (i*2), "%02x", version->addr_recv_ip_address[i]);
-		}
+		r = hex_encode(tmpstr, version->addr_recv_ip_address, IP_ADDR_FIELD_LEN);
+		ERROR_CHECK_NEG(r, "Could not encode addr_recv_ip_address to hex.");
 
 		r = json_add_string(version_json, tmpstr, "addr_recv_ip_address");
 		ERROR_CHECK_NEG(r, "Could not add addr_recv_ip_address to json object.");
@@ -243,10 +241,8 @@ int version_to_json(char **output, Version version)
 	}
 
 	{
-		for(i = 0; i < IP_ADDR_FIELD_LEN; ++i)
-		{
-			sprintf(tmpstr + (i*2), "%02x", version->addr_trans_ip_address[i]);
-		}
+		r = hex_encode(tmpstr, version->addr_trans_ip_address, IP_ADDR_FIELD_LEN);
+		ERROR_CHECK_NEG(r, "Could not encode addr_trans_ip_address to hex.");
 
 		r = json_add_string(version_json, tmpstr, "addr_trans_ip_address");
 		ERROR_CHECK_NEG(r, "Could not add addr_trans_ip_address to json object.");
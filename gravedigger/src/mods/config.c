@@ -20,7 +20,7 @@
 #define CONFIG_DEFAULT_FILE        ".btk/btk.conf"
 #define CONFIG_DEFAULT_FILE_TEST   "/tmp/.btk/btk_test.conf"
 
-static char *(valid_keys[]) = {"rpc-auth", "hostname", "balance-path", "chainstate-path", NULL};
+static char *(valid_keys[]) = {"rpc-auth", "hostname", "balance-path", "chainstate-path", "vanity-threads", "vanity-batch-size", "vanity-tune-host", NULL};
 static cJSON *config_json = NULL;
 
 int config_is_valid(char *key)
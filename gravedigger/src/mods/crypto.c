@@ -11,6 +11,7 @@
 #include <assert.h>
 #include "crypto/rmd160.h"
 #include "crypto/sha256.h"
+#include "crypto/sha512.h"
 #include "crypto.h"
 #include "error.h"
 
@@ -41,6 +42,21 @@ int crypto_get_rmd160(unsigned char *output, unsigned char *input, size_t input_
 	return 1;
 }
 
+int crypto_get_hash160(unsigned char *output, unsigned char *input, size_t input_len)
+{
+	unsigned char sha[32];
+
+	assert(output);
+	assert(input);
+	assert(input_len);
+
+	// RMD(SHA(data))
+	crypto_get_sha256(sha, input, input_len);
+	crypto_get_rmd160(output, sha, 32);
+
+	return 1;
+}
+
 int crypto_get_checksum(uint32_t *output, unsigned char *data, size_t len)
 {
 	int r;
@@ -89,3 +105,64 @@ int crypto_get_checksum(uint32_t *output, unsigned char *data, size_t len)
 	
 	return 1;
 }
+
+int crypto_get_sha512(unsigned char *output, unsigned char *input, size_t input_len)
+{
+	sha512_context ctx;
+	assert(output);
+	assert(input);
+
+	sha512_init(&ctx);
+	sha512_update(&ctx, input, input_len);
+	sha512_final(&ctx, output);
+
+	return 1;
+}
+
+int crypto_get_hmac_sha512(unsigned char *output, unsigned char *key, size_t key_len, unsigned char *input, size_t input_len)
+{
+	size_t i;
+	sha512_context ctx;
+	unsigned char pad[SHA512_BLOCK_LENGTH];
+	unsigned char inner[SHA512_DIGEST_LENGTH];
+
+	assert(output);
+	assert(key);
+	assert(input);
+
+	// Keys longer than a block are hashed first
+	memset(pad, 0, sizeof(pad));
+	if (key_len > SHA512_BLOCK_LENGTH)
+	{
+		crypto_get_sha512(pad, key, key_len);
+	}
+	else
+	{
+		memcpy(pad, key, key_len);
+	}
+
+	// H((K ^ ipad) || m)
+	for (i = 0; i < SHA512_BLOCK_LENGTH; ++i)
+	{
+		pad[i] ^= 0x36;
+	}
+	sha512_init(&ctx);
+	sha512_update(&ctx, pad, SHA512_BLOCK_LENGTH);
+	sha512_update(&ctx, input, input_len);
+	sha512_final(&ctx, inner);
+
+	// H((K ^ opad) || inner)
+	for (i = 0; i < SHA512_BLOCK_LENGTH; ++i)
+	{
+		pad[i] ^= 0x36 ^ 0x5c;
+	}
+	sha512_init(&ctx);
+	sha512_update(&ctx, pad, SHA512_BLOCK_LENGTH);
+	sha512_update(&ctx, inner, SHA512_DIGEST_LENGTH);
+	sha512_final(&ctx, output);
+
+	memset(pad, 0, sizeof(pad));
+	memset(inner, 0, sizeof(inner));
+
+	return 1;
+}
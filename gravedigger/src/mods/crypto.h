@@ -12,9 +12,13 @@
 #include <stddef.h>
 #include "crypto/sha256.h"
 #include "crypto/rmd160.h"
+#include "crypto/sha512.h"
 
 int crypto_get_sha256(unsigned char *, unsigned char *, size_t);
 int crypto_get_rmd160(unsigned char *, unsigned char *, size_t);
+int crypto_get_hash160(unsigned char *, unsigned char *, size_t);
 int crypto_get_checksum(uint32_t *, unsigned char *, size_t);
+int crypto_get_sha512(unsigned char *, unsigned char *, size_t);
+int crypto_get_hmac_sha512(unsigned char *, unsigned char *, size_t, unsigned char *, size_t);
 
 #endif
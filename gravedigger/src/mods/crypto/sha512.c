@@ -0,0 +1,208 @@
+/*
+ * Copyright (c) 2023 Brian Barto
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GPL License. See LICENSE for more details.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "sha512.h"
+#include "shaconst.h"
+
+#define HOST_c2ll(c,l) (l =(((unsigned long long)(*((c)++)))<<56),     \
+						 l|=(((unsigned long long)(*((c)++)))<<48),     \
+						 l|=(((unsigned long long)(*((c)++)))<<40),     \
+						 l|=(((unsigned long long)(*((c)++)))<<32),     \
+						 l|=(((unsigned long long)(*((c)++)))<<24),     \
+						 l|=(((unsigned long long)(*((c)++)))<<16),     \
+						 l|=(((unsigned long long)(*((c)++)))<< 8),     \
+						 l|=(((unsigned long long)(*((c)++)))    )      )
+#define HOST_ll2c(l,c) (*((c)++)=(unsigned char)(((l)>>56)&0xff),      \
+						 *((c)++)=(unsigned char)(((l)>>48)&0xff),      \
+						 *((c)++)=(unsigned char)(((l)>>40)&0xff),      \
+						 *((c)++)=(unsigned char)(((l)>>32)&0xff),      \
+						 *((c)++)=(unsigned char)(((l)>>24)&0xff),      \
+						 *((c)++)=(unsigned char)(((l)>>16)&0xff),      \
+						 *((c)++)=(unsigned char)(((l)>> 8)&0xff),      \
+						 *((c)++)=(unsigned char)(((l)    )&0xff),      \
+						 l)
+
+#define ROTR64(a,n)     (((a)>>(n))|((a)<<(64-(n))))
+
+#define Sigma0(x)    (ROTR64((x),28) ^ ROTR64((x),34) ^ ROTR64((x),39))
+#define Sigma1(x)    (ROTR64((x),14) ^ ROTR64((x),18) ^ ROTR64((x),41))
+#define sigma0(x)    (ROTR64((x),1)  ^ ROTR64((x),8)  ^ ((x)>>7))
+#define sigma1(x)    (ROTR64((x),19) ^ ROTR64((x),61) ^ ((x)>>6))
+
+#define Ch(x,y,z)       (((x) & (y)) ^ ((~(x)) & (z)))
+#define Maj(x,y,z)      (((x) & (y)) ^ ((x) & (z)) ^ ((y) & (z)))
+
+void sha512_block_data_order(sha512_context *ctx, const void *in, size_t num);
+void sha512_cleanse(void *ptr, size_t len);
+
+typedef void *(*memset_t)(void *, int, size_t);
+static volatile memset_t memset_func = memset;
+
+void sha512_init(sha512_context *ctx)
+{
+	memset(ctx, 0, sizeof(*ctx));
+	ctx->state[0] = 0x6a09e667f3bcc908ULL;
+	ctx->state[1] = 0xbb67ae8584caa73bULL;
+	ctx->state[2] = 0x3c6ef372fe94f82bULL;
+	ctx->state[3] = 0xa54ff53a5f1d36f1ULL;
+	ctx->state[4] = 0x510e527fade682d1ULL;
+	ctx->state[5] = 0x9b05688c2b3e6c1fULL;
+	ctx->state[6] = 0x1f83d9abfb41bd6bULL;
+	ctx->state[7] = 0x5be0cd19137e2179ULL;
+}
+
+void sha512_update(sha512_context *ctx, const unsigned char *data, size_t len)
+{
+	unsigned char *p;
+	unsigned long long l;
+	size_t n;
+
+	if (len == 0)
+		return;
+
+	l = ctx->total[0] + (((unsigned long long) len) << 3);
+	if (l < ctx->total[0])              /* overflow */
+		ctx->total[1]++;
+	ctx->total[1] += (unsigned long long) len >> 61;
+	ctx->total[0] = l;
+
+	n = ctx->num;
+	if (n != 0) {
+		p = ctx->buffer;
+
+		if (len + n >= SHA512_BLOCK_LENGTH) {
+			memcpy(p + n, data, SHA512_BLOCK_LENGTH - n);
+			sha512_block_data_order(ctx, p, 1);
+			n = SHA512_BLOCK_LENGTH - n;
+			data += n;
+			len -= n;
+			ctx->num = 0;
+			memset(p, 0, SHA512_BLOCK_LENGTH); /* keep it zeroed */
+		} else {
+			memcpy(p + n, data, len);
+			ctx->num += (unsigned int)len;
+			return;
+		}
+	}
+
+	n = len / SHA512_BLOCK_LENGTH;
+	if (n > 0) {
+		sha512_block_data_order(ctx, data, n);
+		n *= SHA512_BLOCK_LENGTH;
+		data += n;
+		len -= n;
+	}
+
+	if (len != 0) {
+		p = ctx->buffer;
+		ctx->num = (unsigned int)len;
+		memcpy(p, data, len);
+	}
+}
+
+void sha512_final(sha512_context *ctx, unsigned char *md)
+{
+	unsigned char *p = ctx->buffer;
+	size_t n = ctx->num;
+	int i;
+
+	p[n] = 0x80;                /* there is always room for one */
+	n++;
+
+	if (n > (SHA512_BLOCK_LENGTH - 16)) {
+		memset(p + n, 0, SHA512_BLOCK_LENGTH - n);
+		n = 0;
+		sha512_block_data_order(ctx, p, 1);
+	}
+	memset(p + n, 0, SHA512_BLOCK_LENGTH - 16 - n);
+
+	p += SHA512_BLOCK_LENGTH - 16;
+	(void)HOST_ll2c(ctx->total[1], p);
+	(void)HOST_ll2c(ctx->total[0], p);
+	p -= SHA512_BLOCK_LENGTH;
+	sha512_block_data_order(ctx, p, 1);
+	ctx->num = 0;
+	sha512_cleanse(p, SHA512_BLOCK_LENGTH);
+
+	for (i = 0; i < 8; i++) {
+		unsigned long long ll = ctx->state[i];
+		(void)HOST_ll2c(ll, md);
+	}
+}
+
+void sha512_block_data_order(sha512_context *ctx, const void *in, size_t num)
+{
+	unsigned long long a, b, c, d, e, f, g, h, s0, s1, T1, T2;
+	unsigned long long X[16];
+	int i;
+	const unsigned char *data = in;
+
+	while (num--) {
+
+		a = ctx->state[0];
+		b = ctx->state[1];
+		c = ctx->state[2];
+		d = ctx->state[3];
+		e = ctx->state[4];
+		f = ctx->state[5];
+		g = ctx->state[6];
+		h = ctx->state[7];
+
+		for (i = 0; i < 16; i++) {
+			HOST_c2ll(data, X[i]);
+		}
+
+		for (i = 0; i < 16; i++) {
+			T1 = h + Sigma1(e) + Ch(e, f, g) + K512[i] + X[i];
+			T2 = Sigma0(a) + Maj(a, b, c);
+			h = g;
+			g = f;
+			f = e;
+			e = d + T1;
+			d = c;
+			c = b;
+			b = a;
+			a = T1 + T2;
+		}
+
+		for (; i < 80; i++) {
+			s0 = X[(i + 1) & 0x0f];
+			s0 = sigma0(s0);
+			s1 = X[(i + 14) & 0x0f];
+			s1 = sigma1(s1);
+
+			T1 = h + Sigma1(e) + Ch(e, f, g) + K512[i] +
+				(X[i & 0xf] += s0 + s1 + X[(i + 9) & 0xf]);
+			T2 = Sigma0(a) + Maj(a, b, c);
+			h = g;
+			g = f;
+			f = e;
+			e = d + T1;
+			d = c;
+			c = b;
+			b = a;
+			a = T1 + T2;
+		}
+
+		ctx->state[0] += a;
+		ctx->state[1] += b;
+		ctx->state[2] += c;
+		ctx->state[3] += d;
+		ctx->state[4] += e;
+		ctx->state[5] += f;
+		ctx->state[6] += g;
+		ctx->state[7] += h;
+
+	}
+}
+
+void sha512_cleanse(void *ptr, size_t len)
+{
+	memset_func(ptr, 0, len);
+}
@@ -0,0 +1,27 @@
+/*
+ * Copyright (c) 2023 Brian Barto
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GPL License. See LICENSE for more details.
+ */
+
+#ifndef SHA512_H
+#define SHA512_H
+
+#include <stddef.h>
+
+#define SHA512_DIGEST_LENGTH 64
+#define SHA512_BLOCK_LENGTH  128
+
+typedef struct {
+    unsigned long long total[2];
+    unsigned long long state[8];
+    unsigned char buffer[SHA512_BLOCK_LENGTH];
+    unsigned int num;
+} sha512_context;
+
+void sha512_init(sha512_context *ctx);
+void sha512_update(sha512_context *ctx, const unsigned char *input, size_t length);
+void sha512_final(sha512_context *ctx, unsigned char *digest);
+
+#endif
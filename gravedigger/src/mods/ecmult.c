@@ -0,0 +1,168 @@
+/*
+ * Copyright (c) 2023 Brian Barto
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GPL License. See LICENSE for more details.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "ecmult.h"
+#include "error.h"
+
+#define CURVE_PRIME     "FFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFEFFFFFC2F"
+#define COMB_WINDOWS    ECMULT_SCALAR_LEN   // One per byte of the scalar
+#define COMB_ENTRIES    256
+
+struct EcmultBatch {
+    size_t capacity;
+    struct Point *acc;       // Running sums, one per scalar
+    struct Point **terms;    // Point each sum adds next
+    mpz_t *scratch;          // 2 * capacity, for point_add_each()
+};
+
+/*
+ * comb[w][b] = (b + 1) * 256^w * G. Digit b of window w stands for
+ * (b + 1) * 256^w rather than b * 256^w so no entry is the point at
+ * infinity; window 0 is moved down by C = sum of 256^w to make up for
+ * it. The sum over all windows of a scalar's bytes is then exactly
+ * that scalar times G. Shared read-only once built.
+ */
+static struct Point comb[COMB_WINDOWS][COMB_ENTRIES];
+static pthread_once_t comb_once = PTHREAD_ONCE_INIT;
+
+static void comb_init(void) {
+    struct Point g, base, offset;
+    mpz_t c, prime;
+
+    point_init(&g);
+    point_init(&base);
+    point_init(&offset);
+    mpz_init(c);
+    mpz_init_set_str(prime, CURVE_PRIME, 16);
+    point_set_generator(&g);
+    point_set(&base, &g);
+
+    for (int w = 0; w < COMB_WINDOWS; w++) {
+        for (int b = 0; b < COMB_ENTRIES; b++) {
+            point_init(&comb[w][b]);
+            if (b == 0) {
+                point_set(&comb[w][0], &base);
+            } else if (b == 1) {
+                point_double(&comb[w][1], &base);
+            } else {
+                point_add(&comb[w][b], &comb[w][b - 1], &base);
+            }
+        }
+        // The last entry is 256 * 256^w G, the next window's base
+        point_set(&base, &comb[w][COMB_ENTRIES - 1]);
+        mpz_setbit(c, 8 * w);
+    }
+
+    // -C G, then added to every entry of window 0
+    point_mul(&offset, &g, c);
+    mpz_sub(offset.y, prime, offset.y);
+    for (int b = 0; b < COMB_ENTRIES; b++) {
+        point_add(&base, &comb[0][b], &offset);
+        point_set(&comb[0][b], &base);
+    }
+
+    point_clear(&g);
+    point_clear(&base);
+    point_clear(&offset);
+    mpz_clear(c);
+    mpz_clear(prime);
+}
+
+EcmultBatch *ecmult_batch_new(size_t count) {
+    EcmultBatch *batch;
+
+    if (count == 0) {
+        error_log("Multiplication batch must hold at least one scalar");
+        return NULL;
+    }
+
+    pthread_once(&comb_once, comb_init);
+
+    batch = calloc(1, sizeof(EcmultBatch));
+    if (!batch) {
+        error_log("Memory allocation error.");
+        return NULL;
+    }
+
+    batch->capacity = count;
+    batch->acc = calloc(count, sizeof(struct Point));
+    batch->terms = calloc(count, sizeof(struct Point *));
+    batch->scratch = calloc(2 * count, sizeof(mpz_t));
+    if (!batch->acc || !batch->terms || !batch->scratch) {
+        error_log("Memory allocation error.");
+        free(batch->acc);
+        free(batch->terms);
+        free(batch->scratch);
+        free(batch);
+        return NULL;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        point_init(&batch->acc[i]);
+        mpz_init(batch->scratch[2 * i]);
+        mpz_init(batch->scratch[2 * i + 1]);
+    }
+
+    return batch;
+}
+
+int ecmult_batch_gen(EcmultBatch *batch, const unsigned char *scalars, size_t count) {
+    if (!batch || !scalars || count == 0 || count > batch->capacity) {
+        error_log("Invalid parameters for batched multiplication");
+        return -1;
+    }
+
+    // Lowest byte first: start from window 0, then one batched addition
+    // per remaining window
+    for (size_t i = 0; i < count; i++) {
+        point_set(&batch->acc[i], &comb[0][scalars[i * ECMULT_SCALAR_LEN + ECMULT_SCALAR_LEN - 1]]);
+    }
+    for (int w = 1; w < COMB_WINDOWS; w++) {
+        for (size_t i = 0; i < count; i++) {
+            batch->terms[i] = &comb[w][scalars[i * ECMULT_SCALAR_LEN + ECMULT_SCALAR_LEN - 1 - w]];
+        }
+        if (point_add_each(batch->acc, batch->acc, batch->terms, batch->scratch, count) < 0) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+int ecmult_batch_add(EcmultBatch *batch, Point point, size_t count) {
+    if (!batch || !point || count == 0 || count > batch->capacity) {
+        error_log("Invalid parameters for batched addition");
+        return -1;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        batch->terms[i] = point;
+    }
+    return point_add_each(batch->acc, batch->acc, batch->terms, batch->scratch, count) < 0 ? -1 : 0;
+}
+
+Point ecmult_batch_point(EcmultBatch *batch, size_t i) {
+    return &batch->acc[i];
+}
+
+void ecmult_batch_free(EcmultBatch *batch) {
+    if (!batch) return;
+
+    for (size_t i = 0; i < batch->capacity; i++) {
+        point_clear(&batch->acc[i]);
+        mpz_clear(batch->scratch[2 * i]);
+        mpz_clear(batch->scratch[2 * i + 1]);
+    }
+
+    free(batch->acc);
+    free(batch->terms);
+    free(batch->scratch);
+    free(batch);
+}
@@ -0,0 +1,66 @@
+/*
+ * Copyright (c) 2023 Brian Barto
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GPL License. See LICENSE for more details.
+ */
+
+#ifndef ECMULT_H
+#define ECMULT_H
+
+#include <stddef.h>
+#include "point.h"
+
+#define ECMULT_SCALAR_LEN 32
+
+typedef struct EcmultBatch EcmultBatch;
+
+/**
+ * Allocate the working space of batched multiplications of G. The first
+ * batch also builds the shared fixed-base table.
+ *
+ * @param count Most products per call
+ * @return New batch or NULL on error
+ */
+EcmultBatch *ecmult_batch_new(size_t count);
+
+/**
+ * Multiply G by many unrelated scalars at once. The product comes from
+ * a table of 256 multiples of G for each of the 32 bytes of the scalar,
+ * so a scalar costs 31 point additions, and each addition shares one
+ * field inversion with the whole batch.
+ *
+ * @param batch Working space, the products replace its points
+ * @param scalars count * ECMULT_SCALAR_LEN byte big endian scalars, each
+ *        between 1 and n - 1
+ * @param count Number of scalars, at most the batch size
+ * @return 0 on success, -1 if a partial sum met its next term (odds
+ *         about 2^-250; the caller takes the single key path instead)
+ */
+int ecmult_batch_gen(EcmultBatch *batch, const unsigned char *scalars, size_t count);
+
+/**
+ * Add the same point to the first count products, sharing one inversion
+ *
+ * @param batch Batch after ecmult_batch_gen()
+ * @param point Point to add
+ * @param count Number of products
+ * @return 0 on success, -1 if a product is point or -point
+ */
+int ecmult_batch_add(EcmultBatch *batch, Point point, size_t count);
+
+/**
+ * @param batch Batch
+ * @param i Product index
+ * @return The product, owned by the batch
+ */
+Point ecmult_batch_point(EcmultBatch *batch, size_t i);
+
+/**
+ * Free batch working space
+ *
+ * @param batch Batch, may be NULL
+ */
+void ecmult_batch_free(EcmultBatch *batch);
+
+#endif // ECMULT_H
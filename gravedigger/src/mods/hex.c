@@ -1,6 +1,6 @@
 /*
  * Copyright (c) 2017 Brian Barto
- * 
+ *
  * This program is free software; you can redistribute it and/or modify it
  * under the terms of the GPL License. See LICENSE for more details.
  */
@@ -8,15 +8,48 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include <string.h>
-#include <ctype.h>
 #include <assert.h>
 #include "hex.h"
 #include "error.h"
 
+#if defined(__SSE2__)
+#   include <immintrin.h>
+#   define HEX_SSE2 1
+#   if defined(__x86_64__) && defined(__GNUC__)
+#      define HEX_AVX2 1
+#   endif
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#   include <arm_neon.h>
+#   define HEX_NEON 1
+#endif
+
+static const char hex_digits[] = "0123456789abcdef";
+
+// Nibble value of every input byte, -1 for anything that is not hex.
+static const int8_t hex_values[256] = {
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	 0,  1,  2,  3,  4,  5,  6,  7,  8,  9, -1, -1, -1, -1, -1, -1,
+	-1, 10, 11, 12, 13, 14, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, 10, 11, 12, 13, 14, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1
+};
+
+static size_t hex_decode_simd(unsigned char *, const char *, size_t);
+static size_t hex_encode_simd(char *, const unsigned char *, size_t);
+
 int hex_to_dec(char l, char r)
 {
-	int decimal;
-
 	assert(l);
 	assert(r);
 
@@ -26,44 +59,74 @@ int hex_to_dec(char l, char r)
 		return -1;
 	}
 
-	l = tolower(l);
-	r = tolower(r);
-
-	l = isdigit(l) ? l - 48 : l - 87;
-	r = isdigit(r) ? r - 48 : r - 87;
-	
-	decimal = (l << 4) + r;
-	
-	return decimal;
+	return (hex_values[(unsigned char)l] << 4) | hex_values[(unsigned char)r];
 }
 
 int hex_str_to_raw(unsigned char *output, char *input)
 {
 	int r;
-	size_t i, input_len;
 
 	assert(output);
 	assert(input);
-	
-	input_len = strlen(input);
-	
+
+	r = hex_decode(output, input, strlen(input));
+	if (r < 0)
+	{
+		error_log("Could not convert hex character to decimal.");
+		return -1;
+	}
+
+	return 1;
+}
+
+int hex_decode(unsigned char *output, char *input, size_t input_len)
+{
+	int r;
+	size_t i;
+
+	assert(output);
+	assert(input);
+
 	if (input_len % 2 != 0)
 	{
 		error_log("Invalid hex string. Length is not even.");
 		return -1;
 	}
-	
-	for (i = 0; i < input_len; i += 2)
+
+	// The vector kernels stop at the first block containing a non-hex
+	// character. The scalar loop below finishes the tail and reports it.
+	i = hex_decode_simd(output, input, input_len);
+
+	for (; i < input_len; i += 2)
 	{
 		r = hex_to_dec(input[i], input[i + 1]);
 		if (r < 0)
 		{
-			error_log("Could not convert hex character to decimal.");
+			error_log("Invalid hex string at index %zu.", i);
 			return -1;
 		}
-		*output++ = r;
+		output[i / 2] = r;
 	}
-	
+
+	return (int)(input_len / 2);
+}
+
+int hex_encode(char *output, unsigned char *input, size_t input_len)
+{
+	size_t i;
+
+	assert(output);
+	assert(input || input_len == 0);
+
+	i = hex_encode_simd(output, input, input_len);
+
+	for (; i < input_len; ++i)
+	{
+		output[i * 2] = hex_digits[input[i] >> 4];
+		output[i * 2 + 1] = hex_digits[input[i] & 0x0f];
+	}
+	output[input_len * 2] = '\0';
+
 	return 1;
 }
 
@@ -71,6 +134,242 @@ int hex_ischar(char c)
 {
 	assert(c);
 
-	return (c >= 'A' && c <= 'F') || (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f');
+	return hex_values[(unsigned char)c] >= 0;
+}
+
+/*
+ * Vector kernels. Decoding validates a whole block at once: a byte is a
+ * digit if (c - '0') <= 9 and a letter if ((c | 0x20) - 'a') <= 5, both
+ * as unsigned compares. Each kernel returns the number of input
+ * characters (decode) or bytes (encode) it handled.
+ */
+
+#if defined(HEX_SSE2)
+
+static inline __m128i hex_nibbles_sse2(__m128i v, int *valid)
+{
+	__m128i d, l, digit, alpha;
+
+	d = _mm_sub_epi8(v, _mm_set1_epi8('0'));
+	l = _mm_sub_epi8(_mm_or_si128(v, _mm_set1_epi8(0x20)), _mm_set1_epi8('a'));
+	digit = _mm_cmpeq_epi8(_mm_subs_epu8(d, _mm_set1_epi8(9)), _mm_setzero_si128());
+	alpha = _mm_cmpeq_epi8(_mm_subs_epu8(l, _mm_set1_epi8(5)), _mm_setzero_si128());
+
+	*valid = _mm_movemask_epi8(_mm_or_si128(digit, alpha)) == 0xFFFF;
+
+	l = _mm_add_epi8(l, _mm_set1_epi8(10));
+	return _mm_or_si128(_mm_and_si128(digit, d), _mm_andnot_si128(digit, l));
+}
+
+static inline __m128i hex_ascii_sse2(__m128i n)
+{
+	__m128i letter = _mm_and_si128(_mm_cmpgt_epi8(n, _mm_set1_epi8(9)), _mm_set1_epi8('a' - '0' - 10));
+
+	return _mm_add_epi8(_mm_add_epi8(n, _mm_set1_epi8('0')), letter);
+}
+
+#if defined(HEX_AVX2)
+
+__attribute__((target("avx2")))
+static size_t hex_decode_avx2(unsigned char *output, const char *input, size_t input_len)
+{
+	size_t i;
+	__m256i v, d, l, digit, alpha, n, w;
+
+	for (i = 0; i + 32 <= input_len; i += 32)
+	{
+		v = _mm256_loadu_si256((const __m256i *)(input + i));
+
+		d = _mm256_sub_epi8(v, _mm256_set1_epi8('0'));
+		l = _mm256_sub_epi8(_mm256_or_si256(v, _mm256_set1_epi8(0x20)), _mm256_set1_epi8('a'));
+		digit = _mm256_cmpeq_epi8(_mm256_subs_epu8(d, _mm256_set1_epi8(9)), _mm256_setzero_si256());
+		alpha = _mm256_cmpeq_epi8(_mm256_subs_epu8(l, _mm256_set1_epi8(5)), _mm256_setzero_si256());
+		if ((uint32_t)_mm256_movemask_epi8(_mm256_or_si256(digit, alpha)) != 0xFFFFFFFF)
+		{
+			break;
+		}
+
+		n = _mm256_blendv_epi8(_mm256_add_epi8(l, _mm256_set1_epi8(10)), d, digit);
+
+		// (hi << 4) | lo for every byte pair, then pack the words down
+		w = _mm256_maddubs_epi16(n, _mm256_set1_epi16(0x0110));
+		w = _mm256_packus_epi16(w, w);
+		w = _mm256_permute4x64_epi64(w, 0x08);
+		_mm_storeu_si128((__m128i *)(output + i / 2), _mm256_castsi256_si128(w));
+	}
+
+	return i;
+}
+
+__attribute__((target("avx2")))
+static size_t hex_encode_avx2(char *output, const unsigned char *input, size_t input_len)
+{
+	size_t i;
+	__m256i b, w, lut;
+
+	lut = _mm256_setr_epi8('0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'a', 'b', 'c', 'd', 'e', 'f',
+	                       '0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'a', 'b', 'c', 'd', 'e', 'f');
+
+	for (i = 0; i + 16 <= input_len; i += 16)
+	{
+		b = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(input + i)));
+
+		// Low byte of each word gets the high nibble so the chars land in order
+		w = _mm256_or_si256(_mm256_srli_epi16(b, 4), _mm256_slli_epi16(_mm256_and_si256(b, _mm256_set1_epi16(0x0f)), 8));
+		_mm256_storeu_si256((__m256i *)(output + i * 2), _mm256_shuffle_epi8(lut, w));
+	}
+
+	return i;
+}
+
+static int hex_have_avx2(void)
+{
+	static int have = -1;
+
+	if (have < 0)
+	{
+		__builtin_cpu_init();
+		have = __builtin_cpu_supports("avx2") ? 1 : 0;
+	}
+
+	return have;
+}
+
+#endif
+
+static size_t hex_decode_simd(unsigned char *output, const char *input, size_t input_len)
+{
+	int valid;
+	size_t i = 0;
+	__m128i n, w;
+
+#if defined(HEX_AVX2)
+	if (hex_have_avx2())
+	{
+		i = hex_decode_avx2(output, input, input_len);
+	}
+#endif
+
+	for (; i + 16 <= input_len; i += 16)
+	{
+		n = hex_nibbles_sse2(_mm_loadu_si128((const __m128i *)(input + i)), &valid);
+		if (!valid)
+		{
+			break;
+		}
+
+		// Little endian words hold (lo << 8) | hi, fold them to (hi << 4) | lo
+		w = _mm_or_si128(_mm_slli_epi16(_mm_and_si128(n, _mm_set1_epi16(0x00ff)), 4), _mm_srli_epi16(n, 8));
+		_mm_storel_epi64((__m128i *)(output + i / 2), _mm_packus_epi16(w, w));
+	}
+
+	return i;
+}
+
+static size_t hex_encode_simd(char *output, const unsigned char *input, size_t input_len)
+{
+	size_t i = 0;
+	__m128i b, lo, hi;
+
+#if defined(HEX_AVX2)
+	if (hex_have_avx2())
+	{
+		i = hex_encode_avx2(output, input, input_len);
+	}
+#endif
+
+	for (; i + 16 <= input_len; i += 16)
+	{
+		b = _mm_loadu_si128((const __m128i *)(input + i));
+		hi = _mm_and_si128(_mm_srli_epi16(b, 4), _mm_set1_epi8(0x0f));
+		lo = _mm_and_si128(b, _mm_set1_epi8(0x0f));
+
+		_mm_storeu_si128((__m128i *)(output + i * 2), hex_ascii_sse2(_mm_unpacklo_epi8(hi, lo)));
+		_mm_storeu_si128((__m128i *)(output + i * 2 + 16), hex_ascii_sse2(_mm_unpackhi_epi8(hi, lo)));
+	}
+
+	return i;
+}
+
+#elif defined(HEX_NEON)
+
+static inline uint8x16_t hex_nibbles_neon(uint8x16_t v, uint8x16_t *valid)
+{
+	uint8x16_t d, l, digit;
+
+	d = vsubq_u8(v, vdupq_n_u8('0'));
+	l = vsubq_u8(vorrq_u8(v, vdupq_n_u8(0x20)), vdupq_n_u8('a'));
+	digit = vcleq_u8(d, vdupq_n_u8(9));
+
+	*valid = vandq_u8(*valid, vorrq_u8(digit, vcleq_u8(l, vdupq_n_u8(5))));
+
+	return vbslq_u8(digit, d, vaddq_u8(l, vdupq_n_u8(10)));
+}
+
+static size_t hex_decode_simd(unsigned char *output, const char *input, size_t input_len)
+{
+	size_t i;
+	uint8x16x2_t v;
+	uint8x16_t hi, lo, valid;
+
+	for (i = 0; i + 32 <= input_len; i += 32)
+	{
+		// De-interleaves high and low nibble characters
+		v = vld2q_u8((const uint8_t *)(input + i));
+
+		valid = vdupq_n_u8(0xff);
+		hi = hex_nibbles_neon(v.val[0], &valid);
+		lo = hex_nibbles_neon(v.val[1], &valid);
+		if (vminvq_u8(valid) != 0xff)
+		{
+			break;
+		}
+
+		vst1q_u8(output + i / 2, vorrq_u8(vshlq_n_u8(hi, 4), lo));
+	}
+
+	return i;
+}
+
+static size_t hex_encode_simd(char *output, const unsigned char *input, size_t input_len)
+{
+	size_t i;
+	uint8x16_t b, lut;
+	uint8x16x2_t c;
+
+	lut = vld1q_u8((const uint8_t *)hex_digits);
+
+	for (i = 0; i + 16 <= input_len; i += 16)
+	{
+		b = vld1q_u8(input + i);
+		c.val[0] = vqtbl1q_u8(lut, vshrq_n_u8(b, 4));
+		c.val[1] = vqtbl1q_u8(lut, vandq_u8(b, vdupq_n_u8(0x0f)));
+
+		// Interleaving store puts each high nibble before its low nibble
+		vst2q_u8((uint8_t *)(output + i * 2), c);
+	}
+
+	return i;
+}
+
+#else
+
+static size_t hex_decode_simd(unsigned char *output, const char *input, size_t input_len)
+{
+	(void)output;
+	(void)input;
+	(void)input_len;
+
+	return 0;
+}
+
+static size_t hex_encode_simd(char *output, const unsigned char *input, size_t input_len)
+{
+	(void)output;
+	(void)input;
+	(void)input_len;
+
+	return 0;
 }
 
+#endif
@@ -0,0 +1,559 @@
+/*
+ * Copyright (c) 2023 Brian Barto
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GPL License. See LICENSE for more details.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "keybatch.h"
+#include "point.h"
+#include "crypto.h"
+#include "random.h"
+#include "network.h"
+#include "bech32.h"
+#include "error.h"
+
+#define P2PKH_VERSION_MAINNET 0x00
+#define P2PKH_VERSION_TESTNET 0x6F
+#define P2SH_VERSION_MAINNET  0x05
+#define P2SH_VERSION_TESTNET  0xC4
+#define WIF_VERSION_MAINNET   0x80
+#define WIF_VERSION_TESTNET   0xEF
+#define WIF_COMPRESSED_FLAG   0x01
+
+// Largest base scalar that still leaves room for a whole batch below
+// the curve order n (n - KEYBATCH_MAX), so a walk never wraps.
+static const unsigned char scalar_limit[KEYBATCH_SCALAR_LEN] = {
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFE,
+    0xBA, 0xAE, 0xDC, 0xE6, 0xAF, 0x48, 0xA0, 0x3B,
+    0xBF, 0xD2, 0x5E, 0x8C, 0xD0, 0x36, 0x3D, 0x41
+};
+
+// Curve order n, big endian
+static const unsigned char curve_order[KEYBATCH_SCALAR_LEN] = {
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFE,
+    0xBA, 0xAE, 0xDC, 0xE6, 0xAF, 0x48, 0xA0, 0x3B,
+    0xBF, 0xD2, 0x5E, 0x8C, 0xD0, 0x36, 0x41, 0x41
+};
+
+static const char base58_chars[] = "123456789ABCDEFGHJKLMNPQRSTUVWXYZabcdefghijkmnopqrstuvwxyz";
+
+// (i + 1) * G for every slot of the largest batch, shared read-only
+static struct Point multiples[KEYBATCH_MAX];
+static pthread_once_t multiples_once = PTHREAD_ONCE_INIT;
+
+static void multiples_init(void) {
+    point_init(&multiples[0]);
+    point_set_generator(&multiples[0]);
+    for (size_t i = 1; i < KEYBATCH_MAX; i++) {
+        point_init(&multiples[i]);
+        if (i == 1) {
+            point_double(&multiples[1], &multiples[0]);
+        } else {
+            point_add(&multiples[i], &multiples[i - 1], &multiples[0]);
+        }
+    }
+}
+
+static void *aligned_array(size_t count, size_t size) {
+    void *p = NULL;
+    size_t bytes = (count * size + KEYBATCH_ALIGN - 1) & ~(size_t)(KEYBATCH_ALIGN - 1);
+
+    if (posix_memalign(&p, KEYBATCH_ALIGN, bytes) != 0) {
+        return NULL;
+    }
+    memset(p, 0, bytes);
+    return p;
+}
+
+KeyBatch *keybatch_new(size_t count, unsigned int flags) {
+    bool uncompressed = flags & KEYBATCH_UNCOMPRESSED;
+    bool taproot = flags & KEYBATCH_TAPROOT;
+    bool independent = flags & KEYBATCH_INDEPENDENT;
+
+    if (count == 0 || count > KEYBATCH_MAX) {
+        error_log("Batch size must be between 1 and %d", KEYBATCH_MAX);
+        return NULL;
+    }
+
+    pthread_once(&multiples_once, multiples_init);
+
+    KeyBatch *batch = calloc(1, sizeof(KeyBatch));
+    if (!batch) {
+        error_log("Memory allocation error.");
+        return NULL;
+    }
+
+    batch->count = count;
+    batch->candidates = uncompressed ? 2 * count : count;
+    batch->uncompressed = uncompressed;
+    batch->reseed = 1;
+    batch->scalars = aligned_array(count, KEYBATCH_SCALAR_LEN);
+    batch->pubkeys = aligned_array(count, KEYBATCH_PUBKEY_LEN);
+    batch->full_pubkeys = uncompressed ? aligned_array(count, KEYBATCH_FULL_PUBKEY_LEN) : NULL;
+    batch->hashes = aligned_array(batch->candidates, KEYBATCH_HASH_LEN);
+    batch->outputs = taproot ? aligned_array(count, KEYBATCH_OUTPUT_LEN) : NULL;
+    batch->taproot = taproot ? taproot_batch_new(count) : NULL;
+    batch->addresses = aligned_array(batch->candidates, KEYBATCH_ADDR_LEN);
+    batch->hits = aligned_array(batch->candidates, sizeof(uint32_t));
+    batch->points = calloc(count, sizeof(struct Point));
+    batch->scratch = calloc(count, sizeof(mpz_t));
+    batch->products = independent ? ecmult_batch_new(count) : NULL;
+
+    if (!batch->scalars || !batch->pubkeys || (uncompressed && !batch->full_pubkeys) || !batch->hashes ||
+        (taproot && (!batch->outputs || !batch->taproot)) || (independent && !batch->products) ||
+        !batch->addresses || !batch->hits || !batch->points || !batch->scratch) {
+        error_log("Memory allocation error.");
+        free(batch->scalars);
+        free(batch->pubkeys);
+        free(batch->full_pubkeys);
+        free(batch->hashes);
+        free(batch->outputs);
+        taproot_batch_free(batch->taproot);
+        free(batch->addresses);
+        free(batch->hits);
+        free(batch->points);
+        free(batch->scratch);
+        ecmult_batch_free(batch->products);
+        free(batch);
+        return NULL;
+    }
+
+    point_init(&batch->base);
+    for (size_t i = 0; i < count; i++) {
+        point_init(&batch->points[i]);
+        mpz_init(batch->scratch[i]);
+    }
+
+    return batch;
+}
+
+int keybatch_run(KeyBatch *batch, const keybatch_kernel *kernels, const void *arg) {
+    batch->hit_count = 0;
+
+    for (int stage = 0; stage < KEYBATCH_STAGES; stage++) {
+#ifdef VANITY_PROFILE
+        uint64_t start = keybatch_ticks();
+#endif
+        if (kernels[stage] && kernels[stage](batch, arg) < 0) {
+            return -1;
+        }
+#ifdef VANITY_PROFILE
+        KEYBATCH_TALLY(batch->ticks[stage], keybatch_ticks() - start);
+#endif
+    }
+#ifdef VANITY_PROFILE
+    KEYBATCH_TALLY(batch->profiled, batch->candidates);
+#endif
+
+    return 0;
+}
+
+void keybatch_reseed(KeyBatch *batch) {
+    batch->reseed = 1;
+}
+
+void keybatch_set_base(KeyBatch *batch, const unsigned char *scalar) {
+    memcpy(batch->base_scalar, scalar, KEYBATCH_SCALAR_LEN);
+    batch->reseed = 0;
+    batch->rebase = 1;
+}
+
+void keybatch_seed(KeyBatch *batch, const unsigned char *key) {
+    memcpy(batch->seed_key, key, KEYBATCH_SCALAR_LEN);
+    batch->seed_position = 0;
+    batch->seeded = true;
+    batch->reseed = 1;
+}
+
+int keybatch_set_xpub(KeyBatch *batch, const Bip32Xpub *xpub) {
+    if (batch->uncompressed || batch->taproot) {
+        error_log("Child keys of an xpub are only searched compressed, without taproot");
+        return -1;
+    }
+
+    bip32_batch_free(batch->xpub);
+    batch->xpub = bip32_batch_new(xpub, batch->count);
+    return batch->xpub ? 0 : -1;
+}
+
+void keybatch_free(KeyBatch *batch) {
+    if (!batch) return;
+
+    point_clear(&batch->base);
+    for (size_t i = 0; i < batch->count; i++) {
+        point_clear(&batch->points[i]);
+        mpz_clear(batch->scratch[i]);
+    }
+
+    // Private key material
+    memset(batch->scalars, 0, batch->count * KEYBATCH_SCALAR_LEN);
+    memset(batch->base_scalar, 0, KEYBATCH_SCALAR_LEN);
+    memset(batch->seed_key, 0, KEYBATCH_SCALAR_LEN);
+
+    free(batch->scalars);
+    free(batch->pubkeys);
+    free(batch->full_pubkeys);
+    free(batch->hashes);
+    free(batch->outputs);
+    free(batch->addresses);
+    free(batch->hits);
+    free(batch->points);
+    free(batch->scratch);
+    taproot_batch_free(batch->taproot);
+    bip32_batch_free(batch->xpub);
+    ecmult_batch_free(batch->products);
+    free(batch);
+}
+
+// Big endian 256-bit add of a small value, no wrap (callers stay below n)
+static void scalar_add(unsigned char *out, const unsigned char *in, uint32_t v) {
+    uint32_t carry = v;
+
+    for (int i = KEYBATCH_SCALAR_LEN - 1; i >= 0; i--) {
+        carry += in[i];
+        out[i] = carry & 0xFF;
+        carry >>= 8;
+    }
+}
+
+static int scalar_is_zero(const unsigned char *s) {
+    unsigned char acc = 0;
+
+    for (int i = 0; i < KEYBATCH_SCALAR_LEN; i++) {
+        acc |= s[i];
+    }
+    return acc == 0;
+}
+
+/*
+ * Keys are consecutive scalars from a random base, so walking lets the
+ * EC stage replace a full scalar multiplication with one point addition
+ * per key. Any key of a walk gives away the rest: callers that reveal
+ * one must keybatch_reseed() before the next batch.
+ */
+int keybatch_scalar_walk(KeyBatch *batch, const void *arg) {
+    (void)arg;
+
+    if (!batch->reseed && memcmp(batch->base_scalar, scalar_limit, KEYBATCH_SCALAR_LEN) >= 0) {
+        batch->reseed = 1;
+    }
+
+    if (batch->reseed) {
+        do {
+            int r = batch->seeded ? random_get_seeded(batch->base_scalar, KEYBATCH_SCALAR_LEN,
+                                                      batch->seed_key, &batch->seed_position)
+                                  : random_get(batch->base_scalar, KEYBATCH_SCALAR_LEN);
+            if (r < 0) {
+                error_log("Could not get random data for batch base.");
+                return -1;
+            }
+        } while (scalar_is_zero(batch->base_scalar) ||
+                 memcmp(batch->base_scalar, scalar_limit, KEYBATCH_SCALAR_LEN) >= 0);
+        batch->reseed = 0;
+        batch->rebase = 1;
+    }
+
+    unsigned char *s = batch->scalars;
+    scalar_add(s, batch->base_scalar, 1);
+    for (size_t i = 1; i < batch->count; i++, s += KEYBATCH_SCALAR_LEN) {
+        scalar_add(s + KEYBATCH_SCALAR_LEN, s, 1);
+    }
+
+    scalar_add(batch->base_scalar, batch->base_scalar, (uint32_t)batch->count);
+
+    return 0;
+}
+
+// SEC encodings of key i, 0x04 || x || y as well for uncompressed batches
+static void export_pubkey(KeyBatch *batch, size_t i, const struct Point *point) {
+    unsigned char *out = batch->pubkeys + i * KEYBATCH_PUBKEY_LEN;
+    size_t len;
+
+    out[0] = mpz_odd_p(point->y) ? 0x03 : 0x02;
+    len = (mpz_sizeinbase(point->x, 2) + 7) / 8;
+    memset(out + 1, 0, KEYBATCH_PUBKEY_LEN - 1);
+    mpz_export(out + KEYBATCH_PUBKEY_LEN - len, NULL, 1, 1, 1, 0, point->x);
+
+    if (batch->uncompressed) {
+        // x copied from the compressed encoding
+        unsigned char *full = batch->full_pubkeys + i * KEYBATCH_FULL_PUBKEY_LEN;
+        full[0] = 0x04;
+        memcpy(full + 1, out + 1, KEYBATCH_PUBKEY_LEN - 1);
+        len = (mpz_sizeinbase(point->y, 2) + 7) / 8;
+        memset(full + KEYBATCH_PUBKEY_LEN, 0, KEYBATCH_PUBKEY_LEN - 1);
+        mpz_export(full + KEYBATCH_FULL_PUBKEY_LEN - len, NULL, 1, 1, 1, 0, point->y);
+    }
+}
+
+int keybatch_ec_walk(KeyBatch *batch, const void *arg) {
+    (void)arg;
+
+    // A fresh base costs one full multiplication: base = (scalars[0] - 1)G
+    if (batch->rebase) {
+        mpz_t k;
+        struct Point g;
+
+        mpz_init(k);
+        point_init(&g);
+        point_set_generator(&g);
+        mpz_import(k, KEYBATCH_SCALAR_LEN, 1, 1, 1, 0, batch->scalars);
+        mpz_sub_ui(k, k, 1);
+        point_mul(&batch->base, &g, k);
+        mpz_clear(k);
+        point_clear(&g);
+        batch->rebase = 0;
+    }
+
+    if (point_add_batch(batch->points, &batch->base, multiples, batch->scratch, batch->count) < 0) {
+        batch->reseed = 1;
+        return -1;
+    }
+
+    for (size_t i = 0; i < batch->count; i++) {
+        export_pubkey(batch, i, &batch->points[i]);
+    }
+
+    point_set(&batch->base, &batch->points[batch->count - 1]);
+
+    return 0;
+}
+
+/*
+ * Every key drawn on its own, between 1 and n - 1, for keys that are
+ * all handed out: no key tells anything about another. Costs a full
+ * multiplication per key in the EC stage, see keybatch_ec_gen().
+ */
+int keybatch_scalar_random(KeyBatch *batch, const void *arg) {
+    (void)arg;
+
+    if (random_get(batch->scalars, batch->count * KEYBATCH_SCALAR_LEN) < 0) {
+        error_log("Could not get random data for private keys.");
+        return -1;
+    }
+
+    // Draws of 0 or n and up, odds about 2^-128 each, are drawn again
+    for (size_t i = 0; i < batch->count; i++) {
+        unsigned char *s = batch->scalars + i * KEYBATCH_SCALAR_LEN;
+        while (scalar_is_zero(s) || memcmp(s, curve_order, KEYBATCH_SCALAR_LEN) >= 0) {
+            if (random_get(s, KEYBATCH_SCALAR_LEN) < 0) {
+                error_log("Could not get random data for private keys.");
+                return -1;
+            }
+        }
+    }
+
+    batch->rebase = 0;
+    return 0;
+}
+
+int keybatch_ec_gen(KeyBatch *batch, const void *arg) {
+    (void)arg;
+
+    if (!batch->products) {
+        error_log("Batch was not made for independent keys");
+        return -1;
+    }
+
+    if (ecmult_batch_gen(batch->products, batch->scalars, batch->count) == 0) {
+        for (size_t i = 0; i < batch->count; i++) {
+            export_pubkey(batch, i, ecmult_batch_point(batch->products, i));
+        }
+        return 0;
+    }
+
+    // A partial sum met its next term; one plain multiplication per key
+    mpz_t k;
+    struct Point g;
+
+    mpz_init(k);
+    point_init(&g);
+    point_set_generator(&g);
+    for (size_t i = 0; i < batch->count; i++) {
+        mpz_import(k, KEYBATCH_SCALAR_LEN, 1, 1, 1, 0, batch->scalars + i * KEYBATCH_SCALAR_LEN);
+        point_mul(&batch->points[i], &g, k);
+        export_pubkey(batch, i, &batch->points[i]);
+    }
+    mpz_set_ui(k, 0);
+    mpz_clear(k);
+    point_clear(&g);
+
+    return 0;
+}
+
+/*
+ * Scalars count child indices here: scalar i is index + 1, and a batch
+ * always covers consecutive indices, so only the first one is read.
+ */
+int keybatch_ec_xpub(KeyBatch *batch, const void *arg) {
+    const unsigned char *s = batch->scalars + KEYBATCH_SCALAR_LEN - 4;
+    uint32_t first = ((uint32_t)s[0] << 24 | (uint32_t)s[1] << 16 | (uint32_t)s[2] << 8 | s[3]) - 1;
+    (void)arg;
+
+    batch->rebase = 0;
+    return bip32_batch_children(batch->xpub, batch->pubkeys, first, batch->count);
+}
+
+/*
+ * HASH160 of every candidate's input, in. Profiled builds do the same
+ * work as crypto_get_hash160() in two steps so SHA-256 and RIPEMD-160
+ * are timed apart.
+ */
+static void hash160_batch(KeyBatch *batch, unsigned char *(*in)(const KeyBatch *, size_t),
+                          size_t (*in_len)(const KeyBatch *, size_t)) {
+#ifdef VANITY_PROFILE
+    unsigned char sha[32];
+    uint64_t sha_ticks = 0, start;
+
+    for (size_t i = 0; i < batch->candidates; i++) {
+        start = keybatch_ticks();
+        crypto_get_sha256(sha, in(batch, i), in_len(batch, i));
+        sha_ticks += keybatch_ticks() - start;
+        crypto_get_rmd160(batch->hashes + i * KEYBATCH_HASH_LEN, sha, 32);
+    }
+    KEYBATCH_TALLY(batch->sha256_ticks, sha_ticks);
+#else
+    for (size_t i = 0; i < batch->candidates; i++) {
+        crypto_get_hash160(batch->hashes + i * KEYBATCH_HASH_LEN, in(batch, i), in_len(batch, i));
+    }
+#endif
+}
+
+int keybatch_hash160(KeyBatch *batch, const void *arg) {
+    (void)arg;
+
+    hash160_batch(batch, keybatch_pubkey, keybatch_pubkey_len);
+    return 0;
+}
+
+/*
+ * P2WPKH redeem script 0x00 0x14 || HASH160(pubkey). It is built in the
+ * candidate's address slot, which is free until the encode stage.
+ */
+static unsigned char *redeem_script(const KeyBatch *batch, size_t i) {
+    unsigned char *script = (unsigned char *)batch->addresses + i * KEYBATCH_ADDR_LEN;
+
+    script[0] = 0x00;
+    script[1] = KEYBATCH_HASH_LEN;
+    memcpy(script + 2, batch->hashes + i * KEYBATCH_HASH_LEN, KEYBATCH_HASH_LEN);
+    return script;
+}
+
+static size_t redeem_script_len(const KeyBatch *batch, size_t i) {
+    (void)batch;
+    (void)i;
+    return KEYBATCH_SCRIPT_LEN;
+}
+
+int keybatch_hash160_p2sh(KeyBatch *batch, const void *arg) {
+    (void)arg;
+
+    hash160_batch(batch, keybatch_pubkey, keybatch_pubkey_len);
+    hash160_batch(batch, redeem_script, redeem_script_len);
+    return 0;
+}
+
+/*
+ * Base58Check of len_in payload bytes and their 4 byte checksum, which
+ * payload must have room for: version || hash160 for addresses, up to
+ * the 34 bytes of a compressed WIF. Works on small integer digits
+ * instead of a bignum, which is what the generic base58check_encode()
+ * costs per key.
+ */
+static void encode_base58check(char *out, unsigned char *payload, size_t len_in) {
+    unsigned char digits[KEYBATCH_WIF_LEN];
+    unsigned char sha[32];
+    size_t len = 0, zeros = 0, total = len_in + 4;
+
+    crypto_get_sha256(sha, payload, len_in);
+    crypto_get_sha256(sha, sha, 32);
+    memcpy(payload + len_in, sha, 4);
+
+    while (zeros < total && payload[zeros] == 0) {
+        zeros++;
+    }
+
+    for (size_t i = zeros; i < total; i++) {
+        uint32_t carry = payload[i];
+        for (size_t j = 0; j < len; j++) {
+            carry += (uint32_t)digits[j] << 8;
+            digits[j] = carry % 58;
+            carry /= 58;
+        }
+        while (carry) {
+            digits[len++] = carry % 58;
+            carry /= 58;
+        }
+    }
+
+    size_t o = 0;
+    while (o < zeros) {
+        out[o++] = '1';
+    }
+    while (len) {
+        out[o++] = base58_chars[digits[--len]];
+    }
+    out[o] = '\0';
+}
+
+static void encode_base58_batch(KeyBatch *batch, unsigned char version) {
+    unsigned char payload[25];
+
+    payload[0] = version;
+
+    for (size_t i = 0; i < batch->candidates; i++) {
+        memcpy(payload + 1, batch->hashes + i * KEYBATCH_HASH_LEN, KEYBATCH_HASH_LEN);
+        encode_base58check(batch->addresses + i * KEYBATCH_ADDR_LEN, payload, 21);
+    }
+}
+
+void keybatch_encode_wif(const KeyBatch *batch, size_t i, char *wif) {
+    unsigned char payload[1 + KEYBATCH_SCALAR_LEN + 1 + 4];
+    size_t len = 1 + KEYBATCH_SCALAR_LEN;
+
+    payload[0] = network_is_test() ? WIF_VERSION_TESTNET : WIF_VERSION_MAINNET;
+    memcpy(payload + 1, batch->scalars + keybatch_key(batch, i) * KEYBATCH_SCALAR_LEN, KEYBATCH_SCALAR_LEN);
+    if (keybatch_compressed(batch, i)) {
+        payload[len++] = WIF_COMPRESSED_FLAG;
+    }
+    encode_base58check(wif, payload, len);
+    memset(payload, 0, sizeof(payload));
+}
+
+int keybatch_encode_p2pkh(KeyBatch *batch, const void *arg) {
+    (void)arg;
+
+    encode_base58_batch(batch, network_is_test() ? P2PKH_VERSION_TESTNET : P2PKH_VERSION_MAINNET);
+    return 0;
+}
+
+int keybatch_encode_p2sh(KeyBatch *batch, const void *arg) {
+    (void)arg;
+
+    encode_base58_batch(batch, network_is_test() ? P2SH_VERSION_TESTNET : P2SH_VERSION_MAINNET);
+    return 0;
+}
+
+int keybatch_tweak_p2tr(KeyBatch *batch, const void *arg) {
+    (void)arg;
+
+    return taproot_batch_output_keys(batch->taproot, batch->outputs, batch->scalars, batch->pubkeys, batch->count);
+}
+
+int keybatch_encode_p2tr(KeyBatch *batch, const void *arg) {
+    (void)arg;
+
+    for (size_t i = 0; i < batch->count; i++) {
+        if (bech32_get_address(batch->addresses + i * KEYBATCH_ADDR_LEN,
+                               batch->outputs + i * KEYBATCH_OUTPUT_LEN, KEYBATCH_OUTPUT_LEN, 1) < 0) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
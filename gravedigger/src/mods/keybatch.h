@@ -0,0 +1,280 @@
+/*
+ * Copyright (c) 2023 Brian Barto
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GPL License. See LICENSE for more details.
+ */
+
+#ifndef KEYBATCH_H
+#define KEYBATCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "point.h"
+#include "taproot.h"
+#include "bip32.h"
+#include "ecmult.h"
+
+#define KEYBATCH_SIZE        256   // Default candidates per batch
+#define KEYBATCH_MAX         1024  // Upper bound, sizes the shared i*G table
+#define KEYBATCH_ALIGN       64    // Every array starts on its own cache line
+#define KEYBATCH_SCALAR_LEN  32
+#define KEYBATCH_PUBKEY_LEN  33    // Compressed SEC encoding
+#define KEYBATCH_FULL_PUBKEY_LEN 65 // Uncompressed SEC encoding
+#define KEYBATCH_HASH_LEN    20
+#define KEYBATCH_ADDR_LEN    96    // Stride of one encoded address slot
+#define KEYBATCH_SCRIPT_LEN  22    // P2WPKH redeem script of a nested segwit address
+#define KEYBATCH_OUTPUT_LEN  32    // Taproot output key, x-only
+
+// keybatch_new() flags
+#define KEYBATCH_UNCOMPRESSED 1    // Also test the uncompressed address of every key
+#define KEYBATCH_TAPROOT      2    // Tweak every key to its taproot output key
+#define KEYBATCH_INDEPENDENT  4    // Unrelated random keys, see keybatch_scalar_random()
+
+#define KEYBATCH_WIF_LEN      53   // Uncompressed WIF is 51 characters, compressed 52
+
+// Pipeline stages, run in this order by keybatch_run()
+typedef enum {
+    KEYBATCH_STAGE_SCALAR = 0,  // Private key generation
+    KEYBATCH_STAGE_EC,          // Scalar multiplication / point walk
+    KEYBATCH_STAGE_HASH,        // HASH160 of the public keys, or their taproot tweak
+    KEYBATCH_STAGE_ENCODE,      // Address encoding (optional)
+    KEYBATCH_STAGE_MATCH,       // Pattern test, fills the hit list
+    KEYBATCH_STAGES
+} keybatch_stage_t;
+
+#ifdef VANITY_PROFILE
+/*
+ * Builds with VANITY_PROFILE count timer ticks spent in every stage.
+ * x86 reads the TSC, so a tick is a reference cycle; arm64 reads the
+ * generic timer, which runs at a fixed, lower frequency. Other targets
+ * fall back to nanoseconds. Without the flag none of this is compiled.
+ */
+#if defined(__x86_64__) || defined(__i386__)
+#define KEYBATCH_TICK_UNIT "cycles"
+#elif defined(__aarch64__)
+#define KEYBATCH_TICK_UNIT "ticks"
+#else
+#define KEYBATCH_TICK_UNIT "ns"
+#include <time.h>
+#endif
+
+static inline uint64_t keybatch_ticks(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    uint32_t lo, hi;
+    __asm__ volatile("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((uint64_t)hi << 32) | lo;
+#elif defined(__aarch64__)
+    uint64_t t;
+    __asm__ volatile("isb; mrs %0, cntvct_el0" : "=r"(t) :: "memory");
+    return t;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+#endif
+}
+
+// Only the batch's worker adds; readers on other threads see whole values
+#define KEYBATCH_TALLY(counter, n) \
+    __atomic_store_n(&(counter), (counter) + (n), __ATOMIC_RELAXED)
+#endif
+
+typedef struct KeyBatch KeyBatch;
+
+/*
+ * Batch buffers are laid out as a struct of arrays: candidate i owns
+ * scalars[i * 32], pubkeys[i * 33], hashes[i * 20] and so on, so each
+ * stage streams through one dense array and a vector kernel can take
+ * several candidates per instruction.
+ *
+ * A batch made with uncompressed keys tests two addresses per key:
+ * candidates [0, count) are the compressed encodings and candidate
+ * count + i is the uncompressed encoding of key i. The EC stage, the
+ * expensive one, still runs once per key.
+ *
+ * A taproot batch has no HASH160: its hash stage fills outputs with the
+ * BIP341 output key of every key instead.
+ *
+ * A batch given an extended public key holds no private keys: scalar i
+ * is child index + 1, and the EC stage derives the child public keys.
+ */
+struct KeyBatch {
+    size_t count;                 // Keys in this batch
+    size_t candidates;            // Addresses tested: count, or 2 * count
+    bool uncompressed;            // Uncompressed encodings follow the compressed ones
+
+    unsigned char *scalars;       // count * KEYBATCH_SCALAR_LEN, big endian
+    unsigned char *pubkeys;       // count * KEYBATCH_PUBKEY_LEN
+    unsigned char *full_pubkeys;  // count * KEYBATCH_FULL_PUBKEY_LEN, uncompressed only
+    unsigned char *hashes;        // candidates * KEYBATCH_HASH_LEN
+    unsigned char *outputs;       // count * KEYBATCH_OUTPUT_LEN, taproot only
+    char *addresses;              // candidates * KEYBATCH_ADDR_LEN, NUL terminated
+
+    uint32_t *hits;               // Indices of matching candidates
+    size_t hit_count;
+
+    // State of the sequential walk shared by the scalar and EC stages.
+    // Candidate i is base_scalar + i + 1 and its point is base + (i+1)G.
+    unsigned char base_scalar[KEYBATCH_SCALAR_LEN];
+    int reseed;                   // Scalar stage must pick a new random base
+    bool seeded;                  // New bases come from seed_key, not the RNG
+    unsigned char seed_key[KEYBATCH_SCALAR_LEN];
+    uint64_t seed_position;       // Bytes of the seeded stream used so far
+    int rebase;                   // EC stage must recompute base from base_scalar
+    struct Point base;
+    struct Point *points;         // count scratch points
+    mpz_t *scratch;               // count batch inversion products
+    TaprootBatch *taproot;        // Tweak working space, taproot only
+    Bip32Batch *xpub;             // Child derivation working space, xpub only
+    EcmultBatch *products;        // Multiples of G of unrelated scalars, independent only
+
+#ifdef VANITY_PROFILE
+    uint64_t ticks[KEYBATCH_STAGES]; // Time spent in every stage
+    uint64_t sha256_ticks;        // Part of the hash stage spent in SHA-256
+    uint64_t profiled;            // Candidates the ticks cover
+#endif
+};
+
+/**
+ * Stage kernel. Every stage reads the arrays produced by the stages
+ * before it and fills its own array for all batch->count candidates.
+ *
+ * @param batch Batch to process
+ * @param arg Caller context (the vanity search for match kernels)
+ * @return 0 on success, -1 on error
+ */
+typedef int (*keybatch_kernel)(KeyBatch *batch, const void *arg);
+
+/**
+ * Allocate a batch with aligned stage buffers
+ *
+ * @param count Number of keys (1 to KEYBATCH_MAX)
+ * @param flags KEYBATCH_UNCOMPRESSED, KEYBATCH_TAPROOT, KEYBATCH_INDEPENDENT, or 0
+ * @return New batch or NULL on error
+ */
+KeyBatch *keybatch_new(size_t count, unsigned int flags);
+
+/**
+ * Get the key behind a candidate
+ *
+ * @param batch Batch
+ * @param i Candidate index
+ * @return Key index into scalars and pubkeys
+ */
+static inline size_t keybatch_key(const KeyBatch *batch, size_t i) {
+    return i < batch->count ? i : i - batch->count;
+}
+
+/**
+ * Tell whether a candidate is the compressed encoding of its key
+ *
+ * @param batch Batch
+ * @param i Candidate index
+ * @return true for compressed, false for uncompressed
+ */
+static inline bool keybatch_compressed(const KeyBatch *batch, size_t i) {
+    return i < batch->count;
+}
+
+/**
+ * Get the public key encoding behind a candidate
+ *
+ * @param batch Batch, after the EC stage
+ * @param i Candidate index
+ * @return SEC encoded public key, see keybatch_pubkey_len()
+ */
+static inline unsigned char *keybatch_pubkey(const KeyBatch *batch, size_t i) {
+    if (keybatch_compressed(batch, i)) {
+        return batch->pubkeys + i * KEYBATCH_PUBKEY_LEN;
+    }
+    return batch->full_pubkeys + (i - batch->count) * KEYBATCH_FULL_PUBKEY_LEN;
+}
+
+/**
+ * @param batch Batch
+ * @param i Candidate index
+ * @return Length of the candidate's public key encoding
+ */
+static inline size_t keybatch_pubkey_len(const KeyBatch *batch, size_t i) {
+    return keybatch_compressed(batch, i) ? KEYBATCH_PUBKEY_LEN : KEYBATCH_FULL_PUBKEY_LEN;
+}
+
+/**
+ * Run every non-NULL stage of a pipeline over a batch
+ *
+ * @param batch Batch to process
+ * @param kernels KEYBATCH_STAGES kernels indexed by keybatch_stage_t
+ * @param arg Passed through to every kernel
+ * @return 0 on success, -1 if any stage failed
+ */
+int keybatch_run(KeyBatch *batch, const keybatch_kernel *kernels, const void *arg);
+
+/**
+ * Force the next scalar stage to pick a fresh random base
+ *
+ * @param batch Batch to reset
+ */
+void keybatch_reseed(KeyBatch *batch);
+
+/**
+ * Continue the walk from a known position: the next batch starts at
+ * scalar + 1. Used to resume a search from a checkpoint.
+ *
+ * @param batch Batch to position
+ * @param scalar Last scalar already searched, KEYBATCH_SCALAR_LEN bytes
+ */
+void keybatch_set_base(KeyBatch *batch, const unsigned char *scalar);
+
+/**
+ * Draw every new base from a deterministic stream instead of the RNG,
+ * so the batch tests the same keys on every run. Insecure: anyone with
+ * the key can derive every private key the batch makes.
+ *
+ * @param batch Batch to seed, before its first run
+ * @param key KEYBATCH_SCALAR_LEN byte stream key
+ */
+void keybatch_seed(KeyBatch *batch, const unsigned char *key);
+
+/**
+ * Derive child public keys of an extended public key instead of walking
+ * private keys. Pair with keybatch_ec_xpub() as the EC stage.
+ *
+ * @param batch Batch, before its first run
+ * @param xpub Parent key, copied
+ * @return 0 on success, -1 on error
+ */
+int keybatch_set_xpub(KeyBatch *batch, const Bip32Xpub *xpub);
+
+/**
+ * Encode the private key behind a candidate as WIF, flagged compressed
+ * or not to match the candidate's address
+ *
+ * @param batch Batch, after the scalar stage
+ * @param i Candidate index
+ * @param wif At least KEYBATCH_WIF_LEN bytes
+ */
+void keybatch_encode_wif(const KeyBatch *batch, size_t i, char *wif);
+
+/**
+ * Free a batch
+ *
+ * @param batch Batch to free
+ */
+void keybatch_free(KeyBatch *batch);
+
+// Default kernels
+int keybatch_scalar_walk(KeyBatch *batch, const void *arg);
+int keybatch_ec_walk(KeyBatch *batch, const void *arg);
+int keybatch_ec_xpub(KeyBatch *batch, const void *arg);       // Child keys of an xpub, in place of the walk
+int keybatch_scalar_random(KeyBatch *batch, const void *arg);  // Unrelated keys, in place of the walk
+int keybatch_ec_gen(KeyBatch *batch, const void *arg);        // Public keys of unrelated scalars
+int keybatch_hash160(KeyBatch *batch, const void *arg);
+int keybatch_hash160_p2sh(KeyBatch *batch, const void *arg);   // Script hash of P2SH-P2WPKH
+int keybatch_encode_p2pkh(KeyBatch *batch, const void *arg);
+int keybatch_encode_p2sh(KeyBatch *batch, const void *arg);
+int keybatch_tweak_p2tr(KeyBatch *batch, const void *arg);     // Taproot output keys, in place of HASH160
+int keybatch_encode_p2tr(KeyBatch *batch, const void *arg);
+
+#endif // KEYBATCH_H
@@ -0,0 +1,189 @@
+/*
+ * Copyright (c) 2023 Brian Barto
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GPL License. See LICENSE for more details.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include "keygen.h"
+#include "keybatch.h"
+#include "hex.h"
+#include "error.h"
+
+// Longest record: uncompressed pubkey hex, a key, an address and JSON
+#define KEYGEN_RECORD_LEN (KEYBATCH_WIF_LEN + KEYBATCH_SCALAR_LEN * 2 + KEYBATCH_FULL_PUBKEY_LEN * 2 + \
+                           KEYBATCH_ADDR_LEN + 48)
+
+typedef struct {
+    FILE *stream;
+    keygen_format_t format;
+    unsigned int flags;
+    uint64_t count;
+    uint64_t claimed;          // Keys handed to workers so far
+    bool failed;
+    pthread_mutex_t lock;      // Claims, the failure flag and writes to stream
+} KeygenJob;
+
+static const keybatch_kernel kernels[KEYBATCH_STAGES] = {
+    [KEYBATCH_STAGE_SCALAR] = keybatch_scalar_random,
+    [KEYBATCH_STAGE_EC] = keybatch_ec_gen,
+    [KEYBATCH_STAGE_HASH] = keybatch_hash160,
+    [KEYBATCH_STAGE_ENCODE] = keybatch_encode_p2pkh,
+};
+
+// Up to KEYBATCH_SIZE keys for the calling worker, 0 when done
+static size_t claim(KeygenJob *job) {
+    size_t n = 0;
+
+    pthread_mutex_lock(&job->lock);
+    if (!job->failed && job->claimed < job->count) {
+        n = job->count - job->claimed < KEYBATCH_SIZE ? (size_t)(job->count - job->claimed) : KEYBATCH_SIZE;
+        job->claimed += n;
+    }
+    pthread_mutex_unlock(&job->lock);
+
+    return n;
+}
+
+// One record for candidate i; returns its length
+static size_t format_record(const KeygenJob *job, const KeyBatch *batch, size_t i, char *out) {
+    const unsigned char *scalar = batch->scalars + keybatch_key(batch, i) * KEYBATCH_SCALAR_LEN;
+    unsigned char *pubkey = keybatch_pubkey(batch, i);
+    size_t pubkey_len = keybatch_pubkey_len(batch, i);
+    char key[KEYBATCH_SCALAR_LEN * 2 + 1], pub[KEYBATCH_FULL_PUBKEY_LEN * 2 + 1];
+    const char *address = batch->addresses + i * KEYBATCH_ADDR_LEN;
+    size_t len = 0;
+
+    // Every binary record is the same size, whatever the encoding
+    if (job->format == KEYGEN_FORMAT_BINARY) {
+        memset(out, 0, KEYGEN_BINARY_LEN);
+        memcpy(out, scalar, KEYBATCH_SCALAR_LEN);
+        out[KEYBATCH_SCALAR_LEN] = pubkey_len == KEYBATCH_PUBKEY_LEN;
+        memcpy(out + KEYBATCH_SCALAR_LEN + 1, pubkey, pubkey_len);
+        memcpy(out + KEYBATCH_SCALAR_LEN + 1 + KEYBATCH_FULL_PUBKEY_LEN, batch->hashes + i * KEYBATCH_HASH_LEN,
+               KEYBATCH_HASH_LEN);
+        return KEYGEN_BINARY_LEN;
+    }
+
+    if (job->flags & KEYGEN_HEX) {
+        hex_encode(key, (unsigned char *)scalar, KEYBATCH_SCALAR_LEN);
+    } else {
+        keybatch_encode_wif(batch, i, key);
+    }
+    hex_encode(pub, pubkey, pubkey_len);
+
+    if (job->format == KEYGEN_FORMAT_JSON) {
+        len = sprintf(out, "{\"%s\":\"%s\",\"pubkey\":\"%s\",\"address\":\"%s\"}\n",
+                      job->flags & KEYGEN_HEX ? "hex" : "wif", key, pub, address);
+    } else {
+        len = sprintf(out, "%s %s %s\n", key, pub, address);
+    }
+    memset(key, 0, sizeof(key));
+
+    return len;
+}
+
+static void *worker(void *arg) {
+    KeygenJob *job = arg;
+    KeyBatch *batch;
+    char *buffer;
+    size_t n;
+
+    batch = keybatch_new(KEYBATCH_SIZE, KEYBATCH_INDEPENDENT |
+                                        (job->flags & KEYGEN_UNCOMPRESSED ? KEYBATCH_UNCOMPRESSED : 0));
+    buffer = malloc(2 * KEYBATCH_SIZE * KEYGEN_RECORD_LEN);
+    if (!batch || !buffer) {
+        error_log("Memory allocation error.");
+        pthread_mutex_lock(&job->lock);
+        job->failed = true;
+        pthread_mutex_unlock(&job->lock);
+        keybatch_free(batch);
+        free(buffer);
+        return NULL;
+    }
+
+    while ((n = claim(job)) > 0) {
+        size_t len = 0;
+
+        if (keybatch_run(batch, kernels, NULL) < 0) {
+            pthread_mutex_lock(&job->lock);
+            job->failed = true;
+            pthread_mutex_unlock(&job->lock);
+            break;
+        }
+
+        // The first n keys; compressed encodings are candidates [0, count),
+        // uncompressed ones follow
+        for (size_t k = 0; k < n; k++) {
+            if (job->flags & KEYGEN_COMPRESSED) {
+                len += format_record(job, batch, k, buffer + len);
+            }
+            if (job->flags & KEYGEN_UNCOMPRESSED) {
+                len += format_record(job, batch, batch->count + k, buffer + len);
+            }
+        }
+
+        // Formatting runs in parallel, only the write is serialized
+        pthread_mutex_lock(&job->lock);
+        if (!job->failed && fwrite(buffer, 1, len, job->stream) != len) {
+            error_log("Could not write key records.");
+            job->failed = true;
+        }
+        pthread_mutex_unlock(&job->lock);
+        memset(buffer, 0, len);
+    }
+
+    keybatch_free(batch);
+    free(buffer);
+    return NULL;
+}
+
+int keygen_write(FILE *stream, uint64_t count, int threads, keygen_format_t format, unsigned int flags) {
+    pthread_t tids[KEYGEN_MAX_THREADS];
+    KeygenJob job;
+    int started = 0;
+
+    if (!stream || threads < 1 || threads > KEYGEN_MAX_THREADS ||
+        (format != KEYGEN_FORMAT_LIST && format != KEYGEN_FORMAT_JSON && format != KEYGEN_FORMAT_BINARY) ||
+        !(flags & (KEYGEN_COMPRESSED | KEYGEN_UNCOMPRESSED))) {
+        error_log("Invalid parameters for key generation");
+        return -1;
+    }
+
+    memset(&job, 0, sizeof(job));
+    job.stream = stream;
+    job.format = format;
+    job.flags = flags;
+    job.count = count;
+    pthread_mutex_init(&job.lock, NULL);
+
+    // Never more workers than batches
+    if ((uint64_t)threads > (count + KEYBATCH_SIZE - 1) / KEYBATCH_SIZE) {
+        threads = (int)((count + KEYBATCH_SIZE - 1) / KEYBATCH_SIZE);
+    }
+
+    for (; started < threads; started++) {
+        if (pthread_create(&tids[started], NULL, worker, &job) != 0) {
+            error_log("Could not start key generation thread");
+            pthread_mutex_lock(&job.lock);
+            job.failed = true;
+            pthread_mutex_unlock(&job.lock);
+            break;
+        }
+    }
+    for (int i = 0; i < started; i++) {
+        pthread_join(tids[i], NULL);
+    }
+    pthread_mutex_destroy(&job.lock);
+
+    if (fflush(stream) != 0) {
+        error_log("Could not write key records.");
+        return -1;
+    }
+
+    return job.failed ? -1 : 0;
+}
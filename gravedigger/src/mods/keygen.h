@@ -0,0 +1,47 @@
+/*
+ * Copyright (c) 2023 Brian Barto
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GPL License. See LICENSE for more details.
+ */
+
+#ifndef KEYGEN_H
+#define KEYGEN_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#define KEYGEN_MAX_THREADS 256
+#define KEYGEN_BINARY_LEN  118   // Bytes per KEYGEN_FORMAT_BINARY record
+
+// keygen_write() flags
+#define KEYGEN_COMPRESSED   1    // A record for the compressed key
+#define KEYGEN_UNCOMPRESSED 2    // A record for the uncompressed key
+#define KEYGEN_HEX          4    // Private keys as hex instead of WIF
+
+// Record formats
+typedef enum {
+    KEYGEN_FORMAT_LIST = 1,      // "<key> <pubkey hex> <address>" lines
+    KEYGEN_FORMAT_JSON = 2,      // One {"wif" or "hex", "pubkey", "address"} object per line
+    KEYGEN_FORMAT_BINARY = 3     // KEYGEN_BINARY_LEN bytes: 32 byte key, 1 if the
+                                 // pubkey is compressed else 0, 65 byte SEC pubkey
+                                 // (compressed ones zero padded), 20 byte HASH160
+} keygen_format_t;
+
+/**
+ * Generate unrelated random key pairs and write a record per key and
+ * encoding to a stream. Worker threads run the batch pipeline (random
+ * scalars, batched multiplication of G, HASH160, P2PKH encoding) and
+ * format whole batches, so no memory is allocated per key; records
+ * come out in no particular order.
+ *
+ * @param stream Where records go
+ * @param count Number of keys
+ * @param threads Worker threads, 1 to KEYGEN_MAX_THREADS
+ * @param format Record format
+ * @param flags KEYGEN_COMPRESSED and/or KEYGEN_UNCOMPRESSED, optionally KEYGEN_HEX
+ * @return 0 on success, -1 on error (records written so far stay written)
+ */
+int keygen_write(FILE *stream, uint64_t count, int threads, keygen_format_t format, unsigned int flags);
+
+#endif // KEYGEN_H
@@ -0,0 +1,133 @@
+/*
+ * Copyright (c) 2023 Brian Barto
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GPL License. See LICENSE for more details.
+ */
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <assert.h>
+#include <errno.h>
+#include "metrics.h"
+#include "error.h"
+
+static int metrics_append(Metrics metrics, char *format, ...)
+{
+	int r;
+	va_list args;
+
+	va_start(args, format);
+	r = vsnprintf(metrics->text + metrics->len, METRICS_MAX_LENGTH - metrics->len, format, args);
+	va_end(args);
+
+	if (r < 0 || (size_t)r >= METRICS_MAX_LENGTH - metrics->len)
+	{
+		metrics->text[metrics->len] = 0;
+		error_log("Too many metrics.");
+		return -1;
+	}
+
+	metrics->len += r;
+
+	return 1;
+}
+
+int metrics_init(Metrics metrics)
+{
+	assert(metrics);
+
+	metrics->len = 0;
+	metrics->text[0] = 0;
+
+	return 1;
+}
+
+/*
+ * Start a metric family: the HELP and TYPE lines every sample of the
+ * metric shares.
+ */
+int metrics_family(Metrics metrics, char *name, char *type, char *help)
+{
+	int r;
+
+	assert(metrics);
+	assert(name);
+	assert(type);
+	assert(help);
+
+	r = metrics_append(metrics, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+	ERROR_CHECK_NEG(r, "Could not add metric family.");
+
+	return 1;
+}
+
+/*
+ * Add one sample. Labels are given in exposition syntax without the
+ * braces, e.g. thread="3", or NULL for none.
+ */
+int metrics_sample(Metrics metrics, char *name, char *labels, double value)
+{
+	int r;
+
+	assert(metrics);
+	assert(name);
+
+	if (labels && *labels)
+	{
+		r = metrics_append(metrics, "%s{%s} %.17g\n", name, labels, value);
+	}
+	else
+	{
+		r = metrics_append(metrics, "%s %.17g\n", name, value);
+	}
+	ERROR_CHECK_NEG(r, "Could not add metric sample.");
+
+	return 1;
+}
+
+/*
+ * Replace the metrics file. The text goes to a temporary file next to
+ * it first, so a reader never sees a half written file.
+ */
+int metrics_write(Metrics metrics, char *path)
+{
+	int r;
+	FILE *f;
+	char tmp_path[BUFSIZ];
+
+	assert(metrics);
+	assert(path);
+
+	r = snprintf(tmp_path, BUFSIZ, "%s.tmp", path);
+	ERROR_CHECK_TRUE((r < 0 || r >= BUFSIZ), "Metrics path is too long.");
+
+	f = fopen(tmp_path, "w");
+	if (f == NULL)
+	{
+		error_log("Could not open metrics file %s. Errno %i.", tmp_path, errno);
+		return -1;
+	}
+
+	r = fwrite(metrics->text, 1, metrics->len, f) == metrics->len ? 1 : -1;
+	if (fclose(f) != 0)
+	{
+		r = -1;
+	}
+	if (r < 0)
+	{
+		error_log("Could not write metrics file %s. Errno %i.", tmp_path, errno);
+		remove(tmp_path);
+		return -1;
+	}
+
+	if (rename(tmp_path, path) != 0)
+	{
+		error_log("Could not replace metrics file %s. Errno %i.", path, errno);
+		remove(tmp_path);
+		return -1;
+	}
+
+	return 1;
+}
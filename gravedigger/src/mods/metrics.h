@@ -0,0 +1,35 @@
+/*
+ * Copyright (c) 2023 Brian Barto
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GPL License. See LICENSE for more details.
+ */
+
+#ifndef METRICS_H
+#define METRICS_H 1
+
+#include <stddef.h>
+
+#define METRICS_MAX_LENGTH    16384
+#define METRICS_TYPE_COUNTER  "counter"
+#define METRICS_TYPE_GAUGE    "gauge"
+#define METRICS_TYPE_SUMMARY  "summary"
+
+/*
+ * Metrics in the Prometheus text exposition format, written to a file
+ * for the node_exporter textfile collector (or anything else that can
+ * read it). Build the text with metrics_family() and metrics_sample(),
+ * then replace the file with metrics_write().
+ */
+typedef struct metrics *Metrics;
+struct metrics {
+	char text[METRICS_MAX_LENGTH];
+	size_t len;
+};
+
+int metrics_init(Metrics);
+int metrics_family(Metrics, char *, char *, char *);
+int metrics_sample(Metrics, char *, char *, double);
+int metrics_write(Metrics, char *);
+
+#endif
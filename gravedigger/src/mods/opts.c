@@ -33,6 +33,7 @@
 #define OPTS_BALANCE_PATH    (struct opt_info){"balance-path",   ""}
 #define OPTS_BECH32          (struct opt_info){"bech32",     ""}
 #define OPTS_BECH32M         (struct opt_info){"bech32m",     ""}
+#define OPTS_P2SH_SEGWIT     (struct opt_info){"p2sh-segwit", ""}
 #define OPTS_LEGACY          (struct opt_info){"legacy",     ""}
 #define OPTS_TESTNET         (struct opt_info){"testnet",    ""}
 #define OPTS_RPC_AUTH        (struct opt_info){"rpc-auth",   ""}
@@ -41,6 +42,26 @@
 #define OPTS_DUMP            (struct opt_info){"dump",       ""}
 #define OPTS_TRACE           (struct opt_info){"trace",      ""}
 #define OPTS_TEST            (struct opt_info){"test",       ""}
+#define OPTS_CHECKPOINT      (struct opt_info){"checkpoint", ""}
+#define OPTS_RESUME          (struct opt_info){"resume",     ""}
+#define OPTS_PATTERN_FILE    (struct opt_info){"pattern-file", ""}
+#define OPTS_CONTINUOUS      (struct opt_info){"continuous", ""}
+#define OPTS_COUNT           (struct opt_info){"count",      ""}
+#define OPTS_TIME            (struct opt_info){"time",       ""}
+#define OPTS_PIN             (struct opt_info){"pin",        ""}
+#define OPTS_SKIP_SMT        (struct opt_info){"skip-smt",   ""}
+#define OPTS_BATCH_SIZE      (struct opt_info){"batch-size", ""}
+#define OPTS_TUNE            (struct opt_info){"tune",       ""}
+#define OPTS_COORDINATOR     (struct opt_info){"coordinator", ""}
+#define OPTS_WORKER          (struct opt_info){"worker",     ""}
+#define OPTS_RANGE_SIZE      (struct opt_info){"range-size", ""}
+#define OPTS_TOKEN_FILE      (struct opt_info){"token-file", ""}
+#define OPTS_CONTROL         (struct opt_info){"control",    ""}
+#define OPTS_METRICS         (struct opt_info){"metrics",    ""}
+#define OPTS_ALSO_UNCOMPRESSED (struct opt_info){"also-uncompressed", ""}
+#define OPTS_SEED            (struct opt_info){"seed",       ""}
+#define OPTS_XPUB            (struct opt_info){"xpub",       ""}
+#define OPTS_CONFUSABLE      (struct opt_info){"confusable", ""}
 #define OPTS_MAX             30
 
 struct opt_info {
@@ -79,6 +100,7 @@ int opts_init(opts_p opts)
 	opts->output_type_p2pkh = 0;
 	opts->output_type_p2wpkh = 0;
 	opts->output_type_p2wpkh_v1 = 0;
+	opts->output_type_p2sh_p2wpkh = 0;
 	opts->output_stream = 0;
 	opts->output_grep = NULL;
 	opts->compression_on = 0;
@@ -101,8 +123,31 @@ int opts_init(opts_p opts)
 	opts->command = NULL;
 	opts->input = NULL;
 	opts->input_count = 0;
-	opts->threads = 1;  // Default to 1 thread for vanity address generation
+	opts->threads = 0;  // Vanity thread count, 0 until set by -t or the tuned config
+	opts->tuned_host = NULL;
+	opts->tuned_threads = 0;
+	opts->tuned_batch_size = 0;
 	opts->case_insensitive = 0;  // Default to case-sensitive for vanity address generation
+	opts->checkpoint_path = NULL;
+	opts->resume_path = NULL;
+	opts->pattern_file = NULL;
+	opts->continuous = 0;
+	opts->count = 0;
+	opts->time_limit = 0;
+	opts->pin = 0;
+	opts->skip_smt = 0;
+	opts->batch_size = 0;
+	opts->tune = 0;
+	opts->coordinator = NULL;
+	opts->worker = NULL;
+	opts->range_size = 0;
+	opts->token_file = NULL;
+	opts->control_path = NULL;
+	opts->metrics_path = NULL;
+	opts->also_uncompressed = 0;
+	opts->seed = NULL;
+	opts->xpub = NULL;
+	opts->confusable = 0;
 
 	memset(longopts, 0, OPTS_MAX * sizeof(*longopts));
 	memset(shortopts, 0, OPTS_MAX);
@@ -145,6 +190,8 @@ int opts_get(opts_p opts, int argc, char *argv[])
 		opts_add(OPTS_GREP, required_argument);
 		opts_add(OPTS_TESTNET, no_argument);
 		opts_add(OPTS_TRACE, no_argument);
+		opts_add(OPTS_COUNT, required_argument);
+		opts_add((struct opt_info){"threads", "t:"}, required_argument);
 	}
 	else if (strcmp(opts->command, "pubkey") == 0)
 	{
@@ -184,6 +231,7 @@ int opts_get(opts_p opts, int argc, char *argv[])
 		opts_add(OPTS_STREAM, no_argument);
 		opts_add(OPTS_GREP, required_argument);
 		opts_add(OPTS_RPC_AUTH, required_argument);
+		opts_add(OPTS_METRICS, required_argument);
 		opts_add(OPTS_TRACE, no_argument);
 	}
 	else if (strcmp(opts->command, "node") == 0)
@@ -208,7 +256,31 @@ int opts_get(opts_p opts, int argc, char *argv[])
 	{
 		// Add vanity-specific options
 		opts_add((struct opt_info){"case-insensitive", "i"}, no_argument);
-		opts_add((struct opt_info){"threads", "t"}, required_argument);
+		opts_add((struct opt_info){"threads", "t:"}, required_argument);
+		opts_add(OPTS_BECH32, no_argument);
+		opts_add(OPTS_P2SH_SEGWIT, no_argument);
+		opts_add(OPTS_BECH32M, no_argument);
+		opts_add(OPTS_ALSO_UNCOMPRESSED, no_argument);
+		opts_add(OPTS_SEED, required_argument);
+		opts_add(OPTS_XPUB, required_argument);
+		opts_add(OPTS_CONFUSABLE, no_argument);
+		opts_add(OPTS_CHECKPOINT, required_argument);
+		opts_add(OPTS_RESUME, required_argument);
+		opts_add(OPTS_PATTERN_FILE, required_argument);
+		opts_add(OPTS_CONTINUOUS, no_argument);
+		opts_add(OPTS_COUNT, required_argument);
+		opts_add(OPTS_TIME, required_argument);
+		opts_add(OPTS_PIN, no_argument);
+		opts_add(OPTS_SKIP_SMT, no_argument);
+		opts_add(OPTS_BATCH_SIZE, required_argument);
+		opts_add(OPTS_TUNE, no_argument);
+		opts_add(OPTS_COORDINATOR, required_argument);
+		opts_add(OPTS_WORKER, required_argument);
+		opts_add(OPTS_RANGE_SIZE, required_argument);
+		opts_add(OPTS_TOKEN_FILE, required_argument);
+		opts_add(OPTS_CONTROL, required_argument);
+		opts_add(OPTS_METRICS, required_argument);
+		opts_add(OPTS_TEST, no_argument);
 	}
 	else if (strcmp(opts->command, "help") == 0)
 	{
@@ -312,6 +384,14 @@ int opts_get(opts_p opts, int argc, char *argv[])
 				opts->compression_off = 1;
 				break;
 
+			case 'i':
+				opts->case_insensitive = 1;
+				break;
+			case 't':
+				opts->threads = atoi(optarg);
+				ERROR_CHECK_TRUE((opts->threads < 1), "Thread count must be greater than 0");
+				break;
+
 			case 'h':
 				ERROR_CHECK_TRUE(opts->host_name, "Can not use hostname option more than once.");
 				opts->host_name = optarg;
@@ -435,6 +515,35 @@ int opts_set_config(opts_p opts)
 		}
 	}
 
+	// Tuned vanity settings; btk vanity decides whether they fit this machine
+	if (strcmp(opts->command, "vanity") == 0)
+	{
+		char value[BUFSIZ];
+
+		if (!opts->tuned_host && config_exists("vanity-tune-host"))
+		{
+			opts->tuned_host = malloc(BUFSIZ);
+			ERROR_CHECK_NULL(opts->tuned_host, "Memory allocation error.");
+
+			r = config_get(opts->tuned_host, "vanity-tune-host");
+			ERROR_CHECK_NEG(r, "Could not get value from config file.");
+		}
+
+		if (config_exists("vanity-threads"))
+		{
+			r = config_get(value, "vanity-threads");
+			ERROR_CHECK_NEG(r, "Could not get value from config file.");
+			opts->tuned_threads = atoi(value);
+		}
+
+		if (config_exists("vanity-batch-size"))
+		{
+			r = config_get(value, "vanity-batch-size");
+			ERROR_CHECK_NEG(r, "Could not get value from config file.");
+			opts->tuned_batch_size = atoi(value);
+		}
+	}
+
 	config_unload();
 
 	return 1;
@@ -578,6 +687,11 @@ int opts_process_long(opts_p opts, const char *optname, char *optarg)
 		opts->output_type_p2wpkh_v1 = 1;
 	}
 
+	else if (strcmp(optname, OPTS_P2SH_SEGWIT.longopt) == 0)
+	{
+		opts->output_type_p2sh_p2wpkh = 1;
+	}
+
 	else if (strcmp(optname, OPTS_TESTNET.longopt) == 0)
 	{
 		opts->network_test = 1;
@@ -616,6 +730,130 @@ int opts_process_long(opts_p opts, const char *optname, char *optarg)
 		opts->test = 1;
 	}
 
+	else if (strcmp(optname, OPTS_CHECKPOINT.longopt) == 0)
+	{
+		ERROR_CHECK_TRUE(opts->checkpoint_path, "Can not use checkpoint option more than once.");
+		opts->checkpoint_path = optarg;
+	}
+
+	else if (strcmp(optname, OPTS_RESUME.longopt) == 0)
+	{
+		ERROR_CHECK_TRUE(opts->resume_path, "Can not use resume option more than once.");
+		opts->resume_path = optarg;
+	}
+
+	else if (strcmp(optname, OPTS_PATTERN_FILE.longopt) == 0)
+	{
+		ERROR_CHECK_TRUE(opts->pattern_file, "Can not use pattern file option more than once.");
+		opts->pattern_file = optarg;
+	}
+
+	else if (strcmp(optname, OPTS_SEED.longopt) == 0)
+	{
+		ERROR_CHECK_TRUE(opts->seed, "Can not use seed option more than once.");
+		opts->seed = optarg;
+	}
+	else if (strcmp(optname, OPTS_XPUB.longopt) == 0)
+	{
+		ERROR_CHECK_TRUE(opts->xpub, "Can not use xpub option more than once.");
+		opts->xpub = optarg;
+	}
+
+	// A match limit or a time limit implies continuous mode
+	else if (strcmp(optname, OPTS_CONTINUOUS.longopt) == 0)
+	{
+		opts->continuous = 1;
+	}
+
+	else if (strcmp(optname, OPTS_COUNT.longopt) == 0)
+	{
+		ERROR_CHECK_TRUE(opts->count, "Can not use count option more than once.");
+		opts->count = atoi(optarg);
+		ERROR_CHECK_TRUE((opts->count < 1), "Count must be greater than 0");
+		opts->continuous = 1;
+	}
+
+	else if (strcmp(optname, OPTS_TIME.longopt) == 0)
+	{
+		ERROR_CHECK_TRUE(opts->time_limit, "Can not use time option more than once.");
+		opts->time_limit = atoi(optarg);
+		ERROR_CHECK_TRUE((opts->time_limit < 1), "Time limit must be greater than 0 seconds");
+		opts->continuous = 1;
+	}
+
+	else if (strcmp(optname, OPTS_BATCH_SIZE.longopt) == 0)
+	{
+		ERROR_CHECK_TRUE(opts->batch_size, "Can not use batch size option more than once.");
+		opts->batch_size = atoi(optarg);
+		ERROR_CHECK_TRUE((opts->batch_size < 1), "Batch size must be greater than 0");
+	}
+
+	else if (strcmp(optname, OPTS_COORDINATOR.longopt) == 0)
+	{
+		ERROR_CHECK_TRUE(opts->coordinator, "Can not use coordinator option more than once.");
+		ERROR_CHECK_TRUE(opts->worker, "Can not be a coordinator and a worker at once.");
+		opts->coordinator = optarg;
+	}
+
+	else if (strcmp(optname, OPTS_WORKER.longopt) == 0)
+	{
+		ERROR_CHECK_TRUE(opts->worker, "Can not use worker option more than once.");
+		ERROR_CHECK_TRUE(opts->coordinator, "Can not be a coordinator and a worker at once.");
+		opts->worker = optarg;
+	}
+
+	else if (strcmp(optname, OPTS_RANGE_SIZE.longopt) == 0)
+	{
+		ERROR_CHECK_TRUE(opts->range_size, "Can not use range size option more than once.");
+		opts->range_size = atol(optarg);
+		ERROR_CHECK_TRUE((opts->range_size < 1), "Range size must be greater than 0");
+	}
+
+	else if (strcmp(optname, OPTS_TOKEN_FILE.longopt) == 0)
+	{
+		ERROR_CHECK_TRUE(opts->token_file, "Can not use token file option more than once.");
+		opts->token_file = optarg;
+	}
+
+	else if (strcmp(optname, OPTS_CONTROL.longopt) == 0)
+	{
+		ERROR_CHECK_TRUE(opts->control_path, "Can not use control option more than once.");
+		opts->control_path = optarg;
+	}
+
+	else if (strcmp(optname, OPTS_METRICS.longopt) == 0)
+	{
+		ERROR_CHECK_TRUE(opts->metrics_path, "Can not use metrics option more than once.");
+		opts->metrics_path = optarg;
+	}
+
+	else if (strcmp(optname, OPTS_ALSO_UNCOMPRESSED.longopt) == 0)
+	{
+		opts->also_uncompressed = 1;
+	}
+
+	else if (strcmp(optname, OPTS_CONFUSABLE.longopt) == 0)
+	{
+		opts->confusable = 1;
+	}
+
+	else if (strcmp(optname, OPTS_TUNE.longopt) == 0)
+	{
+		opts->tune = 1;
+	}
+
+	else if (strcmp(optname, OPTS_PIN.longopt) == 0)
+	{
+		opts->pin = 1;
+	}
+
+	// Skipping SMT siblings only means something for pinned workers
+	else if (strcmp(optname, OPTS_SKIP_SMT.longopt) == 0)
+	{
+		opts->skip_smt = 1;
+		opts->pin = 1;
+	}
+
 	else if (strcmp(optname, "case-insensitive") == 0)
 	{
 		opts->case_insensitive = 1;
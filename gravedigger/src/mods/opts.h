@@ -30,7 +30,8 @@ struct opts {
 	int output_type_raw;
 	int output_type_p2pkh;
 	int output_type_p2wpkh;
-	int output_type_p2wpkh_v1;
+	int output_type_p2wpkh_v1;    // Bech32m; taproot in vanity
+	int output_type_p2sh_p2wpkh;  // Nested segwit, vanity only
 	int output_stream;
 	char *output_grep;
 	int compression_on;
@@ -53,8 +54,31 @@ struct opts {
 	char *command;
 	char **input;
 	int input_count;
-	int threads;  // Number of threads for vanity address generation
+	int threads;  // Threads for vanity address generation and privkey --count
 	int case_insensitive;  // Case-insensitive flag for vanity address generation
+	char *checkpoint_path;  // Vanity search checkpoint file
+	char *resume_path;      // Vanity search checkpoint to continue from
+	char *pattern_file;     // Vanity patterns to search for at once
+	int continuous;         // Keep searching after a vanity match
+	int count;              // Vanity matches to find (0 for no limit), or keys to create
+	int time_limit;         // Seconds to search for, 0 for no limit
+	int pin;                // Pin vanity workers to CPUs
+	int skip_smt;           // Leave SMT siblings unused when pinning
+	int batch_size;         // Vanity candidates per batch, 0 for the default
+	int tune;               // Calibrate vanity threads and batch size
+	char *tuned_host;       // Machine the saved vanity tuning was measured on
+	int tuned_threads;      // Saved vanity threads, 0 if none
+	int tuned_batch_size;   // Saved vanity batch size, 0 if none
+	char *coordinator;      // Hand vanity ranges to workers on this address
+	char *worker;           // Search vanity ranges from the coordinator at this address
+	long range_size;        // Candidates per coordinator range, 0 for the default
+	char *token_file;       // Shared secret of a vanity coordinator and its workers
+	char *control_path;     // Unix socket taking commands for a running vanity search
+	char *metrics_path;     // File rewritten with Prometheus metrics of a long job
+	int also_uncompressed;  // Also test each vanity key's uncompressed address
+	char *seed;             // Derive vanity keys from this text, insecure
+	char *xpub;             // Search child indices of this extended public key
+	int confusable;         // Vanity pattern characters also match look-alikes
 };
 
 int opts_init(opts_p);
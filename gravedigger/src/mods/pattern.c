@@ -7,27 +7,57 @@
 #include <regex.h>
 #include <math.h>
 #include "pattern.h"
+#include "patterndfa.h"
+#include "patternset.h"
+#include "address.h"
 #include "error.h"
 
-// Maximum pattern length
-#define PATTERN_MAX_LENGTH 64
+#if defined(__SSE2__)
+#   include <immintrin.h>
+#   define PATTERN_SSE2 1
+#   if defined(__x86_64__) && defined(__GNUC__)
+#      define PATTERN_AVX2 1
+#   endif
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#   include <arm_neon.h>
+#   define PATTERN_NEON 1
+#endif
+
 #define PATTERN_MAX_MULTI 8
 #define PATTERN_MAX_CHARCLASS 58
+#define PATTERN_HASH_BITS 160          // One address per HASH160
+#define PATTERN_SAMPLES 16384          // Addresses a regex without a DFA is tried on
+#define PATTERN_SAMPLE_SEED 0x6274686b76616e69ULL // Same sample every time
+#define PATTERN_PAYLOAD_BITS 192       // HASH160 and checksum after the version byte
+#define PATTERN_LEAD_ZEROS 3           // Zero payload bytes regex odds follow; more is < 2^-32
+#define PATTERN_MAX_ADDRESS 64
 
 // Base58 character set for Bitcoin addresses
 static const char *base58_chars = "123456789ABCDEFGHJKLMNPQRSTUVWXYZabcdefghijkmnopqrstuvwxyz";
 static const int base58_len = 58;
 
+// Characters that pass for each other; only the base58 ones go into a class
+static const char *confusable_groups[] = { "1lIi", "0oO", "5S", "8B", NULL };
+
 // Forward declarations
-static bool match_wildcard(const struct Pattern *pattern, const char *str);
-static bool match_alternation(const struct Pattern *pattern, const char *str);
+static void batch_init(struct Pattern *pattern, size_t len);
+static void batch_set_position(struct Pattern *pattern, size_t pos, const char *chars, size_t count,
+                               bool base58_only);
 static double calc_wildcard_probability(const struct Pattern *pattern);
 static double calc_alternation_probability(const struct Pattern *pattern);
 static struct Pattern *compile_wildcard(const char *pattern, bool case_sensitive);
+static struct Pattern *compile_alternation(const char *pattern, bool case_sensitive, bool confusable);
+static int confusable_class(pattern_charclass_t *cls, bool case_sensitive);
+static struct Pattern *compile_pattern(const char *pattern, pattern_type_t type, bool case_sensitive);
+static bool fixed_impossible(const char *str, bool case_sensitive, size_t longest, char *reason, size_t size);
+static size_t longest_address(patternset_encoding_t encoding);
 
 bool pattern_match(const struct Pattern *pattern, const char *str) {
     if (!pattern || !str) return false;
     
+    // Regexes, wildcards and alternations, one table lookup per character
+    if (pattern->dfa) return patterndfa_match(pattern->dfa, str);
+    
     switch (pattern->type) {
         case PATTERN_TYPE_PREFIX: {
             if (strlen(str) < pattern->str.len) return false;
@@ -62,9 +92,6 @@ bool pattern_match(const struct Pattern *pattern, const char *str) {
             return pattern->str.has_regex &&
                 regexec(&pattern->str.regex, str, 0, NULL, 0) == 0;
             
-        case PATTERN_TYPE_WILDCARD:
-            return match_wildcard(pattern, str);
-            
         case PATTERN_TYPE_MULTI: {
             if (pattern->multi.type == PATTERN_COMBINE_AND) {
                 for (size_t i = 0; i < pattern->multi.count; i++) {
@@ -81,47 +108,31 @@ bool pattern_match(const struct Pattern *pattern, const char *str) {
             }
         }
             
+        case PATTERN_TYPE_WILDCARD:
         case PATTERN_TYPE_ALTERNATION:
-            return match_alternation(pattern, str);
+            return false;  // Always compiled to a DFA
     }
     
     return false;
 }
 
-static bool match_wildcard(const struct Pattern *pattern, const char *str) {
-    const char *s = str;
-    size_t i = 0;
+struct Pattern *pattern_compile(const char *pattern, pattern_type_t type, bool case_sensitive) {
+    size_t longest = longest_address(PATTERNSET_BASE58);
+    char reason[128];
     
-    while (i < pattern->wildcard.segment_count) {
-        if (pattern->wildcard.segments[i].is_wildcard) {
-            // Last wildcard matches everything
-            if (i == pattern->wildcard.segment_count - 1) return true;
-            
-            // Try to match the next non-wildcard segment
-            i++;
-            const char *next = s;
-            while (*next) {
-                if (strncmp(next, pattern->wildcard.segments[i].str, pattern->wildcard.segments[i].len) == 0) {
-                    s = next + pattern->wildcard.segments[i].len;
-                    i++;
-                    break;
-                }
-                next++;
-            }
-            if (!*next) return false;
-        } else {
-            if (strncmp(s, pattern->wildcard.segments[i].str, pattern->wildcard.segments[i].len) != 0) {
-                return false;
-            }
-            s += pattern->wildcard.segments[i].len;
-            i++;
-        }
+    // A fixed string must fit in some base58 address, P2PKH or P2SH
+    if (longest_address(PATTERNSET_P2SH) > longest) longest = longest_address(PATTERNSET_P2SH);
+    if (pattern && (type == PATTERN_TYPE_PREFIX || type == PATTERN_TYPE_SUFFIX ||
+                    type == PATTERN_TYPE_CONTAINS || type == PATTERN_TYPE_EXACT) &&
+        fixed_impossible(pattern, case_sensitive, longest, reason, sizeof(reason))) {
+        error_log("%s", reason);
+        return NULL;
     }
     
-    return *s == '\0' || pattern->wildcard.segments[pattern->wildcard.segment_count - 1].is_wildcard;
+    return compile_pattern(pattern, type, case_sensitive);
 }
 
-struct Pattern *pattern_compile(const char *pattern, pattern_type_t type, bool case_sensitive) {
+static struct Pattern *compile_pattern(const char *pattern, pattern_type_t type, bool case_sensitive) {
     if (!pattern || strlen(pattern) > PATTERN_MAX_LENGTH) {
         error_log("Invalid pattern");
         return NULL;
@@ -152,6 +163,15 @@ struct Pattern *pattern_compile(const char *pattern, pattern_type_t type, bool c
         case PATTERN_TYPE_EXACT:
             p->str.str = strdup(pattern);
             p->str.len = strlen(pattern);
+            
+            // Prefixes and exact strings: one character per position,
+            // and an exact string ends with its NUL
+            if (type == PATTERN_TYPE_PREFIX || type == PATTERN_TYPE_EXACT) {
+                batch_init(p, p->str.len + (type == PATTERN_TYPE_EXACT));
+                for (size_t i = 0; i < p->batch.len; i++) {
+                    batch_set_position(p, i, pattern + i, 1, false);
+                }
+            }
             break;
             
         case PATTERN_TYPE_REGEX: {
@@ -164,6 +184,8 @@ struct Pattern *pattern_compile(const char *pattern, pattern_type_t type, bool c
                 return NULL;
             }
             p->str.has_regex = true;
+            // regexec() stays for what the DFA doesn't support
+            p->dfa = patterndfa_regex(pattern, case_sensitive);
             break;
         }
             
@@ -222,11 +244,12 @@ static struct Pattern *compile_wildcard(const char *pattern, bool case_sensitive
     p->type = PATTERN_TYPE_WILDCARD;
     p->case_sensitive = case_sensitive;
     
-    // Count segments
+    // Count segments: every star, and a literal run before each star
+    // and after the last one
     size_t count = 1;
     const char *s = pattern;
     while (*s) {
-        if (*s == '*') count++;
+        if (*s == '*') count += 2;
         s++;
     }
     
@@ -269,10 +292,20 @@ static struct Pattern *compile_wildcard(const char *pattern, bool case_sensitive
     }
     
     p->wildcard.segment_count = idx;
+    
+    p->dfa = patterndfa_wildcard(pattern, case_sensitive);
+    if (!p->dfa) {
+        pattern_free(p);
+        return NULL;
+    }
     return p;
 }
 
 struct Pattern *pattern_compile_alternation(const char *pattern, bool case_sensitive) {
+    return compile_alternation(pattern, case_sensitive, false);
+}
+
+static struct Pattern *compile_alternation(const char *pattern, bool case_sensitive, bool confusable) {
     if (!pattern) return NULL;
     
     struct Pattern *p = calloc(1, sizeof(struct Pattern));
@@ -280,19 +313,20 @@ struct Pattern *pattern_compile_alternation(const char *pattern, bool case_sensi
     
     p->type = PATTERN_TYPE_ALTERNATION;
     p->case_sensitive = case_sensitive;
+    p->confusable = confusable;
     
-    // Count character classes
+    // Count character classes; a character outside brackets is a class of its own
     size_t class_count = 0;
     const char *ptr = pattern;
     while (*ptr) {
         if (*ptr == '[') {
-            class_count++;
             ptr = strchr(ptr, ']');
             if (!ptr) {
                 pattern_free(p);
                 return NULL;
             }
         }
+        class_count++;
         ptr++;
     }
     
@@ -324,109 +358,629 @@ struct Pattern *pattern_compile_alternation(const char *pattern, bool case_sensi
                 return NULL;
             }
             p->alt.classes[class_idx].count = char_idx;
-            class_idx++;
+        } else {
+            p->alt.classes[class_idx].chars[0] = *ptr;
+            p->alt.classes[class_idx].count = 1;
         }
+        if (confusable && confusable_class(&p->alt.classes[class_idx], case_sensitive) < 0) {
+            error_log("Pattern position %zu looks like no base58 character", class_idx + 1);
+            pattern_free(p);
+            return NULL;
+        }
+        class_idx++;
         ptr++;
     }
     
+    p->dfa = patterndfa_classes(p->alt.classes, p->alt.count, case_sensitive, true, true);
+    if (!p->dfa) {
+        pattern_free(p);
+        return NULL;
+    }
+    
+    // The DFA never matches a character outside base58, nor may the batch test
+    batch_init(p, class_count + 1);
+    for (size_t i = 0; i < class_count && p->batch.len; i++) {
+        batch_set_position(p, i, p->alt.classes[i].chars, p->alt.classes[i].count, true);
+    }
+    if (p->batch.len) {
+        batch_set_position(p, class_count, "", 1, false);
+    }
+    
     p->probability = calc_alternation_probability(p);
     return p;
 }
 
-static bool match_alternation(const struct Pattern *pattern, const char *str) {
-    const char *s = str;
-    
-    // Match each position against its character class
-    for (size_t i = 0; i < pattern->alt.count; i++) {
-        if (!*s) return false;
-        
-        bool found = false;
-        for (size_t j = 0; j < pattern->alt.classes[i].count; j++) {
-            char c = pattern->case_sensitive ? *s :
-                tolower(*s);
-            char p = pattern->case_sensitive ? pattern->alt.classes[i].chars[j] :
-                tolower(pattern->alt.classes[i].chars[j]);
-            
-            if (c == p) {
-                found = true;
-                break;
+// Base58 itself, or ignoring case its other case is
+static bool base58_usable(char c, bool case_sensitive) {
+    if (c == '\0') return false;
+    if (strchr(base58_chars, c)) return true;
+    return !case_sensitive && (strchr(base58_chars, toupper((unsigned char)c)) ||
+                               strchr(base58_chars, tolower((unsigned char)c)));
+}
+
+static void class_add(pattern_charclass_t *cls, char c) {
+    if (cls->count < PATTERN_MAX_CHARCLASS && !memchr(cls->chars, c, cls->count)) {
+        cls->chars[cls->count++] = c;
+    }
+}
+
+// Replace a class by its usable characters and every base58 character
+// that looks like one of its own; -1 if that leaves nothing
+static int confusable_class(pattern_charclass_t *cls, bool case_sensitive) {
+    pattern_charclass_t plain = *cls;
+
+    cls->count = 0;
+    for (size_t i = 0; i < plain.count; i++) {
+        char c = plain.chars[i];
+        if (base58_usable(c, case_sensitive)) class_add(cls, c);
+
+        for (const char **group = confusable_groups; *group; group++) {
+            const char *m;
+            for (m = *group; *m; m++) {
+                if (case_sensitive ? *m == c : tolower((unsigned char)*m) == tolower((unsigned char)c)) break;
+            }
+            if (!*m) continue;
+            for (m = *group; *m; m++) {
+                if (strchr(base58_chars, *m)) class_add(cls, *m);
             }
         }
-        
-        if (!found) return false;
-        s++;
     }
-    
-    return *s == '\0';
+
+    return cls->count ? 0 : -1;
 }
 
-static double calc_wildcard_probability(const struct Pattern *pattern) {
-    // Count fixed characters
-    size_t fixed_chars = 0;
-    for (size_t i = 0; i < pattern->wildcard.segment_count; i++) {
-        if (!pattern->wildcard.segments[i].is_wildcard) {
-            fixed_chars += pattern->wildcard.segments[i].len;
+struct Pattern *pattern_compile_confusable(const char *pattern, pattern_type_t type, bool case_sensitive) {
+    struct Pattern *p;
+
+    if (type == PATTERN_TYPE_ALTERNATION) {
+        if (!pattern || strlen(pattern) > PATTERN_MAX_LENGTH) {
+            error_log("Invalid pattern");
+            return NULL;
+        }
+        return compile_alternation(pattern, case_sensitive, true);
+    }
+    if (type != PATTERN_TYPE_PREFIX && type != PATTERN_TYPE_SUFFIX &&
+        type != PATTERN_TYPE_CONTAINS && type != PATTERN_TYPE_EXACT) {
+        error_log("Look-alike matching needs a fixed string or alternation pattern");
+        return NULL;
+    }
+
+    // Characters with only a base58 look-alike are fine here
+    p = compile_pattern(pattern, type, case_sensitive);
+    if (!p) return NULL;
+    p->confusable = true;
+    
+    p->str.classes = calloc(p->str.len ? p->str.len : 1, sizeof(pattern_charclass_t));
+    if (!p->str.classes) {
+        error_log("Memory allocation failed");
+        pattern_free(p);
+        return NULL;
+    }
+    for (size_t i = 0; i < p->str.len; i++) {
+        p->str.classes[i].chars[0] = pattern[i];
+        p->str.classes[i].count = 1;
+        if (confusable_class(&p->str.classes[i], case_sensitive) < 0) {
+            error_log("Pattern character '%c' looks like no base58 character", pattern[i]);
+            pattern_free(p);
+            return NULL;
         }
     }
     
-    // Base probability is 1/58^fixed_chars for fixed characters
-    double prob = pow(1.0/base58_len, fixed_chars);
+    p->dfa = patterndfa_classes(p->str.classes, p->str.len, case_sensitive,
+                                type == PATTERN_TYPE_PREFIX || type == PATTERN_TYPE_EXACT,
+                                type == PATTERN_TYPE_SUFFIX || type == PATTERN_TYPE_EXACT);
+    if (!p->dfa) {
+        pattern_free(p);
+        return NULL;
+    }
     
-    // Adjust for wildcards - each wildcard roughly halves probability
-    for (size_t i = 0; i < pattern->wildcard.segment_count; i++) {
-        if (pattern->wildcard.segments[i].is_wildcard) {
-            prob *= 0.5;
+    // Classes replace the single characters pattern_compile() set up
+    if (p->batch.len) {
+        batch_init(p, p->batch.len);
+        for (size_t i = 0; i < p->str.len; i++) {
+            batch_set_position(p, i, p->str.classes[i].chars, p->str.classes[i].count, true);
+        }
+        if (type == PATTERN_TYPE_EXACT) {
+            batch_set_position(p, p->str.len, "", 1, false);
         }
     }
     
+    return p;
+}
+
+// Every position starts out passing any byte; too long disables the test
+static void batch_init(struct Pattern *pattern, size_t len) {
+    memset(pattern->batch.mask, 0xFF, PATTERN_BATCH_BYTES);
+    memset(pattern->batch.value, 0xFF, PATTERN_BATCH_BYTES);
+    pattern->batch.len = len <= PATTERN_BATCH_BYTES ? len : 0;
+    pattern->batch.exact = true;
+}
+
+/*
+ * The mask is every bit the allowed bytes differ in. The test is exact
+ * when they take every combination of those bits, as one character or
+ * a letter in both cases do; otherwise it passes a superset and the
+ * batch confirms what gets through with pattern_match().
+ */
+static void batch_set_position(struct Pattern *pattern, size_t pos, const char *chars, size_t count,
+                               bool base58_only) {
+    uint64_t seen[4] = { 0 };
+    unsigned char first = 0, mask = 0;
+    size_t allowed = 0;
+
+    for (size_t i = 0; i < count; i++) {
+        unsigned char variants[2] = { (unsigned char)chars[i], (unsigned char)chars[i] };
+        if (!pattern->case_sensitive && isalpha(variants[0])) {
+            variants[1] ^= 0x20;
+        }
+        for (int v = 0; v < 2; v++) {
+            unsigned char c = variants[v];
+            if (base58_only && (c == '\0' || !strchr(base58_chars, c))) continue;
+            if (seen[c / 64] & (1ULL << (c % 64))) continue;
+            seen[c / 64] |= 1ULL << (c % 64);
+            if (allowed++ == 0) first = c;
+            mask |= c ^ first;
+        }
+    }
+
+    if (allowed == 0) {
+        // Nothing can match; leave the position open and let pattern_match() say no
+        pattern->batch.exact = false;
+        return;
+    }
+    pattern->batch.mask[pos] = mask;
+    pattern->batch.value[pos] = first | mask;
+    if (allowed != 1u << __builtin_popcount(mask)) {
+        pattern->batch.exact = false;
+    }
+}
+
+// Eight positions per 64-bit word, for targets without a vector unit
+static void batch_compare_words(const struct Pattern *pattern, const char *addresses, size_t stride,
+                                size_t count, uint64_t *bitmap) {
+    size_t words = (pattern->batch.len + 7) / 8;
+    uint64_t mask[PATTERN_BATCH_BYTES / 8], value[PATTERN_BATCH_BYTES / 8];
+
+    memcpy(mask, pattern->batch.mask, sizeof(mask));
+    memcpy(value, pattern->batch.value, sizeof(value));
+
+    for (size_t i = 0; i < count; i++) {
+        const char *s = addresses + i * stride;
+        uint64_t diff = 0;
+        for (size_t w = 0; w < words; w++) {
+            uint64_t x;
+            memcpy(&x, s + w * 8, 8);
+            diff |= (x | mask[w]) ^ value[w];
+        }
+        bitmap[i / 64] |= (uint64_t)(diff == 0) << (i % 64);
+    }
+}
+
+#if defined(PATTERN_SSE2)
+
+#if defined(PATTERN_AVX2)
+
+__attribute__((target("avx2")))
+static void batch_compare_avx2(const struct Pattern *pattern, const char *addresses, size_t stride,
+                               size_t count, uint64_t *bitmap) {
+    size_t chunks = (pattern->batch.len + 31) / 32;
+    __m256i mask[PATTERN_BATCH_BYTES / 32], value[PATTERN_BATCH_BYTES / 32];
+
+    for (size_t k = 0; k < chunks; k++) {
+        mask[k] = _mm256_loadu_si256((const __m256i *)(pattern->batch.mask + k * 32));
+        value[k] = _mm256_loadu_si256((const __m256i *)(pattern->batch.value + k * 32));
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        const char *s = addresses + i * stride;
+        __m256i eq = _mm256_set1_epi8(-1);
+        for (size_t k = 0; k < chunks; k++) {
+            __m256i v = _mm256_loadu_si256((const __m256i *)(s + k * 32));
+            eq = _mm256_and_si256(eq, _mm256_cmpeq_epi8(_mm256_or_si256(v, mask[k]), value[k]));
+        }
+        bitmap[i / 64] |= (uint64_t)((uint32_t)_mm256_movemask_epi8(eq) == 0xFFFFFFFF) << (i % 64);
+    }
+}
+
+static int pattern_have_avx2(void) {
+    static int have = -1;
+
+    if (have < 0) {
+        __builtin_cpu_init();
+        have = __builtin_cpu_supports("avx2") ? 1 : 0;
+    }
+
+    return have;
+}
+
+#endif
+
+static void batch_compare_sse2(const struct Pattern *pattern, const char *addresses, size_t stride,
+                               size_t count, uint64_t *bitmap) {
+    size_t chunks = (pattern->batch.len + 15) / 16;
+    __m128i mask[PATTERN_BATCH_BYTES / 16], value[PATTERN_BATCH_BYTES / 16];
+
+    for (size_t k = 0; k < chunks; k++) {
+        mask[k] = _mm_loadu_si128((const __m128i *)(pattern->batch.mask + k * 16));
+        value[k] = _mm_loadu_si128((const __m128i *)(pattern->batch.value + k * 16));
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        const char *s = addresses + i * stride;
+        __m128i eq = _mm_set1_epi8(-1);
+        for (size_t k = 0; k < chunks; k++) {
+            __m128i v = _mm_loadu_si128((const __m128i *)(s + k * 16));
+            eq = _mm_and_si128(eq, _mm_cmpeq_epi8(_mm_or_si128(v, mask[k]), value[k]));
+        }
+        bitmap[i / 64] |= (uint64_t)(_mm_movemask_epi8(eq) == 0xFFFF) << (i % 64);
+    }
+}
+
+#elif defined(PATTERN_NEON)
+
+static void batch_compare_neon(const struct Pattern *pattern, const char *addresses, size_t stride,
+                               size_t count, uint64_t *bitmap) {
+    size_t chunks = (pattern->batch.len + 15) / 16;
+    uint8x16_t mask[PATTERN_BATCH_BYTES / 16], value[PATTERN_BATCH_BYTES / 16];
+
+    for (size_t k = 0; k < chunks; k++) {
+        mask[k] = vld1q_u8(pattern->batch.mask + k * 16);
+        value[k] = vld1q_u8(pattern->batch.value + k * 16);
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        const uint8_t *s = (const uint8_t *)addresses + i * stride;
+        uint8x16_t eq = vdupq_n_u8(0xFF);
+        for (size_t k = 0; k < chunks; k++) {
+            eq = vandq_u8(eq, vceqq_u8(vorrq_u8(vld1q_u8(s + k * 16), mask[k]), value[k]));
+        }
+        bitmap[i / 64] |= (uint64_t)(vminvq_u8(eq) == 0xFF) << (i % 64);
+    }
+}
+
+#endif
+
+size_t pattern_match_batch(const struct Pattern *pattern, const char *addresses, size_t stride,
+                           size_t count, uint64_t *bitmap) {
+    size_t len, hits = 0;
+
+    if (!pattern || !addresses || !bitmap) return 0;
+
+    memset(bitmap, 0, (count + 63) / 64 * sizeof(uint64_t));
+    len = pattern->batch.len;
+
+    // Loads run past the NUL up to a whole vector, so they must fit the slot
+#if defined(PATTERN_AVX2)
+    if (len && (len + 31) / 32 * 32 <= stride && pattern_have_avx2()) {
+        batch_compare_avx2(pattern, addresses, stride, count, bitmap);
+    } else
+#endif
+#if defined(PATTERN_SSE2)
+    if (len && (len + 15) / 16 * 16 <= stride) {
+        batch_compare_sse2(pattern, addresses, stride, count, bitmap);
+    } else
+#elif defined(PATTERN_NEON)
+    if (len && (len + 15) / 16 * 16 <= stride) {
+        batch_compare_neon(pattern, addresses, stride, count, bitmap);
+    } else
+#endif
+    if (len && (len + 7) / 8 * 8 <= stride) {
+        batch_compare_words(pattern, addresses, stride, count, bitmap);
+    } else {
+        for (size_t i = 0; i < count; i++) {
+            bitmap[i / 64] |= (uint64_t)pattern_match(pattern, addresses + i * stride) << (i % 64);
+        }
+        len = 0;
+    }
+
+    for (size_t w = 0; w < (count + 63) / 64; w++) {
+        // A superset test leaves the few strings that pass to the exact matcher
+        if (len && !pattern->batch.exact) {
+            for (uint64_t bits = bitmap[w]; bits; bits &= bits - 1) {
+                size_t i = w * 64 + __builtin_ctzll(bits);
+                if (!pattern_match(pattern, addresses + i * stride)) {
+                    bitmap[w] &= ~(1ULL << (i % 64));
+                }
+            }
+        }
+        hits += __builtin_popcountll(bitmap[w]);
+    }
+
+    return hits;
+}
+
+/*
+ * Odds of a plain string at one place in the address, from the pattern
+ * set compiler: exact for prefixes, whose leading base58 digits are far
+ * from uniform, and uniform trailing digits for suffixes and substrings.
+ * before and after are the set's '*' markers for the place.
+ */
+static double string_probability(patternset_encoding_t encoding, const char *str, size_t len,
+                                 const char *before, const char *after, bool case_sensitive) {
+    char body[PATTERN_MAX_LENGTH + 3];
+    PatternSet *set;
+    double p = 0.0;
+
+    if (len == 0) return 1.0;
+    if (len > PATTERN_MAX_LENGTH) return 0.0;
+
+    snprintf(body, sizeof(body), "%s%.*s%s", before, (int)len, str, after);
+    set = patternset_new(encoding, case_sensitive);
+    if (set && patternset_add(set, body) >= 0 && patternset_compile(set) == 0) {
+        p = patternset_probability(set);
+    }
+    patternset_free(set);
+    return p;
+}
+
+/*
+ * Fixed segments are a prefix, a suffix or a substring depending on
+ * the wildcards around them, and are taken as independent.
+ */
+static double calc_wildcard_probability(const struct Pattern *pattern) {
+    size_t count = pattern->wildcard.segment_count;
+    double prob = 1.0;
+
+    for (size_t i = 0; i < count; i++) {
+        const pattern_segment_t *seg = &pattern->wildcard.segments[i];
+        if (seg->is_wildcard) continue;
+
+        bool anchored_start = i == 0;
+        bool anchored_end = i == count - 1;
+        if (anchored_start && anchored_end) {
+            return ldexp(1.0, -PATTERN_HASH_BITS);
+        }
+        prob *= string_probability(PATTERNSET_BASE58, seg->str, seg->len, anchored_start ? "" : "*",
+                                   anchored_start || anchored_end ? "" : "*", pattern->case_sensitive);
+    }
+
     return prob;
 }
 
+// Base58 digits a class lets through
+static size_t class_allowed(const char *chars, size_t count, bool case_sensitive) {
+    size_t allowed = 0;
+
+    for (const char *c = base58_chars; *c; c++) {
+        for (size_t j = 0; j < count; j++) {
+            char a = chars[j];
+            if (case_sensitive ? a == *c : tolower((unsigned char)a) == tolower((unsigned char)*c)) {
+                allowed++;
+                break;
+            }
+        }
+    }
+
+    return allowed;
+}
+
+/*
+ * Alternations match whole addresses: the address must be exactly as
+ * long as the pattern and every character must be in its class.
+ * Characters past the first few are close to uniform.
+ */
 static double calc_alternation_probability(const struct Pattern *pattern) {
-    double prob = 1.0;
+    double prob = patternset_base58_length(PATTERNSET_BASE58, pattern->alt.count);
     
     for (size_t i = 0; i < pattern->alt.count; i++) {
-        prob *= (double)pattern->alt.classes[i].count / base58_len;
+        prob *= (double)class_allowed(pattern->alt.classes[i].chars, pattern->alt.classes[i].count,
+                                      pattern->case_sensitive) / base58_len;
     }
     
     return prob;
 }
 
+// A class character as the base58 digit it stands for
+static char base58_case(char c) {
+    if (strchr(base58_chars, c)) return c;
+    return strchr(base58_chars, toupper((unsigned char)c)) ? (char)toupper((unsigned char)c) :
+                                                            (char)tolower((unsigned char)c);
+}
+
+// The first character of every look-alike class, as a base58 digit
+static void confusable_spelling(const struct Pattern *pattern, char *spelling) {
+    for (size_t i = 0; i < pattern->str.len; i++) {
+        spelling[i] = base58_case(pattern->str.classes[i].chars[0]);
+    }
+    spelling[pattern->str.len] = '\0';
+}
+
+// How much likelier the look-alike classes are than their spelling,
+// taking the digits as uniform
+static double confusable_ratio(const struct Pattern *pattern) {
+    double ratio = 1.0;
+
+    for (size_t i = 0; i < pattern->str.len; i++) {
+        const pattern_charclass_t *cls = &pattern->str.classes[i];
+        ratio *= (double)class_allowed(cls->chars, cls->count, pattern->case_sensitive) /
+                 class_allowed(cls->chars, 1, pattern->case_sensitive);
+    }
+
+    return ratio;
+}
+
+// Suffixes, substrings and exact strings with look-alikes
+static double confusable_probability(const struct Pattern *pattern, const char *before, const char *after) {
+    char spelling[PATTERN_MAX_LENGTH + 1];
+
+    confusable_spelling(pattern, spelling);
+    return string_probability(PATTERNSET_BASE58, spelling, pattern->str.len, before, after,
+                              pattern->case_sensitive) * confusable_ratio(pattern);
+}
+
+double pattern_prefix_probability(const struct Pattern *pattern, patternset_encoding_t encoding) {
+    char spelling[PATTERN_MAX_LENGTH + 1];
+    bool cs;
+    double prob;
+
+    if (!pattern || pattern->type != PATTERN_TYPE_PREFIX) return 0.0;
+    cs = pattern->case_sensitive;
+    if (!pattern->str.classes) {
+        return string_probability(encoding, pattern->str.str, pattern->str.len, "", "", cs);
+    }
+
+    confusable_spelling(pattern, spelling);
+    prob = string_probability(encoding, spelling, pattern->str.len, "", "", cs);
+
+    // Each class against its first character, given the spelling so far;
+    // this keeps the skew of the leading digits
+    for (size_t i = 0; i < pattern->str.len && prob > 0.0; i++) {
+        const pattern_charclass_t *cls = &pattern->str.classes[i];
+        double alone = string_probability(encoding, spelling, i + 1, "", "", cs), any = 0.0;
+        char first = spelling[i];
+
+        for (size_t j = 0; j < cls->count; j++) {
+            char c = base58_case(cls->chars[j]);
+            // Both cases of a letter count once when case doesn't matter
+            if (j > 0 && class_allowed(cls->chars, j, cs) == class_allowed(cls->chars, j + 1, cs)) continue;
+            spelling[i] = c;
+            any += string_probability(encoding, spelling, i + 1, "", "", cs);
+        }
+        spelling[i] = first;
+        prob *= any / alone;
+    }
+
+    return prob;
+}
+
+// Base58 digits of 2^bits, most significant first; returns how many
+static size_t pow2_base58(uint8_t *digits, unsigned int bits) {
+    unsigned char num[PATTERN_PAYLOAD_BITS / 8 + 1] = {0};
+    size_t count = 0, first = sizeof(num) - 1 - bits / 8;
+
+    num[first] = 1 << (bits % 8);
+    while (first < sizeof(num)) {
+        unsigned int rem = 0;
+        for (size_t i = first; i < sizeof(num); i++) {
+            rem = rem * 256 + num[i];
+            num[i] = rem / base58_len;
+            rem %= base58_len;
+        }
+        digits[count++] = rem;
+        while (first < sizeof(num) && num[first] == 0) first++;
+    }
+    for (size_t i = 0; i < count / 2; i++) {
+        uint8_t d = digits[i];
+        digits[i] = digits[count - 1 - i];
+        digits[count - 1 - i] = d;
+    }
+    return count;
+}
+
+// Regex matches among the payloads in [2^(bits - 8), 2^bits), written after lead
+static double regex_count(const struct Pattern *pattern, const char *lead, unsigned int bits) {
+    uint8_t high[PATTERN_MAX_ADDRESS], low[PATTERN_MAX_ADDRESS];
+    size_t high_len = pow2_base58(high, bits), low_len = pow2_base58(low, bits - 8);
+    double above = patterndfa_count_below(pattern->dfa, lead, high, high_len);
+    double below = patterndfa_count_below(pattern->dfa, lead, low, low_len);
+
+    return above < 0.0 || below < 0.0 ? -1.0 : above - below;
+}
+
+// splitmix64, for a sample that doesn't change between runs
+static uint64_t sample_next(uint64_t *state) {
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+/*
+ * A P2PKH address writes the version byte and every leading zero byte
+ * of the payload as '1', then the rest of the payload in base58. With
+ * the payload taken as uniform, a regex the DFA handles is counted
+ * exactly for each number of leading zero bytes. Other regexes are
+ * tried on a fixed sample of addresses; if none of them matches, the
+ * odds are unknown.
+ */
+static double calc_regex_probability(const struct Pattern *pattern) {
+    char address[PATTERN_MAX_ADDRESS];
+    uint64_t state = PATTERN_SAMPLE_SEED;
+    size_t hits = 0;
+
+    if (!pattern->str.has_regex) return 0.0;
+
+    if (pattern->dfa) {
+        char lead[PATTERN_LEAD_ZEROS + 2] = "";
+        double prob = 0.0;
+
+        for (unsigned int zeros = 0; zeros <= PATTERN_LEAD_ZEROS; zeros++) {
+            unsigned int bits = PATTERN_PAYLOAD_BITS - 8 * zeros;
+            double count;
+
+            strcat(lead, "1");
+            count = regex_count(pattern, lead, bits);
+            if (count < 0.0) return -1.0;
+            // Share of payloads with exactly this many zero bytes, spread over the range
+            prob += ldexp(255.0 / 256.0, -8 * (int)zeros) * count / (ldexp(1.0, bits) - ldexp(1.0, bits - 8));
+        }
+        return prob;
+    }
+
+    for (size_t n = 0; n < PATTERN_SAMPLES; n++) {
+        unsigned char hash[20];
+        for (size_t i = 0; i < sizeof(hash); i += 4) {
+            uint32_t word = (uint32_t)sample_next(&state);
+            memcpy(hash + i, &word, 4);
+        }
+        if (address_from_rmd160(address, hash) < 0) return -1.0;
+        if (pattern_match(pattern, address)) hits++;
+    }
+
+    return hits ? (double)hits / PATTERN_SAMPLES : -1.0;
+}
+
 double pattern_probability(const struct Pattern *pattern) {
     if (!pattern) return 0.0;
     
     switch (pattern->type) {
         case PATTERN_TYPE_PREFIX:
-            return pow(1.0/base58_len, pattern->str.len);
+            return pattern_prefix_probability(pattern, PATTERNSET_BASE58);
             
         case PATTERN_TYPE_SUFFIX:
-            return pow(1.0/base58_len, pattern->str.len);
+            if (pattern->str.classes) return confusable_probability(pattern, "*", "");
+            return string_probability(PATTERNSET_BASE58, pattern->str.str, pattern->str.len, "*", "",
+                                      pattern->case_sensitive);
             
         case PATTERN_TYPE_CONTAINS:
-            return pow(1.0/base58_len, pattern->str.len) * 0.1;
+            if (pattern->str.classes) return confusable_probability(pattern, "*", "*");
+            return string_probability(PATTERNSET_BASE58, pattern->str.str, pattern->str.len, "*", "*",
+                                      pattern->case_sensitive);
             
         case PATTERN_TYPE_EXACT:
-            return pow(1.0/base58_len, pattern->str.len);
+            // One hash in 2^160 per spelling, if the string is an address at all
+            if (pattern->str.classes) {
+                return confusable_probability(pattern, "", "") > 0 ?
+                    ldexp(confusable_ratio(pattern), -PATTERN_HASH_BITS) : 0.0;
+            }
+            return string_probability(PATTERNSET_BASE58, pattern->str.str, pattern->str.len, "", "",
+                                      pattern->case_sensitive) > 0 ?
+                ldexp(1.0, -PATTERN_HASH_BITS) : 0.0;
             
         case PATTERN_TYPE_REGEX:
-            return 0.0; // Cannot estimate regex probability
+            return calc_regex_probability(pattern);
             
         case PATTERN_TYPE_WILDCARD:
             return calc_wildcard_probability(pattern);
             
         case PATTERN_TYPE_MULTI:
+            // Unknown if any part is
             if (pattern->multi.type == PATTERN_COMBINE_AND) {
                 double prob = 1.0;
                 for (size_t i = 0; i < pattern->multi.count; i++) {
-                    prob *= pattern_probability(pattern->multi.patterns[i]);
+                    double p = pattern_probability(pattern->multi.patterns[i]);
+                    if (p < 0.0) return -1.0;
+                    prob *= p;
                 }
                 return prob;
-            } else { // OR
-                double prob = 0.0;
+            } else { // OR, taken as independent
+                double log_miss = 0.0;
                 for (size_t i = 0; i < pattern->multi.count; i++) {
-                    prob += pattern_probability(pattern->multi.patterns[i]);
+                    double p = pattern_probability(pattern->multi.patterns[i]);
+                    if (p < 0.0) return -1.0;
+                    log_miss += log1p(-p);
                 }
-                return prob;
+                return -expm1(log_miss);
             }
             
         case PATTERN_TYPE_ALTERNATION:
@@ -436,6 +990,185 @@ double pattern_probability(const struct Pattern *pattern) {
     return 0.0;
 }
 
+// Longest address of a base58 encoding on the current network
+static size_t longest_address(patternset_encoding_t encoding) {
+    size_t longest = 0;
+
+    for (size_t len = 1; len <= PATTERN_MAX_LENGTH; len++) {
+        if (patternset_base58_length(encoding, len) > 0) longest = len;
+    }
+
+    return longest;
+}
+
+// Characters and lengths no base58 address has, with the reason
+static bool fixed_impossible(const char *str, bool case_sensitive, size_t longest, char *reason, size_t size) {
+    size_t len = strlen(str);
+
+    for (size_t i = 0; i < len; i++) {
+        if (!base58_usable(str[i], case_sensitive)) {
+            snprintf(reason, size, "Pattern character '%c' can not appear in a base58 address", str[i]);
+            return true;
+        }
+    }
+    if (len > longest) {
+        snprintf(reason, size, "Pattern has %zu characters, addresses at most %zu", len, longest);
+        return true;
+    }
+
+    return false;
+}
+
+// The base58 character that stands in for c: c itself, its other case
+// or a look-alike; '\0' if there is none
+static char base58_respell(char c) {
+    if (base58_usable(c, false)) return base58_case(c);
+    for (const char **group = confusable_groups; *group; group++) {
+        if (!strchr(*group, c)) continue;
+        for (const char *m = *group; *m; m++) {
+            if (strchr(base58_chars, *m)) return *m;
+        }
+    }
+    return '\0';
+}
+
+// Odds of a fixed string in a random address of the encoding
+static double fixed_probability(patternset_encoding_t encoding, const char *str, size_t len,
+                                pattern_type_t type, bool case_sensitive) {
+    switch (type) {
+        case PATTERN_TYPE_PREFIX:
+            return string_probability(encoding, str, len, "", "", case_sensitive);
+        case PATTERN_TYPE_SUFFIX:
+            return string_probability(encoding, str, len, "*", "", case_sensitive);
+        case PATTERN_TYPE_CONTAINS:
+            return string_probability(encoding, str, len, "*", "*", case_sensitive);
+        case PATTERN_TYPE_EXACT:
+            // One hash in 2^160, if addresses come this long and start so
+            return patternset_base58_length(encoding, len) > 0 &&
+                   string_probability(encoding, str, len, "", "", case_sensitive) > 0 ?
+                ldexp(1.0, -PATTERN_HASH_BITS) : 0.0;
+        default:
+            return 0.0;
+    }
+}
+
+/*
+ * Longest cut of the pattern, at most max_len characters, that matches
+ * with at least min_probability (and at all). Suffixes keep their end,
+ * everything else its start.
+ */
+static void find_shorter(const char *pattern, size_t len, pattern_type_t type, bool case_sensitive,
+                         patternset_encoding_t encoding, size_t max_len, double min_probability,
+                         pattern_analysis_t *analysis) {
+    for (size_t keep = max_len < len ? max_len : len - 1; keep > 0; keep--) {
+        const char *cut = type == PATTERN_TYPE_SUFFIX ? pattern + len - keep : pattern;
+        double p = fixed_probability(encoding, cut, keep, type, case_sensitive);
+        if (p > 0.0 && p >= min_probability) {
+            snprintf(analysis->shorter, sizeof(analysis->shorter), "%.*s", (int)keep, cut);
+            analysis->shorter_probability = p;
+            return;
+        }
+    }
+}
+
+int pattern_analyze(const char *pattern, pattern_type_t type, bool case_sensitive,
+                    patternset_encoding_t encoding, double rate, double max_seconds,
+                    pattern_analysis_t *analysis) {
+    size_t len, longest, good;
+    char scratch[sizeof(analysis->reason)];
+    double p;
+
+    if (!pattern || !analysis || (type != PATTERN_TYPE_PREFIX && type != PATTERN_TYPE_SUFFIX &&
+                                  type != PATTERN_TYPE_CONTAINS && type != PATTERN_TYPE_EXACT)) {
+        error_log("Only fixed string patterns can be analyzed");
+        return -1;
+    }
+    if (encoding != PATTERNSET_BASE58 && encoding != PATTERNSET_P2SH) {
+        error_log("Only base58 patterns can be analyzed");
+        return -1;
+    }
+    len = strlen(pattern);
+    if (len == 0 || len > PATTERN_MAX_LENGTH) {
+        error_log("Invalid pattern");
+        return -1;
+    }
+
+    memset(analysis, 0, sizeof(*analysis));
+    analysis->seconds = -1.0;
+    longest = longest_address(encoding);
+
+    if (fixed_impossible(pattern, case_sensitive, longest, analysis->reason, sizeof(analysis->reason))) {
+        analysis->verdict = PATTERN_IMPOSSIBLE;
+
+        // Whatever base58 characters stand in for the others
+        for (size_t i = 0; i < len && len <= longest; i++) {
+            analysis->respelling[i] = base58_respell(pattern[i]);
+            if (!analysis->respelling[i]) {
+                analysis->respelling[0] = '\0';
+                break;
+            }
+        }
+        if (strcmp(analysis->respelling, pattern) == 0) analysis->respelling[0] = '\0';
+        if (case_sensitive && !fixed_impossible(pattern, false, longest, scratch, sizeof(scratch))) {
+            analysis->insensitive_probability = fixed_probability(encoding, pattern, len, type, false);
+        }
+
+        // Up to the first character that can't be there, or the last one
+        // for a suffix
+        for (good = 0; good < len && base58_usable(pattern[good], case_sensitive); good++);
+        if (type == PATTERN_TYPE_SUFFIX) {
+            for (good = 0; good < len && base58_usable(pattern[len - 1 - good], case_sensitive); good++);
+        }
+        if (type != PATTERN_TYPE_EXACT) {
+            find_shorter(pattern, len, type, case_sensitive, encoding, good < longest ? good : longest, 0.0,
+                         analysis);
+        }
+        return 0;
+    }
+
+    // A prefix that can't even start so has no shorter cut either
+    if (type == PATTERN_TYPE_PREFIX && fixed_probability(encoding, pattern, 1, type, case_sensitive) <= 0.0) {
+        analysis->verdict = PATTERN_IMPOSSIBLE;
+        snprintf(analysis->reason, sizeof(analysis->reason), "No address of this type starts with '%c'",
+                 pattern[0]);
+        return 0;
+    }
+
+    // The version byte and the 25-byte payload leave some prefixes out
+    p = fixed_probability(encoding, pattern, len, type, case_sensitive);
+    if (p <= 0.0) {
+        analysis->verdict = PATTERN_IMPOSSIBLE;
+        if (type == PATTERN_TYPE_EXACT) {
+            snprintf(analysis->reason, sizeof(analysis->reason), "No address of this type is '%s'", pattern);
+        } else {
+            snprintf(analysis->reason, sizeof(analysis->reason), "No address of this type %s '%s'",
+                     type == PATTERN_TYPE_PREFIX ? "starts with" : "holds", pattern);
+            find_shorter(pattern, len, type, case_sensitive, encoding, len - 1, 0.0, analysis);
+        }
+        return 0;
+    }
+
+    analysis->probability = p;
+    if (case_sensitive) {
+        double insensitive = fixed_probability(encoding, pattern, len, type, false);
+        if (insensitive > p) analysis->insensitive_probability = insensitive;
+    }
+    if (rate <= 0.0) return 0;
+
+    analysis->seconds = 1.0 / (p * rate);
+    if (max_seconds > 0.0 && analysis->seconds > max_seconds) {
+        analysis->verdict = PATTERN_SLOW;
+        snprintf(analysis->reason, sizeof(analysis->reason), "Expected to take %.3g times the time limit",
+                 analysis->seconds / max_seconds);
+        if (type != PATTERN_TYPE_EXACT) {
+            find_shorter(pattern, len, type, case_sensitive, encoding, len - 1, 1.0 / (rate * max_seconds),
+                         analysis);
+        }
+    }
+
+    return 0;
+}
+
 int pattern_describe(const struct Pattern *pattern, char *buf, size_t size) {
     if (!pattern || !buf || size == 0) return -1;
     
@@ -478,17 +1211,25 @@ int pattern_describe(const struct Pattern *pattern, char *buf, size_t size) {
             break;
     }
     
+    if (pattern->confusable) {
+        size_t len = strlen(buf);
+        snprintf(buf + len, size - len, " (with look-alikes)");
+    }
+    
     return 0;
 }
 
 void pattern_free(struct Pattern *pattern) {
     if (pattern) {
+        patterndfa_free(pattern->dfa);
+        
         switch (pattern->type) {
             case PATTERN_TYPE_PREFIX:
             case PATTERN_TYPE_SUFFIX:
             case PATTERN_TYPE_CONTAINS:
             case PATTERN_TYPE_EXACT:
                 free(pattern->str.str);
+                free(pattern->str.classes);
                 break;
                 
             case PATTERN_TYPE_REGEX:
@@ -6,6 +6,10 @@
 #include <stdbool.h>
 #include <strings.h>  // For strcasestr and strcasecmp
 #include <regex.h>     // For regex_t
+#include "patternset.h"
+
+#define PATTERN_MAX_LENGTH 64   // Longest pattern
+#define PATTERN_BATCH_BYTES 64  // Longest fixed-position test of pattern_match_batch()
 
 // Pattern types
 typedef enum {
@@ -38,10 +42,31 @@ typedef struct {
     bool is_wildcard;
 } pattern_segment_t;
 
+// What pattern_analyze() makes of a pattern
+typedef enum {
+    PATTERN_FEASIBLE = 0,    // Expected to match within the time limit, or no rate to tell
+    PATTERN_SLOW = 1,        // Expected to run past the time limit
+    PATTERN_IMPOSSIBLE = 2   // No address can match
+} pattern_verdict_t;
+
+typedef struct {
+    pattern_verdict_t verdict;
+    double probability;               // Of a random address matching, 0 if impossible
+    double seconds;                   // Expected runtime at the given rate, -1 without one
+    char reason[128];                 // Why the pattern is impossible or slow
+    char respelling[PATTERN_MAX_LENGTH + 1];  // In base58 characters if it has others, else ""
+    double insensitive_probability;   // Of the pattern case-insensitive, 0 if that's no better
+    char shorter[PATTERN_MAX_LENGTH + 1];     // Longest cut that is possible, or fast enough, or ""
+    double shorter_probability;       // Of the shorter pattern
+} pattern_analysis_t;
+
+struct PatternDfa;
+
 // Pattern structure
 struct Pattern {
     pattern_type_t type;     // Pattern type
     bool case_sensitive;     // Case sensitivity
+    bool confusable;         // Characters also match their look-alikes
     
     union {
         struct {  // For string patterns
@@ -49,6 +74,7 @@ struct Pattern {
             size_t len;
             bool has_regex;
             regex_t regex;
+            pattern_charclass_t *classes;  // Look-alikes of every character, or NULL
         } str;
         
         struct {  // For PATTERN_TYPE_MULTI
@@ -68,6 +94,14 @@ struct Pattern {
         } wildcard;
     };
     
+    struct PatternDfa *dfa;  // Table-driven matcher, NULL to use the above
+    
+    struct {  // Byte c passes position i when (c | mask[i]) == value[i]
+        unsigned char mask[PATTERN_BATCH_BYTES];
+        unsigned char value[PATTERN_BATCH_BYTES];
+        size_t len;          // Positions tested, 0 if the pattern has no fixed positions
+        bool exact;          // Passing every position is a match, no pattern_match() needed
+    } batch;
     double probability;      // Estimated match probability
 };
 
@@ -102,6 +136,20 @@ struct Pattern *pattern_compile_multi(const char **patterns, size_t count,
  */
 struct Pattern *pattern_compile_alternation(const char *pattern, bool case_sensitive);
 
+/**
+ * Compile a pattern whose characters also match their look-alikes
+ * (1/l/i, 0/o, 5/S, 8/B). Every position becomes the class of base58
+ * characters that look like it, compiled into the matcher tables, so
+ * e.g. "1BOSS" is a valid prefix and "18o5S" matches it.
+ * 
+ * @param pattern Pattern text
+ * @param type PATTERN_TYPE_PREFIX, _SUFFIX, _CONTAINS, _EXACT or _ALTERNATION
+ * @param case_sensitive Whether matching should be case sensitive
+ * @return Compiled pattern or NULL on error (also if a position has no
+ *         base58 character at all)
+ */
+struct Pattern *pattern_compile_confusable(const char *pattern, pattern_type_t type, bool case_sensitive);
+
 /**
  * Match a string against a compiled pattern
  * 
@@ -112,14 +160,71 @@ struct Pattern *pattern_compile_alternation(const char *pattern, bool case_sensi
 bool pattern_match(const struct Pattern *pattern, const char *str);
 
 /**
- * Get the estimated probability of a match (1/keyspace)
- * Used for performance estimation
+ * Match a batch of strings held in fixed-size slots. Prefix, exact and
+ * alternation patterns test every position of a string at once with a
+ * vector compare against per-position mask/value bytes (AVX2, SSE2 or
+ * NEON, plain 64-bit words elsewhere). Other patterns, and strings the
+ * compare can't rule on, go through pattern_match().
+ * 
+ * @param pattern Compiled pattern to match against
+ * @param addresses count NUL terminated strings, string i at i * stride
+ * @param stride Bytes from one string to the next
+ * @param count Number of strings
+ * @param bitmap (count + 63) / 64 words, bit i set if string i matches
+ * @return Number of matches
+ */
+size_t pattern_match_batch(const struct Pattern *pattern, const char *addresses, size_t stride,
+                           size_t count, uint64_t *bitmap);
+
+/**
+ * Get the probability that a random P2PKH address matches. Prefixes
+ * are exact, other strings assume uniform trailing digits. Regexes the
+ * DFA handles are counted exactly over uniform payloads; the rest are
+ * tried on a fixed sample of addresses.
  * 
  * @param pattern Compiled pattern
- * @return Estimated probability (0.0 to 1.0)
+ * @return Probability (0.0 to 1.0), or -1.0 if unknown: a regex without
+ *         a DFA that matched none of the sample
  */
 double pattern_probability(const struct Pattern *pattern);
 
+/**
+ * Get the probability that a random address of a base58 encoding
+ * starts with a prefix pattern. The pattern itself is measured exactly
+ * on its HASH160 intervals; each look-alike class multiplies that by
+ * how much likelier the class is than its first character right after
+ * the characters before it.
+ * 
+ * @param pattern Compiled PATTERN_TYPE_PREFIX pattern
+ * @param encoding PATTERNSET_BASE58 or PATTERNSET_P2SH
+ * @return Probability (0.0 to 1.0)
+ */
+double pattern_prefix_probability(const struct Pattern *pattern, patternset_encoding_t encoding);
+
+/**
+ * Check a fixed string pattern before searching for it. The pattern is
+ * impossible if it holds a character no base58 address has, is longer
+ * than any address of the encoding or, as a prefix, starts where no
+ * address can (e.g. a P2PKH '1' followed by more digits than the 25
+ * bytes leave room for). At a known rate it is slow if the expected
+ * runtime is past max_seconds. Either way the analysis suggests what
+ * would do instead: a base58 respelling, the case-insensitive pattern
+ * and the longest cut of it that is possible or fast enough. Prefixes
+ * and exact strings are cut at the end, suffixes at the start.
+ * 
+ * @param pattern Pattern text
+ * @param type PATTERN_TYPE_PREFIX, _SUFFIX, _CONTAINS or _EXACT
+ * @param case_sensitive Whether matching is case sensitive
+ * @param encoding PATTERNSET_BASE58 or PATTERNSET_P2SH
+ * @param rate Addresses tried per second, 0 if unknown
+ * @param max_seconds Expected runtime that makes a pattern slow, 0 for no limit
+ * @param analysis Filled in with the verdict and alternatives
+ * @return 0 on success, -1 on error
+ */
+int pattern_analyze(const char *pattern, pattern_type_t type, bool case_sensitive,
+                    patternset_encoding_t encoding, double rate, double max_seconds,
+                    pattern_analysis_t *analysis);
+
 /**
  * Get a human-readable description of the pattern
  * 
@@ -0,0 +1,812 @@
+/*
+ * Copyright (c) 2023 Brian Barto
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GPL License. See LICENSE for more details.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <ctype.h>
+#include <math.h>
+#include <pthread.h>
+#include "patterndfa.h"
+#include "error.h"
+
+#define SYM_OTHER        (PATTERNDFA_SYMBOLS - 1)
+#define BASE             58      // Base58 digits are symbols 0 to 57
+#define SET_ALL          ((UINT64_C(1) << PATTERNDFA_SYMBOLS) - 1)
+#define MAX_NODES        1024    // Syntax tree nodes, and NFA states
+#define MAX_REPEAT       64      // Largest bound of {m,n}
+#define TABLE_SIZE       (2 * PATTERNDFA_MAX_STATES)
+
+#define FLAG_ACCEPT      1       // Matched, whatever follows
+#define FLAG_ACCEPT_END  2       // Matched if the string ends here
+#define FLAG_DEAD        4       // Can never match any more
+
+/*
+ * Patterns are parsed into a syntax tree, turned into a Thompson NFA
+ * and then into a DFA by subset construction. Case folding happens on
+ * the way in: a letter becomes the set of symbols it may match, so the
+ * DFA itself never looks at case.
+ */
+typedef enum {
+    TREE_SET,       // One character out of set
+    TREE_CAT,       // left then right
+    TREE_ALT,       // left or right
+    TREE_REPEAT,    // left, min to max times (max -1 for no limit)
+    TREE_BOL,       // ^
+    TREE_EOL,       // $
+    TREE_EMPTY
+} tree_kind_t;
+
+typedef struct {
+    tree_kind_t kind;
+    uint64_t set;
+    int left, right;
+    int min, max;
+} TreeNode;
+
+typedef enum {
+    NFA_SET,        // Consume a character in set, go to out
+    NFA_SPLIT,      // Go to out and alt
+    NFA_BOL,        // Go to out at the start of the string
+    NFA_EOL,        // Go to out at the end of the string
+    NFA_MATCH
+} nfa_kind_t;
+
+typedef struct {
+    nfa_kind_t kind;
+    uint64_t set;
+    int out, alt;
+} NfaState;
+
+typedef struct {
+    TreeNode *tree;
+    size_t tree_count;
+    NfaState *nfa;
+    size_t nfa_count;
+    const char *p;          // Parse position
+    int repeat_depth;       // Repeats the NFA build is inside
+    bool case_sensitive;
+    bool failed;            // Unsupported, invalid or too big
+} Compiler;
+
+struct PatternDfa {
+    size_t states;
+    uint16_t *next;         // states * PATTERNDFA_SYMBOLS
+    uint8_t *flags;         // FLAG_* of every state
+};
+
+static const char base58_chars[] = "123456789ABCDEFGHJKLMNPQRSTUVWXYZabcdefghijkmnopqrstuvwxyz";
+
+// Byte to symbol: the base58 digit value, SYM_OTHER for everything else
+static uint8_t symbol_of[256];
+static pthread_once_t symbols_once = PTHREAD_ONCE_INIT;
+
+static void symbols_init(void) {
+    memset(symbol_of, SYM_OTHER, sizeof(symbol_of));
+    for (int i = 0; base58_chars[i]; i++) {
+        symbol_of[(unsigned char)base58_chars[i]] = (uint8_t)i;
+    }
+}
+
+// Symbols a pattern character matches. Letters outside base58 still
+// match their other case when that one is a base58 digit.
+static uint64_t char_set(unsigned char c, bool case_sensitive) {
+    unsigned char variants[3] = { c, (unsigned char)tolower(c), (unsigned char)toupper(c) };
+    uint64_t set = 0;
+
+    for (int i = 0; i < (case_sensitive ? 1 : 3); i++) {
+        if (variants[i] && symbol_of[variants[i]] != SYM_OTHER) {
+            set |= UINT64_C(1) << symbol_of[variants[i]];
+        }
+    }
+    return set;
+}
+
+static int tree_new(Compiler *c, tree_kind_t kind, uint64_t set, int left, int right) {
+    if (c->failed || c->tree_count >= MAX_NODES) {
+        c->failed = true;
+        return -1;
+    }
+
+    TreeNode *node = &c->tree[c->tree_count];
+    node->kind = kind;
+    node->set = set;
+    node->left = left;
+    node->right = right;
+    node->min = 0;
+    node->max = 0;
+    return (int)c->tree_count++;
+}
+
+static int tree_repeat(Compiler *c, int node, int min, int max) {
+    int r = tree_new(c, TREE_REPEAT, 0, node, -1);
+
+    if (r >= 0) {
+        c->tree[r].min = min;
+        c->tree[r].max = max;
+    }
+    return r;
+}
+
+// node followed by item, either may be -1 for nothing yet
+static int tree_append(Compiler *c, int node, int item) {
+    if (node < 0) return item;
+    if (item < 0) return node;
+    return tree_new(c, TREE_CAT, 0, node, item);
+}
+
+static const struct {
+    const char *name;
+    int (*test)(int);
+} char_classes[] = {
+    { "alpha", isalpha }, { "digit", isdigit }, { "alnum", isalnum }, { "upper", isupper },
+    { "lower", islower }, { "xdigit", isxdigit }, { "space", isspace }, { "blank", isblank },
+    { "punct", ispunct }, { "print", isprint }, { "graph", isgraph }, { "cntrl", iscntrl }
+};
+
+// [...] after the '[', up to and including the ']'
+static int parse_bracket(Compiler *c) {
+    const char *p = c->p;
+    uint64_t set = 0;
+    bool negate = false;
+
+    if (*p == '^') {
+        negate = true;
+        p++;
+    }
+
+    // A ']' right at the start is a member
+    for (bool first = true; first || *p != ']'; first = false) {
+        if (*p == '\0') {
+            c->failed = true;
+            return -1;
+        }
+        if (p[0] == '[' && p[1] == ':') {
+            const char *end = strstr(p + 2, ":]");
+            size_t i, len = end ? (size_t)(end - p - 2) : 0;
+            for (i = 0; end && i < sizeof(char_classes) / sizeof(char_classes[0]); i++) {
+                if (strlen(char_classes[i].name) == len && strncmp(p + 2, char_classes[i].name, len) == 0) {
+                    break;
+                }
+            }
+            if (!end || i == sizeof(char_classes) / sizeof(char_classes[0])) {
+                c->failed = true;
+                return -1;
+            }
+            for (int ch = 1; ch < 256; ch++) {
+                if (char_classes[i].test(ch)) set |= char_set((unsigned char)ch, c->case_sensitive);
+            }
+            p = end + 2;
+            continue;
+        }
+        // Equivalence classes and collating elements
+        if (p[0] == '[' && (p[1] == '=' || p[1] == '.')) {
+            c->failed = true;
+            return -1;
+        }
+
+        unsigned char lo = (unsigned char)*p++, hi = lo;
+        if (p[0] == '-' && p[1] != '\0' && p[1] != ']') {
+            hi = (unsigned char)p[1];
+            p += 2;
+            if (hi < lo) {
+                c->failed = true;
+                return -1;
+            }
+        }
+        for (unsigned int ch = lo; ch <= hi; ch++) {
+            set |= char_set((unsigned char)ch, c->case_sensitive);
+        }
+    }
+    c->p = p + 1;
+
+    // Every byte outside base58 is in a negated class
+    return tree_new(c, TREE_SET, negate ? SET_ALL & ~set : set, -1, -1);
+}
+
+static int parse_alt(Compiler *c);
+
+static int parse_atom(Compiler *c) {
+    char ch = *c->p++;
+    int node;
+
+    switch (ch) {
+        case '(':
+            node = parse_alt(c);
+            if (*c->p != ')') {
+                c->failed = true;
+                return -1;
+            }
+            c->p++;
+            return node;
+        case '[':
+            return parse_bracket(c);
+        case '.':
+            return tree_new(c, TREE_SET, SET_ALL, -1, -1);
+        case '^':
+            return tree_new(c, TREE_BOL, 0, -1, -1);
+        case '$':
+            return tree_new(c, TREE_EOL, 0, -1, -1);
+        case '\\':
+            // Back references and GNU escapes are left to regexec()
+            ch = *c->p++;
+            if (ch == '\0' || isalnum((unsigned char)ch)) {
+                c->failed = true;
+                return -1;
+            }
+            return tree_new(c, TREE_SET, char_set((unsigned char)ch, c->case_sensitive), -1, -1);
+        case '*':
+        case '+':
+        case '?':
+        case '{':
+        case ')':
+            c->failed = true;
+            return -1;
+        default:
+            return tree_new(c, TREE_SET, char_set((unsigned char)ch, c->case_sensitive), -1, -1);
+    }
+}
+
+static int parse_bound(Compiler *c) {
+    int value = 0;
+
+    if (!isdigit((unsigned char)*c->p)) return -1;
+    while (isdigit((unsigned char)*c->p)) {
+        value = value * 10 + (*c->p++ - '0');
+        if (value > MAX_REPEAT) {
+            c->failed = true;
+            return -1;
+        }
+    }
+    return value;
+}
+
+static int parse_repeat(Compiler *c) {
+    int node = parse_atom(c);
+
+    while (!c->failed) {
+        char ch = *c->p;
+        int min, max;
+
+        if (ch == '*' || ch == '+' || ch == '?') {
+            c->p++;
+            min = ch == '+' ? 1 : 0;
+            max = ch == '?' ? 1 : -1;
+        } else if (ch == '{' && isdigit((unsigned char)c->p[1])) {
+            c->p++;
+            min = max = parse_bound(c);
+            if (*c->p == ',') {
+                c->p++;
+                max = *c->p == '}' ? -1 : parse_bound(c);
+            }
+            if (c->failed || *c->p != '}' || (max >= 0 && max < min) || max < -1) {
+                c->failed = true;
+                return -1;
+            }
+            c->p++;
+        } else {
+            break;
+        }
+
+        // Stacked quantifiers are undefined in POSIX, and repeating an
+        // anchor means nothing useful
+        if (c->tree[node].kind == TREE_REPEAT || c->tree[node].kind == TREE_BOL ||
+            c->tree[node].kind == TREE_EOL) {
+            c->failed = true;
+            return -1;
+        }
+        node = tree_repeat(c, node, min, max);
+    }
+
+    return node;
+}
+
+static int parse_cat(Compiler *c) {
+    int node = -1;
+
+    while (!c->failed && *c->p != '\0' && *c->p != '|' && *c->p != ')') {
+        node = tree_append(c, node, parse_repeat(c));
+    }
+    return node < 0 ? tree_new(c, TREE_EMPTY, 0, -1, -1) : node;
+}
+
+static int parse_alt(Compiler *c) {
+    int node = parse_cat(c);
+
+    while (!c->failed && *c->p == '|') {
+        c->p++;
+        node = tree_new(c, TREE_ALT, 0, node, parse_cat(c));
+    }
+    return node;
+}
+
+static int nfa_new(Compiler *c, nfa_kind_t kind, uint64_t set, int out, int alt) {
+    if (c->failed || out < -1 || alt < -1 || c->nfa_count >= MAX_NODES) {
+        c->failed = true;
+        return -1;
+    }
+
+    NfaState *state = &c->nfa[c->nfa_count];
+    state->kind = kind;
+    state->set = set;
+    state->out = out;
+    state->alt = alt;
+    return (int)c->nfa_count++;
+}
+
+// NFA of a subtree, leading on to out; returns its entry state
+static int nfa_build(Compiler *c, int node, int out) {
+    const TreeNode *t;
+    int r, entry;
+
+    if (c->failed || node < 0) {
+        c->failed = true;
+        return -1;
+    }
+    t = &c->tree[node];
+
+    switch (t->kind) {
+        case TREE_SET:
+            return nfa_new(c, NFA_SET, t->set, out, -1);
+        case TREE_CAT:
+            return nfa_build(c, t->left, nfa_build(c, t->right, out));
+        case TREE_ALT:
+            r = nfa_build(c, t->right, out);
+            return nfa_new(c, NFA_SPLIT, 0, nfa_build(c, t->left, out), r);
+        case TREE_BOL:
+        case TREE_EOL:
+            // regexec() disagrees with itself on anchors in repeated groups
+            if (c->repeat_depth > 0) {
+                c->failed = true;
+                return -1;
+            }
+            return nfa_new(c, t->kind == TREE_BOL ? NFA_BOL : NFA_EOL, 0, out, -1);
+        case TREE_EMPTY:
+            return out;
+        case TREE_REPEAT:
+            c->repeat_depth++;
+            r = out;
+            if (t->max < 0) {
+                // Loop back to a split that either goes round again or leaves
+                int loop = nfa_new(c, NFA_SPLIT, 0, -1, out);
+                if (loop < 0) return -1;
+                entry = nfa_build(c, t->left, loop);
+                if (entry < 0) return -1;
+                c->nfa[loop].out = entry;
+                r = loop;
+            } else {
+                // Optional copies past the minimum, each one able to skip the rest
+                for (int i = t->min; i < t->max; i++) {
+                    r = nfa_new(c, NFA_SPLIT, 0, nfa_build(c, t->left, r), out);
+                }
+            }
+            for (int i = 0; i < t->min; i++) {
+                r = nfa_build(c, t->left, r);
+            }
+            c->repeat_depth--;
+            return r;
+    }
+
+    c->failed = true;
+    return -1;
+}
+
+// Add a state and everything it reaches without consuming a character
+static void closure_add(const Compiler *c, uint64_t *set, int state, bool at_start, bool at_end, int *stack) {
+    size_t top = 0;
+
+    stack[top++] = state;
+    while (top > 0) {
+        int s = stack[--top];
+        const NfaState *n = &c->nfa[s];
+
+        if (set[s / 64] & (UINT64_C(1) << (s % 64))) continue;
+        set[s / 64] |= UINT64_C(1) << (s % 64);
+
+        if (n->kind == NFA_SPLIT) {
+            stack[top++] = n->out;
+            stack[top++] = n->alt;
+        } else if ((n->kind == NFA_BOL && at_start) || (n->kind == NFA_EOL && at_end)) {
+            stack[top++] = n->out;
+        }
+    }
+}
+
+static uint32_t set_hash(const uint64_t *set, size_t words) {
+    uint64_t h = 0xcbf29ce484222325ULL;
+
+    for (size_t i = 0; i < words; i++) {
+        h = (h ^ set[i]) * 0x100000001b3ULL;
+    }
+    return (uint32_t)(h ^ (h >> 32));
+}
+
+/*
+ * Subset construction. A search adds the entry state's closure back in
+ * after every character, so a match may start anywhere. States that can
+ * no longer reach a match are flagged dead so the walk can stop there.
+ */
+static PatternDfa *dfa_build(Compiler *c, int root, bool search) {
+    PatternDfa *dfa = NULL;
+    uint64_t *sets = NULL, *restart = NULL, *scratch = NULL;
+    int32_t *table = NULL;
+    int *stack = NULL;
+    uint32_t *indegree = NULL, *sources = NULL, *queue = NULL;
+    size_t words, capacity = 64, states = 0;
+    int match, entry;
+
+    match = nfa_new(c, NFA_MATCH, 0, -1, -1);
+    entry = nfa_build(c, root, match);
+    if (c->failed) {
+        return NULL;
+    }
+
+    words = (c->nfa_count + 63) / 64;
+    dfa = calloc(1, sizeof(PatternDfa));
+    sets = malloc(capacity * words * sizeof(uint64_t));
+    restart = calloc(words, sizeof(uint64_t));
+    scratch = malloc(words * sizeof(uint64_t));
+    table = malloc(TABLE_SIZE * sizeof(int32_t));
+    stack = malloc((2 * c->nfa_count + 1) * sizeof(int));
+    if (dfa) {
+        dfa->next = malloc(capacity * PATTERNDFA_SYMBOLS * sizeof(uint16_t));
+        dfa->flags = malloc(capacity);
+    }
+    if (!dfa || !sets || !restart || !scratch || !table || !stack || !dfa->next || !dfa->flags) {
+        error_log("Memory allocation error.");
+        goto fail;
+    }
+    memset(table, -1, TABLE_SIZE * sizeof(int32_t));
+
+    if (search) {
+        closure_add(c, restart, entry, false, false, stack);
+    }
+
+    // State 0 is where every string starts
+    memset(sets, 0, words * sizeof(uint64_t));
+    closure_add(c, sets, entry, true, false, stack);
+    table[set_hash(sets, words) % TABLE_SIZE] = 0;
+    states = 1;
+
+    for (size_t d = 0; d < states; d++) {
+        for (int sym = 0; sym < PATTERNDFA_SYMBOLS; sym++) {
+            memcpy(scratch, restart, words * sizeof(uint64_t));
+            for (size_t s = 0; s < c->nfa_count; s++) {
+                const uint64_t *set = sets + d * words;
+                if ((set[s / 64] & (UINT64_C(1) << (s % 64))) && c->nfa[s].kind == NFA_SET &&
+                    (c->nfa[s].set & (UINT64_C(1) << sym))) {
+                    closure_add(c, scratch, c->nfa[s].out, false, false, stack);
+                }
+            }
+
+            // Find the set, or make it a new state
+            uint32_t slot = set_hash(scratch, words) % TABLE_SIZE;
+            while (table[slot] >= 0 && memcmp(sets + (size_t)table[slot] * words, scratch, words * sizeof(uint64_t))) {
+                slot = (slot + 1) % TABLE_SIZE;
+            }
+            if (table[slot] < 0) {
+                if (states >= PATTERNDFA_MAX_STATES) {
+                    c->failed = true;
+                    goto fail;
+                }
+                if (states == capacity) {
+                    capacity *= 2;
+                    uint64_t *grown_sets = realloc(sets, capacity * words * sizeof(uint64_t));
+                    if (grown_sets) sets = grown_sets;
+                    uint16_t *grown_next = realloc(dfa->next, capacity * PATTERNDFA_SYMBOLS * sizeof(uint16_t));
+                    if (grown_next) dfa->next = grown_next;
+                    uint8_t *grown_flags = realloc(dfa->flags, capacity);
+                    if (grown_flags) dfa->flags = grown_flags;
+                    if (!grown_sets || !grown_next || !grown_flags) {
+                        error_log("Memory allocation error.");
+                        goto fail;
+                    }
+                }
+                memcpy(sets + states * words, scratch, words * sizeof(uint64_t));
+                table[slot] = (int32_t)states++;
+            }
+            dfa->next[d * PATTERNDFA_SYMBOLS + sym] = (uint16_t)table[slot];
+        }
+    }
+    dfa->states = states;
+
+    // Accepting now, or only if the string ends here
+    for (size_t d = 0; d < states; d++) {
+        const uint64_t *set = sets + d * words;
+
+        memcpy(scratch, set, words * sizeof(uint64_t));
+        for (size_t s = 0; s < c->nfa_count; s++) {
+            if ((set[s / 64] & (UINT64_C(1) << (s % 64))) && c->nfa[s].kind == NFA_EOL) {
+                closure_add(c, scratch, c->nfa[s].out, false, true, stack);
+            }
+        }
+        dfa->flags[d] = FLAG_DEAD;
+        if (set[match / 64] & (UINT64_C(1) << (match % 64))) {
+            dfa->flags[d] = FLAG_ACCEPT | FLAG_ACCEPT_END;
+        } else if (scratch[match / 64] & (UINT64_C(1) << (match % 64))) {
+            dfa->flags[d] = FLAG_ACCEPT_END;
+        }
+    }
+
+    // Live states reach an accepting one: walk the edges backwards
+    indegree = calloc(states + 1, sizeof(uint32_t));
+    sources = malloc(states * PATTERNDFA_SYMBOLS * sizeof(uint32_t));
+    queue = malloc(states * sizeof(uint32_t));
+    if (!indegree || !sources || !queue) {
+        error_log("Memory allocation error.");
+        goto fail;
+    }
+    for (size_t e = 0; e < states * PATTERNDFA_SYMBOLS; e++) {
+        indegree[dfa->next[e] + 1]++;
+    }
+    for (size_t d = 0; d < states; d++) {
+        indegree[d + 1] += indegree[d];
+    }
+    for (size_t e = 0; e < states * PATTERNDFA_SYMBOLS; e++) {
+        sources[indegree[dfa->next[e]]++] = (uint32_t)(e / PATTERNDFA_SYMBOLS);
+    }
+    // indegree[d] now ends the sources of d, and indegree[d - 1] starts them
+    size_t head = 0, tail = 0;
+    for (size_t d = 0; d < states; d++) {
+        if (!(dfa->flags[d] & FLAG_DEAD)) queue[tail++] = (uint32_t)d;
+    }
+    while (head < tail) {
+        uint32_t d = queue[head++];
+        for (uint32_t e = d ? indegree[d - 1] : 0; e < indegree[d]; e++) {
+            if (dfa->flags[sources[e]] & FLAG_DEAD) {
+                dfa->flags[sources[e]] &= ~FLAG_DEAD;
+                queue[tail++] = sources[e];
+            }
+        }
+    }
+
+    free(sets);
+    free(restart);
+    free(scratch);
+    free(table);
+    free(stack);
+    free(indegree);
+    free(sources);
+    free(queue);
+    return dfa;
+
+fail:
+    free(sets);
+    free(restart);
+    free(scratch);
+    free(table);
+    free(stack);
+    free(indegree);
+    free(sources);
+    free(queue);
+    patterndfa_free(dfa);
+    return NULL;
+}
+
+static int compiler_init(Compiler *c, const char *text, bool case_sensitive) {
+    pthread_once(&symbols_once, symbols_init);
+
+    memset(c, 0, sizeof(*c));
+    c->p = text;
+    c->case_sensitive = case_sensitive;
+    c->tree = malloc(MAX_NODES * sizeof(TreeNode));
+    c->nfa = malloc(MAX_NODES * sizeof(NfaState));
+    if (!c->tree || !c->nfa) {
+        error_log("Memory allocation error.");
+        free(c->tree);
+        free(c->nfa);
+        return -1;
+    }
+    return 0;
+}
+
+static void compiler_free(Compiler *c) {
+    free(c->tree);
+    free(c->nfa);
+}
+
+PatternDfa *patterndfa_regex(const char *regex, bool case_sensitive) {
+    PatternDfa *dfa = NULL;
+    Compiler c;
+    int root;
+
+    if (!regex || compiler_init(&c, regex, case_sensitive) < 0) {
+        return NULL;
+    }
+
+    root = parse_alt(&c);
+    // A ')' with no '(' stops the parse early
+    if (!c.failed && *c.p == '\0') {
+        dfa = dfa_build(&c, root, true);
+    }
+
+    compiler_free(&c);
+    return dfa;
+}
+
+PatternDfa *patterndfa_wildcard(const char *pattern, bool case_sensitive) {
+    PatternDfa *dfa = NULL;
+    Compiler c;
+    int root = -1;
+    const char *s;
+
+    if (!pattern || compiler_init(&c, pattern, case_sensitive) < 0) {
+        return NULL;
+    }
+
+    for (s = pattern; *s; s++) {
+        if (*s == '*') {
+            while (s[1] == '*') s++;
+            root = tree_append(&c, root, tree_repeat(&c, tree_new(&c, TREE_SET, SET_ALL, -1, -1), 0, -1));
+        } else {
+            root = tree_append(&c, root, tree_new(&c, TREE_SET, char_set((unsigned char)*s, case_sensitive), -1, -1));
+        }
+    }
+    // A trailing '*' takes the rest of the string, anything else must end it
+    if (s == pattern || s[-1] != '*') {
+        root = tree_append(&c, root, tree_new(&c, TREE_EOL, 0, -1, -1));
+    }
+
+    dfa = dfa_build(&c, root, false);
+    if (!dfa) {
+        error_log("Wildcard pattern is too complex");
+    }
+
+    compiler_free(&c);
+    return dfa;
+}
+
+PatternDfa *patterndfa_classes(const pattern_charclass_t *classes, size_t count, bool case_sensitive,
+                               bool anchor_start, bool anchor_end) {
+    PatternDfa *dfa = NULL;
+    Compiler c;
+    int root = -1;
+
+    if (!classes || compiler_init(&c, "", case_sensitive) < 0) {
+        return NULL;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        uint64_t set = 0;
+        for (size_t j = 0; j < classes[i].count; j++) {
+            set |= char_set((unsigned char)classes[i].chars[j], case_sensitive);
+        }
+        root = tree_append(&c, root, tree_new(&c, TREE_SET, set, -1, -1));
+    }
+    if (anchor_end) {
+        root = tree_append(&c, root, tree_new(&c, TREE_EOL, 0, -1, -1));
+    } else if (root < 0) {
+        root = tree_new(&c, TREE_EMPTY, 0, -1, -1);
+    }
+
+    dfa = dfa_build(&c, root, !anchor_start);
+    if (!dfa) {
+        error_log("Character class pattern is too complex");
+    }
+
+    compiler_free(&c);
+    return dfa;
+}
+
+bool patterndfa_match(const PatternDfa *dfa, const char *str) {
+    const unsigned char *s = (const unsigned char *)str;
+    const uint16_t *next = dfa->next;
+    const uint8_t *flags = dfa->flags;
+    uint32_t state = 0;
+
+    if (flags[0] & (FLAG_ACCEPT | FLAG_DEAD)) {
+        return flags[0] & FLAG_ACCEPT;
+    }
+    for (; *s; s++) {
+        state = next[state * PATTERNDFA_SYMBOLS + symbol_of[*s]];
+        if (flags[state] & (FLAG_ACCEPT | FLAG_DEAD)) {
+            return flags[state] & FLAG_ACCEPT;
+        }
+    }
+    return flags[state] & FLAG_ACCEPT_END;
+}
+
+/*
+ * Numbers below limit share a digit prefix with it and then take a
+ * smaller digit, after which every digit is free. Counts of the free
+ * prefixes are kept per state, split by whether a non-zero digit has
+ * been written yet; the one prefix still equal to limit is followed on
+ * its own.
+ */
+double patterndfa_count_below(const PatternDfa *dfa, const char *lead, const uint8_t *limit, size_t digits) {
+    const uint16_t *next = dfa->next;
+    const uint8_t *flags = dfa->flags;
+    size_t n = dfa->states;
+    double *count, *step, *rest, matched = 0.0;
+    uint32_t state = 0, tight = 0;
+    bool tight_started = false, tight_alive = true;
+
+    pthread_once(&symbols_once, symbols_init);
+    for (const unsigned char *s = (const unsigned char *)lead; !(flags[state] & (FLAG_ACCEPT | FLAG_DEAD)) && *s; s++) {
+        state = next[state * PATTERNDFA_SYMBOLS + symbol_of[*s]];
+    }
+
+    // rest[i]: numbers below limit that equal it in digits [0, i)
+    rest = malloc((digits + 1) * sizeof(double));
+    count = calloc(2 * n, sizeof(double));
+    step = calloc(2 * n, sizeof(double));
+    if (!rest || !count || !step) {
+        error_log("Memory allocation failed");
+        free(rest);
+        free(count);
+        free(step);
+        return -1.0;
+    }
+    rest[digits] = 0.0;
+    for (size_t i = digits; i-- > 0; ) {
+        rest[i] = rest[i + 1] + limit[i] * pow(BASE, digits - 1 - i);
+    }
+    if (flags[state] & (FLAG_ACCEPT | FLAG_DEAD)) {
+        matched = flags[state] & FLAG_ACCEPT ? rest[0] : 0.0;
+        goto out;
+    }
+    tight = state;
+
+    for (size_t i = 0; i < digits; i++) {
+        double below = pow(BASE, digits - 1 - i); // Numbers per prefix ending here
+
+        memset(step, 0, 2 * n * sizeof(double));
+        for (size_t started = 0; started < 2; started++) {
+            for (size_t s = 0; s < n; s++) {
+                double c = count[started * n + s];
+                if (c == 0.0) continue;
+                for (int d = 0; d < BASE; d++) {
+                    uint32_t t = !started && d == 0 ? (uint32_t)s : next[s * PATTERNDFA_SYMBOLS + d];
+                    if (flags[t] & FLAG_ACCEPT) {
+                        matched += c * below;
+                    } else if (!(flags[t] & FLAG_DEAD)) {
+                        step[(started || d ? n : 0) + t] += c;
+                    }
+                }
+            }
+        }
+        for (int d = 0; tight_alive && d <= limit[i]; d++) {
+            uint32_t t = !tight_started && d == 0 ? tight : next[tight * PATTERNDFA_SYMBOLS + d];
+            if (d < limit[i]) {
+                if (flags[t] & FLAG_ACCEPT) {
+                    matched += below;
+                } else if (!(flags[t] & FLAG_DEAD)) {
+                    step[(tight_started || d ? n : 0) + t] += 1.0;
+                }
+            } else if (flags[t] & (FLAG_ACCEPT | FLAG_DEAD)) {
+                matched += flags[t] & FLAG_ACCEPT ? rest[i + 1] : 0.0;
+                tight_alive = false;
+            } else {
+                tight = t;
+                tight_started = tight_started || d;
+            }
+        }
+
+        double *swap = count;
+        count = step;
+        step = swap;
+    }
+
+    // The walk ends with the number; limit itself is not below limit
+    for (size_t s = 0; s < 2 * n; s++) {
+        if (flags[s % n] & FLAG_ACCEPT_END) matched += count[s];
+    }
+
+out:
+    free(rest);
+    free(count);
+    free(step);
+    return matched;
+}
+
+void patterndfa_free(PatternDfa *dfa) {
+    if (!dfa) return;
+
+    free(dfa->next);
+    free(dfa->flags);
+    free(dfa);
+}
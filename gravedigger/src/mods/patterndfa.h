@@ -0,0 +1,88 @@
+/*
+ * Copyright (c) 2023 Brian Barto
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GPL License. See LICENSE for more details.
+ */
+
+#ifndef PATTERNDFA_H
+#define PATTERNDFA_H
+
+#include <stddef.h>
+#include <stdbool.h>
+#include "pattern.h"
+
+#define PATTERNDFA_SYMBOLS    59    // The base58 digits, then one for every other byte
+#define PATTERNDFA_MAX_STATES 4096
+
+typedef struct PatternDfa PatternDfa;
+
+/**
+ * Compile a POSIX extended regular expression, with regexec()
+ * semantics: a match may start and end anywhere unless ^ or $ say
+ * otherwise. Back references, GNU escapes such as \w and collating
+ * elements are not supported; callers keep regexec() for those.
+ *
+ * @param regex Regular expression
+ * @param case_sensitive Whether letters match only their own case
+ * @return New DFA, or NULL if the expression is unsupported, invalid or
+ *         needs more than PATTERNDFA_MAX_STATES states
+ */
+PatternDfa *patterndfa_regex(const char *regex, bool case_sensitive);
+
+/**
+ * Compile a wildcard pattern matching the whole string, where '*'
+ * stands for any run of characters (e.g. "1*ABC*Z")
+ *
+ * @param pattern Wildcard pattern
+ * @param case_sensitive Whether letters match only their own case
+ * @return New DFA or NULL on error
+ */
+PatternDfa *patterndfa_wildcard(const char *pattern, bool case_sensitive);
+
+/**
+ * Compile a sequence of character classes, one character per class
+ *
+ * @param classes Classes in order
+ * @param count Number of classes
+ * @param case_sensitive Whether letters match only their own case
+ * @param anchor_start Whether the sequence must start the string
+ * @param anchor_end Whether the sequence must end the string
+ * @return New DFA or NULL on error
+ */
+PatternDfa *patterndfa_classes(const pattern_charclass_t *classes, size_t count, bool case_sensitive,
+                               bool anchor_start, bool anchor_end);
+
+/**
+ * Run a string through the DFA: one table lookup per character, and
+ * the walk stops as soon as the outcome can no longer change. Bytes
+ * outside base58 only match '.', '*' and negated classes.
+ *
+ * @param dfa Compiled DFA
+ * @param str String to match
+ * @return true if the string matches
+ */
+bool patterndfa_match(const PatternDfa *dfa, const char *str);
+
+/**
+ * Count the integers in [0, limit) that match when written as lead
+ * followed by their base58 digits, without leading zero digits (the
+ * way an address writes the number after its leading '1's). Runs in
+ * one pass over the digits of limit, counting per DFA state.
+ *
+ * @param dfa Compiled DFA
+ * @param lead Characters before the number
+ * @param limit Base58 digit values of the bound, most significant first
+ * @param digits Number of digits in limit
+ * @return Number of matching integers, -1.0 on error
+ */
+double patterndfa_count_below(const PatternDfa *dfa, const char *lead, const uint8_t *limit, size_t digits);
+
+/**
+ * Free a DFA
+ *
+ * @param dfa DFA, may be NULL
+ */
+void patterndfa_free(PatternDfa *dfa);
+
+#endif // PATTERNDFA_H
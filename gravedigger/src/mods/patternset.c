@@ -0,0 +1,948 @@
+/*
+ * Copyright (c) 2023 Brian Barto
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GPL License. See LICENSE for more details.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+#include <pthread.h>
+#include <gmp.h>
+#ifdef GMP_H_MISSING
+#   include "GMP/mini-gmp.h"
+#endif
+#include "patternset.h"
+#include "bech32.h"
+#include "crypto.h"
+#include "network.h"
+#include "error.h"
+
+#define P2PKH_VERSION_MAINNET 0x00
+#define P2PKH_VERSION_TESTNET 0x6F
+#define P2SH_VERSION_MAINNET  0x05
+#define P2SH_VERSION_TESTNET  0xC4
+#define P2PKH_PAYLOAD_LEN     25    // version || hash160 || checksum
+#define P2PKH_MAX_DIGITS      35    // base58 digits of a 25 byte payload
+#define P2WPKH_DATA_CHARS     38    // Program and checksum characters after "bc1q"
+#define P2TR_DATA_CHARS       58    // Program and checksum characters after "bc1p"
+#define P2TR_PROGRAM_LEN      32
+
+#define BUCKET_BITS  16
+#define BUCKETS      (1 << BUCKET_BITS)
+
+static const char base58_chars[] = "123456789ABCDEFGHJKLMNPQRSTUVWXYZabcdefghijkmnopqrstuvwxyz";
+static const char bech32_chars[] = "qpzry9x8gf2tvdw0s3jn54khce6mua7l";
+
+typedef struct {
+    unsigned char lo[PATTERNSET_HASH_LEN];
+    unsigned char hi[PATTERNSET_HASH_LEN];   // Inclusive
+} Interval;
+
+/*
+ * Transition table over the symbols used by the set, states * symbols
+ * entries. Walked as a plain trie for prefixes and, once the failure
+ * links are folded in, as a DFA for suffixes and substrings.
+ */
+typedef struct {
+    int32_t *next;
+    int32_t *out;       // Pattern ending here (and via failure links)
+    int32_t *out_end;   // Suffix pattern ending here, only valid at the end
+    size_t states;
+    size_t capacity;
+} Automaton;
+
+struct PatternSet {
+    patternset_encoding_t encoding;
+    bool case_sensitive;
+    bool compiled;
+
+    char **patterns;            // As added
+    char **bodies;              // Without the '*' markers
+    patternset_kind_t *kinds;
+    size_t count;
+    size_t capacity;
+
+    // Characters mapped to dense symbol numbers, -1 if unused
+    int16_t symbol[256];
+    size_t symbols;
+
+    Interval *intervals;
+    size_t interval_count;
+    size_t interval_capacity;
+    uint32_t *buckets;          // BUCKETS + 1 offsets by top 16 hash bits
+
+    Automaton prefixes;
+    Automaton substrings;
+    bool has_substrings;
+
+    unsigned char digest[32];
+};
+
+static bool is_bech32(const PatternSet *set) {
+    return set->encoding == PATTERNSET_BECH32 || set->encoding == PATTERNSET_BECH32M;
+}
+
+static char fold(const PatternSet *set, char c) {
+    if (set->case_sensitive && !is_bech32(set)) {
+        return c;
+    }
+    return (char)tolower((unsigned char)c);
+}
+
+// Version byte of base58 addresses in an encoding on the current network
+static unsigned int base58_version(patternset_encoding_t encoding) {
+    if (encoding == PATTERNSET_P2SH) {
+        return network_is_test() ? P2SH_VERSION_TESTNET : P2SH_VERSION_MAINNET;
+    }
+    return network_is_test() ? P2PKH_VERSION_TESTNET : P2PKH_VERSION_MAINNET;
+}
+
+PatternSet *patternset_new(patternset_encoding_t encoding, bool case_sensitive) {
+    if (encoding != PATTERNSET_BASE58 && encoding != PATTERNSET_BECH32 && encoding != PATTERNSET_P2SH &&
+        encoding != PATTERNSET_BECH32M) {
+        error_log("Unknown pattern encoding");
+        return NULL;
+    }
+
+    PatternSet *set = calloc(1, sizeof(PatternSet));
+    if (!set) {
+        error_log("Memory allocation error.");
+        return NULL;
+    }
+
+    set->encoding = encoding;
+    set->case_sensitive = case_sensitive;
+    return set;
+}
+
+/*
+ * Mask and value a bech32 prefix fixes in the start of the witness
+ * program. A taproot program is 32 bytes, of which the table keeps the
+ * first 20; longer prefixes are left to the address trie to confirm.
+ */
+static int bech32_compile(const PatternSet *set, unsigned char *mask, unsigned char *value, const char *prefix) {
+    unsigned char m[P2TR_PROGRAM_LEN], v[P2TR_PROGRAM_LEN];
+    char lower[PATTERNSET_MAX_LENGTH + 1];
+    bool taproot = set->encoding == PATTERNSET_BECH32M;
+    size_t i;
+
+    for (i = 0; prefix[i]; i++) {
+        lower[i] = (char)tolower((unsigned char)prefix[i]);
+    }
+    lower[i] = '\0';
+
+    if (bech32_prefix_compile(m, v, taproot ? P2TR_PROGRAM_LEN : PATTERNSET_HASH_LEN, lower, taproot ? 1 : 0) < 0) {
+        return -1;
+    }
+    memcpy(mask, m, PATTERNSET_HASH_LEN);
+    memcpy(value, v, PATTERNSET_HASH_LEN);
+    return 0;
+}
+
+// Every character must be able to appear at its place in an address
+static int validate(const PatternSet *set, const char *body, patternset_kind_t kind) {
+    const char *alphabet = is_bech32(set) ? bech32_chars : base58_chars;
+    const char *c = body;
+
+    if (is_bech32(set)) {
+        if (kind == PATTERNSET_PREFIX) {
+            unsigned char mask[PATTERNSET_HASH_LEN], value[PATTERNSET_HASH_LEN];
+            return bech32_compile(set, mask, value, body);
+        }
+        for (; *c; c++) {
+            if (!strchr(bech32_chars, tolower((unsigned char)*c))) {
+                error_log("Pattern character '%c' can not appear in a bech32 address", *c);
+                return -1;
+            }
+        }
+        return 0;
+    }
+
+    if (kind == PATTERNSET_PREFIX && set->encoding == PATTERNSET_P2SH) {
+        const char *lead = network_is_test() ? "2" : "3";
+        if (body[0] != lead[0]) {
+            error_log("P2SH addresses on this network start with '%s'", lead);
+            return -1;
+        }
+    } else if (kind == PATTERNSET_PREFIX) {
+        const char *lead = network_is_test() ? "mn" : "1";
+        if (!strchr(lead, body[0])) {
+            error_log("P2PKH addresses on this network start with '%s'", network_is_test() ? "m' or 'n" : "1");
+            return -1;
+        }
+    }
+
+    for (; *c; c++) {
+        if (strchr(alphabet, *c)) continue;
+        if (!set->case_sensitive && isalpha((unsigned char)*c) &&
+            (strchr(alphabet, toupper((unsigned char)*c)) ||
+             strchr(alphabet, tolower((unsigned char)*c)))) continue;
+        error_log("Pattern character '%c' can not appear in a base58 address", *c);
+        return -1;
+    }
+
+    return 0;
+}
+
+int patternset_add(PatternSet *set, const char *pattern) {
+    patternset_kind_t kind = PATTERNSET_PREFIX;
+    const char *start;
+    size_t len;
+    char *body, *text;
+
+    if (!set || !pattern || set->compiled) {
+        error_log("Can not add to a compiled pattern set");
+        return -1;
+    }
+    if (set->count >= PATTERNSET_MAX) {
+        error_log("Pattern sets hold at most %d patterns", PATTERNSET_MAX);
+        return -1;
+    }
+
+    start = pattern;
+    len = strlen(pattern);
+    if (len > 0 && start[0] == '*') {
+        start++;
+        len--;
+        kind = PATTERNSET_SUFFIX;
+    }
+    if (len > 0 && start[len - 1] == '*') {
+        len--;
+        kind = kind == PATTERNSET_SUFFIX ? PATTERNSET_CONTAINS : PATTERNSET_PREFIX;
+    }
+    if (len == 0 || len > PATTERNSET_MAX_LENGTH) {
+        error_log("Pattern must be 1 to %d characters", PATTERNSET_MAX_LENGTH);
+        return -1;
+    }
+
+    body = strndup(start, len);
+    text = strdup(pattern);
+    if (!body || !text) {
+        free(body);
+        free(text);
+        error_log("Memory allocation error.");
+        return -1;
+    }
+    if (validate(set, body, kind) < 0) {
+        error_log("Invalid pattern '%s'", pattern);
+        free(body);
+        free(text);
+        return -1;
+    }
+
+    if (set->count == set->capacity) {
+        size_t capacity = set->capacity ? set->capacity * 2 : 64;
+        char **patterns = realloc(set->patterns, capacity * sizeof(char *));
+        if (patterns) set->patterns = patterns;
+        char **bodies = realloc(set->bodies, capacity * sizeof(char *));
+        if (bodies) set->bodies = bodies;
+        patternset_kind_t *kinds = realloc(set->kinds, capacity * sizeof(patternset_kind_t));
+        if (kinds) set->kinds = kinds;
+        if (!patterns || !bodies || !kinds) {
+            error_log("Memory allocation error.");
+            free(body);
+            free(text);
+            return -1;
+        }
+        set->capacity = capacity;
+    }
+
+    set->patterns[set->count] = text;
+    set->bodies[set->count] = body;
+    set->kinds[set->count] = kind;
+    return (int)set->count++;
+}
+
+int patternset_load(PatternSet *set, const char *path) {
+    char line[256];
+    int added = 0, number = 0;
+    FILE *f;
+
+    if (!set || !path) return -1;
+
+    f = fopen(path, "r");
+    if (!f) {
+        error_log("Could not open pattern file %s.", path);
+        return -1;
+    }
+
+    while (fgets(line, sizeof(line), f)) {
+        char *start = line, *end;
+
+        number++;
+        if (!strchr(line, '\n') && !feof(f)) {
+            error_log("Line %d of %s is too long", number, path);
+            fclose(f);
+            return -1;
+        }
+
+        while (isspace((unsigned char)*start)) start++;
+        end = start + strlen(start);
+        while (end > start && isspace((unsigned char)end[-1])) end--;
+        *end = '\0';
+
+        if (*start == '\0' || *start == '#') continue;
+
+        if (patternset_add(set, start) < 0) {
+            error_log("Invalid pattern on line %d of %s", number, path);
+            fclose(f);
+            return -1;
+        }
+        added++;
+    }
+
+    fclose(f);
+    return added;
+}
+
+static int automaton_grow(Automaton *a, size_t symbols) {
+    if (a->states < a->capacity) return 0;
+
+    size_t capacity = a->capacity ? a->capacity * 2 : 256;
+    int32_t *next = realloc(a->next, capacity * symbols * sizeof(int32_t));
+    if (next) a->next = next;
+    int32_t *out = realloc(a->out, capacity * sizeof(int32_t));
+    if (out) a->out = out;
+    int32_t *out_end = realloc(a->out_end, capacity * sizeof(int32_t));
+    if (out_end) a->out_end = out_end;
+    if (!next || !out || !out_end) {
+        error_log("Memory allocation error.");
+        return -1;
+    }
+    a->capacity = capacity;
+    return 0;
+}
+
+static int32_t automaton_new_state(Automaton *a, size_t symbols) {
+    if (automaton_grow(a, symbols) < 0) return -1;
+
+    for (size_t s = 0; s < symbols; s++) {
+        a->next[a->states * symbols + s] = -1;
+    }
+    a->out[a->states] = -1;
+    a->out_end[a->states] = -1;
+    return (int32_t)a->states++;
+}
+
+// Walk the trie along a pattern, adding states as needed
+static int32_t automaton_insert(PatternSet *set, Automaton *a, const char *str) {
+    int32_t state = 0;
+
+    if (a->states == 0 && automaton_new_state(a, set->symbols) < 0) return -1;
+
+    for (; *str; str++) {
+        int16_t sym = set->symbol[(unsigned char)fold(set, *str)];
+        int32_t *slot = &a->next[(size_t)state * set->symbols + sym];
+        if (*slot < 0) {
+            int32_t created = automaton_new_state(a, set->symbols);
+            if (created < 0) return -1;
+            // The table may have moved
+            slot = &a->next[(size_t)state * set->symbols + sym];
+            *slot = created;
+        }
+        state = *slot;
+    }
+
+    return state;
+}
+
+/*
+ * Fold the failure links into the transition table (Aho-Corasick): a
+ * missing edge takes the edge of the longest proper suffix instead, and
+ * every state inherits the outputs of its failure state. Matching is
+ * then one table lookup per address character.
+ */
+static int automaton_link(PatternSet *set, Automaton *a) {
+    size_t symbols = set->symbols;
+    int32_t *fail, *queue;
+    size_t head = 0, tail = 0;
+
+    if (a->states == 0) return 0;
+
+    fail = calloc(a->states, sizeof(int32_t));
+    queue = calloc(a->states, sizeof(int32_t));
+    if (!fail || !queue) {
+        error_log("Memory allocation error.");
+        free(fail);
+        free(queue);
+        return -1;
+    }
+
+    for (size_t s = 0; s < symbols; s++) {
+        int32_t child = a->next[s];
+        if (child < 0) {
+            a->next[s] = 0;
+        } else {
+            fail[child] = 0;
+            queue[tail++] = child;
+        }
+    }
+
+    while (head < tail) {
+        int32_t state = queue[head++];
+
+        if (a->out[state] < 0) a->out[state] = a->out[fail[state]];
+        if (a->out_end[state] < 0) a->out_end[state] = a->out_end[fail[state]];
+
+        for (size_t s = 0; s < symbols; s++) {
+            int32_t *slot = &a->next[(size_t)state * symbols + s];
+            int32_t via_fail = a->next[(size_t)fail[state] * symbols + s];
+            if (*slot < 0) {
+                *slot = via_fail;
+            } else {
+                fail[*slot] = via_fail;
+                queue[tail++] = *slot;
+            }
+        }
+    }
+
+    free(fail);
+    free(queue);
+    return 0;
+}
+
+static void automaton_free(Automaton *a) {
+    free(a->next);
+    free(a->out);
+    free(a->out_end);
+    memset(a, 0, sizeof(*a));
+}
+
+static int add_interval(PatternSet *set, const unsigned char *lo, const unsigned char *hi) {
+    if (set->interval_count == set->interval_capacity) {
+        size_t capacity = set->interval_capacity ? set->interval_capacity * 2 : 256;
+        Interval *intervals = realloc(set->intervals, capacity * sizeof(Interval));
+        if (!intervals) {
+            error_log("Memory allocation error.");
+            return -1;
+        }
+        set->intervals = intervals;
+        set->interval_capacity = capacity;
+    }
+
+    memcpy(set->intervals[set->interval_count].lo, lo, PATTERNSET_HASH_LEN);
+    memcpy(set->intervals[set->interval_count].hi, hi, PATTERNSET_HASH_LEN);
+    set->interval_count++;
+    return 0;
+}
+
+static void export_hash(unsigned char *out, const mpz_t value) {
+    size_t len = (mpz_sizeinbase(value, 2) + 7) / 8;
+
+    memset(out, 0, PATTERNSET_HASH_LEN);
+    if (mpz_sgn(value) != 0) {
+        mpz_export(out + PATTERNSET_HASH_LEN - len, NULL, 1, 1, 1, 0, value);
+    }
+}
+
+// 58^i for every digit count of a payload, shared read-only
+static mpz_t pow58[P2PKH_MAX_DIGITS + 1];
+static pthread_once_t pow58_once = PTHREAD_ONCE_INIT;
+
+static void pow58_init(void) {
+    mpz_init_set_ui(pow58[0], 1);
+    for (size_t i = 1; i <= P2PKH_MAX_DIGITS; i++) {
+        mpz_init(pow58[i]);
+        mpz_mul_ui(pow58[i], pow58[i - 1], 58);
+    }
+}
+
+/*
+ * A base58 address is the 25 byte payload P = version || hash || check
+ * as one big number, with a '1' for every leading zero byte. For each
+ * possible digit count the addresses starting with the prefix are one
+ * range of P, and since the hash sits above the 32 checksum bits, one
+ * range of hashes.
+ */
+static int base58_intervals(PatternSet *set, const char *prefix) {
+    unsigned int version = base58_version(set->encoding);
+    unsigned char lo_hash[PATTERNSET_HASH_LEN], hi_hash[PATTERNSET_HASH_LEN];
+    size_t ones = 0, rest_len;
+    const char *rest;
+    mpz_t base_lo, base_hi, value, lo, hi, t, offset;
+    int r = 0;
+
+    while (prefix[ones] == '1') ones++;
+    rest = prefix + ones;
+    rest_len = strlen(rest);
+
+    // All leading zero bytes would have to be in the hash
+    if (version == 0 && ones > PATTERNSET_HASH_LEN + 1) {
+        return 0;
+    }
+
+    mpz_init(base_lo);
+    mpz_init(base_hi);
+    mpz_init(value);
+    mpz_init(lo);
+    mpz_init(hi);
+    mpz_init(t);
+    mpz_init(offset);
+
+    pthread_once(&pow58_once, pow58_init);
+
+    // Range of P allowed by the version byte and the leading '1's
+    if (version == 0) {
+        if (rest_len > 0) {
+            mpz_setbit(base_lo, (P2PKH_PAYLOAD_LEN - 1 - ones) * 8);
+        }
+        mpz_setbit(base_hi, (P2PKH_PAYLOAD_LEN - ones) * 8);
+    } else {
+        mpz_set_ui(base_lo, version);
+        mpz_mul_2exp(base_lo, base_lo, (P2PKH_PAYLOAD_LEN - 1) * 8);
+        mpz_set_ui(base_hi, version + 1);
+        mpz_mul_2exp(base_hi, base_hi, (P2PKH_PAYLOAD_LEN - 1) * 8);
+        mpz_set(offset, base_lo);
+    }
+
+    for (size_t i = 0; i < rest_len; i++) {
+        mpz_mul_ui(value, value, 58);
+        mpz_add_ui(value, value, strchr(base58_chars, rest[i]) - base58_chars);
+    }
+
+    for (size_t digits = rest_len ? rest_len : 1; digits <= P2PKH_MAX_DIGITS; digits++) {
+        // Only the digit counts P can have in this range contribute
+        if (rest_len && mpz_cmp(pow58[digits], base_lo) <= 0) continue;
+        if (rest_len && mpz_cmp(pow58[digits - 1], base_hi) >= 0) break;
+
+        // lo = max(base_lo, 58^(digits-1), value * 58^(digits-rest_len))
+        mpz_set(lo, base_lo);
+        if (rest_len && mpz_cmp(pow58[digits - 1], lo) > 0) mpz_set(lo, pow58[digits - 1]);
+        mpz_mul(t, pow58[digits - rest_len], value);
+        if (mpz_cmp(t, lo) > 0) mpz_set(lo, t);
+
+        // hi = min(base_hi, 58^digits, (value + 1) * 58^(digits-rest_len))
+        mpz_set(hi, base_hi);
+        if (rest_len) {
+            if (mpz_cmp(pow58[digits], hi) < 0) mpz_set(hi, pow58[digits]);
+            mpz_add(t, t, pow58[digits - rest_len]);
+            if (mpz_cmp(t, hi) < 0) mpz_set(hi, t);
+        }
+
+        if (mpz_cmp(lo, hi) < 0) {
+            mpz_sub(lo, lo, offset);
+            mpz_sub(hi, hi, offset);
+            mpz_sub_ui(hi, hi, 1);
+            mpz_fdiv_q_2exp(lo, lo, 32);
+            mpz_fdiv_q_2exp(hi, hi, 32);
+            export_hash(lo_hash, lo);
+            export_hash(hi_hash, hi);
+            if (add_interval(set, lo_hash, hi_hash) < 0) {
+                r = -1;
+                break;
+            }
+        }
+
+        // Without further digits the one range covers everything
+        if (!rest_len) break;
+    }
+
+    mpz_clear(base_lo);
+    mpz_clear(base_hi);
+    mpz_clear(value);
+    mpz_clear(lo);
+    mpz_clear(hi);
+    mpz_clear(t);
+    mpz_clear(offset);
+
+    return r;
+}
+
+// Case insensitive base58 prefixes cover every spelling of the prefix
+static int base58_variants(PatternSet *set, const char *prefix) {
+    char variant[PATTERNSET_MAX_LENGTH + 1];
+    size_t positions[PATTERNSET_MAX_LENGTH];
+    size_t count = 0, len = strlen(prefix);
+
+    if (set->case_sensitive) {
+        return base58_intervals(set, prefix);
+    }
+
+    // Letters with both cases in the alphabet branch, others have one spelling
+    for (size_t i = 0; i < len; i++) {
+        char lower = (char)tolower((unsigned char)prefix[i]);
+        char upper = (char)toupper((unsigned char)prefix[i]);
+        bool has_lower = strchr(base58_chars, lower) != NULL;
+        bool has_upper = strchr(base58_chars, upper) != NULL;
+
+        variant[i] = has_lower ? lower : upper;
+        if (lower != upper && has_lower && has_upper) {
+            positions[count++] = i;
+        }
+    }
+    variant[len] = '\0';
+
+    if (count >= 31 || (1UL << count) > PATTERNSET_MAX_VARIANTS) {
+        error_log("Pattern '%s' has too many case variants", prefix);
+        return -1;
+    }
+
+    for (unsigned long bits = 0; bits < (1UL << count); bits++) {
+        for (size_t j = 0; j < count; j++) {
+            char c = variant[positions[j]];
+            variant[positions[j]] = (char)((bits >> j) & 1 ? toupper((unsigned char)c) : tolower((unsigned char)c));
+        }
+        if (base58_intervals(set, variant) < 0) return -1;
+    }
+
+    return 0;
+}
+
+// A bech32 prefix fixes the top 5 bits of the program per character
+static int bech32_interval(PatternSet *set, const char *prefix) {
+    unsigned char mask[PATTERNSET_HASH_LEN], lo[PATTERNSET_HASH_LEN], hi[PATTERNSET_HASH_LEN];
+    size_t i;
+
+    if (bech32_compile(set, mask, lo, prefix) < 0) {
+        return -1;
+    }
+    for (i = 0; i < PATTERNSET_HASH_LEN; i++) {
+        hi[i] = lo[i] | (unsigned char)~mask[i];
+    }
+
+    return add_interval(set, lo, hi);
+}
+
+static int compare_intervals(const void *a, const void *b) {
+    return memcmp(((const Interval *)a)->lo, ((const Interval *)b)->lo, PATTERNSET_HASH_LEN);
+}
+
+static unsigned int bucket_of(const unsigned char *hash) {
+    return ((unsigned int)hash[0] << 8) | hash[1];
+}
+
+// Sort, merge overlapping intervals and index them by their top bits
+static int build_interval_table(PatternSet *set) {
+    size_t merged = 0;
+
+    if (set->interval_count > 0) {
+        qsort(set->intervals, set->interval_count, sizeof(Interval), compare_intervals);
+
+        for (size_t i = 1; i < set->interval_count; i++) {
+            Interval *last = &set->intervals[merged];
+            Interval *cur = &set->intervals[i];
+            if (memcmp(cur->lo, last->hi, PATTERNSET_HASH_LEN) <= 0) {
+                if (memcmp(cur->hi, last->hi, PATTERNSET_HASH_LEN) > 0) {
+                    memcpy(last->hi, cur->hi, PATTERNSET_HASH_LEN);
+                }
+            } else {
+                set->intervals[++merged] = *cur;
+            }
+        }
+        set->interval_count = merged + 1;
+    }
+
+    set->buckets = calloc(BUCKETS + 1, sizeof(uint32_t));
+    if (!set->buckets) {
+        error_log("Memory allocation error.");
+        return -1;
+    }
+
+    // buckets[b] is the first interval whose low end lies in bucket b or later
+    size_t j = 0;
+    for (unsigned int b = 0; b <= BUCKETS; b++) {
+        while (j < set->interval_count && bucket_of(set->intervals[j].lo) < b) j++;
+        set->buckets[b] = (uint32_t)j;
+    }
+
+    return 0;
+}
+
+static int compute_digest(PatternSet *set) {
+    size_t len = 2;
+    unsigned char *buffer, *p;
+
+    for (size_t i = 0; i < set->count; i++) {
+        len += strlen(set->bodies[i]) + 2;
+    }
+
+    buffer = malloc(len);
+    if (!buffer) {
+        error_log("Memory allocation error.");
+        return -1;
+    }
+
+    p = buffer;
+    *p++ = (unsigned char)set->encoding;
+    *p++ = set->case_sensitive ? 1 : 0;
+    for (size_t i = 0; i < set->count; i++) {
+        size_t l = strlen(set->bodies[i]);
+        *p++ = (unsigned char)set->kinds[i];
+        memcpy(p, set->bodies[i], l);
+        p += l;
+        *p++ = '\n';
+    }
+
+    int r = crypto_get_sha256(set->digest, buffer, len);
+    free(buffer);
+    return r < 0 ? -1 : 0;
+}
+
+int patternset_compile(PatternSet *set) {
+    if (!set || set->compiled) {
+        error_log("Pattern set is already compiled");
+        return -1;
+    }
+    if (set->count == 0) {
+        error_log("Pattern set is empty");
+        return -1;
+    }
+
+    // Dense symbol numbers for the (folded) characters in use
+    memset(set->symbol, 0xFF, sizeof(set->symbol));
+    for (size_t i = 0; i < set->count; i++) {
+        for (const char *c = set->bodies[i]; *c; c++) {
+            unsigned char f = (unsigned char)fold(set, *c);
+            if (set->symbol[f] < 0) {
+                set->symbol[f] = (int16_t)set->symbols++;
+            }
+        }
+    }
+    // Matching looks every address character up through the fold
+    for (int c = 0; c < 256; c++) {
+        unsigned char f = (unsigned char)fold(set, (char)c);
+        if (f != c && set->symbol[c] < 0) {
+            set->symbol[c] = set->symbol[f];
+        }
+    }
+
+    for (size_t i = 0; i < set->count; i++) {
+        const char *pattern = set->bodies[i];
+        int32_t state;
+
+        if (set->kinds[i] == PATTERNSET_PREFIX) {
+            int r = is_bech32(set) ? bech32_interval(set, pattern) : base58_variants(set, pattern);
+            if (r < 0) return -1;
+
+            state = automaton_insert(set, &set->prefixes, pattern);
+            if (state < 0) return -1;
+            if (set->prefixes.out[state] < 0) set->prefixes.out[state] = (int32_t)i;
+        } else {
+            state = automaton_insert(set, &set->substrings, pattern);
+            if (state < 0) return -1;
+            if (set->kinds[i] == PATTERNSET_CONTAINS) {
+                if (set->substrings.out[state] < 0) set->substrings.out[state] = (int32_t)i;
+            } else if (set->substrings.out_end[state] < 0) {
+                set->substrings.out_end[state] = (int32_t)i;
+            }
+            set->has_substrings = true;
+        }
+    }
+
+    if (automaton_link(set, &set->substrings) < 0 || build_interval_table(set) < 0 ||
+        compute_digest(set) < 0) {
+        return -1;
+    }
+
+    set->compiled = true;
+    return 0;
+}
+
+bool patternset_match_hash(const PatternSet *set, const unsigned char *hash) {
+    unsigned int b = bucket_of(hash);
+    size_t lo = set->buckets[b], hi = set->buckets[b + 1];
+
+    // Last interval starting at or below the hash. Intervals starting in
+    // this bucket are in [lo, hi); otherwise it's the one just before.
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (memcmp(set->intervals[mid].lo, hash, PATTERNSET_HASH_LEN) <= 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    if (lo == 0) return false;
+
+    return memcmp(hash, set->intervals[lo - 1].hi, PATTERNSET_HASH_LEN) <= 0;
+}
+
+int patternset_match_address(const PatternSet *set, const char *address) {
+    const Automaton *a;
+    const unsigned char *c;
+    int32_t state;
+
+    // Prefixes: anchored walk down the trie
+    a = &set->prefixes;
+    if (a->states > 0) {
+        state = 0;
+        for (c = (const unsigned char *)address; *c; c++) {
+            int16_t sym = set->symbol[*c];
+            if (sym < 0) break;
+            state = a->next[(size_t)state * set->symbols + sym];
+            if (state < 0) break;
+            if (a->out[state] >= 0) return a->out[state];
+        }
+    }
+
+    // Suffixes and substrings: one pass through the automaton
+    a = &set->substrings;
+    if (set->has_substrings) {
+        state = 0;
+        for (c = (const unsigned char *)address; *c; c++) {
+            int16_t sym = set->symbol[*c];
+            state = sym < 0 ? 0 : a->next[(size_t)state * set->symbols + sym];
+            if (a->out[state] >= 0) return a->out[state];
+        }
+        if (a->out_end[state] >= 0) return a->out_end[state];
+    }
+
+    return -1;
+}
+
+bool patternset_needs_address(const PatternSet *set) {
+    return set->has_substrings;
+}
+
+size_t patternset_count(const PatternSet *set) {
+    return set ? set->count : 0;
+}
+
+const char *patternset_get(const PatternSet *set, int id) {
+    if (!set || id < 0 || (size_t)id >= set->count) return NULL;
+    return set->patterns[id];
+}
+
+// Number of hashes in an inclusive interval, exact up to double rounding
+static double interval_width(const Interval *interval) {
+    double width = 0.0;
+    int borrow = 0;
+    unsigned char diff[PATTERNSET_HASH_LEN];
+
+    for (int i = PATTERNSET_HASH_LEN - 1; i >= 0; i--) {
+        int d = interval->hi[i] - interval->lo[i] - borrow;
+        borrow = d < 0;
+        diff[i] = (unsigned char)(d + (borrow ? 256 : 0));
+    }
+    for (int i = 0; i < PATTERNSET_HASH_LEN; i++) {
+        width = width * 256.0 + diff[i];
+    }
+    return width + 1.0;
+}
+
+// Measure of [lo, hi) inside [from, to)
+static double overlap(double lo, double hi, double from, double to) {
+    if (from > lo) lo = from;
+    if (to < hi) hi = to;
+    return hi > lo ? hi - lo : 0.0;
+}
+
+double patternset_base58_length(patternset_encoding_t encoding, size_t length) {
+    unsigned int version = base58_version(encoding);
+    double total = ldexp(1.0, (P2PKH_PAYLOAD_LEN - 1) * 8);
+    double p = 0.0;
+
+    if (length == 0 || length > P2PKH_PAYLOAD_LEN + P2PKH_MAX_DIGITS) {
+        return 0.0;
+    }
+
+    if (version == 0) {
+        // With z zero bytes after the version byte, P lies in
+        // [256^(23-z), 256^(24-z)) and z + 1 '1's precede its digits
+        for (size_t z = 0; z < P2PKH_PAYLOAD_LEN - 1 && z + 1 < length; z++) {
+            double digits = (double)(length - 1 - z);
+            p += overlap(ldexp(1.0, (int)(P2PKH_PAYLOAD_LEN - 2 - z) * 8),
+                         ldexp(1.0, (int)(P2PKH_PAYLOAD_LEN - 1 - z) * 8),
+                         pow(58.0, digits - 1), pow(58.0, digits));
+        }
+    } else {
+        p = overlap(version * total, (version + 1) * total, pow(58.0, length - 1.0), pow(58.0, (double)length));
+    }
+
+    return p / total;
+}
+
+// Spellings of a body that match it when case doesn't matter
+static double spellings(const PatternSet *set, const char *body) {
+    double n = 1.0;
+
+    if (set->case_sensitive || is_bech32(set)) {
+        return 1.0;
+    }
+    for (const char *c = body; *c; c++) {
+        char lower = (char)tolower((unsigned char)*c);
+        char upper = (char)toupper((unsigned char)*c);
+        if (lower != upper && strchr(base58_chars, lower) && strchr(base58_chars, upper)) {
+            n *= 2.0;
+        }
+    }
+    return n;
+}
+
+/*
+ * Suffix and substring odds. The last digits of P are its low bits,
+ * which the checksum makes uniform, so a suffix of k characters is
+ * spellings / alphabet^k. A substring gets the same odds at every
+ * place it fits after the leading character, taken as independent.
+ */
+static double substring_probability(const PatternSet *set, const char *body, patternset_kind_t kind) {
+    size_t len = strlen(body);
+    double alphabet = is_bech32(set) ? 32.0 : 58.0;
+    double q = spellings(set, body) * pow(alphabet, -(double)len);
+    double places = 0.0;
+
+    if (q > 1.0) q = 1.0;
+    if (kind == PATTERNSET_SUFFIX) {
+        return q;
+    }
+
+    if (is_bech32(set)) {
+        size_t data = set->encoding == PATTERNSET_BECH32M ? P2TR_DATA_CHARS : P2WPKH_DATA_CHARS;
+        places = len <= data ? (double)(data - len + 1) : 0.0;
+    } else {
+        for (size_t l = len + 1; l <= P2PKH_PAYLOAD_LEN + P2PKH_MAX_DIGITS; l++) {
+            places += patternset_base58_length(set->encoding, l) * (double)(l - len);
+        }
+    }
+
+    return -expm1(places * log1p(-q));
+}
+
+double patternset_probability(const PatternSet *set) {
+    double prefix = 0.0, log_miss = 0.0;
+
+    if (!set || !set->compiled) {
+        return 0.0;
+    }
+
+    // Merged intervals don't overlap, so prefixes add up exactly
+    for (size_t i = 0; i < set->interval_count; i++) {
+        prefix += interval_width(&set->intervals[i]);
+    }
+    prefix = ldexp(prefix, -8 * PATTERNSET_HASH_LEN);
+
+    // The rest in log space; 1 - (1 - p) would round tiny odds away
+    for (size_t i = 0; i < set->count; i++) {
+        if (set->kinds[i] != PATTERNSET_PREFIX) {
+            log_miss += log1p(-substring_probability(set, set->bodies[i], set->kinds[i]));
+        }
+    }
+
+    return prefix + (1.0 - prefix) * -expm1(log_miss);
+}
+
+const unsigned char *patternset_digest(const PatternSet *set) {
+    return set->digest;
+}
+
+void patternset_free(PatternSet *set) {
+    if (!set) return;
+
+    for (size_t i = 0; i < set->count; i++) {
+        free(set->patterns[i]);
+        free(set->bodies[i]);
+    }
+    free(set->patterns);
+    free(set->bodies);
+    free(set->kinds);
+    free(set->intervals);
+    free(set->buckets);
+    automaton_free(&set->prefixes);
+    automaton_free(&set->substrings);
+    free(set);
+}
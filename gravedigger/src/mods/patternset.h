@@ -0,0 +1,162 @@
+/*
+ * Copyright (c) 2023 Brian Barto
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GPL License. See LICENSE for more details.
+ */
+
+#ifndef PATTERNSET_H
+#define PATTERNSET_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+#define PATTERNSET_MAX          1000000  // Patterns per set
+#define PATTERNSET_MAX_LENGTH   42       // Characters per pattern
+#define PATTERNSET_MAX_VARIANTS 4096     // Case variants of one base58 prefix
+#define PATTERNSET_HASH_LEN     20       // HASH160
+
+// Address encoding the patterns are written in
+typedef enum {
+    PATTERNSET_BASE58 = 0,  // Legacy P2PKH addresses
+    PATTERNSET_BECH32 = 1,  // Native segwit P2WPKH addresses
+    PATTERNSET_P2SH = 2,    // Nested segwit P2SH-P2WPKH addresses, base58 too
+    PATTERNSET_BECH32M = 3  // Taproot P2TR addresses; the "hash" is the output key's first 20 bytes
+} patternset_encoding_t;
+
+// Where a pattern has to occur in the address
+typedef enum {
+    PATTERNSET_PREFIX = 0,    // "1abc"
+    PATTERNSET_SUFFIX = 1,    // "*xyz"
+    PATTERNSET_CONTAINS = 2   // "*abc*"
+} patternset_kind_t;
+
+typedef struct PatternSet PatternSet;
+
+/**
+ * Create an empty pattern set
+ *
+ * @param encoding Address encoding of every pattern in the set
+ * @param case_sensitive Whether matching is case sensitive (bech32
+ *        patterns always match case insensitively)
+ * @return New set or NULL on error
+ */
+PatternSet *patternset_new(patternset_encoding_t encoding, bool case_sensitive);
+
+/**
+ * Add one pattern. A leading '*' makes it a suffix, a leading and a
+ * trailing '*' make it match anywhere, otherwise it is a prefix.
+ *
+ * @param set Pattern set (not yet compiled)
+ * @param pattern Pattern text
+ * @return Pattern id (0 based, in order of addition) or -1 on error
+ */
+int patternset_add(PatternSet *set, const char *pattern);
+
+/**
+ * Add every pattern of a file, one per line. Blank lines and lines
+ * starting with '#' are skipped.
+ *
+ * @param set Pattern set (not yet compiled)
+ * @param path File to read
+ * @return Number of patterns added or -1 on error
+ */
+int patternset_load(PatternSet *set, const char *path);
+
+/**
+ * Build the lookup structures. Prefixes become a sorted table of
+ * disjoint HASH160 intervals and an anchored trie; suffixes and
+ * substrings become one Aho-Corasick automaton. No patterns can be
+ * added afterwards.
+ *
+ * @param set Pattern set
+ * @return 0 on success, -1 on error
+ */
+int patternset_compile(PatternSet *set);
+
+/**
+ * Test a HASH160 against the prefix interval table. Keys that fail can
+ * not match any prefix; keys that pass must still be confirmed with
+ * patternset_match_address(), since the first and last hash of an
+ * interval may only match for some checksums.
+ *
+ * @param set Compiled pattern set
+ * @param hash PATTERNSET_HASH_LEN bytes
+ * @return true if the hash may match a prefix
+ */
+bool patternset_match_hash(const PatternSet *set, const unsigned char *hash);
+
+/**
+ * Match an encoded address against every pattern of the set
+ *
+ * @param set Compiled pattern set
+ * @param address NUL terminated address
+ * @return Id of a matching pattern or -1 if none matches
+ */
+int patternset_match_address(const PatternSet *set, const char *address);
+
+/**
+ * Whether any pattern needs the encoded address of every candidate
+ * (suffix or substring patterns). Prefix-only sets filter on HASH160.
+ *
+ * @param set Compiled pattern set
+ * @return true if addresses must be encoded
+ */
+bool patternset_needs_address(const PatternSet *set);
+
+/**
+ * Get the number of patterns in the set
+ *
+ * @param set Pattern set
+ * @return Pattern count
+ */
+size_t patternset_count(const PatternSet *set);
+
+/**
+ * Get a pattern by id
+ *
+ * @param set Pattern set
+ * @param id Pattern id
+ * @return Pattern text as added, or NULL for an unknown id
+ */
+const char *patternset_get(const PatternSet *set, int id);
+
+/**
+ * Get the chance that one random key matches the set. Prefixes are
+ * exact: their HASH160 intervals are measured, so the skewed leading
+ * digits of base58 are accounted for. Suffixes and substrings take the
+ * trailing digits as uniform and every place a substring fits as
+ * independent.
+ *
+ * @param set Compiled pattern set
+ * @return Probability per candidate, 0 if the set isn't compiled
+ */
+double patternset_probability(const PatternSet *set);
+
+/**
+ * Get the chance that a random base58 address on the current network
+ * has a given number of characters
+ *
+ * @param encoding PATTERNSET_BASE58 or PATTERNSET_P2SH
+ * @param length Address length
+ * @return Probability
+ */
+double patternset_base58_length(patternset_encoding_t encoding, size_t length);
+
+/**
+ * Get a SHA256 digest identifying the compiled set (encoding, case
+ * sensitivity and every pattern in order)
+ *
+ * @param set Compiled pattern set
+ * @return 32 byte digest
+ */
+const unsigned char *patternset_digest(const PatternSet *set);
+
+/**
+ * Free a pattern set
+ *
+ * @param set Set to free
+ */
+void patternset_free(PatternSet *set);
+
+#endif // PATTERNSET_H
@@ -44,8 +44,8 @@ void point_set_generator(Point p)
 
 void point_double(Point result, Point a)
 {
-	static mpz_t tempx, tempy, p, slope;
-	static int init = 0;
+	static _Thread_local mpz_t tempx, tempy, p, slope;
+	static _Thread_local int init = 0;
 	
 	assert(result);
 	assert(a->x && a->y);
@@ -84,8 +84,8 @@ void point_double(Point result, Point a)
 
 void point_add(Point result, Point a, Point b)
 {
-	static mpz_t tempx, tempy, sumx, sumy, p, slope;
-	static int init = 0;
+	static _Thread_local mpz_t tempx, tempy, sumx, sumy, p, slope;
+	static _Thread_local int init = 0;
 	
 	assert(result);
 	assert(a);
@@ -129,6 +129,208 @@ void point_add(Point result, Point a, Point b)
 	mpz_set(result->y, sumy);
 }
 
+void point_mul(Point result, Point a, mpz_t k)
+{
+	size_t i;
+	struct Point t, d;
+
+	assert(result);
+	assert(a);
+	assert(mpz_sgn(k) > 0);
+
+	// Left to right double-and-add starting at the top bit, so the
+	// accumulator never needs to hold the point at infinity.
+	// point_double() can not work in place, hence the second point.
+	point_init(&t);
+	point_init(&d);
+	point_set(&t, a);
+
+	for (i = mpz_sizeinbase(k, 2) - 1; i-- > 0;)
+	{
+		point_double(&d, &t);
+		if (mpz_tstbit(k, i))
+		{
+			point_add(&t, &d, a);
+		}
+		else
+		{
+			point_set(&t, &d);
+		}
+	}
+
+	point_set(result, &t);
+	point_clear(&t);
+	point_clear(&d);
+}
+
+int point_add_batch(Point results, Point base, Point table, mpz_t *scratch, size_t n)
+{
+	size_t i;
+	static _Thread_local mpz_t p, inv, inv_i, slope, temp;
+	static _Thread_local int init = 0;
+
+	assert(results);
+	assert(base);
+	assert(table);
+	assert(scratch);
+	assert(n);
+
+	if (!init)
+	{
+		mpz_init(p);
+		mpz_init(inv);
+		mpz_init(inv_i);
+		mpz_init(slope);
+		mpz_init(temp);
+		mpz_set_str(p, BITCOIN_PRIME, 16);
+		init = 1;
+	}
+
+	// Montgomery's trick: keep the running product of every (x2 - x1)
+	// so all n slopes share a single modular inversion. The differences
+	// are parked in results[i].x until the backward pass needs them.
+	for (i = 0; i < n; ++i)
+	{
+		mpz_sub(results[i].x, table[i].x, base->x);
+		mpz_mod(results[i].x, results[i].x, p);
+		if (i == 0)
+		{
+			mpz_set(scratch[0], results[0].x);
+		}
+		else
+		{
+			mpz_mul(scratch[i], scratch[i - 1], results[i].x);
+			mpz_mod(scratch[i], scratch[i], p);
+		}
+	}
+
+	// A zero difference means base == +-table[i], which has no slope
+	if (mpz_invert(inv, scratch[n - 1], p) == 0)
+	{
+		return -1;
+	}
+
+	for (i = n; i-- > 0;)
+	{
+		if (i > 0)
+		{
+			mpz_mul(inv_i, inv, scratch[i - 1]);
+			mpz_mod(inv_i, inv_i, p);
+			mpz_mul(inv, inv, results[i].x);
+			mpz_mod(inv, inv, p);
+		}
+		else
+		{
+			mpz_set(inv_i, inv);
+		}
+
+		// slope = (y2 - y1) / (x2 - x1)
+		mpz_sub(slope, table[i].y, base->y);
+		mpz_mul(slope, slope, inv_i);
+		mpz_mod(slope, slope, p);
+
+		// x = slope^2 - x1 - x2
+		mpz_mul(temp, slope, slope);
+		mpz_sub(temp, temp, base->x);
+		mpz_sub(temp, temp, table[i].x);
+		mpz_mod(results[i].x, temp, p);
+
+		// y = slope * (x1 - x) - y1
+		mpz_sub(temp, base->x, results[i].x);
+		mpz_mul(temp, slope, temp);
+		mpz_sub(temp, temp, base->y);
+		mpz_mod(results[i].y, temp, p);
+	}
+
+	return 1;
+}
+
+int point_add_each(Point results, Point a, Point *b, mpz_t *scratch, size_t n)
+{
+	size_t i;
+	mpz_t *diff = scratch + n;
+	static _Thread_local mpz_t p, inv, inv_i, slope, x, y;
+	static _Thread_local int init = 0;
+
+	assert(results);
+	assert(a);
+	assert(b);
+	assert(scratch);
+	assert(n);
+
+	if (!init)
+	{
+		mpz_init(p);
+		mpz_init(inv);
+		mpz_init(inv_i);
+		mpz_init(slope);
+		mpz_init(x);
+		mpz_init(y);
+		mpz_set_str(p, BITCOIN_PRIME, 16);
+		init = 1;
+	}
+
+	// Same single inversion as point_add_batch(), but every sum has its
+	// own pair of points. The differences get their own half of scratch
+	// so results may be a.
+	for (i = 0; i < n; ++i)
+	{
+		mpz_sub(diff[i], b[i]->x, a[i].x);
+		mpz_mod(diff[i], diff[i], p);
+		if (i == 0)
+		{
+			mpz_set(scratch[0], diff[0]);
+		}
+		else
+		{
+			mpz_mul(scratch[i], scratch[i - 1], diff[i]);
+			mpz_mod(scratch[i], scratch[i], p);
+		}
+	}
+
+	if (mpz_invert(inv, scratch[n - 1], p) == 0)
+	{
+		return -1;
+	}
+
+	for (i = n; i-- > 0;)
+	{
+		if (i > 0)
+		{
+			mpz_mul(inv_i, inv, scratch[i - 1]);
+			mpz_mod(inv_i, inv_i, p);
+			mpz_mul(inv, inv, diff[i]);
+			mpz_mod(inv, inv, p);
+		}
+		else
+		{
+			mpz_set(inv_i, inv);
+		}
+
+		// slope = (y2 - y1) / (x2 - x1)
+		mpz_sub(slope, b[i]->y, a[i].y);
+		mpz_mul(slope, slope, inv_i);
+		mpz_mod(slope, slope, p);
+
+		// x = slope^2 - x1 - x2
+		mpz_mul(x, slope, slope);
+		mpz_sub(x, x, a[i].x);
+		mpz_sub(x, x, b[i]->x);
+		mpz_mod(x, x, p);
+
+		// y = slope * (x1 - x) - y1
+		mpz_sub(y, a[i].x, x);
+		mpz_mul(y, slope, y);
+		mpz_sub(y, y, a[i].y);
+		mpz_mod(y, y, p);
+
+		mpz_swap(results[i].x, x);
+		mpz_swap(results[i].y, y);
+	}
+
+	return 1;
+}
+
 void point_solve_y(Point point, unsigned char even_odd_flag)
 {
 	mpz_t tempx, tempy, exp, p;
@@ -175,8 +377,8 @@ void point_solve_y(Point point, unsigned char even_odd_flag)
 int point_verify(Point a)
 {
 	int r = 0;
-	static mpz_t tempx, tempy, tempr, p;
-	static int init = 0;
+	static _Thread_local mpz_t tempx, tempy, tempr, p;
+	static _Thread_local int init = 0;
 	
 	assert(a->x && a->y);
 	
@@ -67,23 +67,18 @@ int privkey_uncompress(PrivKey key)
 
 int privkey_to_hex(char *str, PrivKey key, int cflag)
 {
-	int i;
-	
+	unsigned char flag;
+
 	assert(key);
 	assert(str);
 	
-	for (i = 0; i < PRIVKEY_LENGTH; ++i)
-	{
-		sprintf(str + (i * 2), "%02x", key->data[i]);
-	}
+	hex_encode(str, key->data, PRIVKEY_LENGTH);
 
 	if (cflag)
 	{
-		sprintf(str + (i * 2), "%02x", key->cflag);
-		++i;
+		flag = (unsigned char)key->cflag;
+		hex_encode(str + (PRIVKEY_LENGTH * 2), &flag, 1);
 	}
-
-	str[i * 2] = '\0';
 	
 	return 1;
 }
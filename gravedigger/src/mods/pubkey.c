@@ -394,7 +394,7 @@ int pubkey_is_compressed(PubKey key)
 
 int pubkey_to_hex(char *str, PubKey key)
 {
-	int i, l;
+	int l;
 	
 	assert(str);
 	assert(key);
@@ -402,24 +402,18 @@ int pubkey_to_hex(char *str, PubKey key)
 	switch (key->data[0])
 	{
 		case PUBKEY_UNCOMPRESSED_FLAG:
-			l = (PUBKEY_UNCOMPRESSED_LENGTH * 2) + 2;
+			l = PUBKEY_UNCOMPRESSED_LENGTH + 1;
 			break;
 		case PUBKEY_COMPRESSED_FLAG_EVEN:
 		case PUBKEY_COMPRESSED_FLAG_ODD:
-			l = (PUBKEY_COMPRESSED_LENGTH * 2) + 2;
+			l = PUBKEY_COMPRESSED_LENGTH + 1;
 			break;
 		default:
 			error_log("Public key contains invalid compression flag.");
 			return -1;
 	}
 	
-	for (i = 0; i < l; i += 2)
-	{
-		sprintf(str + i, "%02x", key->data[i/2]);
-	}
-	str[l] = '\0';
-	
-	return 1;
+	return hex_encode(str, key->data, l);
 }
 
 int pubkey_to_raw(unsigned char *raw, PubKey key)
@@ -6,41 +6,302 @@
  */
 
 #include <stdio.h>
+#include <stdint.h>
+#include <string.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/random.h>
 #include <assert.h>
+#include "random.h"
 #include "error.h"
 
-#define RANDOM_SOURCE "/dev/urandom"
+#define RANDOM_SOURCE        "/dev/urandom"
+#define RANDOM_KEY_LENGTH    32
+#define RANDOM_BLOCK_LENGTH  64
+#define RANDOM_BLOCKS        16
+#define RANDOM_BUFFER_LENGTH (RANDOM_BLOCK_LENGTH * RANDOM_BLOCKS)
+#define RANDOM_RESEED_BYTES  (1 << 20)
+
+#define ROTL32(v, n) (((v) << (n)) | ((v) >> (32 - (n))))
+#define QUARTERROUND(a, b, c, d) \
+	a += b; d ^= a; d = ROTL32(d, 16); \
+	c += d; b ^= c; b = ROTL32(b, 12); \
+	a += b; d ^= a; d = ROTL32(d, 8); \
+	c += d; b ^= c; b = ROTL32(b, 7);
+
+/*
+ * Per-thread ChaCha20 generator with fast key erasure: every refill
+ * produces RANDOM_BLOCKS blocks of keystream, the first RANDOM_KEY_LENGTH
+ * bytes of which immediately replace the key, and output bytes are wiped
+ * from the buffer as they are handed out. Earlier output can't be
+ * recovered from the state. The key is mixed with fresh kernel entropy
+ * every RANDOM_RESEED_BYTES and after a fork.
+ */
+struct RandomState
+{
+	uint32_t key[RANDOM_KEY_LENGTH / 4];
+	unsigned char buffer[RANDOM_BUFFER_LENGTH];
+	size_t available;
+	size_t since_reseed;
+	unsigned int generation;
+	int seeded;
+};
+
+static _Thread_local struct RandomState state;
+
+// Bumped in the child after fork() so no thread keeps its parent's stream
+static volatile unsigned int fork_generation = 1;
+static pthread_once_t atfork_once = PTHREAD_ONCE_INIT;
+
+static void random_atfork_child(void)
+{
+	fork_generation++;
+}
+
+static void random_atfork_init(void)
+{
+	pthread_atfork(NULL, NULL, random_atfork_child);
+}
+
+static void random_wipe(void *p, size_t len)
+{
+	volatile unsigned char *v = p;
+
+	while (len--)
+	{
+		*v++ = 0;
+	}
+}
+
+static void chacha20_block(unsigned char *output, const uint32_t *key, uint32_t counter)
+{
+	int i;
+	uint32_t in[16], x[16];
+
+	// "expand 32-byte k", key, block counter, zero nonce
+	in[0] = 0x61707865;
+	in[1] = 0x3320646e;
+	in[2] = 0x79622d32;
+	in[3] = 0x6b206574;
+	for (i = 0; i < 8; ++i)
+	{
+		in[4 + i] = key[i];
+	}
+	in[12] = counter;
+	in[13] = 0;
+	in[14] = 0;
+	in[15] = 0;
+
+	memcpy(x, in, sizeof(x));
+
+	for (i = 0; i < 10; ++i)
+	{
+		QUARTERROUND(x[0], x[4], x[8],  x[12]);
+		QUARTERROUND(x[1], x[5], x[9],  x[13]);
+		QUARTERROUND(x[2], x[6], x[10], x[14]);
+		QUARTERROUND(x[3], x[7], x[11], x[15]);
+		QUARTERROUND(x[0], x[5], x[10], x[15]);
+		QUARTERROUND(x[1], x[6], x[11], x[12]);
+		QUARTERROUND(x[2], x[7], x[8],  x[13]);
+		QUARTERROUND(x[3], x[4], x[9],  x[14]);
+	}
+
+	for (i = 0; i < 16; ++i)
+	{
+		x[i] += in[i];
+		output[i * 4 + 0] = x[i] & 0xFF;
+		output[i * 4 + 1] = (x[i] >> 8) & 0xFF;
+		output[i * 4 + 2] = (x[i] >> 16) & 0xFF;
+		output[i * 4 + 3] = (x[i] >> 24) & 0xFF;
+	}
+
+	random_wipe(x, sizeof(x));
+	random_wipe(in, sizeof(in));
+}
+
+static void random_refill(void)
+{
+	int i;
+
+	for (i = 0; i < RANDOM_BLOCKS; ++i)
+	{
+		chacha20_block(state.buffer + (i * RANDOM_BLOCK_LENGTH), state.key, i);
+	}
+
+	// Fast key erasure
+	memcpy(state.key, state.buffer, RANDOM_KEY_LENGTH);
+	random_wipe(state.buffer, RANDOM_KEY_LENGTH);
+	state.available = RANDOM_BUFFER_LENGTH - RANDOM_KEY_LENGTH;
+}
+
+int random_get_entropy(unsigned char *output, size_t bytes)
+{
+	int fd;
+	ssize_t r;
+	size_t i = 0;
+
+	assert(output);
+
+	while (i < bytes)
+	{
+		r = getrandom(output + i, bytes - i, 0);
+		if (r < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+			break;
+		}
+		i += r;
+	}
+
+	// Kernels without getrandom(2)
+	if (i < bytes)
+	{
+		fd = open(RANDOM_SOURCE, O_RDONLY);
+		if (fd < 0)
+		{
+			error_log("Unable to open source file %s. Errno %i.", RANDOM_SOURCE, errno);
+			return -1;
+		}
+		while (i < bytes)
+		{
+			r = read(fd, output + i, bytes - i);
+			if (r < 0 && errno == EINTR)
+			{
+				continue;
+			}
+			if (r <= 0)
+			{
+				error_log("Could not read from source file %s.", RANDOM_SOURCE);
+				close(fd);
+				return -1;
+			}
+			i += r;
+		}
+		close(fd);
+	}
+
+	return 1;
+}
+
+int random_reseed(void)
+{
+	int i, r;
+	uint32_t seed[RANDOM_KEY_LENGTH / 4];
+
+	pthread_once(&atfork_once, random_atfork_init);
+
+	r = random_get_entropy((unsigned char *)seed, sizeof(seed));
+	if (r < 0)
+	{
+		error_log("Could not seed random number generator.");
+		return -1;
+	}
+
+	// XOR keeps whatever entropy the old key still holds
+	for (i = 0; i < RANDOM_KEY_LENGTH / 4; ++i)
+	{
+		state.key[i] ^= seed[i];
+	}
+	random_wipe(seed, sizeof(seed));
+
+	random_wipe(state.buffer, sizeof(state.buffer));
+	state.available = 0;
+	state.since_reseed = 0;
+	state.generation = fork_generation;
+	state.seeded = 1;
+
+	return 1;
+}
 
 int random_get(unsigned char *output, size_t bytes)
 {
-	size_t i;
-	int c;
-	FILE *source;
+	int r;
+	size_t n;
+	unsigned char *p;
 
 	assert(output);
 	assert(bytes);
 
-	source = fopen(RANDOM_SOURCE, "r");
-	if (source == NULL)
+	if (!state.seeded || state.generation != fork_generation || state.since_reseed >= RANDOM_RESEED_BYTES)
 	{
-		error_log("Unable to open source file %s. Errno %i.", RANDOM_SOURCE, errno);
-		return -1;
+		r = random_reseed();
+		if (r < 0)
+		{
+			error_log("Could not reseed random number generator.");
+			return -1;
+		}
+	}
+
+	while (bytes > 0)
+	{
+		if (state.available == 0)
+		{
+			random_refill();
+		}
+
+		n = bytes < state.available ? bytes : state.available;
+		p = state.buffer + RANDOM_BUFFER_LENGTH - state.available;
+
+		memcpy(output, p, n);
+		random_wipe(p, n);
+
+		output += n;
+		bytes -= n;
+		state.available -= n;
+		state.since_reseed += n;
+	}
+
+	return 1;
+}
+
+/*
+ * Deterministic ChaCha20 keystream of a 32 byte key, starting at byte
+ * *position, which is advanced past the output. Not random at all: the
+ * same key always gives the same bytes. For reproducible test and
+ * benchmark runs only, never for keys that guard funds.
+ */
+int random_get_seeded(unsigned char *output, size_t bytes, const unsigned char *key, uint64_t *position)
+{
+	int i;
+	size_t n, offset;
+	uint32_t k[RANDOM_KEY_LENGTH / 4];
+	unsigned char block[RANDOM_BLOCK_LENGTH];
+
+	assert(output);
+	assert(key);
+	assert(position);
+
+	for (i = 0; i < RANDOM_KEY_LENGTH / 4; ++i)
+	{
+		k[i] = (uint32_t)key[i * 4] | ((uint32_t)key[i * 4 + 1] << 8) |
+		       ((uint32_t)key[i * 4 + 2] << 16) | ((uint32_t)key[i * 4 + 3] << 24);
 	}
 
-	for (i = 0; i < bytes; ++i)
+	while (bytes > 0)
 	{
-		c = fgetc(source);
-		if (c == EOF)
+		if (*position / RANDOM_BLOCK_LENGTH > UINT32_MAX)
 		{
-			error_log("Could not read character from source file %s.", RANDOM_SOURCE);
+			error_log("Seeded random stream is used up.");
 			return -1;
 		}
 
-		output[i] = c;
+		chacha20_block(block, k, (uint32_t)(*position / RANDOM_BLOCK_LENGTH));
+		offset = *position % RANDOM_BLOCK_LENGTH;
+		n = RANDOM_BLOCK_LENGTH - offset < bytes ? RANDOM_BLOCK_LENGTH - offset : bytes;
+		memcpy(output, block + offset, n);
+
+		output += n;
+		bytes -= n;
+		*position += n;
 	}
 
-	fclose(source);
+	random_wipe(k, sizeof(k));
+	random_wipe(block, sizeof(block));
 
 	return 1;
 }
@@ -8,6 +8,12 @@
 #ifndef RANDOM_H
 #define RANDOM_H 1
 
+#include <stddef.h>
+#include <stdint.h>
+
 int random_get(unsigned char *, size_t);
+int random_get_entropy(unsigned char *, size_t);
+int random_reseed(void);
+int random_get_seeded(unsigned char *, size_t, const unsigned char *, uint64_t *);
 
 #endif
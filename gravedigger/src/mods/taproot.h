@@ -0,0 +1,64 @@
+/*
+ * Copyright (c) 2023 Brian Barto
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GPL License. See LICENSE for more details.
+ */
+
+#ifndef TAPROOT_H
+#define TAPROOT_H
+
+#include <stddef.h>
+
+#define TAPROOT_KEY_LEN    32  // x-only output key, the witness program
+#define TAPROOT_PUBKEY_LEN 33  // Compressed internal key
+
+typedef struct TaprootBatch TaprootBatch;
+
+/**
+ * Get the output key of a key path only taproot output (BIP341 with no
+ * script tree, as BIP86 uses): Q = P + H_TapTweak(x(P))G, where P is the
+ * internal key lifted to even y. This is the reference path, one full
+ * scalar multiplication per key.
+ *
+ * @param output TAPROOT_KEY_LEN bytes, set to x(Q)
+ * @param pubkey TAPROOT_PUBKEY_LEN byte compressed internal key
+ * @return 0 on success, -1 on error
+ */
+int taproot_output_key(unsigned char *output, const unsigned char *pubkey);
+
+/**
+ * Allocate the working space of batched output keys. The first batch
+ * also builds the shared fixed-base table.
+ *
+ * @param count Most keys per call
+ * @return New batch or NULL on error
+ */
+TaprootBatch *taproot_batch_new(size_t count);
+
+/**
+ * Get the output keys of many internal keys at once. Q is (d' + t)G,
+ * with d' the secret key of the even-y internal key and t its tweak.
+ * That product comes from a table of 256 multiples of G for each of
+ * the 32 bytes of the scalar, so a key costs 31 point additions, and
+ * each addition shares one field inversion with the whole batch.
+ *
+ * @param batch Working space
+ * @param outputs count * TAPROOT_KEY_LEN bytes
+ * @param scalars count * 32 byte big endian secret keys
+ * @param pubkeys count * TAPROOT_PUBKEY_LEN byte compressed public keys
+ *        of those secret keys
+ * @param count Number of keys, at most the batch size
+ * @return 0 on success, -1 on error
+ */
+int taproot_batch_output_keys(TaprootBatch *batch, unsigned char *outputs, const unsigned char *scalars,
+                              const unsigned char *pubkeys, size_t count);
+
+/**
+ * Free batch working space
+ *
+ * @param batch Batch, may be NULL
+ */
+void taproot_batch_free(TaprootBatch *batch);
+
+#endif // TAPROOT_H
@@ -0,0 +1,234 @@
+/*
+ * Copyright (c) 2023 Brian Barto
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GPL License. See LICENSE for more details.
+ */
+
+#define _GNU_SOURCE  // For sched_getaffinity and CPU_SET
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <sched.h>
+#include "topology.h"
+#include "error.h"
+
+#define TOPOLOGY_SYSFS_CPU  "/sys/devices/system/cpu"
+#define TOPOLOGY_SYSFS_NODE "/sys/devices/system/node"
+
+// Read one line of a sysfs file, returns -1 if it can't be read
+static int read_line(const char *path, char *buf, size_t size) {
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        return -1;
+    }
+    if (!fgets(buf, (int)size, f)) {
+        fclose(f);
+        return -1;
+    }
+    fclose(f);
+    return 0;
+}
+
+static int read_int(const char *path, int fallback) {
+    char buf[32];
+    if (read_line(path, buf, sizeof(buf)) < 0) {
+        return fallback;
+    }
+    return atoi(buf);
+}
+
+// Parse a kernel CPU list such as "0-3,8,10-11" into flags
+static int parse_cpulist(const char *list, unsigned char *cpus) {
+    const char *p = list;
+
+    while (*p && *p != '\n') {
+        char *end;
+        long first = strtol(p, &end, 10);
+        long last = first;
+
+        if (end == p) {
+            return -1;
+        }
+        p = end;
+        if (*p == '-') {
+            last = strtol(p + 1, &end, 10);
+            if (end == p + 1) {
+                return -1;
+            }
+            p = end;
+        }
+        if (first < 0 || last < first || last >= TOPOLOGY_MAX_CPUS) {
+            return -1;
+        }
+        for (long c = first; c <= last; c++) {
+            cpus[c] = 1;
+        }
+        if (*p == ',') {
+            p++;
+        }
+    }
+    return 0;
+}
+
+// Node of every CPU from the node directories; CPUs outside all stay 0
+static void read_nodes(int *node_of) {
+    char path[300], buf[4096];
+    unsigned char cpus[TOPOLOGY_MAX_CPUS];
+    struct dirent *entry;
+    DIR *dir = opendir(TOPOLOGY_SYSFS_NODE);
+    int node;
+
+    if (!dir) {
+        return;
+    }
+    while ((entry = readdir(dir)) != NULL) {
+        if (sscanf(entry->d_name, "node%d", &node) != 1) {
+            continue;
+        }
+        snprintf(path, sizeof(path), TOPOLOGY_SYSFS_NODE "/%s/cpulist", entry->d_name);
+        memset(cpus, 0, sizeof(cpus));
+        if (read_line(path, buf, sizeof(buf)) < 0 || parse_cpulist(buf, cpus) < 0) {
+            continue;
+        }
+        for (int c = 0; c < TOPOLOGY_MAX_CPUS; c++) {
+            if (cpus[c]) {
+                node_of[c] = node;
+            }
+        }
+    }
+    closedir(dir);
+}
+
+static int compare_cpus(const void *a, const void *b) {
+    const TopologyCpu *x = a, *y = b;
+
+    if (x->sibling != y->sibling) return x->sibling - y->sibling;
+    if (x->node != y->node) return x->node - y->node;
+    if (x->package != y->package) return x->package - y->package;
+    if (x->core != y->core) return x->core - y->core;
+    return x->cpu - y->cpu;
+}
+
+int topology_detect(Topology *topo) {
+    int node_of[TOPOLOGY_MAX_CPUS];
+    unsigned char online[TOPOLOGY_MAX_CPUS] = {0};
+    char path[128], buf[4096];
+    cpu_set_t mask;
+
+    if (!topo) {
+        error_log("Invalid topology parameters");
+        return -1;
+    }
+    memset(topo, 0, sizeof(*topo));
+
+    if (sched_getaffinity(0, sizeof(mask), &mask) < 0) {
+        error_log("Could not read CPU affinity");
+        return -1;
+    }
+
+    // Without sysfs, every CPU we may run on is assumed online
+    if (read_line(TOPOLOGY_SYSFS_CPU "/online", buf, sizeof(buf)) < 0 || parse_cpulist(buf, online) < 0) {
+        memset(online, 1, sizeof(online));
+    }
+
+    topo->cpus = calloc(TOPOLOGY_MAX_CPUS, sizeof(TopologyCpu));
+    if (!topo->cpus) {
+        error_log("Memory allocation error.");
+        return -1;
+    }
+
+    memset(node_of, 0, sizeof(node_of));
+    read_nodes(node_of);
+
+    for (int c = 0; c < TOPOLOGY_MAX_CPUS && c < CPU_SETSIZE; c++) {
+        if (!online[c] || !CPU_ISSET(c, &mask)) {
+            continue;
+        }
+        TopologyCpu *cpu = &topo->cpus[topo->count++];
+        cpu->cpu = c;
+        snprintf(path, sizeof(path), TOPOLOGY_SYSFS_CPU "/cpu%d/topology/core_id", c);
+        cpu->core = read_int(path, c);
+        snprintf(path, sizeof(path), TOPOLOGY_SYSFS_CPU "/cpu%d/topology/physical_package_id", c);
+        cpu->package = read_int(path, 0);
+        cpu->node = node_of[c];
+    }
+
+    if (topo->count == 0) {
+        error_log("No usable CPUs found");
+        topology_free(topo);
+        return -1;
+    }
+
+    // Hardware threads of one core share package and core id; number
+    // them in CPU order. CPUs are already in CPU order here.
+    for (int i = 0; i < topo->count; i++) {
+        for (int j = 0; j < i; j++) {
+            if (topo->cpus[j].package == topo->cpus[i].package &&
+                topo->cpus[j].core == topo->cpus[i].core) {
+                topo->cpus[i].sibling++;
+            }
+        }
+        if (topo->cpus[i].sibling == 0) {
+            topo->cores++;
+        }
+    }
+
+    qsort(topo->cpus, topo->count, sizeof(TopologyCpu), compare_cpus);
+
+    // Count distinct packages and nodes
+    for (int i = 0; i < topo->count; i++) {
+        bool new_package = true, new_node = true;
+        for (int j = 0; j < i; j++) {
+            if (topo->cpus[j].package == topo->cpus[i].package) new_package = false;
+            if (topo->cpus[j].node == topo->cpus[i].node) new_node = false;
+        }
+        topo->packages += new_package;
+        topo->nodes += new_node;
+    }
+
+    return 0;
+}
+
+int topology_place(const Topology *topo, int *placed, int count, bool skip_smt) {
+    int usable;
+
+    if (!topo || !topo->cpus || !placed || count < 1) {
+        error_log("Invalid placement parameters");
+        return -1;
+    }
+
+    // Sorting put every core's first hardware thread ahead of all siblings
+    usable = skip_smt ? topo->cores : topo->count;
+    for (int i = 0; i < count; i++) {
+        placed[i] = i % usable;
+    }
+
+    return count < usable ? count : usable;
+}
+
+int topology_pin(int cpu) {
+    cpu_set_t mask;
+
+    if (cpu < 0 || cpu >= CPU_SETSIZE) {
+        error_log("Invalid CPU %d", cpu);
+        return -1;
+    }
+
+    CPU_ZERO(&mask);
+    CPU_SET(cpu, &mask);
+    if (sched_setaffinity(0, sizeof(mask), &mask) < 0) {
+        error_log("Could not pin thread to CPU %d", cpu);
+        return -1;
+    }
+
+    return 0;
+}
+
+void topology_free(Topology *topo) {
+    if (!topo) return;
+
+    free(topo->cpus);
+    memset(topo, 0, sizeof(*topo));
+}
@@ -0,0 +1,72 @@
+/*
+ * Copyright (c) 2023 Brian Barto
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GPL License. See LICENSE for more details.
+ */
+
+#ifndef TOPOLOGY_H
+#define TOPOLOGY_H
+
+#include <stdbool.h>
+
+#define TOPOLOGY_MAX_CPUS 1024  // Highest logical CPU number + 1
+
+// One logical CPU the process may run on
+typedef struct {
+    int cpu;        // Logical CPU number
+    int core;       // Core id within its package
+    int package;    // Physical package (socket)
+    int node;       // NUMA node
+    int sibling;    // 0 for the first hardware thread of a core, 1.. for SMT siblings
+} TopologyCpu;
+
+typedef struct {
+    TopologyCpu *cpus;  // Sorted by sibling, node, package, core
+    int count;          // Usable logical CPUs
+    int cores;          // Physical cores among them
+    int packages;
+    int nodes;
+} Topology;
+
+/**
+ * Read the CPU topology from sysfs, limited to the CPUs in the calling
+ * thread's affinity mask. Without sysfs every CPU counts as its own
+ * core on node 0.
+ *
+ * @param topo Filled with the topology, release with topology_free()
+ * @return 0 on success, -1 on error
+ */
+int topology_detect(Topology *topo);
+
+/**
+ * Choose a CPU for each of count workers. Physical cores are used
+ * before SMT siblings, and a node's cores before the next node's. With
+ * skip_smt only the first hardware thread of each core is used. When
+ * there are more workers than CPUs, CPUs are handed out again from the
+ * start.
+ *
+ * @param topo Detected topology
+ * @param placed Filled with count indexes into topo->cpus
+ * @param count Number of workers
+ * @param skip_smt Whether to leave SMT siblings unused
+ * @return Number of distinct CPUs used, or -1 on error
+ */
+int topology_place(const Topology *topo, int *placed, int count, bool skip_smt);
+
+/**
+ * Pin the calling thread to one logical CPU
+ *
+ * @param cpu Logical CPU number
+ * @return 0 on success, -1 on error
+ */
+int topology_pin(int cpu);
+
+/**
+ * Release a topology
+ *
+ * @param topo Topology to release
+ */
+void topology_free(Topology *topo);
+
+#endif // TOPOLOGY_H
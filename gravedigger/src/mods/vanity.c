@@ -1,6 +1,6 @@
 /*
  * Copyright (c) 2023 Brian Barto
- * 
+ *
  * This program is free software; you can redistribute it and/or modify it
  * under the terms of the GPL License. See LICENSE for more details.
  */
@@ -8,333 +8,2164 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <math.h>
 #include <time.h>
-#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sched.h>
 #include <pthread.h>
-#include <sys/time.h>
+#include <sys/utsname.h>
+#ifdef __linux__
+#include <sys/eventfd.h>
+#endif
 #include "vanity.h"
-#include "random.h"
+#include "keybatch.h"
 #include "privkey.h"
 #include "pubkey.h"
 #include "address.h"
+#include "bech32.h"
+#include "taproot.h"
+#include "bip32.h"
+#include "network.h"
 #include "pattern.h"
+#include "patternset.h"
+#include "topology.h"
+#include "crypto.h"
+#include "serialize.h"
 #include "error.h"
 
-#define VANITY_MAX_PATTERN 16
-#define VANITY_MAX_THREADS 64
-#define VANITY_BATCH_SIZE 16
+#define VANITY_MAX_PATTERN 42
+#define VANITY_CACHE_LINE  64
+#define VANITY_DEFAULT_PROGRESS_MS 1000
+#define VANITY_DEFAULT_CHECKPOINT_MS 60000
+#define VANITY_QUEUE_SIZE  1024   // Results in flight, power of two
+#define VANITY_TUNE_WARMUP 4      // Discard the first 1/n of every trial
+#define VANITY_RANGE_CHUNK 64     // Batches a thread claims at once in a range
+#define VANITY_MATCH_CHUNK 256    // Candidates per pattern_match_batch() bitmap
+
+// Checkpoint file: magic, version, pattern hash, elapsed ms, thread
+// count, then attempts and last searched scalar for every thread, all
+// big endian and followed by a 4 byte double SHA256 checksum.
+#define CHECKPOINT_MAGIC         0x42544B56  // "BTKV"
+#define CHECKPOINT_VERSION       1
+#define CHECKPOINT_HEADER_LEN    (4 + 1 + 32 + 8 + 2)
+#define CHECKPOINT_THREAD_LEN    (8 + KEYBATCH_SCALAR_LEN)
+#define CHECKPOINT_CHECKSUM_LEN  4
+#define CHECKPOINT_MAX_LEN       (CHECKPOINT_HEADER_LEN + VANITY_MAX_THREADS * CHECKPOINT_THREAD_LEN + CHECKPOINT_CHECKSUM_LEN)
 
 // Forward declaration
 typedef struct ThreadContext ThreadContext;
 
+/*
+ * One writer per counter; padding keeps every counter on its own cache
+ * line. The walk position rides along so a checkpoint always pairs a
+ * thread's attempts with the exact scalar it had reached. seq is odd
+ * while the worker is updating the line.
+ */
+typedef struct {
+    _Alignas(VANITY_CACHE_LINE) volatile uint64_t attempts;
+    volatile uint32_t seq;
+    unsigned char position[KEYBATCH_SCALAR_LEN]; // Last scalar searched
+    char pad[VANITY_CACHE_LINE - sizeof(uint64_t) - sizeof(uint32_t) - KEYBATCH_SCALAR_LEN];
+} ThreadCounter;
+
+/*
+ * Bounded multi-producer queue of continuous mode results. Every slot
+ * carries a sequence number telling producers and the consumer whose
+ * turn it is, so neither side ever takes a lock (Vyukov's bounded
+ * queue). Head and tail are padded onto separate cache lines, since
+ * the search struct itself is only malloc aligned.
+ */
+typedef struct {
+    volatile size_t seq;
+    VanityResult result;
+} ResultSlot;
+
+typedef struct {
+    ResultSlot *slots;
+    size_t mask;
+    char pad0[VANITY_CACHE_LINE];
+    size_t head;                      // Next slot to fill
+    char pad1[VANITY_CACHE_LINE - sizeof(size_t)];
+    size_t tail;                      // Next slot to drain
+    char pad2[VANITY_CACHE_LINE - sizeof(size_t)];
+} ResultQueue;
+
 struct ThreadContext {
     struct VanitySearch *search;
     int thread_id;
-    bool running;
+    KeyBatch *batch;
+    ThreadCounter *counter;
+    int cpu;                   // CPU the worker is pinned to, -1 for none
+    int node;                  // NUMA node of that CPU
     pthread_t thread;
 };
 
 struct VanitySearch {
-    struct Pattern pattern;           // Compiled pattern
+    char pattern_str[VANITY_MAX_PATTERN + 1]; // Pattern as given
+    struct Pattern *pattern;    // Compiled pattern (P2PKH)
+    char *pattern_file;        // Pattern set to load instead of pattern_str
+    char **added;              // Patterns for the set from vanity_add_pattern()
+    size_t added_count;
+    PatternSet *set;           // Compiled pattern set
+    bool compiled;             // Pattern or set compiled
+    double probability;        // Estimated match chance per candidate, 0 if unknown
     bool case_sensitive;        // Case sensitivity flag
+    bool confusable;           // Pattern characters also match look-alikes
+    vanity_addr_t address_type; // Address type searched
+    bool uncompressed;         // Also test every key's uncompressed address
+    bool seeded;               // Workers walk from deterministic bases, see vanity_set_seed()
+    unsigned char seed[32];    // SHA-256 of the seed text
+    bool has_xpub;             // Candidates are child indices, see vanity_set_xpub()
+    Bip32Xpub xpub;
     int num_threads;           // Number of threads to use
+    int started_threads;       // Threads that need joining
+    int ready_threads;         // Workers done setting up, successfully or not
+    bool setup_failed;         // A worker could not set up
+    pthread_cond_t ready_cond; // Signalled as workers finish setting up
+    // Placement
+    bool pin;                  // Pin every worker to its own CPU
+    bool skip_smt;             // Leave SMT siblings unused
+    Topology topology;         // Detected when pinning
+    size_t batch_size;         // Candidates per batch
+    // Native segwit prefixes compile to a bit mask over the witness
+    // program (HASH160, or the taproot output key), so only hits ever
+    // pay for bech32 encoding and checksumming.
+    unsigned char hash_mask[KEYBATCH_OUTPUT_LEN];
+    unsigned char hash_value[KEYBATCH_OUTPUT_LEN];
+    size_t hash_bytes;
+    // Pipeline
+    keybatch_kernel kernels[KEYBATCH_STAGES];
+    bool kernel_set[KEYBATCH_STAGES];
+    // Continuous mode
+    bool continuous;           // Queue every match instead of stopping
+    uint64_t max_results;      // Stop after this many results, 0 for no limit
+    uint64_t max_ms;           // Stop after this many milliseconds, 0 for no limit
+    volatile uint64_t result_count; // Results claimed by workers
+    ResultQueue queue;
+    bool discard_hits;         // Calibration runs count candidates only
+    // Keyspace range, threads claim chunks of it in order
+    unsigned char range_base[KEYBATCH_SCALAR_LEN];
+    uint64_t range_length;     // Candidates in the range, 0 for random search
+    volatile uint64_t range_cursor; // Offset of the next unclaimed chunk
+    volatile int range_finished;    // Threads that found the range used up
+    volatile bool exhausted;   // Every candidate in the range was tried, or a key of it revealed
+    volatile bool range_revealed;   // A key of the range was queued
     volatile bool found;       // Whether a match was found
     volatile bool stopped;     // Whether search was stopped
-    volatile uint64_t attempts; // Total attempts made
+    ThreadCounter *counters;   // Per-thread attempt counters
     struct timespec start_time; // Search start time
+    uint64_t elapsed_offset;   // Milliseconds carried over from a checkpoint
     pthread_mutex_t mutex;     // Thread synchronization
-    PrivKey found_privkey;    // Found private key
-    PubKey found_pubkey;      // Found public key
-    char found_address[35];   // Found address
+    unsigned char found_scalar[PRIVKEY_LENGTH]; // Found private key
+    bool found_compressed;                      // Whether the match used the compressed public key
+    char found_address[KEYBATCH_ADDR_LEN];      // Found address
+    int found_pattern;                          // Id of the pattern it matched
+    uint32_t found_index;                       // Child index, xpub only
     // Progress tracking
     vanity_progress_cb progress_callback;
     void *progress_user_data;
     int progress_interval_ms;
-    struct timeval last_progress;
+    // Monitor thread aggregating the counters
+    pthread_t monitor;
+    bool monitor_started;
+    pthread_cond_t monitor_cond;
+    // Consumer wakeups, see vanity_wait()
+    pthread_cond_t event_cond; // Signalled on every event
+    uint64_t events;           // Matches and state changes so far
+    uint64_t events_seen;      // Events vanity_wait() already returned for
+    int event_fd[2];           // Readable while events are unseen: one eventfd, or a pipe
+    // Pausing
+    volatile bool paused;      // Workers wait between batches
+    pthread_cond_t pause_cond; // Signalled when the pause ends or the search stops
+    volatile uint64_t pause_started; // Monotonic ms the current pause began
+    volatile uint64_t paused_ms;     // Time spent in earlier pauses
+    // Checkpointing
+    char *checkpoint_path;
+    int checkpoint_interval_ms;
+    bool resumed;
     // Thread contexts
     ThreadContext contexts[VANITY_MAX_THREADS];
 };
 
-// Thread-local key pool
-struct KeyPool {
-    PrivKey privkeys[VANITY_BATCH_SIZE];
-    PubKey pubkeys[VANITY_BATCH_SIZE];
-    char addresses[VANITY_BATCH_SIZE][35];
-    bool initialized;
-};
+static uint64_t monotonic_ms(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+/*
+ * Record an event and wake everything waiting on the search: the
+ * monitor, paused workers, vanity_wait() and pollers of the event
+ * descriptor. Called with the mutex held.
+ */
+static void wake_locked(VanitySearch *search) {
+    static const uint64_t one = 1;
+    ssize_t r;
+
+    search->events++;
+    pthread_cond_broadcast(&search->monitor_cond);
+    pthread_cond_broadcast(&search->pause_cond);
+    pthread_cond_broadcast(&search->event_cond);
 
-static void init_key_pool(struct KeyPool *pool) {
-    if (pool->initialized) return;
-    
-    for (int i = 0; i < VANITY_BATCH_SIZE; i++) {
-        if (privkey_new(&pool->privkeys[i]) < 0 ||
-            pubkey_new(&pool->pubkeys[i]) < 0) {
-            error_log("Failed to initialize key pool");
-            return;
+    // Full means it is readable already; the count itself doesn't matter
+    do {
+        r = write(search->event_fd[1], &one, sizeof(one));
+    } while (r < 0 && errno == EINTR);
+}
+
+static void wake(VanitySearch *search) {
+    pthread_mutex_lock(&search->mutex);
+    wake_locked(search);
+    pthread_mutex_unlock(&search->mutex);
+}
+
+// Stop the workers from wherever the search ends: a limit, an error or the caller
+static void halt(VanitySearch *search) {
+    pthread_mutex_lock(&search->mutex);
+    search->stopped = true;
+    wake_locked(search);
+    pthread_mutex_unlock(&search->mutex);
+}
+
+static void event_drain(VanitySearch *search) {
+    uint64_t buf[16];
+
+    while (read(search->event_fd[0], buf, sizeof(buf)) > 0) {
+    }
+}
+
+// Prefix test of every encoded address against the compiled pattern,
+// a bitmap chunk at a time
+static int match_p2pkh(KeyBatch *batch, const void *arg) {
+    const VanitySearch *search = arg;
+    uint64_t bitmap[VANITY_MATCH_CHUNK / 64];
+
+    for (size_t first = 0; first < batch->candidates; first += VANITY_MATCH_CHUNK) {
+        size_t count = batch->candidates - first < VANITY_MATCH_CHUNK ? batch->candidates - first : VANITY_MATCH_CHUNK;
+        if (!pattern_match_batch(search->pattern, batch->addresses + first * KEYBATCH_ADDR_LEN,
+                                 KEYBATCH_ADDR_LEN, count, bitmap)) {
+            continue;
+        }
+        for (size_t w = 0; w < (count + 63) / 64; w++) {
+            for (uint64_t bits = bitmap[w]; bits; bits &= bits - 1) {
+                batch->hits[batch->hit_count++] = first + w * 64 + __builtin_ctzll(bits);
+            }
         }
     }
-    pool->initialized = true;
+
+    return 0;
 }
 
-static void cleanup_key_pool(struct KeyPool *pool) {
-    if (!pool->initialized) return;
-    
-    for (int i = 0; i < VANITY_BATCH_SIZE; i++) {
-        privkey_free(pool->privkeys[i]);
-        pubkey_free(pool->pubkeys[i]);
+// Masked compare of every witness program against the compiled bech32 prefix
+static void match_programs(const VanitySearch *search, KeyBatch *batch, const unsigned char *program,
+                           size_t stride, size_t count) {
+    for (size_t i = 0; i < count; i++, program += stride) {
+        size_t j = 0;
+        while (j < search->hash_bytes && (program[j] & search->hash_mask[j]) == search->hash_value[j]) {
+            j++;
+        }
+        if (j == search->hash_bytes) {
+            batch->hits[batch->hit_count++] = i;
+        }
     }
-    pool->initialized = false;
 }
 
-static void *search_thread(void *arg) {
-    ThreadContext *ctx = (ThreadContext *)arg;
-    VanitySearch *search = ctx->search;
-    struct timeval now;
-    struct KeyPool pool = {0};
-    unsigned char key_data[32 * VANITY_BATCH_SIZE];
-    
-    ctx->running = true;
-    printf("Thread %d started\n", ctx->thread_id);
-    
-    // Initialize key pool
-    init_key_pool(&pool);
-    if (!pool.initialized) {
-        printf("Thread %d failed to initialize key pool\n", ctx->thread_id);
-        goto cleanup;
-    }
-    
-    printf("Thread %d initialized key pool\n", ctx->thread_id);
-    
-    while (!search->found && !search->stopped) {
-        // Generate batch of random private keys
-        if (random_get(key_data, sizeof(key_data)) != 0) {
-            printf("Thread %d failed to generate random keys\n", ctx->thread_id);
-            goto cleanup;
-        }
-        
-        // Process batch
-        for (int i = 0; i < VANITY_BATCH_SIZE && !search->found && !search->stopped; i++) {
-            // Import private key
-            if (privkey_import(pool.privkeys[i], key_data + (i * 32), 32) != 0) {
-                printf("Thread %d failed to import private key\n", ctx->thread_id);
-                continue;
+static int match_p2wpkh(KeyBatch *batch, const void *arg) {
+    match_programs(arg, batch, batch->hashes, KEYBATCH_HASH_LEN, batch->candidates);
+    return 0;
+}
+
+static int match_p2tr(KeyBatch *batch, const void *arg) {
+    match_programs(arg, batch, batch->outputs, KEYBATCH_OUTPUT_LEN, batch->count);
+    return 0;
+}
+
+static int encode_hit(const VanitySearch *search, KeyBatch *batch, uint32_t i, char *address) {
+    switch (search->address_type) {
+        case VANITY_ADDR_P2TR:
+            return address_p2wpkh_from_raw(address, batch->outputs + i * KEYBATCH_OUTPUT_LEN,
+                                           KEYBATCH_OUTPUT_LEN, 1) < 0 ? -1 : 0;
+        case VANITY_ADDR_P2WPKH:
+            return address_p2wpkh_from_raw(address, batch->hashes + i * KEYBATCH_HASH_LEN,
+                                           KEYBATCH_HASH_LEN, 0) < 0 ? -1 : 0;
+        case VANITY_ADDR_P2SH_P2WPKH:
+            if (search->kernels[KEYBATCH_STAGE_ENCODE]) {
+                strcpy(address, batch->addresses + i * KEYBATCH_ADDR_LEN);
+                return 0;
             }
-            pool.privkeys[i]->cflag = PRIVKEY_COMPRESSED_FLAG;
-            
-            // Get public key
-            if (pubkey_get(pool.pubkeys[i], pool.privkeys[i]) != 0) {
-                printf("Thread %d failed to get public key\n", ctx->thread_id);
-                continue;
+            return address_from_p2sh_script(address, batch->hashes + i * KEYBATCH_HASH_LEN) < 0 ? -1 : 0;
+        case VANITY_ADDR_P2PKH:
+        default:
+            if (search->kernels[KEYBATCH_STAGE_ENCODE]) {
+                strcpy(address, batch->addresses + i * KEYBATCH_ADDR_LEN);
+                return 0;
             }
-            
-            // Get address
-            if (address_get_p2pkh(pool.addresses[i], pool.pubkeys[i]) != 0) {
-                printf("Thread %d failed to get address\n", ctx->thread_id);
+            return address_from_rmd160(address, batch->hashes + i * KEYBATCH_HASH_LEN) < 0 ? -1 : 0;
+    }
+}
+
+static int encode_p2wpkh(KeyBatch *batch, const void *arg) {
+    (void)arg;
+
+    for (size_t i = 0; i < batch->candidates; i++) {
+        if (address_p2wpkh_from_raw(batch->addresses + i * KEYBATCH_ADDR_LEN,
+                                    batch->hashes + i * KEYBATCH_HASH_LEN, KEYBATCH_HASH_LEN, 0) < 0) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/*
+ * Test every candidate against the whole pattern set. Prefix-only sets
+ * never encode a miss: the HASH160 interval table rejects it and only
+ * the few keys that pass get an address to confirm against the trie.
+ */
+static int match_set(KeyBatch *batch, const void *arg) {
+    const VanitySearch *search = arg;
+    char address[KEYBATCH_ADDR_LEN];
+    const char *candidate;
+
+    for (size_t i = 0; i < batch->candidates; i++) {
+        if (search->kernels[KEYBATCH_STAGE_ENCODE]) {
+            candidate = batch->addresses + i * KEYBATCH_ADDR_LEN;
+        } else {
+            const unsigned char *hash = search->address_type == VANITY_ADDR_P2TR
+                                        ? batch->outputs + i * KEYBATCH_OUTPUT_LEN
+                                        : batch->hashes + i * KEYBATCH_HASH_LEN;
+            if (!patternset_match_hash(search->set, hash)) {
                 continue;
             }
-            
-            // Update attempt counter atomically
-            __atomic_add_fetch(&search->attempts, 1, __ATOMIC_SEQ_CST);
-            
-            // Check if address matches pattern
-            if (pattern_match(&search->pattern, pool.addresses[i] + 1)) { // Skip version byte
-                pthread_mutex_lock(&search->mutex);
-                if (!search->found) {
-                    search->found = true;
-                    memcpy(search->found_privkey->data, pool.privkeys[i]->data, PRIVKEY_LENGTH);
-                    search->found_privkey->cflag = pool.privkeys[i]->cflag;
-                    memcpy(search->found_pubkey, pool.pubkeys[i], sizeof(*pool.pubkeys[i]));
-                    strcpy(search->found_address, pool.addresses[i]);
-                }
-                pthread_mutex_unlock(&search->mutex);
-                break;
+            if (encode_hit(search, batch, i, address) < 0) {
+                return -1;
             }
+            candidate = address;
         }
-        
-        // Handle progress callback
-        if (search->progress_callback) {
-            gettimeofday(&now, NULL);
-            long elapsed_ms = (now.tv_sec - search->last_progress.tv_sec) * 1000 + 
-                            (now.tv_usec - search->last_progress.tv_usec) / 1000;
-                            
-            if (elapsed_ms >= search->progress_interval_ms) {
-                pthread_mutex_lock(&search->mutex);
-                uint64_t current_attempts = search->attempts;
-                double rate = current_attempts * 1000.0 / elapsed_ms;
-                search->progress_callback(current_attempts, rate, search->progress_user_data);
-                search->last_progress = now;
-                pthread_mutex_unlock(&search->mutex);
-            }
+        if (patternset_match_address(search->set, candidate) >= 0) {
+            batch->hits[batch->hit_count++] = i;
         }
     }
-    
-cleanup:
-    printf("Thread %d cleaning up\n", ctx->thread_id);
-    cleanup_key_pool(&pool);
-    ctx->running = false;
-    return NULL;
+
+    return 0;
 }
 
-int vanity_init(VanitySearch **search, const char *pattern, bool case_sensitive, int num_threads) {
-    if (!search || !pattern) return -1;
-    
-    // Validate pattern length
-    if (strlen(pattern) > VANITY_MAX_PATTERN) {
-        error_log("Pattern too long (max %d characters)", VANITY_MAX_PATTERN);
-        return -1;
-    }
-    
-    // Validate thread count
-    if (num_threads < 1 || num_threads > VANITY_MAX_THREADS) {
-        error_log("Invalid thread count (must be between 1 and %d)", VANITY_MAX_THREADS);
-        return -1;
+// Default pipeline for the address type and pattern
+static void default_kernels(const VanitySearch *search, keybatch_kernel *kernels) {
+    kernels[KEYBATCH_STAGE_SCALAR] = keybatch_scalar_walk;
+    kernels[KEYBATCH_STAGE_EC] = search->has_xpub ? keybatch_ec_xpub : keybatch_ec_walk;
+    kernels[KEYBATCH_STAGE_HASH] = keybatch_hash160;
+
+    // Nested segwit matches on the hash of the redeem script instead,
+    // taproot on the tweaked output key
+    if (search->address_type == VANITY_ADDR_P2SH_P2WPKH) {
+        kernels[KEYBATCH_STAGE_HASH] = keybatch_hash160_p2sh;
+    } else if (search->address_type == VANITY_ADDR_P2TR) {
+        kernels[KEYBATCH_STAGE_HASH] = keybatch_tweak_p2tr;
     }
-    
-    // Allocate search context
-    VanitySearch *s = calloc(1, sizeof(VanitySearch));
-    if (!s) {
-        error_log("Could not allocate search context");
-        return -1;
+
+    if (search->set) {
+        bool encode = patternset_needs_address(search->set);
+        if (search->address_type == VANITY_ADDR_P2TR) {
+            kernels[KEYBATCH_STAGE_ENCODE] = encode ? keybatch_encode_p2tr : NULL;
+        } else if (search->address_type == VANITY_ADDR_P2WPKH) {
+            kernels[KEYBATCH_STAGE_ENCODE] = encode ? encode_p2wpkh : NULL;
+        } else if (search->address_type == VANITY_ADDR_P2SH_P2WPKH) {
+            kernels[KEYBATCH_STAGE_ENCODE] = encode ? keybatch_encode_p2sh : NULL;
+        } else {
+            kernels[KEYBATCH_STAGE_ENCODE] = encode ? keybatch_encode_p2pkh : NULL;
+        }
+        kernels[KEYBATCH_STAGE_MATCH] = match_set;
+        return;
     }
-    
-    // Initialize pattern
-    struct Pattern *compiled_pattern = pattern_compile(pattern, PATTERN_TYPE_PREFIX, case_sensitive);
-    if (!compiled_pattern) {
-        error_log("Could not compile pattern");
-        free(s);
-        return -1;
+
+    switch (search->address_type) {
+        case VANITY_ADDR_P2WPKH:
+            kernels[KEYBATCH_STAGE_ENCODE] = NULL;
+            kernels[KEYBATCH_STAGE_MATCH] = match_p2wpkh;
+            break;
+        case VANITY_ADDR_P2TR:
+            kernels[KEYBATCH_STAGE_ENCODE] = NULL;
+            kernels[KEYBATCH_STAGE_MATCH] = match_p2tr;
+            break;
+        case VANITY_ADDR_P2SH_P2WPKH:
+            kernels[KEYBATCH_STAGE_ENCODE] = keybatch_encode_p2sh;
+            kernels[KEYBATCH_STAGE_MATCH] = match_p2pkh;
+            break;
+        case VANITY_ADDR_P2PKH:
+        default:
+            kernels[KEYBATCH_STAGE_ENCODE] = keybatch_encode_p2pkh;
+            kernels[KEYBATCH_STAGE_MATCH] = match_p2pkh;
+            break;
     }
-    memcpy(&s->pattern, compiled_pattern, sizeof(struct Pattern));
-    pattern_free(compiled_pattern);
-    
-    // Initialize other fields
-    s->case_sensitive = case_sensitive;
-    s->num_threads = num_threads;
-    s->found = false;
-    s->stopped = false;
-    s->attempts = 0;
-    
-    // Initialize mutex
-    if (pthread_mutex_init(&s->mutex, NULL) != 0) {
-        error_log("Could not initialize mutex");
-        pattern_free(&s->pattern);
-        free(s);
+}
+
+static int queue_init(ResultQueue *queue, size_t size) {
+    queue->slots = calloc(size, sizeof(ResultSlot));
+    if (!queue->slots) {
         return -1;
     }
-    
-    // Initialize private key for storing result
-    if (privkey_new(&s->found_privkey) < 0) {
-        error_log("Failed to initialize result private key");
-        pattern_free(&s->pattern);
-        pthread_mutex_destroy(&s->mutex);
-        free(s);
-        return -1;
+    for (size_t i = 0; i < size; i++) {
+        queue->slots[i].seq = i;
     }
-    
-    *search = s;
+    queue->mask = size - 1;
+    queue->head = 0;
+    queue->tail = 0;
     return 0;
 }
 
-int vanity_start(VanitySearch *search) {
-    if (!search) {
-        error_log("Invalid search context");
-        return -1;
-    }
-    
-    // Record start time
-    clock_gettime(CLOCK_MONOTONIC, &search->start_time);
-    gettimeofday(&search->last_progress, NULL);
-    
-    // Start worker threads
-    for (int i = 0; i < search->num_threads; i++) {
-        search->contexts[i].search = search;
-        search->contexts[i].thread_id = i;
-        search->contexts[i].running = false;
-        
-        if (pthread_create(&search->contexts[i].thread, NULL, search_thread, &search->contexts[i]) != 0) {
-            error_log("Failed to create worker thread");
-            vanity_stop(search);
+// Returns -1 when the queue is full
+static int queue_push(ResultQueue *queue, const VanityResult *result) {
+    size_t pos = __atomic_load_n(&queue->head, __ATOMIC_RELAXED);
+    ResultSlot *slot;
+
+    for (;;) {
+        slot = &queue->slots[pos & queue->mask];
+        intptr_t diff = (intptr_t)__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) - (intptr_t)pos;
+        if (diff == 0) {
+            if (__atomic_compare_exchange_n(&queue->head, &pos, pos + 1, true,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                break;
+            }
+        } else if (diff < 0) {
             return -1;
+        } else {
+            pos = __atomic_load_n(&queue->head, __ATOMIC_RELAXED);
         }
     }
-    
+
+    slot->result = *result;
+    __atomic_store_n(&slot->seq, pos + 1, __ATOMIC_RELEASE);
     return 0;
 }
 
-void vanity_stop(VanitySearch *search) {
-    if (!search) return;
-    
-    // Signal threads to stop
-    search->stopped = true;
-    
-    // Wait for threads to finish
-    for (int i = 0; i < search->num_threads; i++) {
-        if (search->contexts[i].running) {
-            pthread_join(search->contexts[i].thread, NULL);
+// Returns 0 when the queue is empty
+static int queue_pop(ResultQueue *queue, VanityResult *result) {
+    size_t pos = __atomic_load_n(&queue->tail, __ATOMIC_RELAXED);
+    ResultSlot *slot;
+
+    for (;;) {
+        slot = &queue->slots[pos & queue->mask];
+        intptr_t diff = (intptr_t)__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) - (intptr_t)(pos + 1);
+        if (diff == 0) {
+            if (__atomic_compare_exchange_n(&queue->tail, &pos, pos + 1, true,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                break;
+            }
+        } else if (diff < 0) {
+            return 0;
+        } else {
+            pos = __atomic_load_n(&queue->tail, __ATOMIC_RELAXED);
         }
     }
+
+    *result = slot->result;
+    memset(&slot->result, 0, sizeof(slot->result));
+    __atomic_store_n(&slot->seq, pos + queue->mask + 1, __ATOMIC_RELEASE);
+    return 1;
 }
 
-bool vanity_found(VanitySearch *search) {
-    return search ? search->found : false;
+// The WIF compression flag tells wallets which address the key spends
+static int scalar_to_wif(const unsigned char *scalar, bool compressed, char *wif) {
+    struct PrivKey privkey;
+    int r;
+
+    r = privkey_from_raw(&privkey, (unsigned char *)scalar, PRIVKEY_LENGTH);
+    if (compressed) {
+        privkey_compress(&privkey);
+    } else {
+        privkey_uncompress(&privkey);
+    }
+    if (r > 0) {
+        r = privkey_to_wif(wif, &privkey);
+    }
+    memset(&privkey, 0, sizeof(privkey));
+
+    return r > 0 ? 0 : -1;
 }
 
-bool vanity_is_stopped(VanitySearch *search) {
-    return search ? search->stopped : true;
+// Child index of a candidate of an xpub search, see keybatch_ec_xpub()
+static uint32_t hit_index(const KeyBatch *batch, uint32_t i) {
+    uint32_t scalar;
+
+    deserialize_uint32(&scalar, batch->scalars + keybatch_key(batch, i) * KEYBATCH_SCALAR_LEN + KEYBATCH_SCALAR_LEN - 4,
+                       SERIALIZE_ENDIAN_BIG);
+    return scalar - 1;
 }
 
-uint64_t vanity_get_attempts(VanitySearch *search) {
-    return search ? search->attempts : 0;
+/*
+ * Rebuild a hit from its scalar with the reference code path and make
+ * sure it agrees with the batch before reporting it. A faulty kernel
+ * must never hand out a key for an address it doesn't control.
+ */
+static int verify_hit(VanitySearch *search, KeyBatch *batch, uint32_t i) {
+    unsigned char raw[PUBKEY_UNCOMPRESSED_LENGTH + 1];
+    size_t key = keybatch_key(batch, i);
+    size_t len = keybatch_pubkey_len(batch, i);
+    struct PrivKey privkey;
+    PubKey pubkey;
+    int r;
+
+    // The batched child against one derived the slow way
+    if (search->has_xpub) {
+        r = bip32_child_pubkey(raw, &search->xpub, hit_index(batch, i));
+        return r == 0 && memcmp(raw, keybatch_pubkey(batch, i), BIP32_PUBKEY_LEN) == 0 ? 0 : -1;
+    }
+
+    pubkey = malloc(pubkey_sizeof());
+    if (!pubkey) {
+        error_log("Memory allocation error.");
+        return -1;
+    }
+
+    r = privkey_from_raw(&privkey, batch->scalars + key * KEYBATCH_SCALAR_LEN, PRIVKEY_LENGTH);
+    if (keybatch_compressed(batch, i)) {
+        privkey_compress(&privkey);
+    } else {
+        privkey_uncompress(&privkey);
+    }
+    if (r > 0) {
+        r = pubkey_get(pubkey, &privkey);
+    }
+    if (r > 0) {
+        r = (size_t)pubkey_to_raw(raw, pubkey) == len &&
+            memcmp(raw, keybatch_pubkey(batch, i), len) == 0 ? 1 : -1;
+    }
+    // The batched tweak against one done the slow way
+    if (r > 0 && batch->outputs) {
+        unsigned char output[TAPROOT_KEY_LEN];
+        r = taproot_output_key(output, raw) == 0 &&
+            memcmp(output, batch->outputs + key * KEYBATCH_OUTPUT_LEN, TAPROOT_KEY_LEN) == 0 ? 1 : -1;
+    }
+
+    memset(&privkey, 0, sizeof(privkey));
+    free(pubkey);
+
+    return r > 0 ? 0 : -1;
 }
 
-uint64_t vanity_get_elapsed(VanitySearch *search) {
-    if (!search) return 0;
-    
+/*
+ * Hand a continuous mode result to the consumer. The result number is
+ * claimed first so no more than max_results are ever queued; a full
+ * queue makes the worker wait for the consumer rather than drop keys.
+ */
+static void queue_hit(VanitySearch *search, KeyBatch *batch, uint32_t i, const char *address, int id) {
+    VanityResult result;
     struct timespec now;
-    clock_gettime(CLOCK_MONOTONIC, &now);
-    
-    return (now.tv_sec - search->start_time.tv_sec) * 1000 +
-           (now.tv_nsec - search->start_time.tv_nsec) / 1000000;
+    uint64_t n;
+
+    n = __atomic_fetch_add(&search->result_count, 1, __ATOMIC_RELAXED);
+    if (search->max_results && n >= search->max_results) {
+        return;
+    }
+
+    memset(&result, 0, sizeof(result));
+    result.index = search->has_xpub ? (int64_t)hit_index(batch, i) : -1;
+    if (!search->has_xpub &&
+        scalar_to_wif(batch->scalars + keybatch_key(batch, i) * KEYBATCH_SCALAR_LEN,
+                      keybatch_compressed(batch, i), result.wif) < 0) {
+        error_log("Could not encode matching key");
+        halt(search);
+        return;
+    }
+    strcpy(result.address, address);
+    result.pattern_id = id;
+    result.pattern = search->set ? patternset_get(search->set, id) : search->pattern_str;
+    result.attempts = vanity_get_attempts(search);
+    clock_gettime(CLOCK_REALTIME, &now);
+    result.timestamp_ms = (uint64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+
+    // Once stopped, nobody is guaranteed to drain the queue any more
+    while (queue_push(&search->queue, &result) < 0 && !search->stopped) {
+        sched_yield();
+    }
+    memset(&result, 0, sizeof(result));
+
+    if (search->max_results && n + 1 == search->max_results) {
+        halt(search);
+    } else {
+        wake(search);
+    }
 }
 
-int vanity_get_wif(VanitySearch *search, char *wif, size_t wif_size) {
-    if (!search || !wif || wif_size < PRIVKEY_WIF_LENGTH_MIN || !search->found) {
-        error_log("Invalid parameters for WIF export");
-        return -1;
+/*
+ * Returns true if the hit's private key left the search. Every other
+ * key of the walk is a small offset from it, so the caller must not
+ * reveal another one from the same walk.
+ */
+static bool record_hit(VanitySearch *search, KeyBatch *batch, uint32_t i) {
+    char address[KEYBATCH_ADDR_LEN];
+
+    if (verify_hit(search, batch, i) < 0) {
+        error_log("Pipeline produced a key that does not match its public key");
+        halt(search);
+        return false;
+    }
+
+    if (encode_hit(search, batch, i, address) < 0) {
+        error_log("Could not encode matching address");
+        halt(search);
+        return false;
+    }
+
+    int id = search->set ? patternset_match_address(search->set, address) : 0;
+    if (id < 0) {
+        error_log("Pipeline reported an address no pattern matches");
+        halt(search);
+        return false;
+    }
+
+    // xpub results carry a child index, never a private key. A range
+    // can't start a new walk, so its first key ends it and the worker
+    // asks for another.
+    if (search->continuous) {
+        if (search->has_xpub || !search->range_length) {
+            queue_hit(search, batch, i, address, id);
+            return !search->has_xpub;
+        }
+        if (!__atomic_exchange_n(&search->range_revealed, true, __ATOMIC_ACQ_REL)) {
+            queue_hit(search, batch, i, address, id);
+            pthread_mutex_lock(&search->mutex);
+            search->exhausted = true;
+            search->stopped = true;
+            wake_locked(search);
+            pthread_mutex_unlock(&search->mutex);
+        }
+        return true;
+    }
+
+    pthread_mutex_lock(&search->mutex);
+    if (!search->found) {
+        memcpy(search->found_scalar, batch->scalars + keybatch_key(batch, i) * KEYBATCH_SCALAR_LEN, PRIVKEY_LENGTH);
+        search->found_compressed = keybatch_compressed(batch, i);
+        search->found_index = search->has_xpub ? hit_index(batch, i) : 0;
+        strcpy(search->found_address, address);
+        search->found_pattern = id;
+        search->found = true;
+        wake_locked(search);
     }
-    
-    return privkey_to_wif(wif, search->found_privkey);
+    pthread_mutex_unlock(&search->mutex);
+
+    return !search->has_xpub;
 }
 
-int vanity_get_address(VanitySearch *search, char *address, size_t address_size) {
-    if (!search || !address || address_size < 35 || !search->found) {
-        error_log("Invalid parameters for address export");
-        return -1;
+// Position of a thread whose walk may have revealed a key; resumes at a random base
+static const unsigned char zero_scalar[KEYBATCH_SCALAR_LEN];
+
+static void counter_publish(ThreadCounter *counter, uint64_t attempts, const unsigned char *position) {
+    uint32_t seq = counter->seq;
+
+    __atomic_store_n(&counter->seq, seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    __atomic_store_n(&counter->attempts, attempts, __ATOMIC_RELAXED);
+    memcpy(counter->position, position, KEYBATCH_SCALAR_LEN);
+    __atomic_store_n(&counter->seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+static void counter_snapshot(ThreadCounter *counter, uint64_t *attempts, unsigned char *position) {
+    uint32_t seq;
+
+    do {
+        seq = __atomic_load_n(&counter->seq, __ATOMIC_ACQUIRE);
+        *attempts = __atomic_load_n(&counter->attempts, __ATOMIC_RELAXED);
+        memcpy(position, counter->position, KEYBATCH_SCALAR_LEN);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    } while ((seq & 1) || seq != __atomic_load_n(&counter->seq, __ATOMIC_RELAXED));
+}
+
+// Identifies what a checkpoint was searching for, so resuming with a
+// different pattern, mode, key encoding or network is refused
+static int checkpoint_pattern_hash(VanitySearch *search, unsigned char *hash) {
+    unsigned char buffer[3 + VANITY_MAX_PATTERN + 32];
+    size_t len = strlen(search->pattern_str);
+
+    buffer[0] = (unsigned char)search->address_type;
+    buffer[1] = (search->case_sensitive ? 1 : 0) | (search->uncompressed ? 2 : 0) | (search->confusable ? 4 : 0);
+    buffer[2] = network_is_test() ? 1 : 0;
+    memcpy(buffer + 3, search->pattern_str, len);
+    if (search->set) {
+        memcpy(buffer + 3 + len, patternset_digest(search->set), 32);
+        len += 32;
     }
-    
-    strcpy(address, search->found_address);
-    return 0;
+
+    return crypto_get_sha256(hash, buffer, 3 + len) < 0 ? -1 : 0;
 }
 
-int vanity_set_progress_callback(VanitySearch *search, vanity_progress_cb callback,
-                               void *user_data, int interval_ms) {
-    if (!search || !callback || interval_ms < 0) {
-        error_log("Invalid progress callback parameters");
+static int scalar_is_zero(const unsigned char *s) {
+    unsigned char acc = 0;
+
+    for (int i = 0; i < KEYBATCH_SCALAR_LEN; i++) {
+        acc |= s[i];
+    }
+    return acc == 0;
+}
+
+// Big endian 256-bit add of a 64-bit value, no wrap (ranges stay below n)
+static void scalar_add_u64(unsigned char *out, const unsigned char *in, uint64_t v) {
+    unsigned int carry = 0;
+
+    for (int i = KEYBATCH_SCALAR_LEN - 1; i >= 0; i--) {
+        carry += in[i] + (unsigned int)(v & 0xFF);
+        out[i] = carry & 0xFF;
+        carry >>= 8;
+        v >>= 8;
+    }
+}
+
+/*
+ * Write the checkpoint next to its final path and rename it into place,
+ * so a crash mid-write leaves the previous checkpoint intact. Positions
+ * are private key material; the file is only readable by its owner.
+ */
+static int checkpoint_write(VanitySearch *search) {
+    unsigned char data[CHECKPOINT_MAX_LEN];
+    unsigned char hash[32];
+    unsigned char position[KEYBATCH_SCALAR_LEN];
+    unsigned char *p = data;
+    char tmp_path[4096];
+    uint64_t attempts;
+    uint32_t checksum = 0;
+    size_t len, written = 0;
+    ssize_t r;
+    int fd;
+
+    if (checkpoint_pattern_hash(search, hash) < 0) {
+        error_log("Could not hash checkpoint pattern");
         return -1;
     }
-    
-    search->progress_callback = callback;
-    search->progress_user_data = user_data;
-    search->progress_interval_ms = interval_ms;
+
+    p = serialize_uint32(p, CHECKPOINT_MAGIC, SERIALIZE_ENDIAN_BIG);
+    p = serialize_uint8(p, CHECKPOINT_VERSION, SERIALIZE_ENDIAN_BIG);
+    p = serialize_uchar(p, hash, 32);
+    p = serialize_uint64(p, vanity_get_elapsed(search), SERIALIZE_ENDIAN_BIG);
+    p = serialize_uint16(p, (uint16_t)search->num_threads, SERIALIZE_ENDIAN_BIG);
+    for (int i = 0; i < search->num_threads; i++) {
+        counter_snapshot(&search->counters[i], &attempts, position);
+        p = serialize_uint64(p, attempts, SERIALIZE_ENDIAN_BIG);
+        p = serialize_uchar(p, position, KEYBATCH_SCALAR_LEN);
+    }
+    memset(position, 0, sizeof(position));
+
+    if (crypto_get_checksum(&checksum, data, p - data) < 0) {
+        error_log("Could not compute checkpoint checksum");
+        return -1;
+    }
+    p = serialize_uint32(p, checksum, SERIALIZE_ENDIAN_BIG);
+    len = p - data;
+
+    if (snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", search->checkpoint_path) >= (int)sizeof(tmp_path)) {
+        error_log("Checkpoint path is too long");
+        return -1;
+    }
+
+    fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    if (fd < 0) {
+        error_log("Could not open checkpoint file %s. Errno %i.", tmp_path, errno);
+        return -1;
+    }
+    while (written < len) {
+        r = write(fd, data + written, len - written);
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0) break;
+        written += r;
+    }
+    memset(data, 0, sizeof(data));
+    if (written < len || fsync(fd) < 0) {
+        error_log("Could not write checkpoint file %s. Errno %i.", tmp_path, errno);
+        close(fd);
+        unlink(tmp_path);
+        return -1;
+    }
+    close(fd);
+
+    if (rename(tmp_path, search->checkpoint_path) < 0) {
+        error_log("Could not replace checkpoint file %s. Errno %i.", search->checkpoint_path, errno);
+        unlink(tmp_path);
+        return -1;
+    }
+
     return 0;
 }
 
-void vanity_cleanup(VanitySearch *search) {
-    if (!search) return;
-    
-    vanity_stop(search);
-    pattern_free(&search->pattern);
-    privkey_free(search->found_privkey);
-    pthread_mutex_destroy(&search->mutex);
-    free(search);
-}
\ No newline at end of file
+// Earliest of the due times that are enabled (UINT64_MAX for none)
+static uint64_t earliest(uint64_t a, uint64_t b) {
+    return a < b ? a : b;
+}
+
+/*
+ * Sleeps until the next progress report, checkpoint or time limit is
+ * due and wakes early when the search stops, so vanity_stop() never
+ * waits out a full interval.
+ */
+static void *monitor_thread(void *arg) {
+    VanitySearch *search = arg;
+    struct timespec deadline;
+    uint64_t elapsed = vanity_get_elapsed(search);
+    uint64_t next_progress = UINT64_MAX, next_checkpoint = UINT64_MAX, end = UINT64_MAX;
+    int progress_ms = search->progress_interval_ms > 0 ? search->progress_interval_ms
+                                                      : VANITY_DEFAULT_PROGRESS_MS;
+
+    if (search->progress_callback) {
+        next_progress = elapsed + progress_ms;
+    }
+    if (search->checkpoint_path) {
+        next_checkpoint = elapsed + search->checkpoint_interval_ms;
+    }
+    // The time limit counts this run only, not time carried over by resume
+    if (search->max_ms) {
+        end = elapsed + search->max_ms;
+    }
+
+    pthread_mutex_lock(&search->mutex);
+    while (!search->stopped) {
+        uint64_t wait_ms = earliest(earliest(next_progress, next_checkpoint), end);
+        wait_ms = wait_ms > elapsed ? wait_ms - elapsed : 0;
+
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += wait_ms / 1000;
+        deadline.tv_nsec += (long)(wait_ms % 1000) * 1000000;
+        if (deadline.tv_nsec >= 1000000000) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000;
+        }
+        pthread_cond_timedwait(&search->monitor_cond, &search->mutex, &deadline);
+        if (search->stopped) {
+            break;
+        }
+
+        elapsed = vanity_get_elapsed(search);
+        if (elapsed >= end) {
+            search->stopped = true;
+            wake_locked(search);
+            break;
+        }
+        pthread_mutex_unlock(&search->mutex);
+
+        if (elapsed >= next_progress) {
+            uint64_t attempts = vanity_get_attempts(search);
+            double rate = elapsed > 0 ? attempts * 1000.0 / elapsed : 0.0;
+            search->progress_callback(attempts, rate, search->progress_user_data);
+            next_progress = elapsed + progress_ms;
+        }
+
+        // A failed write is reported and retried at the next interval
+        if (elapsed >= next_checkpoint) {
+            checkpoint_write(search);
+            next_checkpoint = elapsed + search->checkpoint_interval_ms;
+        }
+
+        pthread_mutex_lock(&search->mutex);
+    }
+    pthread_mutex_unlock(&search->mutex);
+
+    return NULL;
+}
+
+/*
+ * Hand the next chunk of the range to a thread. Chunks are whole
+ * batches, so walking one never strays into the next. The last thread
+ * to find nothing left marks the range exhausted and stops the search.
+ */
+static int claim_chunk(VanitySearch *search, KeyBatch *batch, uint64_t *chunk_left) {
+    uint64_t chunk = (uint64_t)search->batch_size * VANITY_RANGE_CHUNK;
+    uint64_t offset = __atomic_fetch_add(&search->range_cursor, chunk, __ATOMIC_RELAXED);
+    unsigned char base[KEYBATCH_SCALAR_LEN];
+
+    if (offset >= search->range_length) {
+        if (__atomic_add_fetch(&search->range_finished, 1, __ATOMIC_ACQ_REL) == search->num_threads) {
+            pthread_mutex_lock(&search->mutex);
+            search->exhausted = true;
+            search->stopped = true;
+            wake_locked(search);
+            pthread_mutex_unlock(&search->mutex);
+        }
+        return -1;
+    }
+
+    // Candidates are base + 1 onwards, so the chunk starts one below
+    scalar_add_u64(base, search->range_base, offset);
+    keybatch_set_base(batch, base);
+    *chunk_left = search->range_length - offset < chunk ? search->range_length - offset : chunk;
+    memset(base, 0, sizeof(base));
+    return 0;
+}
+
+/*
+ * Runs on the worker before its first batch. The worker pins itself and
+ * then allocates its own batch, so under first-touch placement the batch
+ * memory (and this thread's malloc arena) lands on the worker's node.
+ */
+static int worker_setup(ThreadContext *ctx) {
+    VanitySearch *search = ctx->search;
+
+    if (ctx->cpu >= 0 && topology_pin(ctx->cpu) < 0) {
+        return -1;
+    }
+
+    ctx->batch = keybatch_new(search->batch_size,
+                              (search->uncompressed ? KEYBATCH_UNCOMPRESSED : 0) |
+                              (search->address_type == VANITY_ADDR_P2TR ? KEYBATCH_TAPROOT : 0));
+    if (!ctx->batch) {
+        error_log("Could not allocate key batch");
+        return -1;
+    }
+    if (search->has_xpub && keybatch_set_xpub(ctx->batch, &search->xpub) < 0) {
+        return -1;
+    }
+
+    // Thread i's stream key is SHA-256(seed || i), so every worker
+    // repeats its own keys and none repeats another's
+    if (search->seeded) {
+        unsigned char buffer[sizeof(search->seed) + 4], key[KEYBATCH_SCALAR_LEN];
+
+        memcpy(buffer, search->seed, sizeof(search->seed));
+        serialize_uint32(buffer + sizeof(search->seed), (uint32_t)ctx->thread_id, SERIALIZE_ENDIAN_BIG);
+        if (crypto_get_sha256(key, buffer, sizeof(buffer)) < 0) {
+            return -1;
+        }
+        keybatch_seed(ctx->batch, key);
+        memset(key, 0, sizeof(key));
+    }
+
+    // Threads that never finished a batch before the checkpoint simply
+    // start from a random base again
+    if (search->resumed && !scalar_is_zero(ctx->counter->position)) {
+        keybatch_set_base(ctx->batch, ctx->counter->position);
+    }
+
+    return 0;
+}
+
+static void *search_thread(void *arg) {
+    ThreadContext *ctx = (ThreadContext *)arg;
+    VanitySearch *search = ctx->search;
+    int r = worker_setup(ctx);
+
+    pthread_mutex_lock(&search->mutex);
+    search->ready_threads++;
+    if (r < 0) {
+        search->setup_failed = true;
+    }
+    pthread_cond_signal(&search->ready_cond);
+    pthread_mutex_unlock(&search->mutex);
+    if (r < 0) {
+        return NULL;
+    }
+
+    KeyBatch *batch = ctx->batch;
+    uint64_t attempts = __atomic_load_n(&ctx->counter->attempts, __ATOMIC_RELAXED);
+    uint64_t chunk_left = 0;
+
+    while (!search->found && !search->stopped) {
+        if (search->paused) {
+            pthread_mutex_lock(&search->mutex);
+            while (search->paused && !search->stopped) {
+                pthread_cond_wait(&search->pause_cond, &search->mutex);
+            }
+            pthread_mutex_unlock(&search->mutex);
+            continue;
+        }
+
+        if (search->range_length && chunk_left == 0 && claim_chunk(search, batch, &chunk_left) < 0) {
+            break;
+        }
+
+        if (keybatch_run(batch, search->kernels, search) < 0) {
+            // The EC walk landed on a point it can't add to; start over
+            // from a new base. Anything else ends the search, as does
+            // leaving a range.
+            if (batch->reseed && !search->range_length) {
+                continue;
+            }
+            error_log("Thread %d pipeline failed", ctx->thread_id);
+            halt(search);
+            break;
+        }
+
+        // Only this thread writes its counter, so no lock is needed. A
+        // batch with hits may reveal a key, and a checkpoint must not
+        // resume a walk that did.
+        attempts += batch->candidates;
+        chunk_left -= search->range_length ? batch->count : 0;
+        counter_publish(ctx->counter, attempts, batch->hit_count ? zero_scalar : batch->base_scalar);
+
+        // Continuous mode keeps every hit, otherwise the first one wins.
+        // Once a key is out, the rest of this walk is a few additions
+        // away from it: skip the batch's other hits and start a new walk
+        // so every key served from one search is unrelated to the others.
+        for (size_t h = 0; h < batch->hit_count && !search->stopped && !search->discard_hits; h++) {
+            if (record_hit(search, batch, batch->hits[h])) {
+                if (!search->range_length) {
+                    keybatch_reseed(batch);
+                }
+                break;
+            }
+            if (!search->continuous) {
+                break;
+            }
+        }
+    }
+
+    return NULL;
+}
+
+// The leading character must be the address type's; pattern_compile()
+// checks the rest
+static int validate_base58_pattern(const char *pattern, vanity_addr_t type) {
+    if (type == VANITY_ADDR_P2SH_P2WPKH) {
+        const char *lead = network_is_test() ? "2" : "3";
+        if (pattern[0] != lead[0]) {
+            error_log("P2SH addresses on this network start with '%s'", lead);
+            return -1;
+        }
+    } else {
+        const char *lead = network_is_test() ? "mn" : "1";
+        if (!strchr(lead, pattern[0])) {
+            error_log("P2PKH addresses on this network start with '%s'", network_is_test() ? "m' or 'n" : "1");
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+// Pattern set encoding of an address type
+static patternset_encoding_t set_encoding(vanity_addr_t type) {
+    switch (type) {
+        case VANITY_ADDR_P2WPKH:
+            return PATTERNSET_BECH32;
+        case VANITY_ADDR_P2SH_P2WPKH:
+            return PATTERNSET_P2SH;
+        case VANITY_ADDR_P2TR:
+            return PATTERNSET_BECH32M;
+        case VANITY_ADDR_P2PKH:
+        default:
+            return PATTERNSET_BASE58;
+    }
+}
+
+// Compile the pattern for the selected address type
+static int compile_pattern(VanitySearch *search) {
+    int chars;
+
+    if (search->compiled) {
+        return 0;
+    }
+
+    // Segwit only commits to compressed keys
+    if (search->uncompressed && search->address_type != VANITY_ADDR_P2PKH) {
+        error_log("Uncompressed keys only have P2PKH addresses");
+        return -1;
+    }
+
+    // Look-alike classes go into the single pattern's matcher tables
+    if (search->confusable && (search->pattern_file || search->added_count ||
+                               search->address_type == VANITY_ADDR_P2WPKH ||
+                               search->address_type == VANITY_ADDR_P2TR)) {
+        error_log("Look-alike matching is for a single base58 pattern");
+        return -1;
+    }
+
+    if (search->pattern_file || search->added_count) {
+        search->set = patternset_new(set_encoding(search->address_type), search->case_sensitive);
+        if (!search->set) {
+            return -1;
+        }
+        if (search->pattern_file && patternset_load(search->set, search->pattern_file) < 0) {
+            error_log("Could not load pattern file %s", search->pattern_file);
+            return -1;
+        }
+        for (size_t i = 0; i < search->added_count; i++) {
+            if (patternset_add(search->set, search->added[i]) < 0) {
+                return -1;
+            }
+        }
+        if (patternset_compile(search->set) < 0) {
+            return -1;
+        }
+        search->probability = patternset_probability(search->set);
+        search->compiled = true;
+        return 0;
+    }
+
+    if (search->pattern_str[0] == '\0') {
+        error_log("No pattern to search for");
+        return -1;
+    }
+
+    switch (search->address_type) {
+        case VANITY_ADDR_P2WPKH:
+            // Bech32 is case insensitive
+            chars = bech32_prefix_compile(search->hash_mask, search->hash_value, KEYBATCH_HASH_LEN,
+                                          search->pattern_str, 0);
+            if (chars < 0) {
+                error_log("Invalid bech32 pattern");
+                return -1;
+            }
+            search->hash_bytes = ((size_t)chars * 5 + 7) / 8;
+            search->probability = ldexp(1.0, -5 * chars);
+            search->compiled = true;
+            return 0;
+        case VANITY_ADDR_P2TR:
+            chars = bech32_prefix_compile(search->hash_mask, search->hash_value, KEYBATCH_OUTPUT_LEN,
+                                          search->pattern_str, 1);
+            if (chars < 0) {
+                error_log("Invalid bech32m pattern");
+                return -1;
+            }
+            search->hash_bytes = ((size_t)chars * 5 + 7) / 8;
+            search->probability = ldexp(1.0, -5 * chars);
+            search->compiled = true;
+            return 0;
+        case VANITY_ADDR_P2PKH:
+        case VANITY_ADDR_P2SH_P2WPKH:
+        default:
+            if (validate_base58_pattern(search->pattern_str, search->address_type) < 0) {
+                return -1;
+            }
+            search->pattern = search->confusable ?
+                pattern_compile_confusable(search->pattern_str, PATTERN_TYPE_PREFIX, search->case_sensitive) :
+                pattern_compile(search->pattern_str, PATTERN_TYPE_PREFIX, search->case_sensitive);
+            if (!search->pattern) {
+                error_log("Could not compile pattern");
+                return -1;
+            }
+            // Exact on the HASH160 intervals: the characters after the
+            // leading '1' are far from uniform, '2' is some 58 times as
+            // likely as 'Z' in second place
+            search->probability = pattern_prefix_probability(search->pattern, set_encoding(search->address_type));
+            // The version byte rules some prefixes out, e.g. "3a"
+            if (search->probability == 0.0) {
+                error_log("No address of this type can start with '%s'", search->pattern_str);
+                return -1;
+            }
+            search->compiled = true;
+            return 0;
+    }
+}
+
+int vanity_analyze(VanitySearch *search, double rate, double max_seconds, pattern_analysis_t *analysis) {
+    if (!search || !analysis) return -1;
+
+    if (search->pattern_file || search->added_count || search->confusable ||
+        search->address_type == VANITY_ADDR_P2WPKH || search->address_type == VANITY_ADDR_P2TR) {
+        error_log("Feasibility analysis is for a single base58 pattern");
+        return -1;
+    }
+    if (validate_base58_pattern(search->pattern_str, search->address_type) < 0) {
+        return -1;
+    }
+
+    return pattern_analyze(search->pattern_str, PATTERN_TYPE_PREFIX, search->case_sensitive,
+                           set_encoding(search->address_type), rate, max_seconds, analysis);
+}
+
+int vanity_init(VanitySearch **search, const char *pattern, bool case_sensitive, int num_threads) {
+    if (!search) return -1;
+
+    // Validate pattern length, a pattern file may stand in for the pattern
+    if (!pattern) {
+        pattern = "";
+    } else if (strlen(pattern) == 0 || strlen(pattern) > VANITY_MAX_PATTERN) {
+        error_log("Pattern must be 1 to %d characters", VANITY_MAX_PATTERN);
+        return -1;
+    }
+
+    // Validate thread count
+    if (num_threads < 1 || num_threads > VANITY_MAX_THREADS) {
+        error_log("Invalid thread count (must be between 1 and %d)", VANITY_MAX_THREADS);
+        return -1;
+    }
+
+    // Allocate search context
+    VanitySearch *s = calloc(1, sizeof(VanitySearch));
+    if (!s) {
+        error_log("Could not allocate search context");
+        return -1;
+    }
+
+    strcpy(s->pattern_str, pattern);
+    s->case_sensitive = case_sensitive;
+    s->address_type = VANITY_ADDR_P2PKH;
+    s->num_threads = num_threads;
+    s->batch_size = KEYBATCH_SIZE;
+    s->found = false;
+    s->stopped = false;
+    s->event_fd[0] = s->event_fd[1] = -1;
+
+    // Counters must start on a cache line boundary, which calloc won't promise
+    if (posix_memalign((void **)&s->counters, VANITY_CACHE_LINE, num_threads * sizeof(ThreadCounter)) != 0) {
+        error_log("Could not allocate thread counters");
+        free(s);
+        return -1;
+    }
+    memset(s->counters, 0, num_threads * sizeof(ThreadCounter));
+
+    // Initialize mutex
+    if (pthread_mutex_init(&s->mutex, NULL) != 0 || pthread_cond_init(&s->monitor_cond, NULL) != 0 ||
+        pthread_cond_init(&s->ready_cond, NULL) != 0 || pthread_cond_init(&s->event_cond, NULL) != 0 ||
+        pthread_cond_init(&s->pause_cond, NULL) != 0) {
+        error_log("Could not initialize mutex");
+        free(s->counters);
+        free(s);
+        return -1;
+    }
+
+    // Both ends non-blocking: workers never wait on a slow consumer
+#ifdef __linux__
+    s->event_fd[0] = s->event_fd[1] = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (s->event_fd[0] < 0) {
+#else
+    if (pipe(s->event_fd) < 0 || fcntl(s->event_fd[0], F_SETFL, O_NONBLOCK) < 0 ||
+        fcntl(s->event_fd[1], F_SETFL, O_NONBLOCK) < 0) {
+#endif
+        error_log("Could not create event descriptor");
+        vanity_cleanup(s);
+        return -1;
+    }
+
+    *search = s;
+    return 0;
+}
+
+int vanity_set_address_type(VanitySearch *search, vanity_addr_t type) {
+    if (!search || search->compiled ||
+        (type != VANITY_ADDR_P2PKH && type != VANITY_ADDR_P2WPKH && type != VANITY_ADDR_P2SH_P2WPKH &&
+         type != VANITY_ADDR_P2TR)) {
+        error_log("Unknown address type");
+        return -1;
+    }
+
+    search->address_type = type;
+    return 0;
+}
+
+int vanity_set_uncompressed(VanitySearch *search, bool uncompressed) {
+    if (!search || search->compiled) {
+        error_log("Invalid parameters for key encodings");
+        return -1;
+    }
+    if (uncompressed && search->address_type != VANITY_ADDR_P2PKH) {
+        error_log("Uncompressed keys only have P2PKH addresses");
+        return -1;
+    }
+
+    search->uncompressed = uncompressed;
+    return 0;
+}
+
+int vanity_set_seed(VanitySearch *search, const char *seed) {
+    if (!search || !seed || search->compiled) {
+        error_log("Invalid parameters for seed");
+        return -1;
+    }
+
+    if (crypto_get_sha256(search->seed, (unsigned char *)seed, strlen(seed)) < 0) {
+        return -1;
+    }
+    search->seeded = true;
+    return 0;
+}
+
+int vanity_set_confusable(VanitySearch *search, bool confusable) {
+    if (!search || search->compiled) {
+        error_log("Invalid parameters for look-alike matching");
+        return -1;
+    }
+
+    search->confusable = confusable;
+    return 0;
+}
+
+int vanity_set_xpub(VanitySearch *search, const char *xpub) {
+    if (!search || !xpub || search->compiled || search->range_length) {
+        error_log("Invalid parameters for xpub");
+        return -1;
+    }
+
+    if (bip32_xpub_parse(&search->xpub, xpub) < 0) {
+        return -1;
+    }
+    search->has_xpub = true;
+    return 0;
+}
+
+int vanity_set_batch_size(VanitySearch *search, size_t count) {
+    if (!search || count < 1 || count > KEYBATCH_MAX) {
+        error_log("Batch size must be between 1 and %d", KEYBATCH_MAX);
+        return -1;
+    }
+
+    search->batch_size = count;
+    return 0;
+}
+
+int vanity_set_kernel(VanitySearch *search, keybatch_stage_t stage, keybatch_kernel kernel) {
+    if (!search || stage < 0 || stage >= KEYBATCH_STAGES) {
+        error_log("Invalid pipeline stage");
+        return -1;
+    }
+
+    search->kernels[stage] = kernel;
+    search->kernel_set[stage] = true;
+    return 0;
+}
+
+int vanity_set_pattern_file(VanitySearch *search, const char *path) {
+    if (!search || !path || search->compiled) {
+        error_log("Invalid pattern file parameters");
+        return -1;
+    }
+
+    free(search->pattern_file);
+    search->pattern_file = strdup(path);
+    if (!search->pattern_file) {
+        error_log("Memory allocation error.");
+        return -1;
+    }
+    return 0;
+}
+
+int vanity_set_checkpoint(VanitySearch *search, const char *path, int interval_ms) {
+    if (!search || !path || !*path || interval_ms < 0) {
+        error_log("Invalid checkpoint parameters");
+        return -1;
+    }
+
+    free(search->checkpoint_path);
+    search->checkpoint_path = strdup(path);
+    if (!search->checkpoint_path) {
+        error_log("Memory allocation error.");
+        return -1;
+    }
+    search->checkpoint_interval_ms = interval_ms > 0 ? interval_ms : VANITY_DEFAULT_CHECKPOINT_MS;
+    return 0;
+}
+
+int vanity_resume(VanitySearch *search, const char *path) {
+    unsigned char data[CHECKPOINT_MAX_LEN + 1];
+    unsigned char hash[32], expected[32];
+    unsigned char *p = data;
+    ThreadCounter *counters;
+    uint32_t magic, checksum, stored;
+    uint8_t version;
+    uint16_t threads;
+    uint64_t elapsed;
+    size_t len = 0;
+    ssize_t r;
+    int fd;
+
+    if (!search || !path) {
+        error_log("Invalid resume parameters");
+        return -1;
+    }
+
+    // The pattern hash covers the compiled set
+    if (compile_pattern(search) < 0) {
+        return -1;
+    }
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        error_log("Could not open checkpoint file %s. Errno %i.", path, errno);
+        return -1;
+    }
+    while (len < sizeof(data)) {
+        r = read(fd, data + len, sizeof(data) - len);
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0) break;
+        len += r;
+    }
+    close(fd);
+
+    if (len < CHECKPOINT_HEADER_LEN + CHECKPOINT_CHECKSUM_LEN) {
+        error_log("Checkpoint file %s is truncated", path);
+        return -1;
+    }
+
+    p = deserialize_uint32(&magic, p, SERIALIZE_ENDIAN_BIG);
+    p = deserialize_uint8(&version, p, SERIALIZE_ENDIAN_BIG);
+    p = deserialize_uchar(hash, p, 32, SERIALIZE_ENDIAN_BIG);
+    p = deserialize_uint64(&elapsed, p, SERIALIZE_ENDIAN_BIG);
+    p = deserialize_uint16(&threads, p, SERIALIZE_ENDIAN_BIG);
+
+    if (magic != CHECKPOINT_MAGIC || version != CHECKPOINT_VERSION) {
+        error_log("%s is not a vanity checkpoint", path);
+        return -1;
+    }
+    if (threads < 1 || threads > VANITY_MAX_THREADS ||
+        len != CHECKPOINT_HEADER_LEN + (size_t)threads * CHECKPOINT_THREAD_LEN + CHECKPOINT_CHECKSUM_LEN) {
+        error_log("Checkpoint file %s is corrupt", path);
+        return -1;
+    }
+
+    checksum = 0;
+    deserialize_uint32(&stored, data + len - CHECKPOINT_CHECKSUM_LEN, SERIALIZE_ENDIAN_BIG);
+    if (crypto_get_checksum(&checksum, data, len - CHECKPOINT_CHECKSUM_LEN) < 0 || checksum != stored) {
+        error_log("Checkpoint file %s is corrupt", path);
+        return -1;
+    }
+
+    if (checkpoint_pattern_hash(search, expected) < 0 || memcmp(hash, expected, 32) != 0) {
+        error_log("Checkpoint %s was written for a different pattern or address type", path);
+        return -1;
+    }
+
+    // The checkpoint decides the thread count: every walk it recorded
+    // continues on its own thread
+    if (posix_memalign((void **)&counters, VANITY_CACHE_LINE, threads * sizeof(ThreadCounter)) != 0) {
+        error_log("Could not allocate thread counters");
+        return -1;
+    }
+    memset(counters, 0, threads * sizeof(ThreadCounter));
+
+    for (int i = 0; i < threads; i++) {
+        uint64_t attempts;
+        p = deserialize_uint64(&attempts, p, SERIALIZE_ENDIAN_BIG);
+        p = deserialize_uchar(counters[i].position, p, KEYBATCH_SCALAR_LEN, SERIALIZE_ENDIAN_BIG);
+        counters[i].attempts = attempts;
+    }
+    memset(data, 0, sizeof(data));
+
+    memset(search->counters, 0, search->num_threads * sizeof(ThreadCounter));
+    free(search->counters);
+    search->counters = counters;
+    search->num_threads = threads;
+    search->elapsed_offset = elapsed;
+    search->resumed = true;
+
+    return 0;
+}
+
+int vanity_get_threads(VanitySearch *search) {
+    return search ? search->num_threads : 0;
+}
+
+// Choose a CPU for every worker, or none when pinning is off
+static int place_workers(VanitySearch *search) {
+    int placed[VANITY_MAX_THREADS];
+
+    for (int i = 0; i < search->num_threads; i++) {
+        search->contexts[i].cpu = -1;
+        search->contexts[i].node = -1;
+    }
+    if (!search->pin) {
+        return 0;
+    }
+
+    topology_free(&search->topology);
+    if (topology_detect(&search->topology) < 0 ||
+        topology_place(&search->topology, placed, search->num_threads, search->skip_smt) < 0) {
+        error_log("Could not place worker threads");
+        return -1;
+    }
+
+    for (int i = 0; i < search->num_threads; i++) {
+        search->contexts[i].cpu = search->topology.cpus[placed[i]].cpu;
+        search->contexts[i].node = search->topology.cpus[placed[i]].node;
+    }
+    return 0;
+}
+
+int vanity_start(VanitySearch *search) {
+    keybatch_kernel defaults[KEYBATCH_STAGES];
+
+    if (!search) {
+        error_log("Invalid search context");
+        return -1;
+    }
+
+    if (compile_pattern(search) < 0) {
+        return -1;
+    }
+
+    // An xpub search is the range of every non-hardened index: scalar
+    // index + 1, rounded down to whole batches
+    if (search->has_xpub) {
+        if (search->uncompressed || search->address_type == VANITY_ADDR_P2TR) {
+            error_log("Child keys of an xpub are only searched as compressed P2PKH, P2WPKH or P2SH-P2WPKH");
+            return -1;
+        }
+        if (search->seeded || search->checkpoint_path || search->resumed) {
+            error_log("An xpub search can not be seeded, checkpointed or resumed");
+            return -1;
+        }
+        memset(search->range_base, 0, KEYBATCH_SCALAR_LEN);
+        search->range_length = BIP32_HARDENED - BIP32_HARDENED % search->batch_size;
+    }
+
+    // Kernels replaced through vanity_set_kernel() win over the defaults
+    default_kernels(search, defaults);
+    for (int i = 0; i < KEYBATCH_STAGES; i++) {
+        if (!search->kernel_set[i]) {
+            search->kernels[i] = defaults[i];
+        }
+    }
+
+    if (place_workers(search) < 0) {
+        return -1;
+    }
+
+    for (int i = 0; i < search->num_threads; i++) {
+        keybatch_free(search->contexts[i].batch);
+        search->contexts[i].batch = NULL;
+        search->contexts[i].search = search;
+        search->contexts[i].thread_id = i;
+        search->contexts[i].counter = &search->counters[i];
+    }
+    search->ready_threads = 0;
+    search->setup_failed = false;
+
+    if (search->range_length && search->range_length % search->batch_size) {
+        error_log("Range length must be a multiple of the batch size");
+        return -1;
+    }
+    search->range_cursor = 0;
+    search->range_finished = 0;
+    search->exhausted = false;
+    search->range_revealed = false;
+    search->paused = false;
+    search->paused_ms = 0;
+
+    // Record start time
+    clock_gettime(CLOCK_MONOTONIC, &search->start_time);
+
+    // Start worker threads
+    for (int i = 0; i < search->num_threads; i++) {
+        if (pthread_create(&search->contexts[i].thread, NULL, search_thread, &search->contexts[i]) != 0) {
+            error_log("Failed to create worker thread");
+            vanity_stop(search);
+            return -1;
+        }
+        search->started_threads++;
+    }
+
+    // Workers allocate their own batches; wait so failures surface here
+    pthread_mutex_lock(&search->mutex);
+    while (search->ready_threads < search->started_threads) {
+        pthread_cond_wait(&search->ready_cond, &search->mutex);
+    }
+    pthread_mutex_unlock(&search->mutex);
+    if (search->setup_failed) {
+        error_log("Failed to set up worker threads");
+        vanity_stop(search);
+        return -1;
+    }
+
+    // Workers never report progress, write checkpoints or watch the clock
+    if (search->progress_callback || search->checkpoint_path || search->max_ms) {
+        if (pthread_create(&search->monitor, NULL, monitor_thread, search) != 0) {
+            error_log("Failed to create monitor thread");
+            vanity_stop(search);
+            return -1;
+        }
+        search->monitor_started = true;
+    }
+
+    return 0;
+}
+
+void vanity_stop(VanitySearch *search) {
+    if (!search) return;
+
+    // Signal threads to stop
+    halt(search);
+
+    if (search->monitor_started) {
+        pthread_join(search->monitor, NULL);
+        search->monitor_started = false;
+    }
+
+    // Wait for threads to finish
+    for (int i = 0; i < search->started_threads; i++) {
+        pthread_join(search->contexts[i].thread, NULL);
+    }
+
+    // Every worker is idle now, so the final checkpoint is exact. Once a
+    // key is found the positions would lead straight to it; drop them.
+    // Continuous workers already cleared theirs after every key.
+    if (search->started_threads > 0 && search->checkpoint_path) {
+        if (search->found) {
+            unlink(search->checkpoint_path);
+        } else {
+            checkpoint_write(search);
+        }
+    }
+    search->started_threads = 0;
+}
+
+bool vanity_found(VanitySearch *search) {
+    return search ? search->found : false;
+}
+
+bool vanity_is_stopped(VanitySearch *search) {
+    return search ? search->stopped : true;
+}
+
+uint64_t vanity_get_attempts(VanitySearch *search) {
+    uint64_t total = 0;
+
+    if (!search) return 0;
+
+    for (int i = 0; i < search->num_threads; i++) {
+        total += __atomic_load_n(&search->counters[i].attempts, __ATOMIC_RELAXED);
+    }
+    return total;
+}
+
+uint64_t vanity_get_thread_attempts(VanitySearch *search, int thread) {
+    if (!search || thread < 0 || thread >= search->num_threads) return 0;
+
+    return __atomic_load_n(&search->counters[thread].attempts, __ATOMIC_RELAXED);
+}
+
+uint64_t vanity_get_matches(VanitySearch *search) {
+    if (!search) return 0;
+
+    if (!search->continuous) {
+        return search->found ? 1 : 0;
+    }
+    uint64_t n = __atomic_load_n(&search->result_count, __ATOMIC_RELAXED);
+    return search->max_results && n > search->max_results ? search->max_results : n;
+}
+
+size_t vanity_get_queue_depth(VanitySearch *search) {
+    if (!search || !search->queue.slots) return 0;
+
+    size_t tail = __atomic_load_n(&search->queue.tail, __ATOMIC_RELAXED);
+    size_t head = __atomic_load_n(&search->queue.head, __ATOMIC_RELAXED);
+    return head > tail ? head - tail : 0;
+}
+
+double vanity_get_probability(VanitySearch *search) {
+    return search && search->compiled ? search->probability : 0.0;
+}
+
+double vanity_quantile_attempts(double probability, double quantile) {
+    if (probability <= 0.0 || probability > 1.0 || quantile <= 0.0 || quantile >= 1.0) return -1.0;
+    if (probability == 1.0) return 1.0;
+
+    // 1 - (1 - p)^n = q
+    return log1p(-quantile) / log1p(-probability);
+}
+
+double vanity_get_eta(VanitySearch *search, double quantile) {
+    double attempts = vanity_quantile_attempts(vanity_get_probability(search), quantile);
+    uint64_t elapsed = vanity_get_elapsed(search);
+    uint64_t done = vanity_get_attempts(search);
+
+    if (attempts < 0 || elapsed == 0 || done == 0) return -1.0;
+
+    return attempts * elapsed / 1000.0 / done;
+}
+
+const char *vanity_profile_unit(void) {
+#ifdef VANITY_PROFILE
+    return KEYBATCH_TICK_UNIT;
+#else
+    return NULL;
+#endif
+}
+
+const char *vanity_profile_stage_name(int stage) {
+    static const char *names[VANITY_PROFILE_STAGES] = {
+        "scalar", "ec", "sha256", "ripemd160", "tweak", "encode", "match"
+    };
+
+    return stage >= 0 && stage < VANITY_PROFILE_STAGES ? names[stage] : "unknown";
+}
+
+int vanity_get_profile(VanitySearch *search, int thread, VanityProfile *profile) {
+#ifdef VANITY_PROFILE
+    int first = thread, last = thread;
+
+    if (!search || !profile || thread < -1 || thread >= search->num_threads) {
+        error_log("Invalid parameters for profile");
+        return -1;
+    }
+    if (thread < 0) {
+        first = 0;
+        last = search->num_threads - 1;
+    }
+
+    memset(profile, 0, sizeof(*profile));
+    for (int i = first; i <= last; i++) {
+        KeyBatch *batch = search->contexts[i].batch;
+        if (!batch) continue;
+
+        uint64_t hash = __atomic_load_n(&batch->ticks[KEYBATCH_STAGE_HASH], __ATOMIC_RELAXED);
+        uint64_t sha = __atomic_load_n(&batch->sha256_ticks, __ATOMIC_RELAXED);
+
+        // Taproot runs its tweak where the others hash. A replacement
+        // hash kernel doesn't split its time; it all counts as RIPEMD-160
+        // then.
+        profile->ticks[VANITY_PROFILE_SCALAR] +=
+            __atomic_load_n(&batch->ticks[KEYBATCH_STAGE_SCALAR], __ATOMIC_RELAXED);
+        profile->ticks[VANITY_PROFILE_EC] +=
+            __atomic_load_n(&batch->ticks[KEYBATCH_STAGE_EC], __ATOMIC_RELAXED);
+        if (search->address_type == VANITY_ADDR_P2TR) {
+            profile->ticks[VANITY_PROFILE_TWEAK] += hash;
+        } else {
+            profile->ticks[VANITY_PROFILE_SHA256] += sha < hash ? sha : hash;
+            profile->ticks[VANITY_PROFILE_RIPEMD160] += sha < hash ? hash - sha : 0;
+        }
+        profile->ticks[VANITY_PROFILE_ENCODE] +=
+            __atomic_load_n(&batch->ticks[KEYBATCH_STAGE_ENCODE], __ATOMIC_RELAXED);
+        profile->ticks[VANITY_PROFILE_MATCH] +=
+            __atomic_load_n(&batch->ticks[KEYBATCH_STAGE_MATCH], __ATOMIC_RELAXED);
+        profile->candidates += __atomic_load_n(&batch->profiled, __ATOMIC_RELAXED);
+    }
+    return 0;
+#else
+    (void)search;
+    (void)thread;
+    (void)profile;
+    error_log("Built without VANITY_PROFILE, no stage profile kept");
+    return -1;
+#endif
+}
+
+uint64_t vanity_get_elapsed(VanitySearch *search) {
+    if (!search) return 0;
+
+    // The clock stands still while paused
+    uint64_t now = search->paused ? search->pause_started : monotonic_ms();
+    uint64_t start = (uint64_t)search->start_time.tv_sec * 1000 + search->start_time.tv_nsec / 1000000;
+
+    return search->elapsed_offset + now - start - search->paused_ms;
+}
+
+int vanity_get_wif(VanitySearch *search, char *wif, size_t wif_size) {
+    if (!search || !wif || wif_size < PRIVKEY_WIF_LENGTH_MAX + 1 || !search->found || search->has_xpub) {
+        error_log("Invalid parameters for WIF export");
+        return -1;
+    }
+
+    return scalar_to_wif(search->found_scalar, search->found_compressed, wif);
+}
+
+int vanity_get_index(VanitySearch *search, uint32_t *index) {
+    if (!search || !index || !search->found || !search->has_xpub) {
+        error_log("Invalid parameters for index export");
+        return -1;
+    }
+
+    *index = search->found_index;
+    return 0;
+}
+
+int vanity_get_address(VanitySearch *search, char *address, size_t address_size) {
+    if (!search || !address || !search->found || address_size < strlen(search->found_address) + 1) {
+        error_log("Invalid parameters for address export");
+        return -1;
+    }
+
+    strcpy(address, search->found_address);
+    return 0;
+}
+
+int vanity_address_from_wif(char *address, const char *wif, vanity_addr_t type, bool uncompressed) {
+    unsigned char raw[PUBKEY_UNCOMPRESSED_LENGTH + 1];
+    unsigned char script[2 + KEYBATCH_HASH_LEN] = { 0x00, 0x14 };
+    unsigned char hash[TAPROOT_KEY_LEN];
+    char text[PRIVKEY_WIF_LENGTH_MAX + 1];
+    bool test = network_is_test();
+    struct PrivKey privkey;
+    PubKey pubkey;
+    int r;
+
+    if (!address || !wif || strlen(wif) > PRIVKEY_WIF_LENGTH_MAX) {
+        error_log("Invalid parameters for address derivation");
+        return -1;
+    }
+
+    pubkey = malloc(pubkey_sizeof());
+    if (!pubkey) {
+        error_log("Memory allocation error.");
+        return -1;
+    }
+
+    // Decoding switches the network to the key's; a key of the other
+    // network is no key of this search
+    strcpy(text, wif);
+    r = privkey_from_wif(&privkey, text);
+    if (network_is_test() != test) {
+        test ? network_set_test() : network_set_main();
+        r = -1;
+    }
+    if (r > 0 && !privkey_is_compressed(&privkey) && (type != VANITY_ADDR_P2PKH || !uncompressed)) {
+        r = -1;
+    }
+    if (r > 0) {
+        r = pubkey_get(pubkey, &privkey);
+    }
+    if (r > 0) {
+        switch (type) {
+            case VANITY_ADDR_P2TR:
+                r = pubkey_to_raw(raw, pubkey) > 0 && taproot_output_key(hash, raw) == 0 &&
+                    address_p2wpkh_from_raw(address, hash, TAPROOT_KEY_LEN, 1) >= 0 ? 1 : -1;
+                break;
+            case VANITY_ADDR_P2WPKH:
+                r = address_get_p2wpkh(address, pubkey, 0);
+                break;
+            case VANITY_ADDR_P2SH_P2WPKH:
+                r = pubkey_to_raw(raw, pubkey) > 0 &&
+                    crypto_get_hash160(script + 2, raw, PUBKEY_COMPRESSED_LENGTH + 1) >= 0 &&
+                    crypto_get_hash160(hash, script, sizeof(script)) >= 0 &&
+                    address_from_p2sh_script(address, hash) > 0 ? 1 : -1;
+                break;
+            case VANITY_ADDR_P2PKH:
+            default:
+                r = address_get_p2pkh(address, pubkey);
+                break;
+        }
+    }
+
+    memset(&privkey, 0, sizeof(privkey));
+    memset(text, 0, sizeof(text));
+    free(pubkey);
+
+    return r > 0 ? 0 : -1;
+}
+
+int vanity_set_continuous(VanitySearch *search, uint64_t max_results, uint64_t max_ms) {
+    if (!search || search->started_threads > 0) {
+        error_log("Invalid continuous mode parameters");
+        return -1;
+    }
+
+    if (!search->queue.slots && queue_init(&search->queue, VANITY_QUEUE_SIZE) < 0) {
+        error_log("Could not allocate result queue");
+        return -1;
+    }
+
+    search->continuous = true;
+    search->max_results = max_results;
+    search->max_ms = max_ms;
+    return 0;
+}
+
+int vanity_next_result(VanitySearch *search, VanityResult *result) {
+    if (!search || !result || !search->continuous) {
+        return 0;
+    }
+    return queue_pop(&search->queue, result);
+}
+
+int vanity_wait(VanitySearch *search, int timeout_ms) {
+    struct timespec deadline;
+    int r = 1;
+
+    if (!search) {
+        return -1;
+    }
+
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += timeout_ms / 1000;
+    deadline.tv_nsec += (long)(timeout_ms % 1000) * 1000000;
+    if (deadline.tv_nsec >= 1000000000) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000;
+    }
+
+    pthread_mutex_lock(&search->mutex);
+    while (search->events == search->events_seen && r == 1) {
+        if (timeout_ms == 0) {
+            r = 0;
+        } else if (timeout_ms < 0) {
+            pthread_cond_wait(&search->event_cond, &search->mutex);
+        } else if (pthread_cond_timedwait(&search->event_cond, &search->mutex, &deadline) == ETIMEDOUT) {
+            r = search->events == search->events_seen ? 0 : 1;
+        }
+    }
+    search->events_seen = search->events;
+    event_drain(search);
+    pthread_mutex_unlock(&search->mutex);
+
+    return r;
+}
+
+int vanity_get_event_fd(VanitySearch *search) {
+    return search ? search->event_fd[0] : -1;
+}
+
+int vanity_pause(VanitySearch *search) {
+    if (!search || search->started_threads == 0) {
+        error_log("Search is not running");
+        return -1;
+    }
+
+    pthread_mutex_lock(&search->mutex);
+    if (!search->paused && !search->stopped) {
+        search->pause_started = monotonic_ms();
+        search->paused = true;
+        wake_locked(search);
+    }
+    pthread_mutex_unlock(&search->mutex);
+    return 0;
+}
+
+int vanity_unpause(VanitySearch *search) {
+    if (!search || search->started_threads == 0) {
+        error_log("Search is not running");
+        return -1;
+    }
+
+    pthread_mutex_lock(&search->mutex);
+    if (search->paused) {
+        search->paused_ms += monotonic_ms() - search->pause_started;
+        search->paused = false;
+        wake_locked(search);
+    }
+    pthread_mutex_unlock(&search->mutex);
+    return 0;
+}
+
+bool vanity_is_paused(VanitySearch *search) {
+    return search ? search->paused : false;
+}
+
+static void sleep_ms(int ms) {
+    struct timespec ts = { ms / 1000, (long)(ms % 1000) * 1000000 };
+    while (nanosleep(&ts, &ts) < 0 && errno == EINTR) {
+    }
+}
+
+/*
+ * Run a copy of the template search for trial_ms with the given
+ * settings and measure its candidate rate, leaving out the warmup
+ * (thread start, base point setup) at the beginning.
+ */
+static int tune_trial(const VanitySearch *tmpl, int threads, size_t batch_size, int trial_ms, double *rate) {
+    VanitySearch *trial;
+    uint64_t a0, a1, t0, t1;
+    int r = -1;
+
+    if (vanity_init(&trial, tmpl->pattern_str[0] ? tmpl->pattern_str : NULL, tmpl->case_sensitive, threads) < 0) {
+        return -1;
+    }
+    trial->address_type = tmpl->address_type;
+    trial->uncompressed = tmpl->uncompressed;
+    trial->confusable = tmpl->confusable;
+    trial->seeded = tmpl->seeded;
+    memcpy(trial->seed, tmpl->seed, sizeof(trial->seed));
+    trial->has_xpub = tmpl->has_xpub;
+    trial->xpub = tmpl->xpub;
+    trial->pin = tmpl->pin;
+    trial->skip_smt = tmpl->skip_smt;
+    trial->discard_hits = true;
+
+    for (size_t i = 0; i < tmpl->added_count; i++) {
+        if (vanity_add_pattern(trial, tmpl->added[i]) < 0) {
+            vanity_cleanup(trial);
+            return -1;
+        }
+    }
+    if ((tmpl->pattern_file && vanity_set_pattern_file(trial, tmpl->pattern_file) < 0) ||
+        vanity_set_batch_size(trial, batch_size) < 0 ||
+        vanity_start(trial) < 0) {
+        vanity_cleanup(trial);
+        return -1;
+    }
+
+    sleep_ms(trial_ms / VANITY_TUNE_WARMUP);
+    a0 = vanity_get_attempts(trial);
+    t0 = vanity_get_elapsed(trial);
+    sleep_ms(trial_ms);
+    a1 = vanity_get_attempts(trial);
+    t1 = vanity_get_elapsed(trial);
+
+    if (!trial->stopped && t1 > t0) {
+        *rate = (a1 - a0) * 1000.0 / (t1 - t0);
+        r = 0;
+    }
+    vanity_cleanup(trial);
+    return r;
+}
+
+int vanity_tune(VanitySearch *search, int max_threads, int trial_ms, VanityTuning *best,
+                vanity_tune_cb callback, void *user_data) {
+    static const size_t batch_sizes[] = { 32, 64, 128, 256, 512, 1024 };
+    VanityTuning trial;
+
+    if (!search || !best || search->started_threads > 0 || trial_ms < 1 ||
+        max_threads < 1 || max_threads > VANITY_MAX_THREADS) {
+        error_log("Invalid tuning parameters");
+        return -1;
+    }
+
+    // Validate the pattern once here rather than in every trial
+    if (compile_pattern(search) < 0) {
+        return -1;
+    }
+
+    memset(best, 0, sizeof(*best));
+
+    // The best batch size depends on per-core caches, so measure it with
+    // every core busy, then find the thread count that gives the most
+    for (size_t i = 0; i < sizeof(batch_sizes) / sizeof(batch_sizes[0]); i++) {
+        trial.threads = max_threads;
+        trial.batch_size = batch_sizes[i];
+        if (tune_trial(search, trial.threads, trial.batch_size, trial_ms, &trial.rate) < 0) {
+            return -1;
+        }
+        if (callback) {
+            callback(&trial, user_data);
+        }
+        if (trial.rate > best->rate) {
+            *best = trial;
+        }
+    }
+
+    // Powers of two below the limit, the limit itself was measured above
+    for (int threads = 1; threads < max_threads; threads *= 2) {
+        trial.threads = threads;
+        trial.batch_size = best->batch_size;
+        if (tune_trial(search, trial.threads, trial.batch_size, trial_ms, &trial.rate) < 0) {
+            return -1;
+        }
+        if (callback) {
+            callback(&trial, user_data);
+        }
+        if (trial.rate > best->rate) {
+            *best = trial;
+        }
+    }
+
+    return 0;
+}
+
+int vanity_tune_host(char *host, size_t size) {
+    struct utsname name;
+
+    if (!host || size == 0 || uname(&name) < 0) {
+        error_log("Could not identify this machine");
+        return -1;
+    }
+
+    snprintf(host, size, "%s/%ld", name.machine, sysconf(_SC_NPROCESSORS_ONLN));
+    return 0;
+}
+
+int vanity_add_pattern(VanitySearch *search, const char *pattern) {
+    char **added;
+
+    if (!search || !pattern || search->compiled) {
+        error_log("Invalid pattern parameters");
+        return -1;
+    }
+
+    added = realloc(search->added, (search->added_count + 1) * sizeof(char *));
+    if (!added) {
+        error_log("Memory allocation error.");
+        return -1;
+    }
+    search->added = added;
+    search->added[search->added_count] = strdup(pattern);
+    if (!search->added[search->added_count]) {
+        error_log("Memory allocation error.");
+        return -1;
+    }
+    search->added_count++;
+    return 0;
+}
+
+int vanity_set_range(VanitySearch *search, const unsigned char *base, uint64_t length) {
+    if (!search || !base || length == 0 || search->started_threads > 0 || search->resumed || search->has_xpub) {
+        error_log("Invalid range parameters");
+        return -1;
+    }
+
+    memcpy(search->range_base, base, KEYBATCH_SCALAR_LEN);
+    search->range_length = length;
+    return 0;
+}
+
+bool vanity_is_exhausted(VanitySearch *search) {
+    return search ? search->exhausted : false;
+}
+
+int vanity_set_affinity(VanitySearch *search, bool skip_smt) {
+    if (!search || search->started_threads > 0) {
+        error_log("Invalid affinity parameters");
+        return -1;
+    }
+
+    search->pin = true;
+    search->skip_smt = skip_smt;
+    return 0;
+}
+
+const Topology *vanity_get_topology(VanitySearch *search) {
+    return search && search->pin && search->topology.cpus ? &search->topology : NULL;
+}
+
+int vanity_get_worker_cpu(VanitySearch *search, int thread, int *node) {
+    if (!search || thread < 0 || thread >= search->num_threads || !search->pin) {
+        return -1;
+    }
+    if (node) {
+        *node = search->contexts[thread].node;
+    }
+    return search->contexts[thread].cpu;
+}
+
+const char *vanity_get_pattern(VanitySearch *search) {
+    if (!search || !search->found) {
+        return NULL;
+    }
+    return search->set ? patternset_get(search->set, search->found_pattern) : search->pattern_str;
+}
+
+int vanity_set_progress_callback(VanitySearch *search, vanity_progress_cb callback,
+                               void *user_data, int interval_ms) {
+    if (!search || !callback || interval_ms < 0) {
+        error_log("Invalid progress callback parameters");
+        return -1;
+    }
+
+    search->progress_callback = callback;
+    search->progress_user_data = user_data;
+    search->progress_interval_ms = interval_ms;
+    return 0;
+}
+
+void vanity_cleanup(VanitySearch *search) {
+    if (!search) return;
+
+    vanity_stop(search);
+    for (int i = 0; i < search->num_threads; i++) {
+        keybatch_free(search->contexts[i].batch);
+    }
+    if (search->queue.slots) {
+        memset(search->queue.slots, 0, (search->queue.mask + 1) * sizeof(ResultSlot));
+        free(search->queue.slots);
+    }
+    pattern_free(search->pattern);
+    patternset_free(search->set);
+    free(search->pattern_file);
+    for (size_t i = 0; i < search->added_count; i++) {
+        free(search->added[i]);
+    }
+    free(search->added);
+    memset(search->range_base, 0, KEYBATCH_SCALAR_LEN);
+    memset(search->found_scalar, 0, PRIVKEY_LENGTH);
+    memset(search->counters, 0, search->num_threads * sizeof(ThreadCounter));
+    free(search->counters);
+    free(search->checkpoint_path);
+    topology_free(&search->topology);
+    if (search->event_fd[0] >= 0) {
+        close(search->event_fd[0]);
+    }
+    if (search->event_fd[1] >= 0 && search->event_fd[1] != search->event_fd[0]) {
+        close(search->event_fd[1]);
+    }
+    pthread_cond_destroy(&search->ready_cond);
+    pthread_cond_destroy(&search->monitor_cond);
+    pthread_cond_destroy(&search->event_cond);
+    pthread_cond_destroy(&search->pause_cond);
+    pthread_mutex_destroy(&search->mutex);
+    free(search);
+}
@@ -13,10 +13,62 @@
 #include "privkey.h"
 #include "pubkey.h"
 #include "pattern.h"
+#include "keybatch.h"
+#include "topology.h"
+
+// Address types that can be searched
+typedef enum {
+    VANITY_ADDR_P2PKH = 0,       // Legacy "1..." addresses
+    VANITY_ADDR_P2WPKH = 1,      // Native segwit "bc1q..." addresses
+    VANITY_ADDR_P2SH_P2WPKH = 2, // Nested segwit "3..." addresses
+    VANITY_ADDR_P2TR = 3         // Taproot "bc1p..." addresses, key path only (BIP86)
+} vanity_addr_t;
+
+// Stages timed by builds with VANITY_PROFILE, see vanity_get_profile()
+typedef enum {
+    VANITY_PROFILE_SCALAR = 0,  // Private keys: RNG reseeds and the walk
+    VANITY_PROFILE_EC,          // Public keys
+    VANITY_PROFILE_SHA256,      // First half of HASH160
+    VANITY_PROFILE_RIPEMD160,   // Second half of HASH160
+    VANITY_PROFILE_TWEAK,       // Taproot tweak, in place of HASH160
+    VANITY_PROFILE_ENCODE,      // Address checksum and encoding
+    VANITY_PROFILE_MATCH,       // Pattern test
+    VANITY_PROFILE_STAGES
+} vanity_profile_stage_t;
+
+// Time spent per stage, in the unit given by vanity_profile_unit()
+typedef struct {
+    uint64_t ticks[VANITY_PROFILE_STAGES];
+    uint64_t candidates;        // Candidates the ticks cover
+} VanityProfile;
+
+#define VANITY_MAX_THREADS   64  // Worker threads per search
+#define VANITY_TUNE_HOST_LEN 96  // Buffer for vanity_tune_host()
 
 // Forward declarations
 typedef struct VanitySearch VanitySearch;
 
+// Settings and candidate rate of one calibration run
+typedef struct {
+    int threads;
+    size_t batch_size;
+    double rate;                // Candidates per second
+} VanityTuning;
+
+// Called after every calibration run
+typedef void (*vanity_tune_cb)(const VanityTuning *trial, void *user_data);
+
+// One match of a continuous search
+typedef struct {
+    char wif[PRIVKEY_WIF_LENGTH_MAX + 1]; // Empty for an xpub search
+    char address[KEYBATCH_ADDR_LEN];
+    int64_t index;              // Child index of an xpub search, -1 otherwise
+    int pattern_id;             // Pattern id in the pattern file, 0 otherwise
+    const char *pattern;        // Pattern text, owned by the search
+    uint64_t attempts;          // Total attempts when the match was found
+    uint64_t timestamp_ms;      // Wall clock time found, ms since the epoch
+} VanityResult;
+
 // Progress callback type
 typedef void (*vanity_progress_cb)(uint64_t attempts, double rate, void *user_data);
 
@@ -24,13 +76,139 @@ typedef void (*vanity_progress_cb)(uint64_t attempts, double rate, void *user_da
  * Initialize vanity address search
  * 
  * @param search Pointer to search context pointer
- * @param pattern Pattern to search for
+ * @param pattern Pattern to search for, NULL if a pattern file is set
  * @param case_sensitive Whether pattern matching is case sensitive
  * @param num_threads Number of threads to use
  * @return 0 on success, -1 on error
  */
 int vanity_init(VanitySearch **search, const char *pattern, bool case_sensitive, int num_threads);
 
+/**
+ * Select the address type to search (before vanity_start)
+ * 
+ * @param search Search context
+ * @param type Address type
+ * @return 0 on success, -1 on error
+ */
+int vanity_set_address_type(VanitySearch *search, vanity_addr_t type);
+
+/**
+ * Also test the uncompressed P2PKH address of every key (before
+ * vanity_start). The EC work is shared, so this nearly doubles the
+ * addresses tried per second; results carry a WIF with the matching
+ * compression flag. Attempts count addresses, not keys.
+ *
+ * @param search Search context
+ * @param uncompressed Whether to test uncompressed addresses too
+ * @return 0 on success, -1 on error (segwit has no uncompressed form)
+ */
+int vanity_set_uncompressed(VanitySearch *search, bool uncompressed);
+
+/**
+ * Let every pattern character also match its look-alikes, 1/l/i, 0/o,
+ * 5/S and 8/B (before vanity_start). Each position of the prefix turns
+ * into a class, which makes the pattern likelier to match and the
+ * search shorter. Single base58 patterns only.
+ *
+ * @param search Search context
+ * @param confusable Whether look-alikes match
+ * @return 0 on success, -1 on error
+ */
+int vanity_set_confusable(VanitySearch *search, bool confusable);
+
+/**
+ * Make the search repeatable (before vanity_start). Each worker draws
+ * its bases from a ChaCha20 stream keyed by the seed and its thread id
+ * instead of the system RNG, so a run over the same candidates tests
+ * exactly the same keys. INSECURE: the keys follow from the seed. For
+ * benchmarks and checking kernels against each other only.
+ *
+ * @param search Search context
+ * @param seed Seed text
+ * @return 0 on success, -1 on error
+ */
+int vanity_set_seed(VanitySearch *search, const char *seed);
+
+/**
+ * Search the non-hardened children of an extended public key instead
+ * of private keys (before vanity_start). Candidates are child indices
+ * 0 to 2^31 - 1 in order, the search stops by itself once they are
+ * used up, and a match is reported as an index rather than a WIF.
+ * Compressed P2PKH, P2WPKH and P2SH-P2WPKH only; no range, seed or
+ * checkpoint.
+ *
+ * @param search Search context
+ * @param xpub Extended public key of the active network
+ * @return 0 on success, -1 on error
+ */
+int vanity_set_xpub(VanitySearch *search, const char *xpub);
+
+/**
+ * Set the number of candidates each thread pushes through the
+ * pipeline per batch (before vanity_start)
+ * 
+ * @param search Search context
+ * @param count Batch size, 1 to KEYBATCH_MAX
+ * @return 0 on success, -1 on error
+ */
+int vanity_set_batch_size(VanitySearch *search, size_t count);
+
+/**
+ * Replace the kernel of one pipeline stage (before vanity_start). The
+ * address type selects the default kernels; a replacement must produce
+ * the same batch arrays as the kernel it replaces.
+ * 
+ * @param search Search context
+ * @param stage Stage to replace
+ * @param kernel New kernel, NULL skips the stage
+ * @return 0 on success, -1 on error
+ */
+int vanity_set_kernel(VanitySearch *search, keybatch_stage_t stage, keybatch_kernel kernel);
+
+/**
+ * Search for every pattern in a file at once (before vanity_start).
+ * The file is loaded with the address type and case sensitivity in
+ * effect when the search starts; see patternset_load() for its format.
+ * 
+ * @param search Search context
+ * @param path Pattern file
+ * @return 0 on success, -1 on error
+ */
+int vanity_set_pattern_file(VanitySearch *search, const char *path);
+
+/**
+ * Periodically save the search state to a file (before vanity_start).
+ * The checkpoint holds every thread's attempts and walk position, the
+ * elapsed time and a hash of the pattern. It is rewritten once more when
+ * the search stops and removed when a key is found.
+ * 
+ * @param search Search context
+ * @param path Checkpoint file
+ * @param interval_ms Milliseconds between checkpoints, 0 for the default
+ * @return 0 on success, -1 on error
+ */
+int vanity_set_checkpoint(VanitySearch *search, const char *path, int interval_ms);
+
+/**
+ * Continue a search from a checkpoint (after the address type is set,
+ * before vanity_start). The pattern, case sensitivity, address type and
+ * network must match the checkpointed search; the thread count is taken
+ * from the checkpoint.
+ * 
+ * @param search Search context
+ * @param path Checkpoint file
+ * @return 0 on success, -1 on error
+ */
+int vanity_resume(VanitySearch *search, const char *path);
+
+/**
+ * Get the number of worker threads
+ * 
+ * @param search Search context
+ * @return Thread count
+ */
+int vanity_get_threads(VanitySearch *search);
+
 /**
  * Start the vanity address search
  * 
@@ -70,6 +248,104 @@ bool vanity_is_stopped(VanitySearch *search);
  */
 uint64_t vanity_get_attempts(VanitySearch *search);
 
+/**
+ * Get the attempts of one worker thread
+ * 
+ * @param search Search context
+ * @param thread Worker number
+ * @return Number of attempts
+ */
+uint64_t vanity_get_thread_attempts(VanitySearch *search, int thread);
+
+/**
+ * Get the number of matches found so far, queued or taken
+ * 
+ * @param search Search context
+ * @return Number of matches
+ */
+uint64_t vanity_get_matches(VanitySearch *search);
+
+/**
+ * Get the number of continuous mode matches waiting in the queue
+ * 
+ * @param search Search context
+ * @return Queued matches
+ */
+size_t vanity_get_queue_depth(VanitySearch *search);
+
+/**
+ * Check the search's pattern with pattern_analyze(): impossible, or at
+ * the given rate slower than max_seconds, and what would do instead.
+ * Works before vanity_start. Single base58 patterns without look-alikes
+ * only.
+ * 
+ * @param search Search context
+ * @param rate Candidates tried per second, 0 if unknown
+ * @param max_seconds Expected runtime that makes the pattern slow, 0 for no limit
+ * @param analysis Filled in with the verdict and alternatives
+ * @return 0 on success, -1 on error
+ */
+int vanity_analyze(VanitySearch *search, double rate, double max_seconds, pattern_analysis_t *analysis);
+
+/**
+ * Get the chance that one candidate matches, known once the search has
+ * started. Prefixes are exact; suffixes and substrings in a pattern set
+ * are estimated.
+ * 
+ * @param search Search context
+ * @return Probability per candidate, 0 if unknown
+ */
+double vanity_get_probability(VanitySearch *search);
+
+/**
+ * Get the number of candidates after which a match has been found with
+ * a given chance. Candidates are independent, so this is the same from
+ * any point of a search.
+ * 
+ * @param probability Chance that one candidate matches
+ * @param quantile Chance of a match, e.g. 0.5, 0.9 or 0.99
+ * @return Candidates, or -1 if either argument is out of range
+ */
+double vanity_quantile_attempts(double probability, double quantile);
+
+/**
+ * Get the time from now until the chance of the next match reaches a
+ * quantile, at the average rate of the search so far
+ * 
+ * @param search Started search context
+ * @param quantile Chance of a match, e.g. 0.5, 0.9 or 0.99
+ * @return Seconds, or -1 if unknown (no probability or no rate yet)
+ */
+double vanity_get_eta(VanitySearch *search, double quantile);
+
+/**
+ * Get the unit of profile ticks: "cycles" (x86 TSC), "ticks" (arm64
+ * generic timer) or "ns"
+ * 
+ * @return Unit name, NULL if this build was made without VANITY_PROFILE
+ */
+const char *vanity_profile_unit(void);
+
+/**
+ * Get the short name of a profiled stage
+ * 
+ * @param stage A vanity_profile_stage_t
+ * @return Stage name, "unknown" if out of range
+ */
+const char *vanity_profile_stage_name(int stage);
+
+/**
+ * Get the time spent in every pipeline stage since the search started.
+ * Only builds with VANITY_PROFILE keep these counts; the hot path has
+ * no timing code otherwise.
+ * 
+ * @param search Started search context
+ * @param thread Worker number, or -1 for the sum over all workers
+ * @param profile Filled with the counts
+ * @return 0 on success, -1 if unavailable
+ */
+int vanity_get_profile(VanitySearch *search, int thread, VanityProfile *profile);
+
 /**
  * Get elapsed time in milliseconds
  * 
@@ -88,6 +364,15 @@ uint64_t vanity_get_elapsed(VanitySearch *search);
  */
 int vanity_get_wif(VanitySearch *search, char *wif, size_t wif_size);
 
+/**
+ * Get the child index of the match of an xpub search
+ *
+ * @param search Search context
+ * @param index Set to the index
+ * @return 0 on success, -1 on error
+ */
+int vanity_get_index(VanitySearch *search, uint32_t *index);
+
 /**
  * Get found Bitcoin address
  * 
@@ -98,6 +383,191 @@ int vanity_get_wif(VanitySearch *search, char *wif, size_t wif_size);
  */
 int vanity_get_address(VanitySearch *search, char *address, size_t address_size);
 
+/**
+ * Derive the address a WIF key has as a given address type, to check a
+ * key this search did not produce itself
+ * 
+ * @param address Buffer of at least KEYBATCH_ADDR_LEN bytes
+ * @param wif Key in WIF, of the current network
+ * @param type Address type
+ * @param uncompressed Whether uncompressed keys are allowed (P2PKH only)
+ * @return 0 on success, -1 if the key is invalid or doesn't fit the type
+ */
+int vanity_address_from_wif(char *address, const char *wif, vanity_addr_t type, bool uncompressed);
+
+/**
+ * Keep searching after a match (before vanity_start). Every match is
+ * queued for vanity_next_result() and the search runs until either
+ * limit is reached or it is stopped; vanity_found() stays false.
+ * 
+ * @param search Search context
+ * @param max_results Stop after this many matches, 0 for no limit
+ * @param max_ms Stop after this many milliseconds, 0 for no limit
+ * @return 0 on success, -1 on error
+ */
+int vanity_set_continuous(VanitySearch *search, uint64_t max_results, uint64_t max_ms);
+
+/**
+ * Take the next match of a continuous search off the queue. Matches
+ * found before the search stopped stay queued until they are taken.
+ * 
+ * @param search Search context
+ * @param result Filled with the match
+ * @return 1 if a match was taken, 0 if none is waiting
+ */
+int vanity_next_result(VanitySearch *search, VanityResult *result);
+
+/**
+ * Wait until something happens to the search: a match is queued or
+ * found, the search stops, pauses or resumes. Events since the last
+ * call count, so none is missed between calls. Meant for the one
+ * thread consuming the search.
+ * 
+ * @param search Search context
+ * @param timeout_ms Longest wait, 0 to only check, negative for no limit
+ * @return 1 after an event, 0 on timeout, -1 on error
+ */
+int vanity_wait(VanitySearch *search, int timeout_ms);
+
+/**
+ * Get a descriptor that polls readable whenever vanity_wait() would
+ * return an event, for callers that wait on other descriptors too.
+ * vanity_wait(search, 0) takes the event and clears it.
+ * 
+ * @param search Search context
+ * @return Descriptor owned by the search, or -1 on error
+ */
+int vanity_get_event_fd(VanitySearch *search);
+
+/**
+ * Pause a running search. Workers finish their current batch and wait;
+ * elapsed time, time limits and checkpoints leave out the pause.
+ * 
+ * @param search Search context
+ * @return 0 on success, -1 on error
+ */
+int vanity_pause(VanitySearch *search);
+
+/**
+ * Let a paused search carry on
+ * 
+ * @param search Search context
+ * @return 0 on success, -1 on error
+ */
+int vanity_unpause(VanitySearch *search);
+
+/**
+ * Check if the search is paused
+ * 
+ * @param search Search context
+ * @return true if paused, false otherwise
+ */
+bool vanity_is_paused(VanitySearch *search);
+
+/**
+ * Find the batch size and thread count with the highest candidate rate
+ * on this machine. Every batch size is measured with max_threads
+ * threads, then smaller thread counts with the best batch size. Runs
+ * copies of the search (pattern, address type, placement) for trial_ms
+ * each; matches found meanwhile are discarded and search itself is not
+ * started.
+ * 
+ * @param search Configured search used as the template
+ * @param max_threads Most threads to try, normally the online CPU count
+ * @param trial_ms Measuring time per setting
+ * @param best Filled with the fastest setting
+ * @param callback Called with every measurement, may be NULL
+ * @param user_data Passed to callback
+ * @return 0 on success, -1 on error
+ */
+int vanity_tune(VanitySearch *search, int max_threads, int trial_ms, VanityTuning *best,
+                vanity_tune_cb callback, void *user_data);
+
+/**
+ * Describe this machine (architecture and online CPU count) so tuning
+ * results cached in a shared config are only applied where they were
+ * measured
+ * 
+ * @param host Buffer for the description
+ * @param size Buffer size, VANITY_TUNE_HOST_LEN is enough
+ * @return 0 on success, -1 on error
+ */
+int vanity_tune_host(char *host, size_t size);
+
+/**
+ * Add one pattern to search for (before vanity_start). Added patterns
+ * form a pattern set together with any pattern file, in the order
+ * added, after the file's; see patternset_add() for the syntax.
+ * 
+ * @param search Search context
+ * @param pattern Pattern text
+ * @return 0 on success, -1 on error
+ */
+int vanity_add_pattern(VanitySearch *search, const char *pattern);
+
+/**
+ * Search a fixed keyspace range instead of random bases (before
+ * vanity_start). Candidates are base + 1 to base + length. Threads
+ * claim chunks of the range in order and the search stops by itself
+ * once every candidate was tried. In continuous mode the first key
+ * found also ends it, as the rest of the range is a short walk from
+ * that key. Not for resumed searches.
+ * 
+ * @param search Search context
+ * @param base KEYBATCH_SCALAR_LEN byte big endian scalar, base + length
+ *        must stay below the curve order
+ * @param length Number of keys, a multiple of the batch size
+ * @return 0 on success, -1 on error
+ */
+int vanity_set_range(VanitySearch *search, const unsigned char *base, uint64_t length);
+
+/**
+ * Check whether a range search is done with its range: every candidate
+ * was tried, or a continuous search revealed a key of it
+ * 
+ * @param search Search context
+ * @return true if the range is used up
+ */
+bool vanity_is_exhausted(VanitySearch *search);
+
+/**
+ * Pin every worker to its own CPU (before vanity_start). Workers go to
+ * physical cores first, filling one NUMA node before the next, and
+ * allocate their key batches after pinning so the memory is local to
+ * their node.
+ * 
+ * @param search Search context
+ * @param skip_smt Use only the first hardware thread of each core
+ * @return 0 on success, -1 on error
+ */
+int vanity_set_affinity(VanitySearch *search, bool skip_smt);
+
+/**
+ * Get the topology workers were placed on
+ * 
+ * @param search Search context
+ * @return Topology, or NULL if the search is not pinned or not started
+ */
+const Topology *vanity_get_topology(VanitySearch *search);
+
+/**
+ * Get the CPU a worker is pinned to
+ * 
+ * @param search Search context
+ * @param thread Worker number
+ * @param node Set to the NUMA node of the CPU, may be NULL
+ * @return Logical CPU number, or -1 if the worker is not pinned
+ */
+int vanity_get_worker_cpu(VanitySearch *search, int thread, int *node);
+
+/**
+ * Get the pattern the found address matched
+ * 
+ * @param search Search context
+ * @return Pattern text, or NULL if nothing was found
+ */
+const char *vanity_get_pattern(VanitySearch *search);
+
 /**
  * Set progress callback
  * 
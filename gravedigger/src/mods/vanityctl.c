@@ -0,0 +1,483 @@
+/*
+ * Copyright (c) 2023 Brian Barto
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GPL License. See LICENSE for more details.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#ifdef __linux__
+#include <sys/signalfd.h>
+#endif
+#include "vanityctl.h"
+#include "json.h"
+#include "error.h"
+
+// One control connection with whatever part of a command has arrived
+typedef struct {
+    int fd;
+    char buf[VANITYCTL_LINE_MAX];
+    size_t len;
+} Client;
+
+struct VanityControl {
+    VanitySearch *search;
+    int signal_fd;              // SIGINT and SIGTERM arrive here
+    sigset_t old_mask;
+#ifndef __linux__
+    struct sigaction old_int, old_term;
+#endif
+    char *path;                 // Control socket, NULL for none
+    int listen_fd;
+    bool stopping;              // A client asked to stop
+    Client clients[VANITYCTL_MAX_CLIENTS];
+};
+
+#ifndef __linux__
+/*
+ * Without signalfd the handler writes to a pipe instead. It is the only
+ * thing the handler does, so it is safe on any thread.
+ */
+static int signal_pipe[2] = { -1, -1 };
+
+static void signal_handler(int sig) {
+    unsigned char c = (unsigned char)sig;
+    int saved = errno;
+
+    if (write(signal_pipe[1], &c, 1) < 0) {
+        // Full already means a signal is waiting
+    }
+    errno = saved;
+}
+#endif
+
+static int signals_open(VanityControl *ctl) {
+    sigset_t mask;
+
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGINT);
+    sigaddset(&mask, SIGTERM);
+
+#ifdef __linux__
+    // Blocked signals stay pending for the descriptor, on every thread
+    // started after this
+    if (pthread_sigmask(SIG_BLOCK, &mask, &ctl->old_mask) != 0) {
+        error_log("Could not block signals");
+        return -1;
+    }
+    ctl->signal_fd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (ctl->signal_fd < 0) {
+        error_log("Could not create signal descriptor");
+        pthread_sigmask(SIG_SETMASK, &ctl->old_mask, NULL);
+        return -1;
+    }
+#else
+    struct sigaction sa;
+
+    if (pipe(signal_pipe) < 0 || fcntl(signal_pipe[0], F_SETFL, O_NONBLOCK) < 0 ||
+        fcntl(signal_pipe[1], F_SETFL, O_NONBLOCK) < 0) {
+        error_log("Could not create signal pipe");
+        return -1;
+    }
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = signal_handler;
+    sigaction(SIGINT, &sa, &ctl->old_int);
+    sigaction(SIGTERM, &sa, &ctl->old_term);
+    ctl->signal_fd = signal_pipe[0];
+#endif
+
+    return 0;
+}
+
+// Returns 1 if a signal was waiting
+static int signals_drain(VanityControl *ctl) {
+    char buf[256];
+    int r = 0;
+
+    while (read(ctl->signal_fd, buf, sizeof(buf)) > 0) {
+        r = 1;
+    }
+    return r;
+}
+
+static void signals_close(VanityControl *ctl) {
+    if (ctl->signal_fd < 0) {
+        return;
+    }
+
+    // Take what is pending so unblocking doesn't deliver it after all
+    signals_drain(ctl);
+#ifdef __linux__
+    close(ctl->signal_fd);
+    pthread_sigmask(SIG_SETMASK, &ctl->old_mask, NULL);
+#else
+    sigaction(SIGINT, &ctl->old_int, NULL);
+    sigaction(SIGTERM, &ctl->old_term, NULL);
+    close(signal_pipe[0]);
+    close(signal_pipe[1]);
+    signal_pipe[0] = signal_pipe[1] = -1;
+#endif
+    ctl->signal_fd = -1;
+}
+
+/*
+ * Listen on the control socket, readable by its owner only. A socket
+ * left behind by a search that died is replaced; one that still answers
+ * belongs to a running search and is left alone.
+ */
+static int socket_open(VanityControl *ctl, const char *path) {
+    struct sockaddr_un sa;
+    struct stat st;
+    mode_t old_umask;
+    int fd, r;
+
+    if (strlen(path) == 0 || strlen(path) >= sizeof(sa.sun_path)) {
+        error_log("Invalid control socket path %s", path);
+        return -1;
+    }
+    memset(&sa, 0, sizeof(sa));
+    sa.sun_family = AF_UNIX;
+    strcpy(sa.sun_path, path);
+
+    if (lstat(path, &st) == 0) {
+        if (!S_ISSOCK(st.st_mode)) {
+            error_log("%s exists and is not a socket", path);
+            return -1;
+        }
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        r = fd >= 0 ? connect(fd, (struct sockaddr *)&sa, sizeof(sa)) : -1;
+        if (fd >= 0) {
+            close(fd);
+        }
+        if (r == 0) {
+            error_log("Another search is using control socket %s", path);
+            return -1;
+        }
+        unlink(path);
+    }
+
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        error_log("Could not create control socket");
+        return -1;
+    }
+    old_umask = umask(077);
+    r = bind(fd, (struct sockaddr *)&sa, sizeof(sa));
+    umask(old_umask);
+    if (r < 0 || listen(fd, VANITYCTL_MAX_CLIENTS) < 0 || fcntl(fd, F_SETFL, O_NONBLOCK) < 0) {
+        error_log("Could not listen on control socket %s", path);
+        close(fd);
+        return -1;
+    }
+
+    ctl->path = strdup(path);
+    if (!ctl->path) {
+        error_log("Memory allocation error.");
+        close(fd);
+        unlink(path);
+        return -1;
+    }
+    ctl->listen_fd = fd;
+    return 0;
+}
+
+static const char *state_name(VanityControl *ctl) {
+    if (vanity_found(ctl->search)) {
+        return "found";
+    }
+    if (ctl->stopping) {
+        return "stopping";
+    }
+    if (vanity_is_stopped(ctl->search)) {
+        return "stopped";
+    }
+    return vanity_is_paused(ctl->search) ? "paused" : "running";
+}
+
+static void client_close(Client *client) {
+    if (client->fd >= 0) {
+        close(client->fd);
+    }
+    memset(client, 0, sizeof(*client));
+    client->fd = -1;
+}
+
+// Send one JSON object as a line; a client that can't take it is dropped
+static void client_reply(Client *client, cJSON *jobj) {
+    char *line = cJSON_PrintUnformatted(jobj);
+    size_t len, sent = 0;
+    ssize_t r;
+
+    if (!line) {
+        error_log("Could not format control reply.");
+        client_close(client);
+        return;
+    }
+    len = strlen(line);
+    line[len++] = '\n';  // Replaces the terminator, send() doesn't need it
+
+    while (sent < len) {
+        r = send(client->fd, line + sent, len - sent, MSG_NOSIGNAL);
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0) break;
+        sent += r;
+    }
+    free(line);
+    if (sent < len) {
+        client_close(client);
+    }
+}
+
+// Per candidate stage times, with the unit, in a VANITY_PROFILE build
+static int profile_json(VanitySearch *search, cJSON *jobj) {
+    VanityProfile profile;
+    cJSON *stages = NULL, *threads = NULL;
+    char key[16];
+    int r = -1;
+
+    if (vanity_get_profile(search, -1, &profile) < 0 ||
+        json_add_string(jobj, (char *)vanity_profile_unit(), "unit") < 0 ||
+        json_add_number(jobj, (double)profile.candidates, "candidates") < 0 ||
+        json_init_object(&stages) < 0 || json_init_object(&threads) < 0) {
+        goto out;
+    }
+    for (int i = 0; i < VANITY_PROFILE_STAGES; i++) {
+        double ticks = profile.candidates ? (double)profile.ticks[i] / profile.candidates : 0.0;
+        if (json_add_number(stages, ticks, (char *)vanity_profile_stage_name(i)) < 0) {
+            goto out;
+        }
+    }
+    for (int t = 0; t < vanity_get_threads(search); t++) {
+        uint64_t total = 0;
+        if (vanity_get_profile(search, t, &profile) < 0) {
+            goto out;
+        }
+        for (int i = 0; i < VANITY_PROFILE_STAGES; i++) {
+            total += profile.ticks[i];
+        }
+        snprintf(key, sizeof(key), "%d", t);
+        if (json_add_number(threads, profile.candidates ? (double)total / profile.candidates : 0.0, key) < 0) {
+            goto out;
+        }
+    }
+    if (json_add_object(jobj, stages, "stages") > 0 && json_add_object(jobj, threads, "threads") > 0) {
+        r = 0;
+    }
+
+out:
+    if (stages) json_free(stages);
+    if (threads) json_free(threads);
+    return r;
+}
+
+static void client_command(VanityControl *ctl, Client *client, const char *command) {
+    VanitySearch *search = ctl->search;
+    cJSON *jobj = NULL;
+    uint64_t attempts, elapsed;
+
+    if (strcmp(command, "pause") == 0) {
+        vanity_pause(search);
+    } else if (strcmp(command, "resume") == 0) {
+        vanity_unpause(search);
+    } else if (strcmp(command, "stop") == 0) {
+        ctl->stopping = true;
+    } else if (strcmp(command, "profile") == 0) {
+        if (json_init_object(&jobj) > 0) {
+            if (!vanity_profile_unit()) {
+                if (json_add_string(jobj, "built without VANITY_PROFILE", "error") > 0) {
+                    client_reply(client, jobj);
+                }
+            } else if (profile_json(search, jobj) == 0) {
+                client_reply(client, jobj);
+            } else {
+                error_log("Could not format control reply.");
+                client_close(client);
+            }
+            json_free(jobj);
+        }
+        return;
+    } else if (strcmp(command, "status") != 0) {
+        if (json_init_object(&jobj) > 0 && json_add_string(jobj, "unknown command", "error") > 0) {
+            client_reply(client, jobj);
+        }
+        if (jobj) {
+            json_free(jobj);
+        }
+        return;
+    }
+
+    attempts = vanity_get_attempts(search);
+    elapsed = vanity_get_elapsed(search);
+    if (json_init_object(&jobj) < 0 ||
+        json_add_string(jobj, (char *)state_name(ctl), "state") < 0 ||
+        json_add_number(jobj, (double)attempts, "attempts") < 0 ||
+        json_add_number(jobj, elapsed / 1000.0, "elapsed") < 0 ||
+        json_add_number(jobj, elapsed > 0 ? attempts * 1000.0 / elapsed : 0.0, "rate") < 0 ||
+        json_add_number(jobj, vanity_get_threads(search), "threads") < 0) {
+        error_log("Could not format control reply.");
+        client_close(client);
+    } else {
+        client_reply(client, jobj);
+    }
+    if (jobj) {
+        json_free(jobj);
+    }
+}
+
+// Answer every complete command that has arrived
+static void client_read(VanityControl *ctl, Client *client) {
+    ssize_t r;
+    char *end;
+
+    do {
+        r = recv(client->fd, client->buf + client->len, sizeof(client->buf) - client->len, 0);
+    } while (r < 0 && errno == EINTR);
+    if (r < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+        return;
+    }
+    if (r <= 0) {
+        client_close(client);
+        return;
+    }
+    client->len += r;
+
+    while (client->fd >= 0 && (end = memchr(client->buf, '\n', client->len)) != NULL) {
+        size_t len = end - client->buf;
+        *end = '\0';
+        if (len > 0 && client->buf[len - 1] == '\r') {
+            client->buf[len - 1] = '\0';
+        }
+        client_command(ctl, client, client->buf);
+        if (client->fd < 0) {
+            return;
+        }
+        client->len -= len + 1;
+        memmove(client->buf, end + 1, client->len);
+    }
+
+    if (client->len == sizeof(client->buf)) {
+        error_log("Dropping control client with an overlong command");
+        client_close(client);
+    }
+}
+
+int vanityctl_open(VanityControl **ctl, VanitySearch *search, const char *path) {
+    VanityControl *c;
+
+    if (!ctl || !search) {
+        error_log("Invalid control parameters");
+        return -1;
+    }
+
+    c = calloc(1, sizeof(VanityControl));
+    if (!c) {
+        error_log("Memory allocation error.");
+        return -1;
+    }
+    c->search = search;
+    c->signal_fd = -1;
+    c->listen_fd = -1;
+    for (int i = 0; i < VANITYCTL_MAX_CLIENTS; i++) {
+        c->clients[i].fd = -1;
+    }
+
+    if (signals_open(c) < 0 || (path && socket_open(c, path) < 0)) {
+        vanityctl_close(c);
+        return -1;
+    }
+
+    *ctl = c;
+    return 0;
+}
+
+int vanityctl_wait(VanityControl *ctl, int timeout_ms) {
+    struct pollfd fds[3 + VANITYCTL_MAX_CLIENTS];
+    int events = 0;
+
+    if (!ctl) {
+        return -1;
+    }
+
+    fds[0] = (struct pollfd){ ctl->signal_fd, POLLIN, 0 };
+    fds[1] = (struct pollfd){ vanity_get_event_fd(ctl->search), POLLIN, 0 };
+    fds[2] = (struct pollfd){ ctl->listen_fd, POLLIN, 0 };
+    for (int i = 0; i < VANITYCTL_MAX_CLIENTS; i++) {
+        fds[3 + i] = (struct pollfd){ ctl->clients[i].fd, POLLIN, 0 };
+    }
+
+    if (poll(fds, 3 + VANITYCTL_MAX_CLIENTS, timeout_ms) < 0) {
+        if (errno == EINTR) {
+            return 0;
+        }
+        error_log("Could not wait for search events");
+        return -1;
+    }
+
+    if ((fds[0].revents & POLLIN) && signals_drain(ctl)) {
+        events |= VANITYCTL_INTERRUPT;
+    }
+    if ((fds[1].revents & POLLIN) && vanity_wait(ctl->search, 0) > 0) {
+        events |= VANITYCTL_EVENT;
+    }
+
+    for (int i = 0; i < VANITYCTL_MAX_CLIENTS; i++) {
+        if (ctl->clients[i].fd >= 0 && (fds[3 + i].revents & (POLLIN | POLLHUP | POLLERR))) {
+            client_read(ctl, &ctl->clients[i]);
+        }
+    }
+
+    // Connections beyond the client limit are turned away. Clients don't
+    // block, so one that stops reading can't hold up the search.
+    if (fds[2].revents & POLLIN) {
+        int fd;
+        while ((fd = accept(ctl->listen_fd, NULL, NULL)) >= 0) {
+            int slot = -1;
+            if (fcntl(fd, F_SETFL, O_NONBLOCK) < 0) {
+                close(fd);
+                continue;
+            }
+            for (int i = 0; i < VANITYCTL_MAX_CLIENTS && slot < 0; i++) {
+                if (ctl->clients[i].fd < 0) {
+                    slot = i;
+                }
+            }
+            if (slot < 0) {
+                close(fd);
+                continue;
+            }
+            ctl->clients[slot].fd = fd;
+            ctl->clients[slot].len = 0;
+        }
+    }
+
+    if (ctl->stopping) {
+        events |= VANITYCTL_STOP;
+    }
+    return events;
+}
+
+void vanityctl_close(VanityControl *ctl) {
+    if (!ctl) return;
+
+    for (int i = 0; i < VANITYCTL_MAX_CLIENTS; i++) {
+        client_close(&ctl->clients[i]);
+    }
+    if (ctl->listen_fd >= 0) {
+        close(ctl->listen_fd);
+        unlink(ctl->path);
+    }
+    free(ctl->path);
+    signals_close(ctl);
+    free(ctl);
+}
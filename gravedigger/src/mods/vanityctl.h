@@ -0,0 +1,68 @@
+/*
+ * Copyright (c) 2023 Brian Barto
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GPL License. See LICENSE for more details.
+ */
+
+#ifndef VANITYCTL_H
+#define VANITYCTL_H
+
+#include "vanity.h"
+
+#define VANITYCTL_MAX_CLIENTS 8
+#define VANITYCTL_LINE_MAX    128  // Longest command line
+
+// What vanityctl_wait() woke up for, any combination
+#define VANITYCTL_EVENT     1  // The search has news, see vanity_wait()
+#define VANITYCTL_INTERRUPT 2  // SIGINT or SIGTERM arrived
+#define VANITYCTL_STOP      4  // A control client asked to stop
+
+/*
+ * Clients of the control socket send one command per line and get one
+ * JSON object per line back:
+ *
+ *   status   {"state":..., "attempts":..., "elapsed":..., "rate":..., "threads":...}
+ *   pause    the status after pausing
+ *   resume   the status after resuming
+ *   stop     the status, with state "stopping"; the search owner stops it
+ *   profile  {"unit":..., "candidates":..., "stages":{...}, "threads":{...}},
+ *            time per candidate, from builds with VANITY_PROFILE only
+ *
+ * state is one of running, paused, stopping, stopped or found. Anything
+ * else gets {"error":"unknown command"}.
+ */
+
+typedef struct VanityControl VanityControl;
+
+/**
+ * Take over SIGINT and SIGTERM and, with a path, listen for commands.
+ * Call before vanity_start() so the search's threads inherit the
+ * blocked signals and every signal reaches the control descriptor.
+ *
+ * @param ctl Set to the new control context
+ * @param search Search to control
+ * @param path Unix socket path for commands, NULL for none
+ * @return 0 on success, -1 on error
+ */
+int vanityctl_open(VanityControl **ctl, VanitySearch *search, const char *path);
+
+/**
+ * Sleep until a signal, a search event or a command arrives. Status,
+ * pause and resume are answered here; a search event is taken with
+ * vanity_wait().
+ *
+ * @param ctl Control context
+ * @param timeout_ms Longest wait, negative for no limit
+ * @return VANITYCTL_* flags, 0 if nothing needs the caller, -1 on error
+ */
+int vanityctl_wait(VanityControl *ctl, int timeout_ms);
+
+/**
+ * Remove the control socket and give the signals back
+ *
+ * @param ctl Control context, may be NULL
+ */
+void vanityctl_close(VanityControl *ctl);
+
+#endif // VANITYCTL_H
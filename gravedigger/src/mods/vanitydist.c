@@ -0,0 +1,968 @@
+/*
+ * Copyright (c) 2023 Brian Barto
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GPL License. See LICENSE for more details.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <inttypes.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <poll.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include "vanitydist.h"
+#include "patternset.h"
+#include "network.h"
+#include "random.h"
+#include "crypto.h"
+#include "hex.h"
+#include "error.h"
+
+#define VANITYDIST_BUFFER    (VANITYDIST_LINE_MAX * 4)
+#define VANITYDIST_TOKENS    8
+#define VANITYDIST_POLL_MS   100
+#define VANITYDIST_REPORT_MS 1000
+#define VANITYDIST_STOP_MS   1000  // Longest wait for workers to hang up after STOP
+#define VANITYDIST_NONCE_LEN 32
+#define VANITYDIST_AUTH_LEN  64    // HMAC-SHA512
+
+// One end of a connection with whatever part of a line has arrived
+typedef struct {
+    int fd;
+    char buf[VANITYDIST_BUFFER];
+    size_t len;
+} Conn;
+
+// A range as handed out; every range starts at its own random base
+typedef struct {
+    uint64_t id;
+    unsigned char base[KEYBATCH_SCALAR_LEN];
+} Range;
+
+// A connected worker as the coordinator sees it
+typedef struct {
+    Conn conn;
+    bool challenged;    // Sent HELLO, owes the answer to the challenge
+    unsigned char nonce[VANITYDIST_NONCE_LEN];
+    bool ready;         // Sent HELLO (and AUTH), got the job
+    int64_t range;      // Range being searched, -1 for none
+    unsigned char base[KEYBATCH_SCALAR_LEN]; // Its base
+    bool revealed;      // The range gave up a key
+    uint64_t progress;  // Attempts reported in that range
+    uint64_t last_seen; // Time of the last message
+} Worker;
+
+typedef struct {
+    const VanityDistJob *job;
+    PatternSet *set;        // Validated patterns, ids as the workers see them
+    uint64_t length;        // Candidates per range
+    uint64_t next_range;    // Next range never handed out
+    Range *orphans;         // Ranges of dead workers, handed out first
+    size_t orphan_count;
+    uint64_t done_attempts; // Attempts in finished ranges
+    uint64_t results;
+    Worker workers[VANITYDIST_MAX_WORKERS];
+} Coordinator;
+
+static uint64_t now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static bool is_loopback(const struct sockaddr *sa) {
+    if (sa->sa_family == AF_INET) {
+        return (ntohl(((const struct sockaddr_in *)sa)->sin_addr.s_addr) >> 24) == 127;
+    }
+    if (sa->sa_family == AF_INET6) {
+        const struct in6_addr *a = &((const struct sockaddr_in6 *)sa)->sin6_addr;
+        return IN6_IS_ADDR_LOOPBACK(a) || (IN6_IS_ADDR_V4MAPPED(a) && a->s6_addr[12] == 127);
+    }
+    return false;
+}
+
+/*
+ * Open a listening or connected stream socket for "unix:/path",
+ * "host:port" or ":port". ":port" listens on the loopback address;
+ * listening where other hosts can connect takes remote set.
+ */
+static int open_socket(const char *address, bool listening, bool remote) {
+    int fd = -1;
+
+    if (strncmp(address, "unix:", 5) == 0) {
+        struct sockaddr_un sa;
+        const char *path = address + 5;
+
+        if (strlen(path) == 0 || strlen(path) >= sizeof(sa.sun_path)) {
+            error_log("Invalid socket path %s", path);
+            return -1;
+        }
+        memset(&sa, 0, sizeof(sa));
+        sa.sun_family = AF_UNIX;
+        strcpy(sa.sun_path, path);
+
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0) {
+            error_log("Could not create socket");
+            return -1;
+        }
+        if (listening) {
+            unlink(path);
+            if (bind(fd, (struct sockaddr *)&sa, sizeof(sa)) < 0 || listen(fd, 16) < 0) {
+                error_log("Could not listen on %s", address);
+                close(fd);
+                return -1;
+            }
+        } else if (connect(fd, (struct sockaddr *)&sa, sizeof(sa)) < 0) {
+            error_log("Could not connect to %s", address);
+            close(fd);
+            return -1;
+        }
+        return fd;
+    }
+
+    const char *colon = strrchr(address, ':');
+    char host[256];
+    struct addrinfo hints, *res, *ai;
+
+    if (!colon || colon == address + strlen(address) - 1 || (size_t)(colon - address) >= sizeof(host)) {
+        error_log("Address must be unix:/path or host:port");
+        return -1;
+    }
+    memcpy(host, address, colon - address);
+    host[colon - address] = '\0';
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(host[0] ? host : NULL, colon + 1, &hints, &res) != 0) {
+        error_log("Could not resolve %s", address);
+        return -1;
+    }
+
+    for (ai = res; ai; ai = ai->ai_next) {
+        if (listening && !remote && !is_loopback(ai->ai_addr)) {
+            error_log("Listening on %s lets other hosts in; that needs a token", address);
+            freeaddrinfo(res);
+            return -1;
+        }
+        fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (fd < 0) {
+            continue;
+        }
+        if (listening) {
+            int one = 1;
+            setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+            if (bind(fd, ai->ai_addr, ai->ai_addrlen) == 0 && listen(fd, 16) == 0) {
+                break;
+            }
+        } else if (connect(fd, ai->ai_addr, ai->ai_addrlen) == 0) {
+            break;
+        }
+        close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(res);
+
+    if (fd < 0) {
+        error_log("Could not %s %s", listening ? "listen on" : "connect to", address);
+    }
+    return fd;
+}
+
+static int conn_send(Conn *conn, const char *format, ...) {
+    char line[VANITYDIST_LINE_MAX];
+    va_list args;
+    int len;
+
+    va_start(args, format);
+    len = vsnprintf(line, sizeof(line) - 1, format, args);
+    va_end(args);
+    if (len < 0 || len >= (int)sizeof(line) - 1) {
+        return -1;
+    }
+    line[len++] = '\n';
+
+    for (int sent = 0; sent < len; ) {
+        ssize_t r = send(conn->fd, line + sent, len - sent, MSG_NOSIGNAL);
+        if (r < 0 && errno == EINTR) {
+            continue;
+        }
+        if (r <= 0) {
+            memset(line, 0, sizeof(line));
+            return -1;
+        }
+        sent += r;
+    }
+    memset(line, 0, sizeof(line));
+    return 0;
+}
+
+// Read what has arrived, returns -1 on EOF or error
+static int conn_fill(Conn *conn) {
+    ssize_t r;
+
+    do {
+        r = recv(conn->fd, conn->buf + conn->len, sizeof(conn->buf) - conn->len, 0);
+    } while (r < 0 && errno == EINTR);
+
+    if (r <= 0) {
+        return -1;
+    }
+    conn->len += r;
+    return 0;
+}
+
+/*
+ * Take one complete line off the buffer, split into tokens. Returns 1
+ * for a line, 0 if none is complete yet, -1 for a line that is too long.
+ */
+static int conn_line(Conn *conn, char *line, char **tokens, int *count) {
+    char *end = memchr(conn->buf, '\n', conn->len);
+    char *save;
+    size_t len;
+
+    if (!end) {
+        return conn->len == sizeof(conn->buf) ? -1 : 0;
+    }
+    len = end - conn->buf;
+    if (len >= VANITYDIST_LINE_MAX) {
+        return -1;
+    }
+    memcpy(line, conn->buf, len);
+    line[len] = '\0';
+    conn->len -= len + 1;
+    memmove(conn->buf, end + 1, conn->len);
+    memset(conn->buf + conn->len, 0, len + 1);
+
+    *count = 0;
+    for (char *t = strtok_r(line, " \r", &save); t && *count < VANITYDIST_TOKENS; t = strtok_r(NULL, " \r", &save)) {
+        tokens[(*count)++] = t;
+    }
+    return 1;
+}
+
+static void conn_close(Conn *conn) {
+    if (conn->fd >= 0) {
+        close(conn->fd);
+    }
+    memset(conn, 0, sizeof(*conn));
+    conn->fd = -1;
+}
+
+static int parse_u64(const char *s, uint64_t *v) {
+    char *end;
+
+    errno = 0;
+    *v = strtoull(s, &end, 10);
+    return (errno || end == s || *end) ? -1 : 0;
+}
+
+/*
+ * Coordinator
+ */
+
+/*
+ * Ranges don't share a base, so no range tells a worker anything about
+ * the keys of another. Clearing the top bit keeps base + length below
+ * the curve order.
+ */
+static int assign_range(Coordinator *c, Worker *w) {
+    char hex[KEYBATCH_SCALAR_LEN * 2 + 1];
+    int r;
+
+    if (c->orphan_count) {
+        Range *orphan = &c->orphans[--c->orphan_count];
+        w->range = (int64_t)orphan->id;
+        memcpy(w->base, orphan->base, KEYBATCH_SCALAR_LEN);
+        memset(orphan, 0, sizeof(*orphan));
+    } else {
+        if (random_get(w->base, KEYBATCH_SCALAR_LEN) < 0) {
+            return -1;
+        }
+        w->base[0] &= 0x7F;
+        w->range = (int64_t)c->next_range++;
+    }
+    w->revealed = false;
+    w->progress = 0;
+
+    hex_encode(hex, w->base, KEYBATCH_SCALAR_LEN);
+    r = conn_send(&w->conn, "RANGE %" PRId64 " %s %" PRIu64, w->range, hex, c->length);
+    memset(hex, 0, sizeof(hex));
+    return r;
+}
+
+/*
+ * A worker that leaves mid-range leaves the whole range to someone
+ * else, unless the range already gave up a key: the rest of it is a
+ * short walk from that key.
+ */
+static void drop_worker(Coordinator *c, Worker *w) {
+    if (w->range >= 0 && !w->revealed) {
+        Range *orphans = realloc(c->orphans, (c->orphan_count + 1) * sizeof(Range));
+        if (orphans) {
+            c->orphans = orphans;
+            c->orphans[c->orphan_count].id = (uint64_t)w->range;
+            memcpy(c->orphans[c->orphan_count].base, w->base, KEYBATCH_SCALAR_LEN);
+            c->orphan_count++;
+        } else {
+            error_log("Range %" PRId64 " lost", w->range);
+        }
+    }
+    conn_close(&w->conn);
+    memset(w->base, 0, sizeof(w->base));
+    w->challenged = false;
+    w->ready = false;
+    w->revealed = false;
+    w->range = -1;
+    w->progress = 0;
+}
+
+static uint64_t total_attempts(const Coordinator *c) {
+    uint64_t total = c->done_attempts;
+
+    for (int i = 0; i < VANITYDIST_MAX_WORKERS; i++) {
+        total += c->workers[i].progress;
+    }
+    return total;
+}
+
+// Address type as named in the JOB line
+static const char *type_name(vanity_addr_t type) {
+    switch (type) {
+        case VANITY_ADDR_P2WPKH:
+            return "p2wpkh";
+        case VANITY_ADDR_P2SH_P2WPKH:
+            return "p2sh-p2wpkh";
+        case VANITY_ADDR_P2TR:
+            return "p2tr";
+        case VANITY_ADDR_P2PKH:
+        default:
+            return "p2pkh";
+    }
+}
+
+// Pattern set encoding of an address type
+static patternset_encoding_t type_encoding(vanity_addr_t type) {
+    switch (type) {
+        case VANITY_ADDR_P2WPKH:
+            return PATTERNSET_BECH32;
+        case VANITY_ADDR_P2SH_P2WPKH:
+            return PATTERNSET_P2SH;
+        case VANITY_ADDR_P2TR:
+            return PATTERNSET_BECH32M;
+        case VANITY_ADDR_P2PKH:
+        default:
+            return PATTERNSET_BASE58;
+    }
+}
+
+static int send_job(Coordinator *c, Worker *w) {
+    const VanityDistJob *job = c->job;
+
+    if (conn_send(&w->conn, "JOB %s %d %d %d", type_name(job->address_type),
+                  job->case_sensitive ? 1 : 0, network_is_test() ? 1 : 0, job->uncompressed ? 1 : 0) < 0) {
+        return -1;
+    }
+    for (size_t i = 0; i < patternset_count(c->set); i++) {
+        if (conn_send(&w->conn, "PATTERN %s", patternset_get(c->set, (int)i)) < 0) {
+            return -1;
+        }
+    }
+    return conn_send(&w->conn, "END");
+}
+
+// HMAC-SHA512 of a challenge under the shared token, in hex
+static void auth_response(char *hex, const char *token, const unsigned char *nonce) {
+    unsigned char mac[VANITYDIST_AUTH_LEN];
+
+    crypto_get_hmac_sha512(mac, (unsigned char *)token, strlen(token), (unsigned char *)nonce, VANITYDIST_NONCE_LEN);
+    hex_encode(hex, mac, VANITYDIST_AUTH_LEN);
+    memset(mac, 0, sizeof(mac));
+}
+
+// Compares every byte, so the time taken says nothing about the answer
+static bool auth_equal(const char *a, const char *b, size_t len) {
+    unsigned char diff = 0;
+
+    for (size_t i = 0; i < len; i++) {
+        diff |= (unsigned char)a[i] ^ (unsigned char)b[i];
+    }
+    return diff == 0;
+}
+
+// Returns -1 if the worker broke the protocol and has to go
+static int handle_line(Coordinator *c, Worker *w, char **tok, int n, vanitydist_result_cb result_cb,
+                       void *user_data) {
+    uint64_t id, attempts, pattern_id;
+
+    // With a token the worker proves it knows it before it learns the
+    // job or a range
+    if (n == 2 && strcmp(tok[0], "HELLO") == 0 && !w->ready && !w->challenged) {
+        char hex[VANITYDIST_NONCE_LEN * 2 + 1];
+
+        if (!c->job->token) {
+            w->ready = true;
+            return send_job(c, w) < 0 || assign_range(c, w) < 0 ? -1 : 0;
+        }
+        if (random_get(w->nonce, VANITYDIST_NONCE_LEN) < 0) {
+            return -1;
+        }
+        w->challenged = true;
+        hex_encode(hex, w->nonce, VANITYDIST_NONCE_LEN);
+        return conn_send(&w->conn, "CHALLENGE %s", hex);
+    }
+    if (n == 2 && strcmp(tok[0], "AUTH") == 0 && w->challenged) {
+        char expected[VANITYDIST_AUTH_LEN * 2 + 1];
+        bool valid;
+
+        auth_response(expected, c->job->token, w->nonce);
+        valid = strlen(tok[1]) == VANITYDIST_AUTH_LEN * 2 && auth_equal(tok[1], expected, VANITYDIST_AUTH_LEN * 2);
+        memset(expected, 0, sizeof(expected));
+        if (!valid) {
+            error_log("Worker failed to authenticate");
+            return -1;
+        }
+        w->challenged = false;
+        w->ready = true;
+        return send_job(c, w) < 0 || assign_range(c, w) < 0 ? -1 : 0;
+    }
+    if (!w->ready || n < 3 || parse_u64(tok[1], &id) < 0 || parse_u64(tok[2], &attempts) < 0 ||
+        w->range < 0 || id != (uint64_t)w->range) {
+        return -1;
+    }
+
+    if (n == 3 && strcmp(tok[0], "PROGRESS") == 0) {
+        w->progress = attempts;
+        return 0;
+    }
+
+    if (n == 3 && strcmp(tok[0], "DONE") == 0) {
+        c->done_attempts += attempts;
+        w->progress = 0;
+        w->range = -1;
+        return assign_range(c, w);
+    }
+
+    // Nothing a worker says is taken on trust: the key must derive the
+    // address and the address must match the pattern it claims
+    if (n == 6 && strcmp(tok[0], "MATCH") == 0) {
+        VanityResult result;
+        struct timespec now;
+        char address[KEYBATCH_ADDR_LEN];
+
+        if (parse_u64(tok[3], &pattern_id) < 0 || pattern_id >= patternset_count(c->set) ||
+            strlen(tok[4]) >= sizeof(result.address) || strlen(tok[5]) >= sizeof(result.wif)) {
+            return -1;
+        }
+        if (vanity_address_from_wif(address, tok[5], c->job->address_type, c->job->uncompressed) < 0 ||
+            strcmp(address, tok[4]) != 0 || patternset_match_address(c->set, address) != (int)pattern_id) {
+            error_log("Worker sent a key that does not match");
+            return -1;
+        }
+        w->revealed = true;
+        // Matches past the limit may still arrive before STOP does
+        if (c->job->max_results && c->results >= c->job->max_results) {
+            return 0;
+        }
+
+        w->progress = attempts;
+        memset(&result, 0, sizeof(result));
+        result.index = -1;
+        strcpy(result.address, tok[4]);
+        strcpy(result.wif, tok[5]);
+        result.pattern_id = (int)pattern_id;
+        result.pattern = patternset_get(c->set, (int)pattern_id);
+        result.attempts = total_attempts(c);
+        clock_gettime(CLOCK_REALTIME, &now);
+        result.timestamp_ms = (uint64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+        c->results++;
+        result_cb(&result, user_data);
+        memset(&result, 0, sizeof(result));
+        return 0;
+    }
+
+    return -1;
+}
+
+static int load_patterns(Coordinator *c) {
+    const VanityDistJob *job = c->job;
+
+    c->set = patternset_new(type_encoding(job->address_type), job->case_sensitive);
+    if (!c->set) {
+        return -1;
+    }
+    if (job->pattern_file && patternset_load(c->set, job->pattern_file) < 0) {
+        error_log("Could not load pattern file %s", job->pattern_file);
+        return -1;
+    }
+    if (job->pattern && patternset_add(c->set, job->pattern) < 0) {
+        return -1;
+    }
+    if (patternset_count(c->set) == 0 || patternset_compile(c->set) < 0) {
+        error_log("No valid patterns to search for");
+        return -1;
+    }
+    return 0;
+}
+
+int vanitydist_coordinate(const char *address, const VanityDistJob *job, vanitydist_result_cb result_cb,
+                          vanitydist_progress_cb progress_cb, void *user_data,
+                          volatile sig_atomic_t *stop) {
+    static Coordinator c;
+    struct pollfd fds[VANITYDIST_MAX_WORKERS + 1];
+    char line[VANITYDIST_LINE_MAX];
+    char *tok[VANITYDIST_TOKENS];
+    uint64_t start, next_report, stop_ms;
+    int listen_fd, n, r = -1;
+
+    if (!address || !job || !result_cb || !stop) {
+        error_log("Invalid coordinator parameters");
+        return -1;
+    }
+
+    memset(&c, 0, sizeof(c));
+    c.job = job;
+    c.length = job->range_length ? job->range_length : VANITYDIST_RANGE_LENGTH;
+    if (c.length % VANITYDIST_RANGE_UNIT) {
+        error_log("Range length must be a multiple of %d", VANITYDIST_RANGE_UNIT);
+        return -1;
+    }
+    for (int i = 0; i < VANITYDIST_MAX_WORKERS; i++) {
+        c.workers[i].conn.fd = -1;
+        c.workers[i].range = -1;
+    }
+
+    if (load_patterns(&c) < 0) {
+        patternset_free(c.set);
+        return -1;
+    }
+
+    listen_fd = open_socket(address, true, job->token != NULL);
+    if (listen_fd < 0) {
+        patternset_free(c.set);
+        return -1;
+    }
+
+    start = now_ms();
+    next_report = start + VANITYDIST_REPORT_MS;
+
+    while (!*stop) {
+        int count = 0;
+        uint64_t now;
+
+        fds[0].fd = listen_fd;
+        fds[0].events = POLLIN;
+        for (int i = 0; i < VANITYDIST_MAX_WORKERS; i++) {
+            fds[i + 1].fd = c.workers[i].conn.fd;
+            fds[i + 1].events = POLLIN;
+            fds[i + 1].revents = 0;
+        }
+        if (poll(fds, VANITYDIST_MAX_WORKERS + 1, VANITYDIST_POLL_MS) < 0 && errno != EINTR) {
+            error_log("Could not wait for workers");
+            break;
+        }
+        now = now_ms();
+
+        if (fds[0].revents & POLLIN) {
+            int fd = accept(listen_fd, NULL, NULL);
+            int slot = -1;
+            for (int i = 0; fd >= 0 && i < VANITYDIST_MAX_WORKERS && slot < 0; i++) {
+                if (c.workers[i].conn.fd < 0) {
+                    slot = i;
+                }
+            }
+            if (slot >= 0) {
+                c.workers[slot].conn.fd = fd;
+                c.workers[slot].last_seen = now;
+            } else if (fd >= 0) {
+                close(fd);
+            }
+        }
+
+        for (int i = 0; i < VANITYDIST_MAX_WORKERS; i++) {
+            Worker *w = &c.workers[i];
+            if (w->conn.fd < 0) {
+                continue;
+            }
+            if (fds[i + 1].revents & (POLLIN | POLLHUP | POLLERR)) {
+                if (conn_fill(&w->conn) < 0) {
+                    drop_worker(&c, w);
+                    continue;
+                }
+                w->last_seen = now;
+                while ((n = conn_line(&w->conn, line, tok, &count)) > 0) {
+                    if (count > 0 && handle_line(&c, w, tok, count, result_cb, user_data) < 0) {
+                        n = -1;
+                        break;
+                    }
+                }
+                memset(line, 0, sizeof(line));
+                if (n < 0) {
+                    error_log("Dropping worker that broke the protocol");
+                    drop_worker(&c, w);
+                    continue;
+                }
+            }
+            if (now - w->last_seen > VANITYDIST_TIMEOUT_MS) {
+                error_log("Dropping silent worker");
+                drop_worker(&c, w);
+            }
+        }
+
+        if (job->max_results && c.results >= job->max_results) {
+            r = 0;
+            break;
+        }
+        if (job->max_ms && now - start >= job->max_ms) {
+            r = 0;
+            break;
+        }
+
+        if (progress_cb && now >= next_report) {
+            uint64_t attempts = total_attempts(&c);
+            int workers = 0;
+            for (int i = 0; i < VANITYDIST_MAX_WORKERS; i++) {
+                workers += c.workers[i].ready;
+            }
+            progress_cb(attempts, now > start ? attempts * 1000.0 / (now - start) : 0.0, workers, user_data);
+            next_report = now + VANITYDIST_REPORT_MS;
+        }
+    }
+    if (*stop) {
+        r = 0;
+    }
+
+    // Closing on reports we never read would reset the connection and
+    // could take STOP with it; let every worker see it and hang up first
+    for (int i = 0; i < VANITYDIST_MAX_WORKERS; i++) {
+        if (c.workers[i].conn.fd >= 0) {
+            conn_send(&c.workers[i].conn, "STOP");
+            shutdown(c.workers[i].conn.fd, SHUT_WR);
+        }
+    }
+    stop_ms = now_ms() + VANITYDIST_STOP_MS;
+    for (int open = 1; open && now_ms() < stop_ms; ) {
+        open = 0;
+        for (int i = 0; i < VANITYDIST_MAX_WORKERS; i++) {
+            fds[i].fd = c.workers[i].conn.fd;
+            fds[i].events = POLLIN;
+            fds[i].revents = 0;
+            open |= fds[i].fd >= 0;
+        }
+        if (open && poll(fds, VANITYDIST_MAX_WORKERS, VANITYDIST_POLL_MS) < 0 && errno != EINTR) {
+            break;
+        }
+        for (int i = 0; i < VANITYDIST_MAX_WORKERS; i++) {
+            Conn *conn = &c.workers[i].conn;
+            if (conn->fd >= 0 && (fds[i].revents & (POLLIN | POLLHUP | POLLERR))) {
+                conn->len = 0;
+                if (conn_fill(conn) < 0) {
+                    conn_close(conn);
+                }
+            }
+        }
+    }
+    for (int i = 0; i < VANITYDIST_MAX_WORKERS; i++) {
+        conn_close(&c.workers[i].conn);
+    }
+    close(listen_fd);
+    if (strncmp(address, "unix:", 5) == 0) {
+        unlink(address + 5);
+    }
+    patternset_free(c.set);
+    if (c.orphans) {
+        memset(c.orphans, 0, c.orphan_count * sizeof(Range));
+    }
+    free(c.orphans);
+
+    return r < 0 ? -1 : (int)c.results;
+}
+
+/*
+ * Worker
+ */
+
+// Wait for the next line; 0 if stop was set, -1 on EOF or error
+static int wait_line(Conn *conn, char *line, char **tok, int *count, volatile sig_atomic_t *stop) {
+    struct pollfd pfd = { conn->fd, POLLIN, 0 };
+    int r;
+
+    while ((r = conn_line(conn, line, tok, count)) == 0) {
+        if (*stop) {
+            return 0;
+        }
+        if (poll(&pfd, 1, VANITYDIST_POLL_MS) > 0 && conn_fill(conn) < 0) {
+            return -1;
+        }
+    }
+    return r;
+}
+
+static int send_results(Conn *conn, VanitySearch *search, uint64_t id) {
+    VanityResult result;
+    int r = 0;
+
+    while (vanity_next_result(search, &result)) {
+        if (r == 0 && conn_send(conn, "MATCH %" PRIu64 " %" PRIu64 " %d %s %s", id, result.attempts,
+                                result.pattern_id, result.address, result.wif) < 0) {
+            r = -1;
+        }
+        memset(&result, 0, sizeof(result));
+    }
+    return r;
+}
+
+/*
+ * A coordinator that reached its limit says STOP and hangs up, which
+ * can beat a report still on its way. Check whether that is why a send
+ * failed.
+ */
+static bool coordinator_stopped(Conn *conn) {
+    char line[VANITYDIST_LINE_MAX];
+    char *tok[VANITYDIST_TOKENS];
+    struct pollfd pfd = { conn->fd, POLLIN, 0 };
+    int count;
+
+    while (conn_line(conn, line, tok, &count) == 0) {
+        if (poll(&pfd, 1, 0) <= 0 || conn_fill(conn) < 0) {
+            return false;
+        }
+    }
+    return count == 1 && strcmp(tok[0], "STOP") == 0;
+}
+
+/*
+ * Search one range and report on it. Returns 1 once the range is done,
+ * 0 if the coordinator or the user stopped the worker, -1 on error.
+ */
+static int work_range(Conn *conn, char **patterns, size_t pattern_count, vanity_addr_t type, bool case_sensitive,
+                      bool uncompressed, int threads, size_t batch_size, uint64_t id, const unsigned char *base,
+                      uint64_t length, volatile sig_atomic_t *stop) {
+    VanitySearch *search;
+    struct pollfd pfd[2];
+    char line[VANITYDIST_LINE_MAX];
+    char *tok[VANITYDIST_TOKENS];
+    uint64_t next_report = now_ms() + VANITYDIST_REPORT_MS;
+    int count, r = -1;
+
+    if (vanity_init(&search, NULL, case_sensitive, threads) < 0) {
+        return -1;
+    }
+    if (vanity_set_address_type(search, type) < 0 || vanity_set_uncompressed(search, uncompressed) < 0) {
+        vanity_cleanup(search);
+        return -1;
+    }
+    for (size_t i = 0; i < pattern_count; i++) {
+        if (vanity_add_pattern(search, patterns[i]) < 0) {
+            vanity_cleanup(search);
+            return -1;
+        }
+    }
+    if ((batch_size && vanity_set_batch_size(search, batch_size) < 0) ||
+        vanity_set_range(search, base, length) < 0 || vanity_set_continuous(search, 0, 0) < 0 ||
+        vanity_start(search) < 0) {
+        vanity_cleanup(search);
+        return -1;
+    }
+
+    for (;;) {
+        if (*stop) {
+            r = 0;
+            break;
+        }
+        if (vanity_is_stopped(search)) {
+            vanity_stop(search);
+            if (send_results(conn, search, id) < 0) {
+                r = coordinator_stopped(conn) ? 0 : -1;
+                break;
+            }
+            if (!vanity_is_exhausted(search)) {
+                error_log("Search of range %" PRIu64 " failed", id);
+                break;
+            }
+            if (conn_send(conn, "DONE %" PRIu64 " %" PRIu64, id, vanity_get_attempts(search)) < 0) {
+                r = coordinator_stopped(conn) ? 0 : -1;
+            } else {
+                r = 1;
+            }
+            break;
+        }
+
+        if (send_results(conn, search, id) < 0) {
+            r = coordinator_stopped(conn) ? 0 : -1;
+            break;
+        }
+
+        // The only thing a coordinator says mid-range is STOP, and it may
+        // have come in with the RANGE line
+        if (conn_line(conn, line, tok, &count) != 0) {
+            r = count == 1 && strcmp(tok[0], "STOP") == 0 ? 0 : -1;
+            break;
+        }
+
+        if (now_ms() >= next_report) {
+            if (conn_send(conn, "PROGRESS %" PRIu64 " %" PRIu64, id, vanity_get_attempts(search)) < 0) {
+                break;
+            }
+            next_report = now_ms() + VANITYDIST_REPORT_MS;
+        }
+
+        // Sleep until the coordinator talks, the search has news or a
+        // report is due; a signal setting stop interrupts the poll
+        uint64_t now = now_ms();
+        pfd[0] = (struct pollfd){ conn->fd, POLLIN, 0 };
+        pfd[1] = (struct pollfd){ vanity_get_event_fd(search), POLLIN, 0 };
+        if (poll(pfd, 2, next_report > now ? (int)(next_report - now) : 0) <= 0) {
+            continue;
+        }
+        if (pfd[1].revents & POLLIN) {
+            vanity_wait(search, 0);
+        }
+
+        if ((pfd[0].revents & (POLLIN | POLLHUP | POLLERR)) && conn_fill(conn) < 0) {
+            error_log("Lost the coordinator");
+            break;
+        }
+    }
+
+    vanity_cleanup(search);
+    return r;
+}
+
+int vanitydist_work(const char *address, const char *token, int threads, size_t batch_size,
+                    volatile sig_atomic_t *stop) {
+    static Conn conn;
+    char line[VANITYDIST_LINE_MAX];
+    char *tok[VANITYDIST_TOKENS];
+    char **patterns = NULL;
+    size_t pattern_count = 0;
+    vanity_addr_t type = VANITY_ADDR_P2PKH;
+    bool case_sensitive = true;
+    bool uncompressed = false;
+    unsigned char base[KEYBATCH_SCALAR_LEN];
+    uint64_t id, length;
+    int count, n, ranges = 0, r = -1;
+
+    if (!address || threads < 1 || !stop) {
+        error_log("Invalid worker parameters");
+        return -1;
+    }
+
+    memset(&conn, 0, sizeof(conn));
+    conn.fd = open_socket(address, false, false);
+    if (conn.fd < 0) {
+        return -1;
+    }
+    if (conn_send(&conn, "HELLO %d", threads) < 0) {
+        conn_close(&conn);
+        return -1;
+    }
+
+    // A coordinator with a token challenges us first
+    n = wait_line(&conn, line, tok, &count, stop);
+    if (n > 0 && count == 2 && strcmp(tok[0], "CHALLENGE") == 0) {
+        unsigned char nonce[VANITYDIST_NONCE_LEN];
+        char response[VANITYDIST_AUTH_LEN * 2 + 1];
+
+        if (!token) {
+            error_log("Coordinator wants a token");
+            goto done;
+        }
+        if (strlen(tok[1]) != VANITYDIST_NONCE_LEN * 2 || hex_decode(nonce, tok[1], strlen(tok[1])) < 0) {
+            error_log("Invalid challenge from coordinator");
+            goto done;
+        }
+        auth_response(response, token, nonce);
+        n = conn_send(&conn, "AUTH %s", response);
+        memset(response, 0, sizeof(response));
+        if (n == 0) {
+            n = wait_line(&conn, line, tok, &count, stop);
+        }
+    }
+
+    // The job: address type, case sensitivity, network and key encodings,
+    // then patterns. Older coordinators leave the key encodings out.
+    if (n <= 0 || (count != 4 && count != 5) || strcmp(tok[0], "JOB") != 0) {
+        error_log("Coordinator sent no job");
+        goto done;
+    }
+    if (strcmp(tok[1], type_name(VANITY_ADDR_P2WPKH)) == 0) {
+        type = VANITY_ADDR_P2WPKH;
+    } else if (strcmp(tok[1], type_name(VANITY_ADDR_P2SH_P2WPKH)) == 0) {
+        type = VANITY_ADDR_P2SH_P2WPKH;
+    } else if (strcmp(tok[1], type_name(VANITY_ADDR_P2TR)) == 0) {
+        type = VANITY_ADDR_P2TR;
+    } else {
+        type = VANITY_ADDR_P2PKH;
+    }
+    case_sensitive = strcmp(tok[2], "1") == 0;
+    if (strcmp(tok[3], "1") == 0) {
+        network_set_test();
+    } else {
+        network_set_main();
+    }
+    uncompressed = count == 5 && strcmp(tok[4], "1") == 0;
+
+    while ((n = wait_line(&conn, line, tok, &count, stop)) > 0 && !(count == 1 && strcmp(tok[0], "END") == 0)) {
+        char **grown;
+        if (count != 2 || strcmp(tok[0], "PATTERN") != 0) {
+            error_log("Invalid job from coordinator");
+            goto done;
+        }
+        grown = realloc(patterns, (pattern_count + 1) * sizeof(char *));
+        if (!grown || !(grown[pattern_count] = strdup(tok[1]))) {
+            error_log("Memory allocation error.");
+            patterns = grown ? grown : patterns;
+            goto done;
+        }
+        patterns = grown;
+        pattern_count++;
+    }
+    if (n <= 0) {
+        r = n == 0 ? ranges : -1;
+        goto done;
+    }
+
+    for (;;) {
+        n = wait_line(&conn, line, tok, &count, stop);
+        if (n == 0 || (n > 0 && count == 1 && strcmp(tok[0], "STOP") == 0)) {
+            r = ranges;
+            break;
+        }
+        if (n < 0 || count != 4 || strcmp(tok[0], "RANGE") != 0 || parse_u64(tok[1], &id) < 0 ||
+            strlen(tok[2]) != KEYBATCH_SCALAR_LEN * 2 || hex_decode(base, tok[2], strlen(tok[2])) < 0 ||
+            parse_u64(tok[3], &length) < 0) {
+            error_log("Invalid range from coordinator");
+            break;
+        }
+
+        n = work_range(&conn, patterns, pattern_count, type, case_sensitive, uncompressed, threads, batch_size,
+                       id, base, length, stop);
+        if (n < 0) {
+            break;
+        }
+        if (n == 0) {
+            r = ranges;
+            break;
+        }
+        ranges++;
+    }
+
+done:
+    for (size_t i = 0; i < pattern_count; i++) {
+        free(patterns[i]);
+    }
+    free(patterns);
+    memset(base, 0, sizeof(base));
+    conn_close(&conn);
+    return r;
+}
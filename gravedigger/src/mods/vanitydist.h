@@ -0,0 +1,100 @@
+/*
+ * Copyright (c) 2023 Brian Barto
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GPL License. See LICENSE for more details.
+ */
+
+#ifndef VANITYDIST_H
+#define VANITYDIST_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <signal.h>
+#include "vanity.h"
+
+#define VANITYDIST_RANGE_LENGTH (1ULL << 24)  // Default candidates per range
+#define VANITYDIST_RANGE_UNIT   KEYBATCH_MAX  // Ranges are whole batches of any power-of-two size
+#define VANITYDIST_TIMEOUT_MS   30000         // Silent workers count as dead
+#define VANITYDIST_MAX_WORKERS  256
+#define VANITYDIST_LINE_MAX     512           // Longest protocol line
+
+/*
+ * Coordinator and workers talk in text lines over a stream socket,
+ * "unix:/path" or "host:port" (":port" listens on loopback only):
+ *
+ *   worker       HELLO <threads>
+ *   coordinator  CHALLENGE <nonce hex>  only with a token
+ *   worker       AUTH <HMAC-SHA512 of the nonce under the token, hex>
+ *   coordinator  JOB <p2pkh|p2wpkh|p2sh-p2wpkh> <case sensitive 0|1> <testnet 0|1> <uncompressed 0|1>
+ *                PATTERN <text>        once per pattern, in id order
+ *                END
+ *                RANGE <id> <base hex> <length>
+ *   worker       PROGRESS <id> <attempts>
+ *                MATCH <id> <attempts> <pattern id> <address> <wif>
+ *                DONE <id> <attempts>
+ *   coordinator  RANGE ...             after every DONE
+ *                STOP
+ *
+ * Every range starts at its own random base. A coordinator listening
+ * beyond loopback needs a token, which keeps out workers that don't
+ * know it. The token doesn't encrypt anything: ranges and matches,
+ * private keys included, cross TCP in the clear. Keep TCP to trusted
+ * networks, tunnel it, or use a Unix socket.
+ */
+
+// What the coordinator searches for
+typedef struct {
+    vanity_addr_t address_type;
+    bool case_sensitive;
+    bool uncompressed;          // Also test uncompressed P2PKH addresses
+    const char *pattern;        // One pattern, or NULL with pattern_file
+    const char *pattern_file;   // Pattern file, or NULL with pattern
+    uint64_t range_length;      // Candidates per range, a multiple of
+                                // VANITYDIST_RANGE_UNIT, 0 for the default
+    uint64_t max_results;       // Stop after this many matches, 0 for no limit
+    uint64_t max_ms;            // Stop after this many milliseconds, 0 for no limit
+    const char *token;          // Shared secret workers must prove, NULL for none
+} VanityDistJob;
+
+// Called for every match a worker reports
+typedef void (*vanitydist_result_cb)(const VanityResult *result, void *user_data);
+
+// Called about once a second with totals over every worker
+typedef void (*vanitydist_progress_cb)(uint64_t attempts, double rate, int workers, void *user_data);
+
+/**
+ * Run a coordinator until the job's limits are reached or stop is set.
+ * Every range starts at its own random base; the range of a worker that disconnects or stays silent for
+ * VANITYDIST_TIMEOUT_MS goes to the next worker that asks, unless it
+ * already gave up a key. Without a token only loopback addresses and
+ * Unix sockets can be listened on.
+ *
+ * @param address Address to listen on
+ * @param job What to search for
+ * @param result_cb Called for every match
+ * @param progress_cb Called with aggregate progress, may be NULL
+ * @param user_data Passed to the callbacks
+ * @param stop Polled, non-zero ends the search
+ * @return Number of matches, or -1 on error
+ */
+int vanitydist_coordinate(const char *address, const VanityDistJob *job, vanitydist_result_cb result_cb,
+                          vanitydist_progress_cb progress_cb, void *user_data,
+                          volatile sig_atomic_t *stop);
+
+/**
+ * Run a worker: search the ranges a coordinator hands out until it
+ * says stop or stop is set
+ *
+ * @param address Coordinator address
+ * @param token Shared secret if the coordinator asks for one, or NULL
+ * @param threads Search threads
+ * @param batch_size Candidates per batch, 0 for the default; must
+ *        divide the coordinator's range length
+ * @param stop Polled, non-zero ends the worker
+ * @return Number of ranges searched, or -1 on error
+ */
+int vanitydist_work(const char *address, const char *token, int threads, size_t batch_size,
+                    volatile sig_atomic_t *stop);
+
+#endif // VANITYDIST_H
@@ -4,4 +4,5 @@ from .address import Address
 from .balance import Balance
 from .node import Node
 from .config import Config
-from .version import Version
\ No newline at end of file
+from .version import Version
+from .vanity import Vanity
\ No newline at end of file
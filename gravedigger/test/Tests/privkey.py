@@ -771,4 +771,100 @@ class Privkey(unittest.TestCase):
 
         sys.stdout.flush()
 
+    ###############
+    ## Bulk Tests
+    ###############
+
+    def test_1720(self):
+
+        self.btk.reset()
+        self.btk.arg("--create")
+        self.btk.arg("--count=600")
+        self.btk.arg("-t")
+        self.btk.arg("2")
+        self.btk.arg("-L")
+        out = self.btk.run()
+
+        self.assertTrue(out.returncode == 0)
+
+        lines = out.stdout.splitlines()
+
+        self.assertTrue(len(lines) == 600)
+        self.assertTrue(len(set(lines)) == 600)
+
+        for line in lines:
+            fields = line.split(" ")
+            self.assertTrue(len(fields) == 3)
+            self.assertTrue(fields[0][0] in "KL")
+            self.assertTrue(fields[1][:2] in ("02", "03"))
+            self.assertTrue(fields[2][0] == "1")
+
+        ## Each key's address matches the single key path
+        self.btk.reset()
+        self.btk.set_input(lines[0].split(" ")[0])
+        self.btk.arg("-w")
+        self.btk.arg("-W")
+        out = self.btk.run()
+
+        self.assertTrue(out.returncode == 0)
+        self.assertTrue(json.loads(out.stdout)[0] == lines[0].split(" ")[0])
+
+        self.btk.reset("address")
+        self.btk.set_input(lines[0].split(" ")[0])
+        self.btk.arg("-w")
+        out = self.btk.run()
+
+        self.assertTrue(out.returncode == 0)
+        self.assertTrue(json.loads(out.stdout)[0] == lines[0].split(" ")[2])
+
+        self.btk.reset("privkey")
+
+    def test_1730(self):
+
+        self.btk.reset()
+        self.btk.arg("--create")
+        self.btk.arg("--count=10")
+        self.btk.arg("-X")
+        self.btk.arg("-C")
+        self.btk.arg("-U")
+        out = self.btk.run()
+
+        self.assertTrue(out.returncode == 0)
+
+        records = [json.loads(line) for line in out.stdout.splitlines()]
+
+        self.assertTrue(len(records) == 20)
+        self.assertTrue(len(set(r["hex"] for r in records)) == 10)
+        self.assertTrue(len([r for r in records if r["pubkey"][:2] == "04"]) == 10)
+
+    def test_1740(self):
+
+        self.btk.reset()
+        self.btk.arg("--count=10")
+        out = self.btk.run()
+
+        self.assertTrue(out.returncode != 0)
+
+    def test_1750(self):
+
+        self.btk.reset()
+        self.btk.set_text(False)
+        self.btk.arg("--create")
+        self.btk.arg("--count=10")
+        self.btk.arg("-B")
+        self.btk.arg("-C")
+        self.btk.arg("-U")
+        out = self.btk.run()
+
+        self.assertTrue(out.returncode == 0)
+
+        ## Binary records are the same size with either encoding
+        self.assertTrue(len(out.stdout) == 20 * 118)
+        records = [out.stdout[i:i + 118] for i in range(0, len(out.stdout), 118)]
 
+        compressed = [r for r in records if r[32] == 1]
+        uncompressed = [r for r in records if r[32] == 0]
+        self.assertTrue(len(compressed) == 10 and len(uncompressed) == 10)
+        self.assertTrue(all(r[33] in (2, 3) and r[66:98] == bytes(32) for r in compressed))
+        self.assertTrue(all(r[33] == 4 for r in uncompressed))
+        self.assertTrue(set(r[:32] for r in compressed) == set(r[:32] for r in uncompressed))
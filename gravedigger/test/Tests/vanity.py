@@ -0,0 +1,802 @@
+import hashlib
+import hmac
+import json
+import os
+import shutil
+import signal
+import socket
+import struct
+import subprocess
+import tempfile
+import time
+import unittest
+from .btk import BTK
+
+# secp256k1 and base58, for checking addresses against their keys
+P = 2**256 - 2**32 - 977
+G = (0x79BE667EF9DCBBAC55A06295CE870B07029BFCDB2DCE28D959F2815B16F81798,
+     0x483ADA7726A3C4655DA4FBFC0E1108A8FD17B448A68554199C47D08FFB10D4B8)
+BASE58 = "123456789ABCDEFGHJKLMNPQRSTUVWXYZabcdefghijkmnopqrstuvwxyz"
+
+
+# Points are (x, y) tuples, None for the point at infinity
+def point_add(a, b):
+    if a is None:
+        return b
+    if b is None:
+        return a
+    if a[0] == b[0] and (a[1] + b[1]) % P == 0:
+        return None
+    if a == b:
+        s = 3 * a[0] * a[0] * pow(2 * a[1], -1, P)
+    else:
+        s = (b[1] - a[1]) * pow(b[0] - a[0], -1, P)
+    x = (s * s - a[0] - b[0]) % P
+    return (x, (s * (a[0] - x) - a[1]) % P)
+
+
+def point_mul(k, pt):
+    r = None
+    while k:
+        if k & 1:
+            r = point_add(r, pt)
+        pt, k = point_add(pt, pt), k >> 1
+    return r
+
+
+def hash160(data):
+    return hashlib.new("ripemd160", hashlib.sha256(data).digest()).digest()
+
+
+def base58check(payload):
+    payload += hashlib.sha256(hashlib.sha256(payload).digest()).digest()[:4]
+    n, text = int.from_bytes(payload, "big"), ""
+    while n:
+        n, r = divmod(n, 58)
+        text = BASE58[r] + text
+    return "1" * (len(payload) - len(payload.lstrip(b"\0"))) + text
+
+
+class Vanity(unittest.TestCase):
+
+    def run_test(self):
+        suite = unittest.defaultTestLoader.loadTestsFromTestCase(Vanity)
+        unittest.TextTestRunner().run(suite)
+
+    def setUp(self):
+        self.btk = BTK("vanity")
+
+    def vanity_test(self, pattern, opts=[], address_opts=[]):
+        self.btk.reset()
+        for opt in opts:
+            self.btk.arg(opt)
+        self.btk.arg(pattern)
+        out = self.btk.run()
+
+        self.assertTrue(out.returncode == 0)
+        self.assertTrue(out.stdout)
+
+        out_json = json.loads(out.stdout)
+        self.assertTrue(len(out_json) == 2)
+
+        wif, address = out_json
+        if "-i" in opts:
+            self.assertTrue(address.lower().startswith(pattern.lower()))
+        else:
+            self.assertTrue(address.startswith(pattern))
+
+        # The key must control the address it was reported with
+        self.btk.reset("address")
+        for opt in address_opts:
+            self.btk.arg(opt)
+        self.btk.set_input(wif)
+        out = self.btk.run()
+
+        self.assertTrue(out.returncode == 0)
+        self.assertTrue(json.loads(out.stdout)[0] == address)
+
+    def test_0010(self):
+        self.vanity_test("1a")
+
+    def test_0020(self):
+        self.vanity_test("1ab", opts=["-i"])
+
+    def test_0030(self):
+        self.vanity_test("bc1qz", opts=["--bech32"], address_opts=["--bech32"])
+
+    def test_0040(self):
+        for pattern in ["2a", "1l", "10"]:
+            self.btk.reset()
+            self.btk.arg(pattern)
+            out = self.btk.run()
+            self.assertTrue(out.returncode != 0)
+
+    def test_0050(self):
+        self.btk.reset()
+        self.btk.arg("--bech32")
+        self.btk.arg("bc1qb")
+        out = self.btk.run()
+        self.assertTrue(out.returncode != 0)
+
+    def scalar(self, wif):
+        self.btk.reset("privkey")
+        self.btk.arg("-X")
+        self.btk.set_input(wif)
+        return int(json.loads(self.btk.run().stdout)[0][:64], 16)
+
+    # No key may be a short walk away from another one
+    def assert_unrelated(self, results):
+        scalars = [self.scalar(r["wif"]) for r in results]
+        for i, a in enumerate(scalars):
+            for b in scalars[i + 1:]:
+                self.assertTrue(abs(a - b) > 2**40)
+
+    def checkpoint_attempts(self, path):
+        with open(path, "rb") as f:
+            data = f.read()
+        threads = struct.unpack(">H", data[45:47])[0]
+        return sum(struct.unpack(">Q", data[47 + i * 40:55 + i * 40])[0] for i in range(threads))
+
+    def interrupted_run(self, args):
+        proc = subprocess.Popen(["bin/btk", "vanity"] + args,
+                                stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL)
+        time.sleep(1)
+        proc.send_signal(signal.SIGINT)
+        return proc.wait()
+
+    def test_0060(self):
+        path = os.path.join(tempfile.mkdtemp(), "vanity.ckpt")
+
+        # Interrupting writes a checkpoint only the owner can read
+        self.assertTrue(self.interrupted_run(["--checkpoint", path, "1zzzzzzzzz"]) == 0)
+        self.assertTrue(os.stat(path).st_mode & 0o077 == 0)
+        attempts = self.checkpoint_attempts(path)
+        self.assertTrue(attempts > 0)
+
+        # Resuming continues the count and refuses a different pattern
+        self.assertTrue(self.interrupted_run(["--resume", path, "1zzzzzzzzz"]) == 0)
+        self.assertTrue(self.checkpoint_attempts(path) > attempts)
+
+        self.btk.reset()
+        self.btk.arg("--resume", path)
+        self.btk.arg("1zzzzzzzzy")
+        out = self.btk.run()
+        self.assertTrue(out.returncode != 0)
+
+        os.unlink(path)
+        os.rmdir(os.path.dirname(path))
+
+    def test_0070(self):
+        path = os.path.join(tempfile.mkdtemp(), "patterns.txt")
+        with open(path, "w") as f:
+            f.write("# prefixes, a suffix and a substring\n1ab\n1Zz\n\n*zq\n*Qm*\n")
+
+        self.btk.reset()
+        self.btk.arg("--pattern-file", path)
+        out = self.btk.run()
+        self.assertTrue(out.returncode == 0)
+
+        wif, address, pattern = json.loads(out.stdout)
+        if pattern.startswith("*") and pattern.endswith("*"):
+            self.assertTrue(pattern[1:-1] in address)
+        elif pattern.startswith("*"):
+            self.assertTrue(address.endswith(pattern[1:]))
+        else:
+            self.assertTrue(address.startswith(pattern))
+
+        self.btk.reset("address")
+        self.btk.set_input(wif)
+        out = self.btk.run()
+        self.assertTrue(json.loads(out.stdout)[0] == address)
+
+        # One bad line rejects the whole file
+        with open(path, "a") as f:
+            f.write("1l0\n")
+        self.btk.reset()
+        self.btk.arg("--pattern-file", path)
+        out = self.btk.run()
+        self.assertTrue(out.returncode != 0)
+
+        os.unlink(path)
+        os.rmdir(os.path.dirname(path))
+
+    def test_0080(self):
+        self.btk.reset()
+        self.btk.arg("--count", "3")
+        self.btk.arg("1a")
+        out = self.btk.run()
+        self.assertTrue(out.returncode == 0)
+
+        results = [json.loads(line) for line in out.stdout.splitlines()]
+        self.assertTrue(len(results) == 3)
+        self.assertTrue(len(set(r["address"] for r in results)) == 3)
+        for r in results:
+            self.assertTrue(r["address"].startswith("1a"))
+            self.assertTrue(r["pattern"] == "1a" and r["pattern_id"] == 0)
+            self.assertTrue(r["attempts"] > 0 and r["timestamp"] > 0)
+
+            self.btk.reset("address")
+            self.btk.set_input(r["wif"])
+            addr = self.btk.run()
+            self.assertTrue(json.loads(addr.stdout)[0] == r["address"])
+
+        # A time limit ends the search whether or not anything matched
+        self.btk.reset("vanity")
+        self.btk.arg("--time", "1")
+        self.btk.arg("1zzzzzzzz")
+        out = self.btk.run()
+        self.assertTrue(out.returncode == 0)
+        self.assertTrue(out.stdout.strip() == "")
+
+    def test_0090(self):
+        self.vanity_test("1a", ["--pin", "-t 2"])
+        self.btk.reset("vanity")
+        self.vanity_test("1a", ["--skip-smt", "-t 2"])
+
+    def test_0100(self):
+        if os.path.exists("/tmp/.btk"):
+            shutil.rmtree("/tmp/.btk")
+
+        self.btk.reset()
+        self.btk.arg("--test")
+        self.btk.arg("--tune")
+        self.btk.arg("-t 2")
+        self.btk.arg("1ab")
+        out = self.btk.run()
+        self.assertTrue(out.returncode == 0)
+
+        best = json.loads(out.stdout)
+        self.assertTrue(best["threads"] in (1, 2))
+        self.assertTrue(best["batch_size"] in (32, 64, 128, 256, 512, 1024))
+        self.assertTrue(best["rate"] > 0)
+
+        # Later searches pick the cached settings up
+        self.btk.reset("config")
+        self.btk.arg("--test")
+        self.btk.arg("--dump")
+        config = json.loads(self.btk.run().stdout)
+        self.assertTrue(config["vanity-threads"] == str(best["threads"]))
+        self.assertTrue(config["vanity-batch-size"] == str(best["batch_size"]))
+
+        self.btk.reset("vanity")
+        self.btk.arg("--test")
+        self.btk.arg("1a")
+        out = self.btk.run()
+        self.assertTrue(out.returncode == 0)
+        self.assertTrue(f"Batch size {best['batch_size']}" in out.stderr)
+
+        shutil.rmtree("/tmp/.btk")
+
+    def coordinator(self, sock, args):
+        proc = subprocess.Popen(["bin/btk", "vanity", "--coordinator", "unix:" + sock] + args,
+                                stdout=subprocess.PIPE, stderr=subprocess.DEVNULL, text=True)
+        for _ in range(100):
+            if os.path.exists(sock):
+                break
+            time.sleep(0.05)
+        return proc
+
+    def test_0110(self):
+        sock = os.path.join(tempfile.mkdtemp(), "coordinator.sock")
+
+        # Two real workers share one search
+        proc = self.coordinator(sock, ["--count", "2", "1a"])
+        workers = [subprocess.Popen(["bin/btk", "vanity", "--worker", "unix:" + sock],
+                                    stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL) for _ in range(2)]
+        out, _ = proc.communicate(timeout=60)
+        self.assertTrue(proc.returncode == 0)
+        for w in workers:
+            self.assertTrue(w.wait(timeout=10) == 0)
+
+        results = [json.loads(line) for line in out.splitlines()]
+        self.assertTrue(len(results) == 2)
+        for r in results:
+            self.assertTrue(r["address"].startswith("1a"))
+            self.btk.reset("address")
+            self.btk.set_input(r["wif"])
+            self.assertTrue(json.loads(self.btk.run().stdout)[0] == r["address"])
+
+        # A real key to report, found locally
+        self.btk.reset("vanity")
+        self.btk.arg("--count 1")
+        self.btk.arg("1a")
+        key = json.loads(self.btk.run().stdout)
+
+        # The range of a worker that disconnects goes to the next one
+        proc = self.coordinator(sock, ["--count", "1", "--range-size", "1024", "1a"])
+
+        def worker():
+            conn = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+            conn.connect(sock)
+            conn.sendall(b"HELLO 1\n")
+            lines = conn.makefile("r")
+            self.assertTrue(lines.readline().split() == ["JOB", "p2pkh", "1", "0", "0"])
+            self.assertTrue(lines.readline().split() == ["PATTERN", "1a"])
+            self.assertTrue(lines.readline().strip() == "END")
+            return conn, lines
+
+        conn, lines = worker()
+        first = lines.readline().split()
+        self.assertTrue(first[0] == "RANGE" and first[3] == "1024")
+        lines.close()
+        conn.close()
+
+        conn, lines = worker()
+        self.assertTrue(lines.readline().split() == first)
+        conn.sendall(f"DONE {first[1]} 1024\n".encode())
+        second = lines.readline().split()
+        self.assertTrue(second[1] != first[1])
+        self.assertTrue(abs(int(second[2], 16) - int(first[2], 16)) > 2**40)
+
+        # A key that doesn't derive its address gets the worker dropped
+        conn.sendall(f"MATCH {second[1]} 10 0 1aForgedAddress {key['wif']}\n".encode())
+        self.assertTrue(lines.readline() == "")
+        lines.close()
+        conn.close()
+
+        conn, lines = worker()
+        self.assertTrue(lines.readline().split() == second)
+        conn.sendall(f"MATCH {second[1]} 10 0 {key['address']} {key['wif']}\n".encode())
+        self.assertTrue(lines.readline().strip() == "STOP")
+        lines.close()
+        conn.close()
+
+        out, _ = proc.communicate(timeout=10)
+        result = json.loads(out)
+        self.assertTrue(result["address"] == key["address"] and result["attempts"] == 1034)
+        os.rmdir(os.path.dirname(sock))
+
+    def test_0120(self):
+        path = os.path.join(tempfile.mkdtemp(), "control.sock")
+        proc = subprocess.Popen(["bin/btk", "vanity", "--control", path, "1zzzzzzzzz"],
+                                stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL)
+        try:
+            for _ in range(100):
+                if os.path.exists(path):
+                    break
+                time.sleep(0.05)
+            conn = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+            conn.connect(path)
+            lines = conn.makefile("r")
+
+            def command(text):
+                conn.sendall((text + "\n").encode())
+                return json.loads(lines.readline())
+
+            self.assertTrue(command("status")["state"] == "running")
+
+            # A paused search stops counting attempts and time
+            paused = command("pause")
+            self.assertTrue(paused["state"] == "paused")
+            time.sleep(0.3)
+            first = command("status")
+            time.sleep(0.3)
+            second = command("status")
+            self.assertTrue(first["attempts"] == second["attempts"] and first["elapsed"] == second["elapsed"])
+
+            self.assertTrue(command("resume")["state"] == "running")
+            self.assertTrue("error" in command("bogus"))
+            # Stage times only exist in VANITY_PROFILE builds
+            profile = command("profile")
+            self.assertTrue("error" in profile or set(profile["stages"]) ==
+                            {"scalar", "ec", "sha256", "ripemd160", "tweak", "encode", "match"})
+
+            # A client that never reads its replies is dropped instead of
+            # holding up everyone else
+            greedy = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+            greedy.connect(path)
+            greedy.settimeout(5)
+            try:
+                greedy.sendall(b"status\n" * 200000)
+            except (socket.timeout, BrokenPipeError, ConnectionResetError):
+                pass
+            conn.settimeout(5)
+            self.assertTrue(command("status")["state"] == "running")
+            greedy.close()
+
+            # A second search can't take over the socket of a running one
+            other = subprocess.run(["bin/btk", "vanity", "--control", path, "1zzzzzzzzz"],
+                                   capture_output=True, timeout=10)
+            self.assertTrue(other.returncode != 0)
+
+            self.assertTrue(command("stop")["state"] == "stopping")
+            lines.close()
+            conn.close()
+            self.assertTrue(proc.wait(timeout=10) == 0)
+            self.assertFalse(os.path.exists(path))
+        finally:
+            proc.kill()
+            proc.wait()
+        os.rmdir(os.path.dirname(path))
+
+    def test_0130(self):
+        path = os.path.join(tempfile.mkdtemp(), "vanity.prom")
+        self.assertTrue(self.interrupted_run(["-t", "2", "--metrics", path, "1zzzzzzzzz"]) == 0)
+
+        samples = {}
+        with open(path) as f:
+            for line in f:
+                if not line.startswith("#"):
+                    name, value = line.rsplit(" ", 1)
+                    samples[name] = float(value)
+        self.assertTrue(samples["btk_vanity_attempts_total"] > 0)
+        self.assertTrue(samples["btk_vanity_threads"] == 2)
+        self.assertTrue('btk_vanity_candidates_per_second{thread="1"}' in samples)
+        self.assertTrue(samples["btk_vanity_expected_seconds"] > 0)
+
+        # A metrics file that can't be written stops the search before it starts
+        self.btk.reset("vanity")
+        self.btk.arg("--metrics", os.path.join(path, "missing"))
+        self.btk.arg("1zzzzzzzzz")
+        self.assertTrue(self.btk.run().returncode != 0)
+
+        os.remove(path)
+        os.rmdir(os.path.dirname(path))
+
+    def test_0140(self):
+        path = os.path.join(tempfile.mkdtemp(), "vanity.prom")
+
+        def metrics(args):
+            self.assertTrue(self.interrupted_run(["--metrics", path] + args) == 0)
+            samples = {}
+            with open(path) as f:
+                for line in f:
+                    if not line.startswith("#"):
+                        name, value = line.rsplit(" ", 1)
+                        samples[name] = float(value)
+            return samples
+
+        # Share of 24 byte payloads (after the 0x00 version) whose address
+        # starts with the prefix; every zero byte adds a '1' up front
+        def exact(prefix):
+            rest = prefix.lstrip("1")
+            ones = len(prefix) - len(rest)
+            lo, hi = 256 ** (24 - ones), 256 ** (25 - ones)
+            value = 0
+            for c in rest:
+                value = value * 58 + BASE58.index(c)
+            count = 0
+            for digits in range(len(rest), 36):
+                scale = 58 ** (digits - len(rest))
+                count += max(0, min(hi, 58 ** digits, (value + 1) * scale) - max(lo, 58 ** (digits - 1), value * scale))
+            return count / 2 ** 192
+
+        # The second character is far from uniform: 'Z' is rare, 'z' rarer
+        for prefix in ["1Zzzzzz", "12zzzzz", "11zzzzz"]:
+            p = metrics([prefix])["btk_vanity_match_probability"]
+            self.assertTrue(abs(p - exact(prefix)) < exact(prefix) * 1e-9)
+
+        # Case insensitive prefixes cover every spelling
+        p = metrics(["-i", "1Zzzzzz"])["btk_vanity_match_probability"]
+        spellings = sum(exact("1" + a + b + c + d + e + f) for a in "Zz" for b in "Zz" for c in "Zz"
+                        for d in "Zz" for e in "Zz" for f in "Zz")
+        self.assertTrue(abs(p - spellings) < spellings * 1e-9)
+
+        # ETA quantiles grow with the chance asked for
+        samples = metrics(["-t", "2", "1zzzzzzzzz"])
+        etas = [samples['btk_vanity_eta_seconds{quantile="%s"}' % q] for q in ["0.5", "0.9", "0.99"]]
+        self.assertTrue(0 < etas[0] < etas[1] < etas[2])
+        self.assertTrue(abs(etas[1] / etas[0] - 3.3219) < 0.001)
+
+        os.remove(path)
+        os.rmdir(os.path.dirname(path))
+
+    def test_0150(self):
+        # Both encodings of every key are tested, each match keeps the
+        # compression flag of the public key behind its address
+        self.btk.reset()
+        self.btk.arg("--also-uncompressed")
+        self.btk.arg("--count 40")
+        self.btk.arg("1a")
+        out = self.btk.run()
+        self.assertTrue(out.returncode == 0)
+
+        results = [json.loads(line) for line in out.stdout.splitlines()]
+        self.assertTrue(len(results) == 40)
+        self.assertTrue(any(r["wif"].startswith("5") for r in results))
+        for r in results:
+            self.assertTrue(r["address"].startswith("1a"))
+            self.btk.reset("address")
+            self.btk.set_input(r["wif"])
+            self.assertTrue(json.loads(self.btk.run().stdout)[0] == r["address"])
+
+        # Segwit addresses have no uncompressed form
+        self.btk.reset()
+        self.btk.arg("--also-uncompressed")
+        self.btk.arg("--bech32")
+        self.btk.arg("bc1qq")
+        self.assertTrue(self.btk.run().returncode != 0)
+
+    def test_0160(self):
+        # Every match is the script hash of its key's P2WPKH redeem script
+        self.btk.reset()
+        self.btk.arg("--p2sh-segwit")
+        self.btk.arg("--count 5")
+        self.btk.arg("3Ab")
+        out = self.btk.run()
+        self.assertTrue(out.returncode == 0)
+
+        results = [json.loads(line) for line in out.stdout.splitlines()]
+        self.assertTrue(len(results) == 5)
+        for r in results:
+            self.assertTrue(r["address"].startswith("3Ab"))
+            self.btk.reset("pubkey")
+            self.btk.set_input(r["wif"])
+            pubkey = bytes.fromhex(json.loads(self.btk.run().stdout)[0])
+            self.assertTrue(base58check(b"\x05" + hash160(b"\x00\x14" + hash160(pubkey))) == r["address"])
+
+        # The version byte keeps the second character at 'R' or before
+        self.btk.reset()
+        self.btk.arg("--p2sh-segwit")
+        self.btk.arg("3a")
+        self.assertTrue(self.btk.run().returncode != 0)
+
+    def test_0170(self):
+        charset = "qpzry9x8gf2tvdw0s3jn54khce6mua7l"
+
+        def tagged_hash(tag, data):
+            t = hashlib.sha256(tag.encode()).digest()
+            return hashlib.sha256(t + t + data).digest()
+
+        def bech32m(program):
+            def polymod(values):
+                chk = 1
+                for v in values:
+                    top, chk = chk >> 25, (chk & 0x1ffffff) << 5 ^ v
+                    for i, gen in enumerate([0x3b6a57b2, 0x26508e6d, 0x1ea119fa, 0x3d4233dd, 0x2a1462b3]):
+                        chk ^= gen if (top >> i) & 1 else 0
+                return chk
+            bits = int.from_bytes(program, "big") << 4
+            data = [1] + [(bits >> (5 * i)) & 31 for i in reversed(range(52))]
+            hrp = [ord(c) >> 5 for c in "bc"] + [0] + [ord(c) & 31 for c in "bc"]
+            chk = polymod(hrp + data + [0] * 6) ^ 0x2bc830a3
+            return "bc1" + "".join(charset[d] for d in data + [(chk >> 5 * (5 - i)) & 31 for i in range(6)])
+
+        # Every match is Q = P + H_TapTweak(P)G of its key, P with even y
+        self.btk.reset()
+        self.btk.arg("--bech32m")
+        self.btk.arg("--count 3")
+        self.btk.arg("bc1pq")
+        out = self.btk.run()
+        self.assertTrue(out.returncode == 0)
+
+        results = [json.loads(line) for line in out.stdout.splitlines()]
+        self.assertTrue(len(results) == 3)
+        for r in results:
+            self.assertTrue(r["address"].startswith("bc1pq"))
+            self.btk.reset("privkey")
+            self.btk.arg("-X")
+            self.btk.set_input(r["wif"])
+            d = int(json.loads(self.btk.run().stdout)[0][:64], 16)
+            pt = point_mul(d, G)
+            if pt[1] & 1:
+                pt = (pt[0], P - pt[1])
+            x = pt[0].to_bytes(32, "big")
+            t = int.from_bytes(tagged_hash("TapTweak", x), "big")
+            q = point_add(pt, point_mul(t, G))
+            self.assertTrue(bech32m(q[0].to_bytes(32, "big")) == r["address"])
+
+        # Uncompressed keys have no taproot address
+        self.btk.reset()
+        self.btk.arg("--bech32m")
+        self.btk.arg("--also-uncompressed")
+        self.btk.arg("bc1pq")
+        self.assertTrue(self.btk.run().returncode != 0)
+
+    def test_0180(self):
+        def seeded(args):
+            self.btk.reset()
+            for arg in args:
+                self.btk.arg(arg)
+            self.btk.arg("--count 3")
+            self.btk.arg("1aa")
+            out = self.btk.run()
+            self.assertTrue(out.returncode == 0)
+            return [(r["address"], r["wif"]) for r in map(json.loads, out.stdout.splitlines())]
+
+        # The same seed walks the same keys, whatever the batch size
+        first = seeded(["--seed bench"])
+        self.assertTrue(len(first) == 3)
+        self.assertTrue(seeded(["--seed bench"]) == first)
+        self.assertTrue(seeded(["--seed bench", "--batch-size 64"]) == first)
+        self.assertTrue(seeded(["--seed other"]) != first)
+
+    def test_0190(self):
+        # BIP32 test vector 1, chain m
+        xpub = "xpub661MyMwAqRbcFtXgS5sYJABqqG9YLmC4Q1Rdap9gSE8NqtwybGhePY2gZ29ESFjqJoCu1Rupje8YtGqsefD265TMg7usUDFdp6W1EGMcet8"
+        xprv = "xprv9s21ZrQH143K3QTDL4LXw2F7HEK3wJUD2nW2nRk4stbPy6cq3jPPqjiChkVvvNKmPGJxWUtg6LnF5kejMRNNU3TGtRBeJgk33yuGBxrMPHi"
+
+        # CKDpub: K_i = IL G + K, I = HMAC-SHA512(c, K || ser32(i))
+        data = sum(BASE58.index(c) * 58**i for i, c in enumerate(reversed(xpub))).to_bytes(82, "big")[:78]
+        chain, key = data[13:45], data[45:]
+        x = int.from_bytes(key[1:], "big")
+        y = pow(x**3 + 7, (P + 1) // 4, P)
+        parent = (x, y if y & 1 == key[0] & 1 else P - y)
+
+        def child(i):
+            il = hmac.new(chain, key + struct.pack(">I", i), hashlib.sha512).digest()[:32]
+            c = point_add(point_mul(int.from_bytes(il, "big"), G), parent)
+            return bytes([2 + (c[1] & 1)]) + c[0].to_bytes(32, "big")
+
+        self.btk.reset()
+        self.btk.arg("--xpub " + xpub)
+        self.btk.arg("--count 2")
+        self.btk.arg("1a")
+        out = self.btk.run()
+        self.assertTrue(out.returncode == 0)
+
+        results = [json.loads(line) for line in out.stdout.splitlines()]
+        self.assertTrue(len(results) == 2)
+        for r in results:
+            self.assertTrue("wif" not in r)
+            self.btk.reset("address")
+            self.btk.arg("-x")
+            self.btk.set_input(child(r["index"]).hex())
+            self.assertTrue(json.loads(self.btk.run().stdout)[0] == r["address"])
+
+        # Single mode prints the path in place of the WIF
+        self.btk.reset("vanity")
+        self.btk.arg("--xpub " + xpub)
+        self.btk.arg("--bech32")
+        self.btk.arg("bc1qq")
+        out = self.btk.run()
+        self.assertTrue(out.returncode == 0)
+        path, address = json.loads(out.stdout)
+        self.assertTrue(path.startswith("M/"))
+        self.btk.reset("address")
+        self.btk.arg("-x")
+        self.btk.arg("--bech32")
+        self.btk.set_input(child(int(path[2:])).hex())
+        self.assertTrue(json.loads(self.btk.run().stdout)[0] == address)
+
+        # Private extended keys and keys without a single address type
+        for args in (["--xpub " + xprv], ["--xpub " + xpub, "--bech32m"], ["--xpub " + xpub, "--also-uncompressed"]):
+            self.btk.reset("vanity")
+            for arg in args:
+                self.btk.arg(arg)
+            self.btk.arg("1a" if "--bech32m" not in args else "bc1pq")
+            self.assertTrue(self.btk.run().returncode != 0)
+
+    def test_0200(self):
+        # 'O' is not base58, but it looks like 'o'; 'B' and 'S' look like '8' and '5'
+        self.btk.reset("vanity")
+        self.btk.arg("--confusable")
+        self.btk.arg("--count 3")
+        self.btk.arg("1BOS")
+        out = self.btk.run()
+        self.assertTrue(out.returncode == 0)
+        results = [json.loads(line) for line in out.stdout.splitlines()]
+        self.assertTrue(len(results) == 3)
+        for r in results:
+            a = r["address"]
+            self.assertTrue(a[0] == "1" and a[1] in "B8" and a[2] == "o" and a[3] in "S5")
+
+        # Without look-alikes the pattern can't appear in an address
+        self.btk.reset("vanity")
+        self.btk.arg("1BOS")
+        self.assertTrue(self.btk.run().returncode != 0)
+
+        # Look-alikes are for single base58 patterns
+        self.btk.reset("vanity")
+        self.btk.arg("--confusable")
+        self.btk.arg("--bech32")
+        self.btk.arg("bc1qq")
+        self.assertTrue(self.btk.run().returncode != 0)
+
+    def test_0210(self):
+        # A P2SH address is 34 digits of 23 bytes behind version 5, which
+        # never leaves room for 'z' after the '3'
+        self.btk.reset("vanity")
+        self.btk.arg("--p2sh-segwit")
+        self.btk.arg("3z")
+        out = self.btk.run()
+        self.assertTrue(out.returncode != 0)
+        self.assertTrue("No address of this type starts with '3z'" in out.stderr)
+
+        # Impossible characters come with what would do instead
+        self.btk.reset("vanity")
+        self.btk.arg("1HeLlo")
+        out = self.btk.run()
+        self.assertTrue(out.returncode != 0)
+        self.assertTrue("Try '1HeLLo', --confusable, -i or '1HeL' instead" in out.stderr)
+
+        # Longer than any address
+        self.btk.reset("vanity")
+        self.btk.arg("1" + "a" * 34)
+        out = self.btk.run()
+        self.assertTrue(out.returncode != 0)
+        self.assertTrue("addresses at most 34" in out.stderr)
+
+        # A search that would take centuries says so once the rate is known
+        self.btk.reset("vanity")
+        self.btk.arg("--continuous")
+        self.btk.arg("--time 2")
+        self.btk.arg("1abcdefghijk")
+        out = self.btk.run()
+        self.assertTrue(out.returncode == 0)
+        self.assertTrue(out.stderr.count("WARNING: expected to take") == 1)
+
+    def test_0220(self):
+        path = os.path.join(tempfile.mkdtemp(), "orders.txt")
+        with open(path, "w") as f:
+            f.write("1a\n1b\n")
+
+        # Orders served from one pattern set get unrelated keys
+        self.btk.reset()
+        self.btk.arg("--pattern-file", path)
+        self.btk.arg("--count 6")
+        out = self.btk.run()
+        self.assertTrue(out.returncode == 0)
+
+        results = [json.loads(line) for line in out.stdout.splitlines()]
+        self.assertTrue(len(results) == 6)
+        self.assert_unrelated(results)
+
+        os.unlink(path)
+        os.rmdir(os.path.dirname(path))
+
+    def test_0230(self):
+        path = os.path.join(tempfile.mkdtemp(), "vanity.ckpt")
+
+        # Continuous keys are unrelated, and the checkpoint left behind
+        # resumes no walk that revealed one of them
+        self.btk.reset()
+        self.btk.arg("--count 4")
+        self.btk.arg("--checkpoint", path)
+        self.btk.arg("1a")
+        out = self.btk.run()
+        self.assertTrue(out.returncode == 0)
+
+        results = [json.loads(line) for line in out.stdout.splitlines()]
+        self.assertTrue(len(results) == 4)
+        self.assert_unrelated(results)
+
+        with open(path, "rb") as f:
+            data = f.read()
+        threads = struct.unpack(">H", data[45:47])[0]
+        positions = [int.from_bytes(data[55 + i * 40:87 + i * 40], "big") for i in range(threads)]
+        for d in (self.scalar(r["wif"]) for r in results):
+            self.assertTrue(all(abs(d - position) > 2**40 for position in positions if position))
+
+        os.unlink(path)
+        os.rmdir(os.path.dirname(path))
+
+    def test_0240(self):
+        tmp = tempfile.mkdtemp()
+        sock = os.path.join(tmp, "coordinator.sock")
+        token = os.path.join(tmp, "token")
+        with open(token, "w") as f:
+            f.write("correct horse battery staple\n")
+
+        # Listening beyond loopback takes a token
+        out = subprocess.run(["bin/btk", "vanity", "--coordinator", "0.0.0.0:0", "1a"],
+                             stdout=subprocess.PIPE, stderr=subprocess.PIPE, timeout=10)
+        self.assertTrue(out.returncode != 0)
+
+        proc = self.coordinator(sock, ["--token-file", token, "1a"])
+
+        # A worker has to answer the challenge before it learns the job
+        conn = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+        conn.connect(sock)
+        conn.sendall(b"HELLO 1\n")
+        lines = conn.makefile("r")
+        challenge = lines.readline().split()
+        self.assertTrue(challenge[0] == "CHALLENGE" and len(challenge[1]) == 64)
+        wrong = hmac.new(b"wrong", bytes.fromhex(challenge[1]), hashlib.sha512).hexdigest()
+        conn.sendall(f"AUTH {wrong}\n".encode())
+        self.assertTrue(lines.readline() == "")
+        lines.close()
+        conn.close()
+
+        # Without the token a worker gives up, with it one finds the match
+        worker = subprocess.run(["bin/btk", "vanity", "--worker", "unix:" + sock],
+                                stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL, timeout=10)
+        self.assertTrue(worker.returncode != 0)
+        worker = subprocess.Popen(["bin/btk", "vanity", "--worker", "unix:" + sock, "--token-file", token],
+                                  stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL)
+        out, _ = proc.communicate(timeout=60)
+        self.assertTrue(proc.returncode == 0 and worker.wait(timeout=10) == 0)
+        self.assertTrue(json.loads(out)["address"].startswith("1a"))
+
+        os.unlink(token)
+        os.rmdir(tmp)
@@ -1,4 +1,4 @@
-from Tests import Privkey, Pubkey, Address, Balance, Node, Config, Version
+from Tests import Privkey, Pubkey, Address, Balance, Node, Config, Version, Vanity
 
 test = Privkey()
 test.run_test()
@@ -19,4 +19,7 @@ test = Config()
 test.run_test()
 
 test = Version()
+test.run_test()
+
+test = Vanity()
 test.run_test()
\ No newline at end of file
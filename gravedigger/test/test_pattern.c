@@ -0,0 +1,105 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <math.h>
+#include "../src/mods/pattern.h"
+
+// Wildcards between literal runs: every run and every star is a segment
+static const char *wildcard_patterns[] = {"1*ab*c", "1*a*b*c*d", "*ab*", "1**2"};
+
+// Test wildcard patterns with literal runs between the stars
+int test_wildcard_segments(void)
+{
+    for (size_t i = 0; i < sizeof(wildcard_patterns) / sizeof(wildcard_patterns[0]); i++) {
+        struct Pattern *pattern = pattern_compile(wildcard_patterns[i], PATTERN_TYPE_WILDCARD, true);
+        if (!pattern) {
+            printf("Failed to compile %s\n", wildcard_patterns[i]);
+            return 1;
+        }
+
+        double p = pattern_probability(pattern);
+        pattern_free(pattern);
+        if (!(p > 0.0 && p < 1.0)) {
+            printf("Probability of %s out of range: %g\n", wildcard_patterns[i], p);
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+// Test wildcard matching
+int test_wildcard_match(void)
+{
+    struct Pattern *pattern = pattern_compile("1*ab*c", PATTERN_TYPE_WILDCARD, true);
+    if (!pattern) {
+        printf("Failed to compile 1*ab*c\n");
+        return 1;
+    }
+
+    bool ok = pattern_match(pattern, "1xxabyyc") && pattern_match(pattern, "1abc") &&
+              !pattern_match(pattern, "1xxbayyc") && !pattern_match(pattern, "2xxabyyc");
+    pattern_free(pattern);
+
+    return ok ? 0 : 1;
+}
+
+// Test regex odds against the exact prefix odds, and the unknown case
+int test_regex_probability(void)
+{
+    struct Pattern *regex = pattern_compile("^1ABC", PATTERN_TYPE_REGEX, true);
+    struct Pattern *prefix = pattern_compile("1ABC", PATTERN_TYPE_PREFIX, true);
+    struct Pattern *rare = pattern_compile("^1[a-z]{6}$|^1zzzzz", PATTERN_TYPE_REGEX, true);
+    struct Pattern *unsupported = pattern_compile("^1\\wzzzzzz", PATTERN_TYPE_REGEX, true);
+    bool ok = regex && prefix && rare && unsupported;
+
+    if (ok) {
+        double p = pattern_probability(regex), expected = pattern_probability(prefix);
+        ok = fabs(p - expected) < 0.01 * expected && p == pattern_probability(regex) &&
+             pattern_probability(rare) > 0.0 && pattern_probability(unsupported) == -1.0;
+        if (!ok) {
+            printf("^1ABC %g, 1ABC %g, rare %g, unsupported %g\n", p, expected,
+                   pattern_probability(rare), pattern_probability(unsupported));
+        }
+    }
+    pattern_free(regex);
+    pattern_free(prefix);
+    pattern_free(rare);
+    pattern_free(unsupported);
+
+    return ok ? 0 : 1;
+}
+
+int main()
+{
+    int result = 0;
+
+    printf("Running tests...\n");
+
+    printf("Test 1: Wildcard segments... ");
+    if (test_wildcard_segments() == 0) {
+        printf("PASS\n");
+    } else {
+        printf("FAIL\n");
+        result = 1;
+    }
+
+    printf("Test 2: Wildcard match... ");
+    if (test_wildcard_match() == 0) {
+        printf("PASS\n");
+    } else {
+        printf("FAIL\n");
+        result = 1;
+    }
+
+    printf("Test 3: Regex probability... ");
+    if (test_regex_probability() == 0) {
+        printf("PASS\n");
+    } else {
+        printf("FAIL\n");
+        result = 1;
+    }
+
+    return result;
+}